@@ -10,6 +10,7 @@
 #include <string.h>
 #include <stdarg.h>
 #include "mpi.h"
+#include "scr.h"
 
 typedef struct checkpoint_buf_t { char buf[7]; } checkpoint_buf_t;
 
@@ -243,3 +244,65 @@ int safe_snprintf(char* buf, size_t size, const char* fmt, ...)
 
   return rc;
 }
+
+/* print msg with the line number if cond is false, and return cond */
+int check(int cond, const char* msg, int line)
+{
+  if (! cond) {
+    fprintf(stderr, "Failed: %s in line %d\n", msg, line);
+  }
+  return cond;
+}
+
+/* fill buffer with a pattern that depends on rank */
+void fill_buffer(char* buf, size_t size, int rank)
+{
+  size_t i;
+  for (i = 0; i < size; i++) {
+    buf[i] = (char) ((rank + i) % 251);
+  }
+}
+
+/* compare contents of file with buf */
+int same_contents(const char* file, const char* buf, size_t size)
+{
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  char* data = (char*) malloc(size + 1);
+  ssize_t n = read(fd, data, size + 1);
+  close(fd);
+  int same = (n == (ssize_t) size && memcmp(data, buf, size) == 0);
+  free(data);
+  return same;
+}
+
+/* write a dataset with one file per process through SCR */
+int write_dataset(const char* dset, int flags, const char* name, const char* buf, size_t size)
+{
+  int valid = 1;
+
+  if (SCR_Start_output(dset, flags) != SCR_SUCCESS) {
+    return 0;
+  }
+
+  char file[SCR_MAX_FILENAME];
+  if (SCR_Route_file(name, file) == SCR_SUCCESS) {
+    int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0 || write(fd, buf, size) != (ssize_t) size) {
+      valid = 0;
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  } else {
+    valid = 0;
+  }
+
+  if (SCR_Complete_output(valid) != SCR_SUCCESS) {
+    valid = 0;
+  }
+
+  return valid;
+}
@@ -29,3 +29,15 @@ int read_checkpoint_file(char* file, int* ckpt, char* buf, size_t size);
 
 /* check for truncation on snprintf */
 int safe_snprintf(char* buf, size_t size, const char* fmt, ...);
+
+/* print msg with the line number if cond is false, and return cond */
+int check(int cond, const char* msg, int line);
+
+/* fill buffer with a pattern that depends on rank */
+void fill_buffer(char* buf, size_t size, int rank);
+
+/* compare contents of file with buf */
+int same_contents(const char* file, const char* buf, size_t size);
+
+/* write a dataset with one file per process through SCR */
+int write_dataset(const char* dset, int flags, const char* name, const char* buf, size_t size);
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "mpi.h"
+
+#include "test_common.h"
+
+#include "scr.h"
+#include "scr_globals.h"
+#include "scr_container.h"
+#include "scr_index_api.h"
+
+#include "spath.h"
+#include "kvtree.h"
+#include "kvtree_util.h"
+
+int main (int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int tests_passed = 1;
+
+  /* flush every checkpoint synchronously, aggregating files into containers */
+  SCR_Config("SCR_FLUSH=1");
+  SCR_Config("SCR_FLUSH_ASYNC=0");
+  SCR_Config("SCR_FLUSH_COMPRESS=NONE");
+  SCR_Config("SCR_FLUSH_AGGREGATE=1");
+
+  if (SCR_Init() != SCR_SUCCESS) {
+    fprintf(stderr, "Failed initializing SCR\n");
+    MPI_Finalize();
+    return 2;
+  }
+
+  /* give each process a file of a different size */
+  size_t size = 1000 + 100 * (size_t) rank;
+  char* buf = (char*) malloc(size);
+  fill_buffer(buf, size, rank);
+
+  char ckpt_name[256];
+  char output_name[256];
+  char fetch_name[256];
+  snprintf(ckpt_name,   sizeof(ckpt_name),   "rank_%d.test_container", rank);
+  snprintf(output_name, sizeof(output_name), "rank_%d.test_container.output", rank);
+  snprintf(fetch_name,  sizeof(fetch_name),  "rank_%d.test_container.fetched", rank);
+
+  /* a checkpoint is written to containers as it is flushed */
+  tests_passed &= check(write_dataset("test_container.ckpt", SCR_FLAG_CHECKPOINT, ckpt_name, buf, size),
+    "write checkpoint", __LINE__
+  );
+
+  /* output is flushed as individual files */
+  tests_passed &= check(write_dataset("test_container.output", SCR_FLAG_OUTPUT, output_name, buf, size),
+    "write output", __LINE__
+  );
+
+  SCR_Finalize();
+
+  tests_passed &= check(same_contents(output_name, buf, size), "output flushed as its own file", __LINE__);
+  tests_passed &= check(access(ckpt_name, F_OK) != 0, "checkpoint not flushed as its own file", __LINE__);
+
+  /* look up the id of the checkpoint in the index of the prefix directory */
+  int id = -1;
+  if (rank == 0) {
+    spath* prefix = spath_from_str(".");
+    kvtree* index = kvtree_new();
+    if (scr_index_read(prefix, index) == SCR_SUCCESS) {
+      scr_index_get_id_by_name(index, "test_container.ckpt", &id);
+    }
+    kvtree_delete(&index);
+    spath_delete(&prefix);
+  }
+  MPI_Bcast(&id, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  tests_passed &= check(id >= 0, "checkpoint in index", __LINE__);
+
+  /* find our file in the index of one of the containers of the checkpoint,
+   * without using the rank2file map */
+  char dsetdir[256];
+  snprintf(dsetdir, sizeof(dsetdir), ".scr/scr.dataset.%d", id);
+  char* container = NULL;
+  unsigned long offset = 0;
+  unsigned long length = 0;
+  int found = 0;
+  DIR* dir = opendir(dsetdir);
+  if (dir != NULL) {
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+      if (strncmp(entry->d_name, "ctr.", 4) != 0) {
+        continue;
+      }
+
+      char path[512];
+      snprintf(path, sizeof(path), "%s/%s", dsetdir, entry->d_name);
+      kvtree* index = kvtree_new();
+      tests_passed &= check(scr_container_read_index(path, index) == SCR_SUCCESS, "read container index", __LINE__);
+      kvtree* file_hash = kvtree_get_kv(index, SCR_KEY_FILE, ckpt_name);
+      if (file_hash != NULL) {
+        found++;
+        container = strdup(path);
+        kvtree_util_get_unsigned_long(file_hash, SCR_KEY_OFFSET, &offset);
+        kvtree_util_get_unsigned_long(file_hash, SCR_KEY_LENGTH, &length);
+      }
+      kvtree_delete(&index);
+    }
+    closedir(dir);
+  }
+  tests_passed &= check(found == 1, "file listed in one container", __LINE__);
+  tests_passed &= check(length == (unsigned long) size, "file length in container index", __LINE__);
+
+  /* extract our file from its container as a fetch would */
+  int count = (found == 1);
+  const char* fetch_file = fetch_name;
+  tests_passed &= check(scr_container_read(MPI_COMM_WORLD, count, (const char**) &container,
+    &offset, &length, &fetch_file) == SCR_SUCCESS, "read container", __LINE__
+  );
+  tests_passed &= check(same_contents(fetch_name, buf, size), "fetched file contents", __LINE__);
+
+  /* a container whose footer is damaged has no index */
+  if (found == 1) {
+    char copy[256];
+    snprintf(copy, sizeof(copy), "rank_%d.test_container.ctr", rank);
+    int fd = open(copy, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd >= 0) {
+      write(fd, "not a container footer, just some bytes", 40);
+      close(fd);
+    }
+    kvtree* index = kvtree_new();
+    tests_passed &= check(scr_container_read_index(copy, index) != SCR_SUCCESS, "read bad container index", __LINE__);
+    kvtree_delete(&index);
+    unlink(copy);
+  }
+
+  free(container);
+  free(buf);
+
+  unlink(fetch_name);
+  unlink(output_name);
+
+  MPI_Finalize();
+
+  int rc = tests_passed ? 0 : 2;
+  if (rc != 0) {
+    fprintf(stderr, "%s failed\n", argv[0]);
+  }
+
+  return rc;
+}
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mpi.h"
+
+#include "test_common.h"
+
+#include "scr.h"
+#include "scr_io.h"
+
+#include "zlib.h"
+
+/* files of at least this many bytes are split into more than one range,
+ * matches SCR_CRC32_MIN_RANGE in scr_io.c */
+#define MIN_RANGE (16*1024*1024)
+
+/* compare scr_crc32_buf against zlib over len bytes starting at buf,
+ * both from a fresh crc and continuing from a previous value */
+static int check_buf(const char* buf, size_t len, int line)
+{
+  int passed = 1;
+
+  uLong expected = crc32(0L, (const Bytef*) buf, (uInt) len);
+  uLong crc = scr_crc32_buf(crc32(0L, Z_NULL, 0), buf, len);
+  if (crc != expected) {
+    fprintf(stderr, "Buffer crc32 mismatch: len=%lu align=%lu got=%lx expected=%lx\n",
+      (unsigned long) len, (unsigned long) ((size_t) buf % 16), crc, expected
+    );
+    passed &= check(0, "crc32 of buffer", line);
+  }
+
+  /* split the buffer in two so the second call starts from a nonzero crc */
+  size_t half = len / 2;
+  crc = scr_crc32_buf(crc32(0L, Z_NULL, 0), buf, half);
+  crc = scr_crc32_buf(crc, buf + half, len - half);
+  if (crc != expected) {
+    fprintf(stderr, "Chained crc32 mismatch: len=%lu split=%lu got=%lx expected=%lx\n",
+      (unsigned long) len, (unsigned long) half, crc, expected
+    );
+    passed &= check(0, "chained crc32 of buffer", line);
+  }
+
+  return passed;
+}
+
+/* write size bytes of buf to file */
+static int write_file(const char* file, const char* buf, size_t size)
+{
+  int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    return 0;
+  }
+  int rc = (reliable_write(fd, buf, size) == (ssize_t) size);
+  close(fd);
+  return rc;
+}
+
+/* compare scr_crc32_parallel against zlib for a file holding the
+ * first size bytes of buf, using from one up to several threads */
+static int check_file(const char* file, const char* buf, size_t size, int line)
+{
+  int passed = 1;
+
+  passed &= check(write_file(file, buf, size), "write file", line);
+
+  uLong expected = crc32(0L, Z_NULL, 0);
+  size_t offset = 0;
+  while (offset < size) {
+    size_t count = size - offset;
+    if (count > MIN_RANGE) {
+      count = MIN_RANGE;
+    }
+    expected = crc32(expected, (const Bytef*) (buf + offset), (uInt) count);
+    offset += count;
+  }
+
+  int threads;
+  for (threads = 1; threads <= 4; threads++) {
+    uLong crc = 0;
+    passed &= check(scr_crc32_parallel(file, threads, &crc) == SCR_SUCCESS, "crc32 of file", line);
+    if (crc != expected) {
+      fprintf(stderr, "File crc32 mismatch: size=%lu threads=%d got=%lx expected=%lx\n",
+        (unsigned long) size, threads, crc, expected
+      );
+      passed &= check(0, "crc32 of file", line);
+    }
+  }
+
+  unlink(file);
+  return passed;
+}
+
+int main (int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int tests_passed = 1;
+
+  /* enough data for three full ranges and an odd tail */
+  size_t size = 3 * (size_t) MIN_RANGE + 12345;
+  char* buf = (char*) malloc(size + 16);
+  fill_buffer(buf, size + 16, rank);
+
+  /* short lengths take the zlib path, and those from 64 bytes up use
+   * the hardware kernel for all 16 byte blocks and zlib for the rest,
+   * so try every length across that boundary at every alignment */
+  size_t align;
+  for (align = 0; align < 16; align++) {
+    size_t len;
+    for (len = 0; len <= 300; len++) {
+      tests_passed &= check_buf(buf + align, len, __LINE__);
+    }
+  }
+
+  /* larger buffers whose length is not a multiple of 16 */
+  tests_passed &= check_buf(buf + 3, 4096 + 13, __LINE__);
+  tests_passed &= check_buf(buf + 1, 1024 * 1024 + 7, __LINE__);
+  tests_passed &= check_buf(buf, size, __LINE__);
+
+  char file[256];
+  snprintf(file, sizeof(file), "rank_%d.test_crc", rank);
+
+  /* empty, small and odd sized files are read as a single range */
+  tests_passed &= check_file(file, buf, 0, __LINE__);
+  tests_passed &= check_file(file, buf, 100, __LINE__);
+  tests_passed &= check_file(file, buf, 1024 * 1024 + 7, __LINE__);
+
+  /* a file of exactly one range, and files split into two and three ranges */
+  tests_passed &= check_file(file, buf, MIN_RANGE, __LINE__);
+  tests_passed &= check_file(file, buf, 2 * (size_t) MIN_RANGE + 1, __LINE__);
+  tests_passed &= check_file(file, buf, size, __LINE__);
+
+  free(buf);
+
+  MPI_Finalize();
+
+  int rc = tests_passed ? 0 : 2;
+  if (rc != 0) {
+    fprintf(stderr, "%s failed\n", argv[0]);
+  }
+
+  return rc;
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mpi.h"
+
+#include "test_common.h"
+
+#include "scr.h"
+#include "scr_globals.h"
+#include "scr_index_api.h"
+
+#include "spath.h"
+#include "kvtree.h"
+#include "kvtree_util.h"
+
+/* size of each block hashed for incremental checkpoints */
+#define BLOCK_SIZE (1024)
+
+/* number of blocks in the file of each process */
+#define BLOCKS (16)
+
+/* fill buffer with a pattern that depends on rank and step,
+ * only the second block changes from one step to the next */
+static void fill(char* buf, size_t size, int rank, int step)
+{
+  fill_buffer(buf, size, rank);
+  memset(buf + BLOCK_SIZE, step, BLOCK_SIZE);
+}
+
+/* write a checkpoint with one file per process through SCR */
+static int write_ckpt(const char* dset, const char* name, const char* buf, size_t size)
+{
+  char path[SCR_MAX_FILENAME];
+  snprintf(path, sizeof(path), "%s/%s", dset, name);
+  return write_dataset(dset, SCR_FLAG_CHECKPOINT, path, buf, size);
+}
+
+/* check that the file of this process in the second checkpoint was
+ * flushed as its changed blocks against the first checkpoint */
+static int check_flushed(int rank)
+{
+  int passed = 1;
+
+  /* look up the ids of the checkpoints in the index of the prefix directory */
+  int ids[2] = {-1, -1};
+  if (rank == 0) {
+    spath* prefix = spath_from_str(".");
+    kvtree* index = kvtree_new();
+    passed &= check(scr_index_read(prefix, index) == SCR_SUCCESS, "index read", __LINE__);
+    scr_index_get_id_by_name(index, "test_delta.1", &ids[0]);
+    scr_index_get_id_by_name(index, "test_delta.2", &ids[1]);
+
+    /* the first checkpoint is kept as long as the second needs it */
+    passed &= check(scr_index_is_base(index, ids[0]), "base pinned in index", __LINE__);
+    passed &= check(! scr_index_is_base(index, ids[1]), "delta not pinned in index", __LINE__);
+
+    int id;
+    char name[SCR_MAX_FILENAME];
+    scr_index_get_oldest_deletable(index, &id, name);
+    passed &= check(id == ids[1], "oldest deletable skips base", __LINE__);
+
+    kvtree_delete(&index);
+    spath_delete(&prefix);
+  }
+  MPI_Bcast(ids, 2, MPI_INT, 0, MPI_COMM_WORLD);
+  passed &= check(ids[0] >= 0 && ids[1] >= 0, "checkpoints in index", __LINE__);
+
+  /* the rank2file map lists the changed blocks and the id of their base */
+  char rank2file[256];
+  snprintf(rank2file, sizeof(rank2file), ".scr/scr.dataset.%d/rank2file", ids[1]);
+  kvtree* filelist = kvtree_new();
+  passed &= check(kvtree_read_scatter(rank2file, filelist, MPI_COMM_WORLD) == KVTREE_SUCCESS,
+    "read rank2file", __LINE__
+  );
+  kvtree* files = kvtree_get(filelist, SCR_KEY_FILE);
+  passed &= check(kvtree_size(files) == 1, "one file per process", __LINE__);
+  kvtree_elem* elem = kvtree_elem_first(files);
+  if (elem != NULL) {
+    const char* file = kvtree_elem_key(elem);
+    size_t len = strlen(file);
+    size_t suffix_len = strlen(SCR_DELTA_SUFFIX);
+    passed &= check(len > suffix_len && strcmp(file + len - suffix_len, SCR_DELTA_SUFFIX) == 0,
+      "changed blocks flushed", __LINE__
+    );
+
+    char* base;
+    int base_id = -1;
+    kvtree* hash = kvtree_elem_hash(elem);
+    if (kvtree_util_get_str(hash, SCR_KEY_BASE, &base) == KVTREE_SUCCESS) {
+      kvtree_util_get_int(kvtree_get_kv(hash, SCR_KEY_BASE, base), SCR_KEY_ID, &base_id);
+    }
+    passed &= check(base_id == ids[0], "base id in rank2file", __LINE__);
+  }
+  kvtree_delete(&filelist);
+
+  return passed;
+}
+
+int main (int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int tests_passed = 1;
+
+  /* on a restart, the checkpoints of the first run are in the prefix directory */
+  int expect_restart = 0;
+  if (rank == 0) {
+    expect_restart = (access(".scr/index.scr", F_OK) == 0);
+  }
+  MPI_Bcast(&expect_restart, 1, MPI_INT, 0, MPI_COMM_WORLD);
+
+  /* keep two checkpoints in cache so the second can be stored as the
+   * blocks that changed since the first, flush each synchronously
+   * into containers, and fetch from the prefix directory on restart */
+  SCR_Config("SCR_CACHE_SIZE=2");
+  SCR_Config("SCR_CACHE_PURGE=1");
+  SCR_Config("SCR_INCREMENTAL=1");
+  SCR_Configf("SCR_INCREMENTAL_BLOCK_SIZE=%d", BLOCK_SIZE);
+  SCR_Config("SCR_FLUSH=1");
+  SCR_Config("SCR_FLUSH_ASYNC=0");
+  SCR_Config("SCR_FLUSH_COMPRESS=NONE");
+  SCR_Config("SCR_FLUSH_AGGREGATE=1");
+
+  if (SCR_Init() != SCR_SUCCESS) {
+    fprintf(stderr, "Failed initializing SCR\n");
+    MPI_Finalize();
+    return 2;
+  }
+
+  size_t size = BLOCKS * BLOCK_SIZE;
+  char* buf = (char*) malloc(size);
+
+  char name[256];
+  snprintf(name, sizeof(name), "rank_%d.test_delta", rank);
+
+  int have_restart = 0;
+  char dset[SCR_MAX_FILENAME];
+  SCR_Have_restart(&have_restart, dset);
+  tests_passed &= check(have_restart == expect_restart, "fetch checkpoint on restart", __LINE__);
+  if (! have_restart) {
+    /* write two checkpoints that differ in one block */
+    fill(buf, size, rank, 1);
+    tests_passed &= check(write_ckpt("test_delta.1", name, buf, size), "write first checkpoint", __LINE__);
+    fill(buf, size, rank, 2);
+    tests_passed &= check(write_ckpt("test_delta.2", name, buf, size), "write second checkpoint", __LINE__);
+
+    SCR_Finalize();
+
+    tests_passed &= check_flushed(rank);
+  } else {
+    /* the restart fetched the changed blocks of the second checkpoint
+     * and rebuilt the full file from the first checkpoint */
+    tests_passed &= check(strcmp(dset, "test_delta.2") == 0, "restart from second checkpoint", __LINE__);
+    tests_passed &= check(SCR_Start_restart(dset) == SCR_SUCCESS, "start restart", __LINE__);
+
+    char path[SCR_MAX_FILENAME];
+    snprintf(path, sizeof(path), "%s/%s", dset, name);
+
+    int valid = 0;
+    char file[SCR_MAX_FILENAME];
+    if (SCR_Route_file(path, file) == SCR_SUCCESS) {
+      fill(buf, size, rank, 2);
+      valid = same_contents(file, buf, size);
+    }
+    tests_passed &= check(valid, "rebuilt file contents", __LINE__);
+    tests_passed &= check(SCR_Complete_restart(valid) == SCR_SUCCESS, "complete restart", __LINE__);
+
+    SCR_Finalize();
+  }
+
+  free(buf);
+
+  MPI_Finalize();
+
+  int rc = tests_passed ? 0 : 2;
+  if (rc != 0) {
+    fprintf(stderr, "%s failed\n", argv[0]);
+  }
+
+  return rc;
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "mpi.h"
+
+#include "test_common.h"
+
+#include "scr.h"
+#include "scr_io.h"
+
+#include "zlib.h"
+
+/* size of buffers used to copy files, a multiple of the O_DIRECT block size */
+#define BUF_SIZE (64*1024)
+
+/* write size bytes of buf to file */
+static int write_file(const char* file, const char* buf, size_t size)
+{
+  int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    return 0;
+  }
+  int rc = (reliable_write(fd, buf, size) == (ssize_t) size);
+  close(fd);
+  return rc;
+}
+
+/* copy src to dst with the given flags and check that dst holds the
+ * first size bytes of buf, and if with_crc is set, that the crc matches */
+static int check_copy(const char* src, const char* dst, const char* buf, size_t size,
+  int with_crc, int flags, int line)
+{
+  int passed = 1;
+
+  uLong crc = 0;
+  uLong* crc_ptr = with_crc ? &crc : NULL;
+  passed &= check(scr_file_copy(src, dst, BUF_SIZE, crc_ptr, flags) == SCR_SUCCESS, "file copy", line);
+  passed &= check(same_contents(dst, buf, size), "copied contents", line);
+
+  if (with_crc) {
+    uLong expected = crc32(0L, (const Bytef*) buf, (uInt) size);
+    if (crc != expected) {
+      fprintf(stderr, "Copy crc32 mismatch: size=%lu flags=%d got=%lx expected=%lx\n",
+        (unsigned long) size, flags, crc, expected
+      );
+      passed &= check(0, "copy crc32", line);
+    }
+  }
+
+  unlink(dst);
+  return passed;
+}
+
+/* write size bytes of buf to src and copy it in each of the ways
+ * scr_file_copy supports */
+static int check_copies(const char* src, const char* dst, const char* buf, size_t size, int line)
+{
+  int passed = 1;
+
+  passed &= check(write_file(src, buf, size), "write source file", line);
+
+  /* read and write with a crc, through the pipeline for large files */
+  passed &= check_copy(src, dst, buf, size, 1, 0, line);
+
+  /* O_DIRECT writes the tail that is not a multiple of the block size
+   * with O_DIRECT disabled, or falls back to buffered I/O entirely if
+   * the file system does not support it */
+  passed &= check_copy(src, dst, buf, size, 1, SCR_FILE_COPY_DIRECT, line);
+  passed &= check_copy(src, dst, buf, size, 0, SCR_FILE_COPY_DIRECT, line);
+
+  /* without a crc or O_DIRECT, the kernel copies the data */
+  passed &= check_copy(src, dst, buf, size, 0, 0, line);
+
+  unlink(src);
+  return passed;
+}
+
+/* copy from a FIFO fed by a child process, the kernel does not copy
+ * from pipes and the size of a FIFO is zero, so scr_file_copy must
+ * fall back to read and write until the end of the data */
+static int check_fifo(const char* fifo, const char* dst, const char* buf, size_t size, int line)
+{
+  int passed = 1;
+
+  unlink(fifo);
+  if (! check(mkfifo(fifo, S_IRUSR | S_IWUSR) == 0, "create fifo", line)) {
+    return 0;
+  }
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    int fd = open(fifo, O_WRONLY);
+    int rc = (fd >= 0 && reliable_write(fd, buf, size) == (ssize_t) size);
+    if (fd >= 0) {
+      close(fd);
+    }
+    _exit(rc ? 0 : 1);
+  }
+  passed &= check(pid > 0, "fork fifo writer", line);
+
+  if (pid > 0) {
+    passed &= check_copy(fifo, dst, buf, size, 0, 0, line);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    passed &= check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "fifo writer", line);
+  }
+
+  unlink(fifo);
+  return passed;
+}
+
+int main (int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int tests_passed = 1;
+
+  size_t size = 64 * BUF_SIZE + 123;
+  char* buf = (char*) malloc(size);
+  fill_buffer(buf, size, rank);
+
+  char src[256];
+  char dst[256];
+  char fifo[256];
+  snprintf(src,  sizeof(src),  "rank_%d.test_file_copy", rank);
+  snprintf(dst,  sizeof(dst),  "rank_%d.test_file_copy.copy", rank);
+  snprintf(fifo, sizeof(fifo), "rank_%d.test_file_copy.fifo", rank);
+
+  /* empty files, and files smaller than one buffer */
+  tests_passed &= check_copies(src, dst, buf, 0, __LINE__);
+  tests_passed &= check_copies(src, dst, buf, 100, __LINE__);
+
+  /* a few buffers are copied serially, with and without a partial last buffer */
+  tests_passed &= check_copies(src, dst, buf, 3 * BUF_SIZE, __LINE__);
+  tests_passed &= check_copies(src, dst, buf, 3 * BUF_SIZE + 4096 + 7, __LINE__);
+
+  /* many buffers go through the reader and writer threads */
+  tests_passed &= check_copies(src, dst, buf, 64 * BUF_SIZE, __LINE__);
+  tests_passed &= check_copies(src, dst, buf, size, __LINE__);
+
+  /* data the kernel will not copy */
+  tests_passed &= check_fifo(fifo, dst, buf, size, __LINE__);
+
+  free(buf);
+
+  MPI_Finalize();
+
+  int rc = tests_passed ? 0 : 2;
+  if (rc != 0) {
+    fprintf(stderr, "%s failed\n", argv[0]);
+  }
+
+  return rc;
+}
@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mpi.h"
+
+#include "test_common.h"
+
+#include "scr.h"
+#include "scr_meta.h"
+#include "scr_filemap.h"
+
+#include "spath.h"
+#include "kvtree.h"
+
+#define NFILES (20)
+
+/* build a filemap listing NFILES files with a few metadata fields set */
+static scr_filemap* build_map(int rank)
+{
+  scr_filemap* map = scr_filemap_new();
+
+  kvtree* dataset = kvtree_new();
+  kvtree_util_set_int(dataset, "ID", 7);
+  scr_filemap_set_dataset(map, dataset);
+  kvtree_delete(&dataset);
+
+  int i;
+  for (i = 0; i < NFILES; i++) {
+    char file[256];
+    char name[256];
+    snprintf(file, sizeof(file), "/cache/scr.dataset.7/rank_%d.%d.ckpt", rank, i);
+    snprintf(name, sizeof(name), "rank_%d.%d.ckpt", rank, i);
+
+    scr_meta* meta = scr_meta_new();
+    scr_meta_set_origpath(meta, "/prefix/ckpt.7");
+    scr_meta_set_origname(meta, name);
+    scr_meta_set_filesize(meta, (unsigned long) (1000 + i));
+    scr_meta_set_complete(meta, 1);
+    scr_meta_set_ranks(meta, 4);
+    if (i % 2 == 0) {
+      scr_meta_set_crc32(meta, (uLong) (0xabc00000 + i));
+    }
+
+    scr_filemap_add_file(map, file);
+    scr_filemap_set_meta(map, file, meta);
+    scr_meta_delete(&meta);
+  }
+
+  return map;
+}
+
+/* check that every file in the map can be found in the view with matching fields */
+static int check_view(const scr_filemap_view* view, int rank)
+{
+  int passed = 1;
+
+  passed &= check(scr_filemap_view_num_files(view) == NFILES, "view file count", __LINE__);
+
+  int i;
+  for (i = 0; i < NFILES; i++) {
+    char file[256];
+    char name[256];
+    snprintf(file, sizeof(file), "/cache/scr.dataset.7/rank_%d.%d.ckpt", rank, i);
+    snprintf(name, sizeof(name), "rank_%d.%d.ckpt", rank, i);
+
+    int index = scr_filemap_view_find(view, file);
+    passed &= check(index >= 0, "view find", __LINE__);
+    if (index < 0) {
+      continue;
+    }
+
+    scr_filemap_record rec;
+    passed &= check(scr_filemap_view_get(view, index, &rec) == SCR_SUCCESS, "view get", __LINE__);
+    passed &= check(rec.file != NULL && strcmp(rec.file, file) == 0, "record file", __LINE__);
+    passed &= check(rec.origpath != NULL && strcmp(rec.origpath, "/prefix/ckpt.7") == 0, "record origpath", __LINE__);
+    passed &= check(rec.origname != NULL && strcmp(rec.origname, name) == 0, "record origname", __LINE__);
+    passed &= check(rec.complete == 1, "record complete", __LINE__);
+    passed &= check(rec.ranks == 4, "record ranks", __LINE__);
+    passed &= check(rec.have_filesize && rec.filesize == (unsigned long) (1000 + i), "record filesize", __LINE__);
+    if (i % 2 == 0) {
+      passed &= check(rec.have_crc32 && rec.crc32 == (uLong) (0xabc00000 + i), "record crc32", __LINE__);
+    } else {
+      passed &= check(! rec.have_crc32, "record without crc32", __LINE__);
+    }
+  }
+
+  passed &= check(scr_filemap_view_find(view, "/cache/not_listed") == -1, "view find missing file", __LINE__);
+
+  scr_filemap_record rec;
+  passed &= check(scr_filemap_view_get(view, NFILES, &rec) != SCR_SUCCESS, "view get out of range", __LINE__);
+
+  return passed;
+}
+
+/* check that a filemap read back from a file matches the one we wrote */
+static int check_read(const spath* path, int rank)
+{
+  int passed = 1;
+
+  scr_filemap* map = scr_filemap_new();
+  passed &= check(scr_filemap_read(path, map) == SCR_SUCCESS, "filemap read", __LINE__);
+  passed &= check(scr_filemap_num_files(map) == NFILES, "read file count", __LINE__);
+
+  kvtree* dataset = kvtree_new();
+  int id = -1;
+  scr_filemap_get_dataset(map, dataset);
+  kvtree_util_get_int(dataset, "ID", &id);
+  passed &= check(id == 7, "read dataset id", __LINE__);
+  kvtree_delete(&dataset);
+
+  char file[256];
+  snprintf(file, sizeof(file), "/cache/scr.dataset.7/rank_%d.%d.ckpt", rank, NFILES - 1);
+  scr_meta* meta = scr_meta_new();
+  unsigned long filesize = 0;
+  passed &= check(scr_filemap_get_meta(map, file, meta) == SCR_SUCCESS, "read meta", __LINE__);
+  scr_meta_get_filesize(meta, &filesize);
+  passed &= check(filesize == (unsigned long) (1000 + NFILES - 1), "read meta filesize", __LINE__);
+  scr_meta_delete(&meta);
+
+  scr_filemap_delete(&map);
+  return passed;
+}
+
+/* overwrite bytes at the given offset of a file, header fields are big-endian */
+static int poke(const char* file, off_t offset, const void* buf, size_t size)
+{
+  int fd = open(file, O_WRONLY);
+  if (fd < 0) {
+    return 0;
+  }
+  int rc = (pwrite(fd, buf, size, offset) == (ssize_t) size);
+  close(fd);
+  return rc;
+}
+
+int main (int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int tests_passed = 1;
+
+  char binfile[256];
+  char oldfile[256];
+  snprintf(binfile, sizeof(binfile), "test_filemap.%d.scrinfo", rank);
+  snprintf(oldfile, sizeof(oldfile), "test_filemap.%d.old.scrinfo", rank);
+  spath* binpath = spath_from_str(binfile);
+  spath* oldpath = spath_from_str(oldfile);
+
+  scr_filemap* map = build_map(rank);
+
+  /* round trip through the binary format */
+  tests_passed &= check(scr_filemap_write(binpath, map) == SCR_SUCCESS, "filemap write", __LINE__);
+  scr_filemap_view* view = scr_filemap_view_open(binpath);
+  tests_passed &= check(view != NULL, "view open", __LINE__);
+  if (view != NULL) {
+    tests_passed &= check_view(view, rank);
+    scr_filemap_view_close(&view);
+  }
+  tests_passed &= check_read(binpath, rank);
+
+  /* filemaps written as a kvtree by earlier versions are still read */
+  tests_passed &= check(kvtree_write_file(oldfile, map) == KVTREE_SUCCESS, "kvtree write", __LINE__);
+  view = scr_filemap_view_open(oldpath);
+  tests_passed &= check(view != NULL, "view open kvtree file", __LINE__);
+  if (view != NULL) {
+    tests_passed &= check_view(view, rank);
+    scr_filemap_view_close(&view);
+  }
+  tests_passed &= check_read(oldpath, rank);
+
+  /* an unknown version is rejected */
+  unsigned char version[4] = {0, 0, 0, 99};
+  tests_passed &= check(poke(binfile, 8, version, sizeof(version)), "corrupt version", __LINE__);
+  view = scr_filemap_view_open(binpath);
+  tests_passed &= check(view == NULL, "view open bad version", __LINE__);
+  scr_filemap* bad = scr_filemap_new();
+  tests_passed &= check(scr_filemap_read(binpath, bad) != SCR_SUCCESS, "read bad version", __LINE__);
+  scr_filemap_delete(&bad);
+
+  /* a section that runs past the end of the file is rejected */
+  tests_passed &= check(scr_filemap_write(binpath, map) == SCR_SUCCESS, "filemap rewrite", __LINE__);
+  unsigned char nfiles[4] = {0x7f, 0xff, 0xff, 0xff};
+  tests_passed &= check(poke(binfile, 12, nfiles, sizeof(nfiles)), "corrupt file count", __LINE__);
+  view = scr_filemap_view_open(binpath);
+  tests_passed &= check(view == NULL, "view open bad file count", __LINE__);
+  bad = scr_filemap_new();
+  tests_passed &= check(scr_filemap_read(binpath, bad) != SCR_SUCCESS, "read bad file count", __LINE__);
+  scr_filemap_delete(&bad);
+
+  /* a tree size that disagrees with the packed tree is rejected */
+  tests_passed &= check(scr_filemap_write(binpath, map) == SCR_SUCCESS, "filemap rewrite", __LINE__);
+  unsigned char treesize[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+  tests_passed &= check(poke(binfile, 64, treesize, sizeof(treesize)), "corrupt tree size", __LINE__);
+  bad = scr_filemap_new();
+  tests_passed &= check(scr_filemap_read(binpath, bad) != SCR_SUCCESS, "read bad tree size", __LINE__);
+  tests_passed &= check(scr_filemap_num_files(bad) == 0, "read bad tree size leaves map empty", __LINE__);
+  scr_filemap_delete(&bad);
+
+  /* a packed tree whose bytes changed is rejected before it is unpacked,
+   * the tree is the last section of the file */
+  tests_passed &= check(scr_filemap_write(binpath, map) == SCR_SUCCESS, "filemap rewrite", __LINE__);
+  struct stat st;
+  tests_passed &= check(stat(binfile, &st) == 0, "stat filemap", __LINE__);
+  unsigned char treebyte[1] = {0xff};
+  tests_passed &= check(poke(binfile, st.st_size - 2, treebyte, sizeof(treebyte)), "corrupt tree", __LINE__);
+  bad = scr_filemap_new();
+  tests_passed &= check(scr_filemap_read(binpath, bad) != SCR_SUCCESS, "read bad tree", __LINE__);
+  tests_passed &= check(scr_filemap_num_files(bad) == 0, "read bad tree leaves map empty", __LINE__);
+  scr_filemap_delete(&bad);
+
+  scr_filemap_delete(&map);
+
+  unlink(binfile);
+  unlink(oldfile);
+  spath_delete(&binpath);
+  spath_delete(&oldpath);
+
+  MPI_Finalize();
+
+  int rc = tests_passed ? 0 : 2;
+  if (rc != 0) {
+    fprintf(stderr, "%s failed\n", argv[0]);
+  }
+
+  return rc;
+}
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mpi.h"
+
+#include "test_common.h"
+
+#include "scr.h"
+#include "scr_dataset.h"
+#include "scr_index_api.h"
+
+#include "spath.h"
+#include "kvtree.h"
+
+/* add a complete checkpoint with the given id to the index */
+static void add_ckpt(kvtree* index, int id)
+{
+  char name[64];
+  snprintf(name, sizeof(name), "ckpt.%d", id);
+
+  scr_dataset* dataset = scr_dataset_new();
+  scr_dataset_set_id(dataset, id);
+  scr_dataset_set_name(dataset, name);
+  scr_dataset_set_flags(dataset, SCR_FLAG_CHECKPOINT);
+  scr_dataset_set_ckpt(dataset, id);
+  scr_index_set_dataset(index, id, name, dataset, 1);
+  scr_dataset_delete(&dataset);
+}
+
+/* read the index from dir into a new hash and check which of ids 1..max are listed */
+static int check_ids(const spath* dir, int max, const int* expected, int line)
+{
+  int passed = 1;
+
+  kvtree* index = kvtree_new();
+  passed &= check(scr_index_read(dir, index) == SCR_SUCCESS, "index read", line);
+
+  int id;
+  for (id = 1; id <= max; id++) {
+    char name[64];
+    snprintf(name, sizeof(name), "ckpt.%d", id);
+    int found_id = -1;
+    int found = (scr_index_get_id_by_name(index, name, &found_id) == SCR_SUCCESS && found_id == id);
+    if (found != expected[id - 1]) {
+      fprintf(stderr, "Dataset %d %s, expected it %s\n",
+        id, found ? "listed" : "missing", expected[id - 1] ? "listed" : "missing"
+      );
+      passed &= check(0, "index contents", line);
+    }
+  }
+
+  kvtree_delete(&index);
+  return passed;
+}
+
+static off_t file_size(const char* file)
+{
+  struct stat st;
+  if (stat(file, &st) != 0) {
+    return -1;
+  }
+  return st.st_size;
+}
+
+int main (int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  int tests_passed = 1;
+
+  /* each process works in its own prefix directory */
+  char dirname[256];
+  char scrdir[256];
+  char index_file[256];
+  char journal_file[256];
+  snprintf(dirname, sizeof(dirname), "test_index.d.%d", rank);
+  snprintf(scrdir, sizeof(scrdir), "%s/.scr", dirname);
+  snprintf(index_file, sizeof(index_file), "%s/index.scr", scrdir);
+  snprintf(journal_file, sizeof(journal_file), "%s/index.scr.journal", scrdir);
+  unlink(index_file);
+  unlink(journal_file);
+  mkdir(dirname, S_IRWXU);
+  mkdir(scrdir, S_IRWXU);
+  spath* dir = spath_from_str(dirname);
+
+  /* rewrite the index file after every fourth journal record */
+  scr_index_set_journal_records(4);
+
+  int expected[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+  /* the first write creates the index file */
+  kvtree* index = kvtree_new();
+  add_ckpt(index, 1);
+  expected[0] = 1;
+  tests_passed &= check(scr_index_write(dir, index) == SCR_SUCCESS, "index write", __LINE__);
+  tests_passed &= check(file_size(journal_file) < 0, "no journal after first write", __LINE__);
+  off_t base_size = file_size(index_file);
+
+  /* later writes append to the journal and leave the index file alone */
+  add_ckpt(index, 2);
+  expected[1] = 1;
+  tests_passed &= check(scr_index_write(dir, index) == SCR_SUCCESS, "index write", __LINE__);
+  add_ckpt(index, 3);
+  expected[2] = 1;
+  tests_passed &= check(scr_index_write(dir, index) == SCR_SUCCESS, "index write", __LINE__);
+  tests_passed &= check(file_size(journal_file) > 0, "journal appended", __LINE__);
+  tests_passed &= check(file_size(index_file) == base_size, "index file unchanged", __LINE__);
+
+  /* a write that changes nothing appends nothing */
+  off_t journal_size = file_size(journal_file);
+  tests_passed &= check(scr_index_write(dir, index) == SCR_SUCCESS, "index write", __LINE__);
+  tests_passed &= check(file_size(journal_file) == journal_size, "unchanged index appends nothing", __LINE__);
+
+  /* replaying the journal gives back every dataset */
+  tests_passed &= check_ids(dir, 8, expected, __LINE__);
+
+  /* the sorted ids follow datasets as they are added and removed */
+  int id;
+  char name[SCR_MAX_FILENAME];
+  scr_index_get_oldest(index, &id, name);
+  tests_passed &= check(id == 1 && strcmp(name, "ckpt.1") == 0, "oldest dataset", __LINE__);
+  scr_index_get_most_recent_complete(index, -1, &id, name);
+  tests_passed &= check(id == 3, "most recent dataset", __LINE__);
+  scr_index_get_most_recent_complete(index, 3, &id, name);
+  tests_passed &= check(id == 2, "most recent dataset before 3", __LINE__);
+  scr_index_remove(index, "ckpt.1");
+  expected[0] = 0;
+  scr_index_get_oldest(index, &id, name);
+  tests_passed &= check(id == 2, "oldest dataset after remove", __LINE__);
+  add_ckpt(index, 4);
+  expected[3] = 1;
+  scr_index_get_most_recent_complete(index, -1, &id, name);
+  tests_passed &= check(id == 4, "most recent dataset after add", __LINE__);
+
+  /* a removal is journaled too */
+  tests_passed &= check(scr_index_write(dir, index) == SCR_SUCCESS, "index write", __LINE__);
+  tests_passed &= check_ids(dir, 8, expected, __LINE__);
+
+  /* a record whose crc does not match is dropped on replay along with
+   * anything after it, flip the last byte of the journal */
+  int fd = open(journal_file, O_RDWR);
+  tests_passed &= check(fd >= 0, "open journal", __LINE__);
+  if (fd >= 0) {
+    unsigned char byte;
+    off_t last = file_size(journal_file) - 1;
+    pread(fd, &byte, 1, last);
+    byte ^= 0xff;
+    pwrite(fd, &byte, 1, last);
+    close(fd);
+  }
+  int torn_expected[8];
+  memcpy(torn_expected, expected, sizeof(expected));
+  torn_expected[0] = 1;
+  torn_expected[3] = 0;
+  tests_passed &= check_ids(dir, 8, torn_expected, __LINE__);
+
+  /* after a bad record, the next write rewrites the index file
+   * instead of appending after it */
+  kvtree_delete(&index);
+  index = kvtree_new();
+  scr_index_read(dir, index);
+  scr_index_remove(index, "ckpt.1");
+  add_ckpt(index, 4);
+  tests_passed &= check(scr_index_write(dir, index) == SCR_SUCCESS, "index write", __LINE__);
+  tests_passed &= check(file_size(journal_file) < 0, "journal removed after rewrite", __LINE__);
+  tests_passed &= check_ids(dir, 8, expected, __LINE__);
+
+  /* a record cut short is ignored the same way */
+  fd = open(journal_file, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  tests_passed &= check(fd >= 0, "create journal", __LINE__);
+  if (fd >= 0) {
+    unsigned char header[12] = {0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0};
+    write(fd, header, sizeof(header));
+    close(fd);
+  }
+  tests_passed &= check_ids(dir, 8, expected, __LINE__);
+  unlink(journal_file);
+
+  /* once the journal holds four records, the next write compacts
+   * it into the index file */
+  kvtree_delete(&index);
+  index = kvtree_new();
+  scr_index_read(dir, index);
+  for (id = 5; id <= 8; id++) {
+    add_ckpt(index, id);
+    expected[id - 1] = 1;
+    tests_passed &= check(scr_index_write(dir, index) == SCR_SUCCESS, "index write", __LINE__);
+    tests_passed &= check(file_size(journal_file) > 0, "journal appended", __LINE__);
+  }
+  scr_index_remove(index, "ckpt.2");
+  expected[1] = 0;
+  tests_passed &= check(scr_index_write(dir, index) == SCR_SUCCESS, "index write", __LINE__);
+  tests_passed &= check(file_size(journal_file) < 0, "journal compacted", __LINE__);
+  tests_passed &= check_ids(dir, 8, expected, __LINE__);
+
+  kvtree_delete(&index);
+
+  unlink(index_file);
+  unlink(journal_file);
+  rmdir(scrdir);
+  rmdir(dirname);
+  spath_delete(&dir);
+
+  MPI_Finalize();
+
+  int rc = tests_passed ? 0 : 2;
+  if (rc != 0) {
+    fprintf(stderr, "%s failed\n", argv[0]);
+  }
+
+  return rc;
+}
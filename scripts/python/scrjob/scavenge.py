@@ -29,10 +29,14 @@ def scavenge_files(jobenv,
     # lookup buffer size and crc flag via scr_param
     param = jobenv.param
 
-    # used as buffer size when doing file copy operations from cache to prefix directory
-    buf_size = os.environ.get('SCR_FILE_BUF_SIZE')
-    if buf_size is None:
-        buf_size = str(1024 * 1024)
+    # used as buffer size when doing file copy operations from cache to prefix directory,
+    # if not set, scr_copy uses the same default as the library
+    buf_size = param.get('SCR_FILE_BUF_SIZE')
+
+    # number of threads scr_copy uses to copy files on each node
+    threads = param.get('SCR_SCAVENGE_THREADS')
+    if threads is None:
+        threads = '4'
 
     # enable CRC on flush by default
     # computes CRC when copying files, checks against CRC recorded for file if it exists
@@ -65,11 +69,16 @@ def scavenge_files(jobenv,
         cntldir,
         '--prefix',
         prefix,
-        '--buf',
-        buf_size,
+        '--threads',
+        threads,
     ]
+    if buf_size is not None:
+        argv.extend(['--buf-size', buf_size])
     if crc_flag:
         argv.append(crc_flag)
+    if verbose:
+        # print time taken to copy each file
+        argv.append('--timing')
     if nodes_down:
         argv.extend(nodes_down)
     result = jobenv.rexec.rexec(argv, nodes, jobenv)
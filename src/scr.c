@@ -236,6 +236,9 @@ static int scr_flush_finalize(void)
     scr_flush_async_finalize();
   }
 
+  /* free list of directories created during flush */
+  scr_flush_create_dirs_reset();
+
   return SCR_SUCCESS;
 }
 
@@ -1038,6 +1041,15 @@ static int scr_get_params()
     scr_dbg(1, "SCR_FETCH_BYPASS=%d", scr_fetch_bypass);
   }
 
+  /* rather than wait for all files to be copied to cache on fetch,
+   * have route_file wait on each file as it's needed during restart */
+  if ((value = scr_param_get("SCR_FETCH_STREAM")) != NULL) {
+    scr_fetch_stream = atoi(value);
+  }
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "SCR_FETCH_STREAM=%d", scr_fetch_stream);
+  }
+
   /* specify number of processes to read files simultaneously */
   if ((value = scr_param_get("SCR_FETCH_WIDTH")) != NULL) {
     scr_fetch_width = atoi(value);
@@ -1046,6 +1058,14 @@ static int scr_get_params()
     scr_dbg(1, "SCR_FETCH_WIDTH=%d", scr_fetch_width);
   }
 
+  /* whether to start new readers as soon as others finish during fetch */
+  if ((value = scr_param_get("SCR_FETCH_PIPELINE")) != NULL) {
+    scr_fetch_pipeline = atoi(value);
+  }
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "SCR_FETCH_PIPELINE=%d", scr_fetch_pipeline);
+  }
+
   /* allow user to specify checkpoint to start with on fetch */
   if ((value = scr_param_get("SCR_CURRENT")) != NULL) {
     scr_fetch_current = strdup(value);
@@ -1070,6 +1090,14 @@ static int scr_get_params()
     scr_dbg(1, "SCR_FLUSH_WIDTH=%d", scr_flush_width);
   }
 
+  /* specify whether to aggregate files into containers during flush */
+  if ((value = scr_param_get("SCR_FLUSH_AGGREGATE")) != NULL) {
+    scr_flush_aggregate = atoi(value);
+  }
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "SCR_FLUSH_AGGREGATE=%d", scr_flush_aggregate);
+  }
+
   /* specify flush transfer type */
   if ((value = scr_param_get("SCR_FLUSH_TYPE")) != NULL) {
     scr_flush_type = strdup(value);
@@ -1080,6 +1108,22 @@ static int scr_get_params()
     scr_dbg(1, "SCR_FLUSH_TYPE=%s", scr_flush_type);
   }
 
+  /* specify codec and level to compress files during flush */
+  if ((value = scr_param_get("SCR_FLUSH_COMPRESS")) == NULL) {
+    value = SCR_FLUSH_COMPRESS;
+  }
+  if (scr_compress_parse(value, &scr_flush_compress, &scr_flush_compress_level) != SCR_SUCCESS) {
+    scr_err("Failed to read SCR_FLUSH_COMPRESS successfully, disabling compression @ %s:%d",
+      __FILE__, __LINE__
+    );
+    scr_flush_compress = SCR_COMPRESS_NONE;
+  }
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "SCR_FLUSH_COMPRESS=%s:%d",
+      scr_compress_name(scr_flush_compress), scr_flush_compress_level
+    );
+  }
+
   /* specify whether to always flush latest checkpoint from cache on restart */
   if ((value = scr_param_get("SCR_FLUSH_ON_RESTART")) != NULL) {
     scr_flush_on_restart = atoi(value);
@@ -1116,6 +1160,16 @@ static int scr_get_params()
     scr_dbg(1, "SCR_PREFIX_SIZE=%d", scr_prefix_size);
   }
 
+  /* specify number of changes to append to the index journal before
+   * the index file is rewritten, set to 0 to rewrite it on every update */
+  if ((value = scr_param_get("SCR_INDEX_JOURNAL_RECORDS")) != NULL) {
+    scr_index_journal_records = atoi(value);
+  }
+  scr_index_set_journal_records(scr_index_journal_records);
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "SCR_INDEX_JOURNAL_RECORDS=%d", scr_index_journal_records);
+  }
+
   /* Some applications provide options so their users can wipe out all checkpoints
    * and start over.  While one could call SCR_Delete for each of those in turn,
    * we provide this option as a convenience.  If set, SCR will read the index file
@@ -1135,6 +1189,28 @@ static int scr_get_params()
     scr_dbg(1, "SCR_FLUSH_ASYNC=%d", scr_flush_async);
   }
 
+  /* specify whether to store only the changed blocks of checkpoint files */
+  if ((value = scr_param_get("SCR_INCREMENTAL")) != NULL) {
+    scr_incremental = atoi(value);
+  }
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "SCR_INCREMENTAL=%d", scr_incremental);
+  }
+
+  /* set block size used to detect changes for incremental checkpoints */
+  if ((value = scr_param_get("SCR_INCREMENTAL_BLOCK_SIZE")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS && ull > 0) {
+      scr_incremental_block_size = (unsigned long) ull;
+    } else {
+      scr_err("Failed to read SCR_INCREMENTAL_BLOCK_SIZE successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "SCR_INCREMENTAL_BLOCK_SIZE=%lu", scr_incremental_block_size);
+  }
+
  /* Specify whether our flush will be finalized in poststage (currently
   * only supported with BBAPI). */
   if ((value = scr_param_get("SCR_FLUSH_POSTSTAGE")) != NULL) {
@@ -1244,6 +1320,23 @@ static int scr_get_params()
     scr_dbg(1, "SCR_CRC_ON_DELETE=%d" , scr_crc_on_delete);
   }
 
+  /* specify max number of threads to use when computing CRC of a file */
+  if ((value = scr_param_get("SCR_CRC_THREADS")) != NULL) {
+    scr_crc_threads = atoi(value);
+  }
+  scr_crc32_set_threads(scr_crc_threads);
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "SCR_CRC_THREADS=%d", scr_crc_threads);
+  }
+
+  /* specify max number of threads to use when checking files of a dataset */
+  if ((value = scr_param_get("SCR_STAT_THREADS")) != NULL) {
+    scr_stat_threads = atoi(value);
+  }
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "SCR_STAT_THREADS=%d", scr_stat_threads);
+  }
+
   /* override default checkpoint interval
    * (number of times to call Need_checkpoint between checkpoints) */
   if ((value = scr_param_get("SCR_CHECKPOINT_INTERVAL")) != NULL) {
@@ -1300,6 +1393,35 @@ Common code for Start/Complete output/checkpoint
 =========================================
 */
 
+/* wait for a streaming fetch to copy all files to cache, if any process
+ * failed to copy its files, delete the dataset and forget the checkpoint */
+static int scr_fetch_stream_finish(void)
+{
+  /* nothing to do if we're not streaming */
+  if (! scr_fetch_stream_in_progress()) {
+    return SCR_SUCCESS;
+  }
+
+  if (scr_fetch_stream_complete(scr_cindex) != SCR_SUCCESS) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Failed to fetch checkpoint %d into cache, discarding it @ %s:%d",
+        scr_ckpt_dset_id, __FILE__, __LINE__
+      );
+      if (scr_log_enable) {
+        scr_log_event("FETCH_FAIL", NULL, &scr_ckpt_dset_id, NULL, NULL, NULL);
+      }
+    }
+    scr_cache_delete(scr_cindex, scr_ckpt_dset_id);
+    scr_have_restart  = 0;
+    scr_dataset_id    = 0;
+    scr_checkpoint_id = 0;
+    scr_ckpt_dset_id  = 0;
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
 /* start phase for a new output dataset */
 static int scr_start_output(const char* name, int flags)
 {
@@ -1317,6 +1439,14 @@ static int scr_start_output(const char* name, int flags)
   /* make sure everyone is ready to start before we delete any existing checkpoints */
   MPI_Barrier(scr_comm_world);
 
+  /* any checkpoint we fetched must be fully in cache, if it could not be
+   * fetched, it has been dropped and there is no longer a restart */
+  if (scr_fetch_stream_finish() != SCR_SUCCESS) {
+    scr_dbg(1, "Dropped checkpoint that failed to stream into cache before starting %s @ %s:%d",
+      name, __FILE__, __LINE__
+    );
+  }
+
   /* determine whether this is a checkpoint */
   int is_ckpt = (flags & SCR_FLAG_CHECKPOINT);
 
@@ -1507,7 +1637,12 @@ static int scr_start_output(const char* name, int flags)
       base = sd->name;
       if (base != NULL) {
         if (strcmp(base, scr_rd->base) == 0) {
-          if (! scr_flush_file_is_flushing(dsets[i])) {
+          if (scr_incremental && scr_delta_is_base(scr_cindex, dsets[i])) {
+            /* a newer incremental checkpoint that has not been flushed yet
+             * needs the full files of this dataset to be rebuilt, skip it,
+             * the loop goes on to consider newer datasets for deletion */
+            continue;
+          } else if (! scr_flush_file_is_flushing(dsets[i])) {
             /* this dataset is in our base, and it's not being flushed, so delete it */
             scr_cache_delete(scr_cindex, dsets[i]);
             nckpts_base--;
@@ -1523,38 +1658,19 @@ static int scr_start_output(const char* name, int flags)
   /* if we still don't have room and we're flushing,
    * the dataset we need to delete must be flushing, so wait for it to finish */
   if (nckpts_base >= size && flushing != -1) {
-    /* in case there are ongoing flush operations from other cache
-     * base locations, finalize datasets in order up to our target id
-     * so that we don't mess up our current pointer */
-
+    /* flushes may complete out of order, so we only need to wait on
+     * the dataset we want to delete, while waiting any other flushes
+     * that finish are completed as well */
     double scr_time_wait_start = MPI_Wtime();
 
-    /* get full list of ids for ongoing flushes */
-    int flush_num = 0;
-    int* flush_ids = NULL;
-    scr_flush_async_get_list(scr_cindex, &flush_num, &flush_ids);
-
-    /* wait for each dataset up to and including the one we need
-     * to complete */
-    for (i = 0; i < flush_num; i++) {
-      /* wait for this dataset to complete its flush */
-      int id = flush_ids[i];
-      int flush_rc = scr_flush_async_wait(scr_cindex, id);
-      if (flush_rc != SCR_SUCCESS) {
-        scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
-          id, __FILE__, __LINE__
-        );
-      }
-
-      /* can break once the target id is done */
-      if (id == flushing) {
-        break;
-      }
+    /* wait for this dataset to complete its flush */
+    int flush_rc = scr_flush_async_wait(scr_cindex, flushing);
+    if (flush_rc != SCR_SUCCESS) {
+      scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
+        flushing, __FILE__, __LINE__
+      );
     }
 
-    /* free list of flush ids */
-    scr_free(&flush_ids);
-
     /* now dataset is no longer flushing, we can delete it and continue on */
     scr_cache_delete(scr_cindex, flushing);
     nckpts_base--;
@@ -1640,8 +1756,7 @@ static int scr_assign_ownership(scr_filemap* map, const scr_reddesc* rd)
     mapfiles[i] = strdup(file);
 
     /* get metadata for this file from file map */
-    scr_meta* meta = scr_meta_new();
-    scr_filemap_get_meta(map, file, meta);
+    const scr_meta* meta = scr_filemap_peek_meta(map, file);
 
     /* get the directory to the file in the prefix directory */
     char* origpath;
@@ -1659,9 +1774,6 @@ static int scr_assign_ownership(scr_filemap* map, const scr_reddesc* rd)
     filelist[i] = spath_strdup(path);
     spath_delete(&path);
 
-    /* free meta data */
-    scr_meta_delete(&meta);
-
     /* move on to the next file */
     i++;
   }
@@ -1763,24 +1875,39 @@ static int scr_complete_output(int valid)
    * file in their file map. */
   rc = scr_assign_ownership(scr_map, scr_rd);
 
-  /* count number of files, number of bytes, and record filesize for each file
-   * as written by this process */
-  int files_valid = valid;
-  unsigned long my_counts[3] = {0, 0, 0};
+  /* check and stat all of our files in one batch,
+   * which may spread the system calls over multiple threads */
+  int num_files = scr_filemap_num_files(scr_map);
+  scr_file_check* checks = NULL;
+  if (num_files > 0) {
+    checks = (scr_file_check*) SCR_MALLOC(num_files * sizeof(scr_file_check));
+  }
+  int i = 0;
   kvtree_elem* elem;
   for (elem = scr_filemap_first_file(scr_map);
        elem != NULL;
        elem = kvtree_elem_next(elem))
   {
+    checks[i].file = kvtree_elem_key(elem);
+    i++;
+  }
+  scr_file_check_batch(num_files, checks, scr_stat_threads);
+
+  /* count number of files, number of bytes, and record filesize for each file
+   * as written by this process, the size and complete flag recorded here
+   * are used by scr_reddesc_apply rather than checking the files again */
+  int files_valid = valid;
+  unsigned long my_counts[3] = {0, 0, 0};
+  for (i = 0; i < num_files; i++) {
     /* get the filename */
-    char* file = kvtree_elem_key(elem);
+    const char* file = checks[i].file;
     my_counts[0]++;
 
     /* start with valid flag from caller for this file */
     int file_valid = valid;
 
     /* check that we can read the file */
-    if (scr_file_is_readable(file) != SCR_SUCCESS) {
+    if (! checks[i].readable) {
       scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
         file, __FILE__, __LINE__
       );
@@ -1788,31 +1915,23 @@ static int scr_complete_output(int valid)
       files_valid = 0;
     }
 
-    /* stat the file to get its size and other metadata */
+    /* get size and other metadata of the file from its stat */
     unsigned long filesize = 0;
-    struct stat stat_buf;
-    int stat_rc = stat(file, &stat_buf);
+    int stat_rc = checks[i].stat_rc;
     if (stat_rc == 0) {
-      filesize = (unsigned long) stat_buf.st_size;
+      filesize = (unsigned long) checks[i].statbuf.st_size;
     }
-
-    /* get size of this file */
-    //unsigned long filesize = scr_file_size(file);
     my_counts[1] += filesize;
 
-    /* TODO: record permissions and/or timestamps? */
-
     /* fill in filesize and complete flag in the meta data for the file */
-    scr_meta* meta = scr_meta_new();
-    scr_filemap_get_meta(scr_map, file, meta);
+    scr_meta* meta = scr_filemap_edit_meta(scr_map, file);
     scr_meta_set_filesize(meta, filesize);
     scr_meta_set_complete(meta, file_valid);
     if (stat_rc == 0) {
-      scr_meta_set_stat(meta, &stat_buf);
+      scr_meta_set_stat(meta, &checks[i].statbuf);
     }
-    scr_filemap_set_meta(scr_map, file, meta);
-    scr_meta_delete(&meta);
   }
+  scr_free(&checks);
 
   /* we execute a sum as a logical allreduce to determine whether everyone is valid
    * we interpret the result to be true only if the sum adds up to the number of processes */
@@ -1850,6 +1969,13 @@ static int scr_complete_output(int valid)
   scr_cache_index_set_dataset(scr_cindex, scr_dataset_id, dataset);
   scr_cache_index_write(scr_cindex_file, scr_cindex);
 
+  /* for incremental checkpoints, store the blocks of each file that changed
+   * since the last full copy of that file in an older checkpoint in cache */
+  if (scr_incremental && is_ckpt && ! scr_rd->bypass && rc == SCR_SUCCESS) {
+    scr_delta_complete_output(scr_cindex, scr_dataset_id, scr_map);
+    scr_cache_index_write(scr_cindex_file, scr_cindex);
+  }
+
   /* write out info to filemap */
   scr_cache_set_map(scr_cindex, scr_dataset_id, scr_map);
 
@@ -1898,7 +2024,7 @@ static int scr_complete_output(int valid)
 
   /* apply redundancy scheme if we're still valid */
   if (rc == SCR_SUCCESS) {
-    rc = scr_reddesc_apply(scr_map, scr_rd, scr_dataset_id);
+    rc = scr_reddesc_apply(scr_map, scr_rd, scr_dataset_id, 1);
   }
 
   /* record the cost of the output and log its completion */
@@ -2548,6 +2674,9 @@ int SCR_Init()
    * we'll take this to mean that we have a checkpoint in cache */
   scr_have_restart = (scr_checkpoint_id > 0);
 
+  /* write any cache metadata changes made while rebuilding the cache */
+  scr_cache_sync(scr_cindex);
+
   /* sync everyone before returning to ensure that subsequent
    * calls to SCR functions are valid */
   MPI_Barrier(scr_comm_world);
@@ -2596,6 +2725,9 @@ int SCR_Finalize()
    * are calling this as a collective */
   MPI_Barrier(scr_comm_world);
 
+  /* wait for any files still streaming into cache */
+  scr_fetch_stream_finish();
+
   if (scr_my_rank_world == 0) {
     /* stop the clock for measuring the compute time */
     scr_time_compute_end = MPI_Wtime();
@@ -2620,9 +2752,16 @@ int SCR_Finalize()
   /* Free memory cache of a halt file */
   kvtree_delete(&scr_halt_hash);
 
+  /* free memory cache of the flush file */
+  scr_flush_file_finalize();
+
   /* free off our global filemap object */
   scr_filemap_delete(&scr_map);
 
+  /* write any remaining cache metadata changes and free our copies */
+  scr_cache_sync(scr_cindex);
+  scr_cache_forget_maps();
+
   /* free off our global filemap object */
   scr_cache_index_delete(&scr_cindex);
 
@@ -3254,9 +3393,8 @@ int SCR_Route_file(const char* file, char* newfile)
     /* add the file to the filemap */
     scr_filemap_add_file(scr_map, newfile);
 
-    /* read meta data for this file */
-    scr_meta* meta = scr_meta_new();
-    scr_filemap_get_meta(scr_map, newfile, meta);
+    /* update meta data for this file in place */
+    scr_meta* meta = scr_filemap_edit_meta(scr_map, newfile);
 
     /* set parameters for the file */
     scr_meta_set_complete(meta, 0);
@@ -3320,15 +3458,16 @@ int SCR_Route_file(const char* file, char* newfile)
     spath_delete(&path_name);
     spath_delete(&path_abs);
 
-    /* record the meta data for this file */
-    scr_filemap_set_meta(scr_map, newfile, meta);
-
-    /* write out the filemap */
+    /* write out the filemap before the application creates the file,
+     * so that the file can be found and deleted after a crash */
     scr_cache_set_map(scr_cindex, scr_dataset_id, scr_map);
-
-    /* delete the meta data object */
-    scr_meta_delete(&meta);
+    scr_cache_sync_map(scr_cindex, scr_dataset_id);
   } else {
+    /* if the file is still being copied to cache, wait for it */
+    if (scr_fetch_stream_wait(newfile) != SCR_SUCCESS) {
+      return SCR_FAILURE;
+    }
+
     /* if user specified path to file within prefix, return */
     if (scr_file_is_readable(newfile) == SCR_SUCCESS) {
       return SCR_SUCCESS;
@@ -3361,8 +3500,7 @@ int SCR_Route_file(const char* file, char* newfile)
     spath_delete(&path);
 
     /* get the filemap for this checkpoint */
-    scr_filemap* map = scr_filemap_new();
-    scr_cache_get_map(scr_cindex, scr_dataset_id, map);
+    const scr_filemap* map = scr_cache_peek_map(scr_cindex, scr_dataset_id);
 
     /* loop over each file in the map */
     int found_file = 0;
@@ -3375,8 +3513,8 @@ int SCR_Route_file(const char* file, char* newfile)
       char* mapfile = kvtree_elem_key(file_elem);
 
       /* get meta data for this file */
-      scr_meta* meta = scr_meta_new();
-      if (scr_filemap_get_meta(map, mapfile, meta) == SCR_SUCCESS) {
+      const scr_meta* meta = scr_filemap_peek_meta(map, mapfile);
+      if (meta != NULL) {
         /* lookup basename for this file from meta data */
         char* origname = NULL;
         if (scr_meta_get_origname(meta, &origname) == SCR_SUCCESS) {
@@ -3390,7 +3528,6 @@ int SCR_Route_file(const char* file, char* newfile)
           }
         }
       }
-      scr_meta_delete(&meta);
 
       /* stop looping early if we found the file */
       if (found_file) {
@@ -3398,9 +3535,6 @@ int SCR_Route_file(const char* file, char* newfile)
       }
     }
 
-    /* free the filemap */
-    scr_filemap_delete(&map);
-
     /* free the base name of new file */
     scr_free(&newfilebase);
 
@@ -3410,7 +3544,9 @@ int SCR_Route_file(const char* file, char* newfile)
     }
 
     /* if we can't read the file, return an error */
-    if (scr_file_is_readable(newfile) != SCR_SUCCESS) {
+    if (scr_fetch_stream_wait(newfile) != SCR_SUCCESS ||
+        scr_file_is_readable(newfile) != SCR_SUCCESS)
+    {
       return SCR_FAILURE;
     }
   }
@@ -3678,6 +3814,14 @@ int SCR_Complete_restart(int valid)
    * this should eventually be changed to use an output flag instead */
   int rc = SCR_SUCCESS;
 
+  /* wait for any files still streaming into cache,
+   * and treat a failure to copy them like invalid data */
+  if (scr_fetch_stream_in_progress() &&
+      scr_fetch_stream_complete(scr_cindex) != SCR_SUCCESS)
+  {
+    valid = 0;
+  }
+
   /* check that all procs read valid data */
   if (! scr_alltrue(valid, scr_comm_world)) {
     /* if some process fails, attempt to restart from
@@ -3929,6 +4073,9 @@ int SCR_Drop(const char* name)
    * are calling this as a collective */
   MPI_Barrier(scr_comm_world);
 
+  /* wait for any files still streaming into cache */
+  scr_fetch_stream_finish();
+
   /* delete dataset from prefix directory, if it exists */
   if (scr_my_rank_world == 0) {
       /* read the index file */
@@ -3938,9 +4085,17 @@ int SCR_Drop(const char* name)
          * mark it as failed so we don't try to restart it with it again */
         int id;
         if (scr_index_get_id_by_name(index_hash, name, &id) == SCR_SUCCESS) {
-          /* found an entry, remove it from the index */
-          scr_index_remove(index_hash, name);
-          scr_index_write(scr_prefix_path, index_hash);
+          if (scr_index_is_base(index_hash, id)) {
+            /* a newer dataset needs the files of this one to be fetched */
+            scr_err("Cannot drop `%s', it holds base files of a newer dataset @ %s:%d",
+              name, __FILE__, __LINE__
+            );
+            rc = SCR_FAILURE;
+          } else {
+            /* found an entry, remove it from the index */
+            scr_index_remove(index_hash, name);
+            scr_index_write(scr_prefix_path, index_hash);
+          }
         }
       }
       kvtree_delete(&index_hash);
@@ -3949,6 +4104,9 @@ int SCR_Drop(const char* name)
   /* hold everyone until delete is complete */
   MPI_Barrier(scr_comm_world);
 
+  /* have rank 0 broadcast whether the drop succeeded */
+  MPI_Bcast(&rc, 1, MPI_INT, 0, scr_comm_world);
+
   return rc;
 }
 
@@ -3979,6 +4137,9 @@ int SCR_Delete(const char* name)
    * are calling this as a collective */
   MPI_Barrier(scr_comm_world);
 
+  /* wait for any files still streaming into cache */
+  scr_fetch_stream_finish();
+
   /* NOTE: It is possible that two datasets exist with the same name
    * if one is on the parallel file system and a newer one is in cache
    * but has yet to have been flushed.  Those will have two different
@@ -3997,15 +4158,24 @@ int SCR_Delete(const char* name)
        * mark it as failed so we don't try to restart it with it again */
       int tmp_id;
       if (scr_index_get_id_by_name(index_hash, name, &tmp_id) == SCR_SUCCESS) {
-        /* found an entry to delete */
-        id = tmp_id;
+        if (scr_index_is_base(index_hash, tmp_id)) {
+          /* a newer dataset needs the files of this one to be fetched */
+          scr_err("Cannot delete `%s' from prefix directory, it holds base files of a newer dataset @ %s:%d",
+            name, __FILE__, __LINE__
+          );
+          rc = SCR_FAILURE;
+        } else {
+          /* found an entry to delete */
+          id = tmp_id;
+        }
       }
     }
     kvtree_delete(&index_hash);
   }
 
-  /* broadcast id for the named dataset from rank 0 */
+  /* broadcast id for the named dataset and success code from rank 0 */
   MPI_Bcast(&id, 1, MPI_INT, 0, scr_comm_world);
+  MPI_Bcast(&rc, 1, MPI_INT, 0, scr_comm_world);
 
   /* delete the dataset if we found it */
   if (id != -1) {
@@ -156,6 +156,9 @@ static spath* scr_cache_get_map_path(const scr_cache_index* cindex, int id)
 
 const char* scr_cache_get_map_file(const scr_cache_index* cindex, int id)
 {
+  /* callers read the file directly, so write any changes first */
+  scr_cache_sync_map(cindex, id);
+
   /* get directory for dataset */
   spath* path = scr_cache_get_map_path(cindex, id);
   if (path == NULL) {
@@ -172,30 +175,101 @@ const char* scr_cache_get_map_file(const scr_cache_index* cindex, int id)
   return file;
 }
 
-/* read file map for dataset from cache directory */
-int scr_cache_get_map(const scr_cache_index* cindex, int id, scr_filemap* map)
+/* copies of the filemaps of datasets in cache, indexed by dataset id,
+ * so that each filemap is read from the cache directory at most once */
+#define SCR_CACHE_KEY_MAP   ("MAP")
+
+/* dataset ids whose filemap copy has changes that have not been written */
+#define SCR_CACHE_KEY_DIRTY ("DIRTY")
+
+static kvtree* scr_cache_maps = NULL;
+
+/* return our copy of the filemap for the given dataset, NULL if we have none */
+static scr_filemap* scr_cache_map_lookup(int id)
+{
+  return kvtree_get_kv_int(scr_cache_maps, SCR_CACHE_KEY_MAP, id);
+}
+
+/* replace our copy of the filemap for the given dataset */
+static void scr_cache_map_store(int id, const scr_filemap* map)
+{
+  if (scr_cache_maps == NULL) {
+    scr_cache_maps = kvtree_new();
+  }
+  kvtree_unset_kv_int(scr_cache_maps, SCR_CACHE_KEY_MAP, id);
+  scr_filemap* copy = kvtree_set_kv_int(scr_cache_maps, SCR_CACHE_KEY_MAP, id);
+  kvtree_merge(copy, map);
+}
+
+/* return file map for dataset without copying it, reading it from the
+ * cache directory if needed, returns NULL if it can't be read, the map
+ * is valid until the next call to set, unset, or forget the map */
+const scr_filemap* scr_cache_peek_map(const scr_cache_index* cindex, int id)
 {
+  /* use our copy if we have one */
+  scr_filemap* cached = scr_cache_map_lookup(id);
+  if (cached != NULL) {
+    return cached;
+  }
+
   /* get directory for dataset */
   spath* path = scr_cache_get_map_path(cindex, id);
   if (path == NULL) {
-    return SCR_FAILURE;
+    return NULL;
   }
 
-  /* read map file */
-  int rc = SCR_SUCCESS;
-  if (scr_filemap_read(path, map) != SCR_SUCCESS) {
-    rc = SCR_FAILURE;
+  /* read map file directly into our copy */
+  if (scr_cache_maps == NULL) {
+    scr_cache_maps = kvtree_new();
+  }
+  cached = kvtree_set_kv_int(scr_cache_maps, SCR_CACHE_KEY_MAP, id);
+  if (scr_filemap_read(path, cached) != SCR_SUCCESS) {
+    kvtree_unset_kv_int(scr_cache_maps, SCR_CACHE_KEY_MAP, id);
+    cached = NULL;
   }
 
   /* free the path to the map file */
   spath_delete(&path);
 
-  return rc;
+  return cached;
 }
 
-/* write file map for dataset to cache directory */
+/* read file map for dataset from cache directory */
+int scr_cache_get_map(const scr_cache_index* cindex, int id, scr_filemap* map)
+{
+  const scr_filemap* cached = scr_cache_peek_map(cindex, id);
+  if (cached == NULL) {
+    return SCR_FAILURE;
+  }
+  kvtree_merge(map, cached);
+  return SCR_SUCCESS;
+}
+
+/* record file map for dataset, the map file in the cache directory
+ * is written by the next call to scr_cache_sync_map or scr_cache_sync */
 int scr_cache_set_map(const scr_cache_index* cindex, int id, const scr_filemap* map)
 {
+  /* check that the dataset is in the cache index */
+  char* dir;
+  if (scr_cache_index_get_dir(cindex, id, &dir) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* update our copy and mark it as changed */
+  scr_cache_map_store(id, map);
+  kvtree_set_kv_int(scr_cache_maps, SCR_CACHE_KEY_DIRTY, id);
+
+  return SCR_SUCCESS;
+}
+
+/* write file map for dataset to cache directory if it has unwritten changes */
+int scr_cache_sync_map(const scr_cache_index* cindex, int id)
+{
+  /* nothing to do if the map file is up to date */
+  if (kvtree_get_kv_int(scr_cache_maps, SCR_CACHE_KEY_DIRTY, id) == NULL) {
+    return SCR_SUCCESS;
+  }
+
   /* get directory for dataset */
   spath* path = scr_cache_get_map_path(cindex, id);
   if (path == NULL) {
@@ -204,7 +278,9 @@ int scr_cache_set_map(const scr_cache_index* cindex, int id, const scr_filemap*
 
   /* write map file */
   int rc = SCR_SUCCESS;
-  if (scr_filemap_write(path, map) != SCR_SUCCESS) {
+  if (scr_filemap_write(path, scr_cache_map_lookup(id)) == SCR_SUCCESS) {
+    kvtree_unset_kv_int(scr_cache_maps, SCR_CACHE_KEY_DIRTY, id);
+  } else {
     rc = SCR_FAILURE;
   }
 
@@ -214,9 +290,56 @@ int scr_cache_set_map(const scr_cache_index* cindex, int id, const scr_filemap*
   return rc;
 }
 
+/* write all file maps and the cache index that have unwritten changes */
+int scr_cache_sync(scr_cache_index* cindex)
+{
+  int rc = SCR_SUCCESS;
+
+  /* get list of datasets whose map has changed, we get a list
+   * since a successful sync removes the id from the dirty set */
+  int ndsets;
+  int* dsets;
+  kvtree* dirty = kvtree_get(scr_cache_maps, SCR_CACHE_KEY_DIRTY);
+  kvtree_list_int(dirty, &ndsets, &dsets);
+
+  int i;
+  for (i = 0; i < ndsets; i++) {
+    if (scr_cache_sync_map(cindex, dsets[i]) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  }
+  scr_free(&dsets);
+
+  /* write out the cache index */
+  if (scr_cache_index_sync(scr_cindex_file, cindex) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  return rc;
+}
+
+/* drop our copy of the file map for dataset, to be called when the map file
+ * is changed by some other means, unwritten changes are lost */
+int scr_cache_forget_map(int id)
+{
+  kvtree_unset_kv_int(scr_cache_maps, SCR_CACHE_KEY_MAP, id);
+  kvtree_unset_kv_int(scr_cache_maps, SCR_CACHE_KEY_DIRTY, id);
+  return SCR_SUCCESS;
+}
+
+/* free copies of all file maps, call scr_cache_sync first to keep changes */
+int scr_cache_forget_maps(void)
+{
+  kvtree_delete(&scr_cache_maps);
+  return SCR_SUCCESS;
+}
+
 /* delete file map file for dataset from cache directory */
 int scr_cache_unset_map(const scr_cache_index* cindex, int id)
 {
+  /* drop our copy */
+  scr_cache_forget_map(id);
+
   /* get directory for dataset */
   spath* path = scr_cache_get_map_path(cindex, id);
   if (path == NULL) {
@@ -269,9 +392,15 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
   int bypass = 0;
   scr_cache_index_get_bypass(cindex, id, &bypass);
 
-  /* get list of files for this dataset */
-  scr_filemap* map = scr_filemap_new();
-  scr_cache_get_map(cindex, id, map);
+  /* get list of files for this dataset, we read our cached copy in place
+   * unless we need to record crc values, which modifies the map */
+  scr_filemap* crc_map = NULL;
+  const scr_filemap* map = scr_cache_peek_map(cindex, id);
+  if (scr_crc_on_delete) {
+    crc_map = scr_filemap_new();
+    scr_cache_get_map(cindex, id, crc_map);
+    map = crc_map;
+  }
   
   /* for each file we have for this dataset, delete the file */
   kvtree_elem* file_elem;
@@ -286,10 +415,8 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
      * which could idenitfy a bug in the user's code */
     struct stat statbuf;
     int stat_rc = stat(file, &statbuf);
-    if (stat_rc == 0) {
-      scr_meta* meta = scr_meta_new();
-      scr_filemap_get_meta(map, file, meta);
-
+    const scr_meta* meta = scr_filemap_peek_meta(map, file);
+    if (stat_rc == 0 && meta != NULL) {
       int file_changed = 0;
 
       /* check that file contents have not been modified */
@@ -313,15 +440,13 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
           file, __FILE__, __LINE__
         );
       }
-
-      scr_meta_delete(&meta);
     }
   
     /* check file's crc value (monitor that cache hardware isn't corrupting
      * files on us) */
     if (scr_crc_on_delete) {
       /* TODO: if corruption, need to log */
-      if (scr_compute_crc(map, file) != SCR_SUCCESS) {
+      if (scr_compute_crc(crc_map, file) != SCR_SUCCESS) {
         scr_err("Failed to verify CRC32 before deleting file %s, bad drive? @ %s:%d",
           file, __FILE__, __LINE__
         );
@@ -332,11 +457,20 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
     if (! bypass) {
       /* delete the file */
       scr_file_unlink(file);
+
+      /* delete the block hashes of an incremental checkpoint file */
+      scr_delta_hash_unlink(file);
+
+      /* delete the changed blocks of an incremental checkpoint file */
+      char* delta_file;
+      if (meta != NULL && scr_meta_get_delta(meta, &delta_file, NULL, NULL, NULL) == SCR_SUCCESS) {
+        scr_file_unlink(delta_file);
+      }
     }
   }
   
   /* delete map object */
-  scr_filemap_delete(&map);
+  scr_filemap_delete(&crc_map);
 
   /* delete the map file */
   scr_cache_unset_map(cindex, id);
@@ -380,9 +514,10 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
 
   /* TODO: remove data from transfer file for this dataset */
 
-  /* remove this dataset from the index and write updated index to disk */
+  /* remove this dataset from the index, the updated index is written
+   * at the next sync point, a stale entry only names files that are gone */
   scr_cache_index_remove_dataset(cindex, id);
-  scr_cache_index_write(scr_cindex_file, cindex);
+  scr_cache_index_defer(cindex);
 
   /* free path to hidden directory */
   scr_free(&dir_scr);
@@ -641,8 +776,7 @@ int scr_cache_check_files(const scr_cache_index* cindex, int id)
   int failed_read = 0;
 
   /* get map of files for this dataset */
-  scr_filemap* map = scr_filemap_new();
-  scr_cache_get_map(cindex, id, map);
+  const scr_filemap* map = scr_cache_peek_map(cindex, id);
 
   /* loop over each file in the map */
   kvtree_elem* file_elem;
@@ -659,8 +793,8 @@ int scr_cache_check_files(const scr_cache_index* cindex, int id)
     }
 
     /* get meta data for this file */
-    scr_meta* meta = scr_meta_new();
-    if (scr_filemap_get_meta(map, file, meta) != SCR_SUCCESS) {
+    const scr_meta* meta = scr_filemap_peek_meta(map, file);
+    if (meta == NULL) {
       failed_read = 1;
     } else {
       /* check that the file is complete */
@@ -668,12 +802,8 @@ int scr_cache_check_files(const scr_cache_index* cindex, int id)
         failed_read = 1;
       }
     }
-    scr_meta_delete(&meta);
   }
 
-  /* free the map */
-  scr_filemap_delete(&map);
-
   /* if we failed to read a file, assume the set is incomplete */
   if (failed_read) {
     /* TODO: want to unlink all files in this case? */
@@ -701,15 +831,12 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     return 0;
   }
 
-  /* allocate object to read meta data into */
-  scr_meta* meta = scr_meta_new();
-
   /* check that we can read meta file for the file */
-  if (scr_filemap_get_meta(map, file, meta) != SCR_SUCCESS) {
+  const scr_meta* meta = scr_filemap_peek_meta(map, file);
+  if (meta == NULL) {
     scr_dbg(2, "Failed to read meta data for file: %s @ %s:%d",
       file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
 
@@ -718,7 +845,6 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     scr_dbg(2, "File is marked as incomplete: %s @ %s:%d",
       file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
 
@@ -731,14 +857,12 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     scr_dbg(2, "Failed to read dataset field in meta data: %s @ %s:%d",
             file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
   if (dset != meta_dset) {
     scr_dbg(2, "File's dataset ID (%d) does not match id in meta data file (%d) for %s @ %s:%d",
             dset, meta_dset, file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
 #endif
@@ -750,14 +874,12 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     scr_dbg(2, "Failed to read rank field in meta data: %s @ %s:%d",
             file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
   if (rank != meta_rank) {
     scr_dbg(2, "File's rank (%d) does not match rank in meta data (%d) for %s @ %s:%d",
             rank, meta_rank, file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
 #endif
@@ -769,14 +891,12 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     scr_dbg(2, "Failed to read ranks field in meta data: %s @ %s:%d",
             file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
   if (ranks != meta_ranks) {
     scr_dbg(2, "File's ranks (%d) does not match ranks in meta data file (%d) for %s @ %s:%d",
             ranks, meta_ranks, file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
 #endif
@@ -788,22 +908,17 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     scr_dbg(2, "Failed to read filesize field in meta data: %s @ %s:%d",
       file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
   if (size != meta_size) {
     scr_dbg(2, "Filesize is incorrect, currently %lu, expected %lu for %s @ %s:%d",
       size, meta_size, file, __FILE__, __LINE__
     );
-    scr_meta_delete(&meta);
     return 0;
   }
 
   /* TODO: check that crc32 match if set (this would be expensive) */
 
-  /* free meta data object */
-  scr_meta_delete(&meta);
-
   /* if we made it here, assume the file is good */
   return 1;
 }
@@ -814,25 +929,18 @@ int scr_compute_crc(scr_filemap* map, const char* file)
 {
   /* compute crc for the file */
   uLong crc_file;
-  if (scr_crc32(file, &crc_file) != SCR_SUCCESS) {
+  if (scr_crc32_parallel(file, scr_crc_threads, &crc_file) != SCR_SUCCESS) {
     scr_err("Failed to compute crc for file %s @ %s:%d",
       file, __FILE__, __LINE__
     );
     return SCR_FAILURE;
   }
 
-  /* allocate a new meta data object */
-  scr_meta* meta = scr_meta_new();
-  if (meta == NULL) {
-    scr_abort(-1, "Failed to allocate meta data object @ %s:%d",
-      __FILE__, __LINE__
-    );
-  }
-
-  /* read meta data from filemap */
-  if (scr_filemap_get_meta(map, file, meta) != SCR_SUCCESS) {
+  /* look up meta data in the filemap, we update it in place */
+  if (scr_filemap_peek_meta(map, file) == NULL) {
     return SCR_FAILURE;
   }
+  scr_meta* meta = scr_filemap_edit_meta(map, file);
 
   int rc = SCR_SUCCESS;
 
@@ -846,12 +954,8 @@ int scr_compute_crc(scr_filemap* map, const char* file)
   } else {
     /* record crc in filemap */
     scr_meta_set_crc32(meta, crc_file);
-    scr_filemap_set_meta(map, file, meta);
   }
 
-  /* free our meta data object */
-  scr_meta_delete(&meta);
-
   return rc;
 }
 
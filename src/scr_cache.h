@@ -28,13 +28,33 @@ char* scr_cache_dir_hidden_get(const scr_reddesc* reddesc, int id);
 /* read file map for dataset from cache directory */
 int scr_cache_get_map(const scr_cache_index* cindex, int id, scr_filemap* map);
 
-/* write file map for dataset to cache directory */
+/* return file map for dataset without copying it, reading it from the
+ * cache directory if needed, returns NULL if it can't be read, the map
+ * is valid until the next call to set, unset, or forget the map */
+const scr_filemap* scr_cache_peek_map(const scr_cache_index* cindex, int id);
+
+/* record file map for dataset, the map file in the cache directory
+ * is written by the next call to scr_cache_sync_map or scr_cache_sync */
 int scr_cache_set_map(const scr_cache_index* cindex, int id, const scr_filemap* map);
 
+/* write file map for dataset to cache directory if it has unwritten changes */
+int scr_cache_sync_map(const scr_cache_index* cindex, int id);
+
+/* write all file maps and the cache index that have unwritten changes */
+int scr_cache_sync(scr_cache_index* cindex);
+
+/* drop our copy of the file map for dataset, to be called when the map file
+ * is changed by some other means, unwritten changes are lost */
+int scr_cache_forget_map(int id);
+
+/* free copies of all file maps, call scr_cache_sync first to keep changes */
+int scr_cache_forget_maps(void);
+
 /* delete file map file for dataset from cache directory */
 int scr_cache_unset_map(const scr_cache_index* cindex, int id);
 
-/* return string pointing to filemap file, caller must free string when done */
+/* return string pointing to filemap file after writing any unwritten changes to it,
+ * caller must free string when done */
 const char* scr_cache_get_map_file(const scr_cache_index* cindex, int id);
 
 /* create a dataset directory given a redundancy descriptor and dataset id,
@@ -40,18 +40,19 @@
 #define SCR_CINDEX_KEY_DATA      ("DSETDESC")
 #define SCR_CINDEX_KEY_PATH      ("PATH")
 #define SCR_CINDEX_KEY_BYPASS    ("BYPASS")
+#define SCR_CINDEX_KEY_BASE      ("BASE")
 
 /* returns the DSET hash */
-static kvtree* scr_cache_index_get_dh(const kvtree* h)
+static kvtree* scr_cache_index_get_dh(const scr_cache_index* cindex)
 {
-  kvtree* dh = kvtree_get(h, SCR_CINDEX_KEY_DSET);
+  kvtree* dh = kvtree_get(cindex->hash, SCR_CINDEX_KEY_DSET);
   return dh;
 }
 
 /* returns the hash associated with a particular dataset */
-static kvtree* scr_cache_index_get_d(const kvtree* h, int dset)
+static kvtree* scr_cache_index_get_d(const scr_cache_index* cindex, int dset)
 {
-  kvtree* d = kvtree_get_kv_int(h, SCR_CINDEX_KEY_DSET, dset);
+  kvtree* d = kvtree_get_kv_int(cindex->hash, SCR_CINDEX_KEY_DSET, dset);
   return d;
 }
 
@@ -59,7 +60,7 @@ static kvtree* scr_cache_index_get_d(const kvtree* h, int dset)
 static kvtree* scr_cache_index_set_d(scr_cache_index* cindex, int dset)
 {
   /* set DSET index */
-  kvtree* d = kvtree_set_kv_int(cindex, SCR_CINDEX_KEY_DSET, dset);
+  kvtree* d = kvtree_set_kv_int(cindex->hash, SCR_CINDEX_KEY_DSET, dset);
   return d;
 }
 
@@ -71,7 +72,7 @@ static int scr_cache_index_unset_if_empty(scr_cache_index* cindex, int dset)
 
   /* if there is nothing left under this dataset, unset the dataset */
   if (kvtree_size(d) == 0) {
-    kvtree_unset_kv_int(cindex, SCR_CINDEX_KEY_DSET, dset);
+    kvtree_unset_kv_int(cindex->hash, SCR_CINDEX_KEY_DSET, dset);
   }
 
   return SCR_SUCCESS;
@@ -80,16 +81,16 @@ static int scr_cache_index_unset_if_empty(scr_cache_index* cindex, int dset)
 /* set the CURRENT name, used to rememeber if we already proccessed
  * a SCR_CURRENT name a user may have provided to set the current value,
  * we ignore that request in later runs and use this marker to remember */
-int scr_cache_index_set_current(const kvtree* h, const char* current)
+int scr_cache_index_set_current(scr_cache_index* cindex, const char* current)
 {
-  kvtree_util_set_str((kvtree*) h, SCR_CINDEX_KEY_CURRENT, current);
+  kvtree_util_set_str(cindex->hash, SCR_CINDEX_KEY_CURRENT, current);
   return SCR_SUCCESS;
 }
 
 /* returns the CURRENT name */
-int scr_cache_index_get_current(const kvtree* h, char** current)
+int scr_cache_index_get_current(const scr_cache_index* cindex, char** current)
 {
-  int kvtree_rc = kvtree_util_get_str(h, SCR_CINDEX_KEY_CURRENT, current);
+  int kvtree_rc = kvtree_util_get_str(cindex->hash, SCR_CINDEX_KEY_CURRENT, current);
   int rc = (kvtree_rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
   return rc;
 }
@@ -206,17 +207,62 @@ int scr_cache_index_get_bypass(const scr_cache_index* cindex, int dset, int* byp
   return SCR_FAILURE; 
 }
 
+/* record that files of dataset dset are stored as deltas against
+ * files of dataset base */
+int scr_cache_index_add_base(scr_cache_index* cindex, int dset, int base)
+{
+  /* set indicies and get hash reference */
+  kvtree* d = scr_cache_index_set_d(cindex, dset);
+
+  /* add the base id under the RANK/DSET hash */
+  kvtree_set_kv_int(d, SCR_CINDEX_KEY_BASE, base);
+
+  return SCR_SUCCESS;
+}
+
+/* returns list of datasets in cache whose files are stored as deltas
+ * against files of dataset base, caller must free ids with scr_free */
+int scr_cache_index_list_dependents(const scr_cache_index* cindex, int base, int* n, int** ids)
+{
+  *n   = 0;
+  *ids = NULL;
+
+  kvtree* dh = scr_cache_index_get_dh(cindex);
+  int size = kvtree_size(dh);
+  if (size == 0) {
+    return SCR_SUCCESS;
+  }
+
+  int* list = (int*) SCR_MALLOC(size * sizeof(int));
+  int count = 0;
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(dh);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    kvtree* d = kvtree_elem_hash(elem);
+    if (kvtree_get_kv_int(d, SCR_CINDEX_KEY_BASE, base) != NULL) {
+      list[count] = kvtree_elem_key_int(elem);
+      count++;
+    }
+  }
+
+  *n   = count;
+  *ids = list;
+  return SCR_SUCCESS;
+}
+
 /* remove all associations for a given dataset */
 int scr_cache_index_remove_dataset(scr_cache_index* cindex, int dset)
 {
-  kvtree_unset_kv_int(cindex, SCR_CINDEX_KEY_DSET, dset);
+  kvtree_unset_kv_int(cindex->hash, SCR_CINDEX_KEY_DSET, dset);
   return SCR_SUCCESS;
 }
 
 /* clear the cache index completely */
 int scr_cache_index_clear(scr_cache_index* cindex)
 {
-  return kvtree_unset_all(cindex);
+  return kvtree_unset_all(cindex->hash);
 }
 
 /* returns the latest dataset id (largest int) in given index */
@@ -269,23 +315,51 @@ int scr_cache_index_num_datasets(const scr_cache_index* cindex)
 /* allocate a new cache index structure and return it */
 scr_cache_index* scr_cache_index_new()
 {
-  scr_cache_index* cindex = kvtree_new();
-  if (cindex == NULL) {
-    scr_err("Failed to allocate cache index @ %s:%d", __FILE__, __LINE__);
-  }
+  scr_cache_index* cindex = (scr_cache_index*) SCR_MALLOC(sizeof(scr_cache_index));
+  cindex->hash  = kvtree_new();
+  cindex->dirty = 0;
   return cindex;
 }
 
 /* free memory resources assocaited with cache index */
 int scr_cache_index_delete(scr_cache_index** ptr_cindex)
 {
-  kvtree_delete(ptr_cindex);
+  if (ptr_cindex != NULL) {
+    scr_cache_index* cindex = *ptr_cindex;
+    if (cindex != NULL) {
+      kvtree_delete(&cindex->hash);
+    }
+    scr_free(ptr_cindex);
+  }
   return SCR_SUCCESS;
 }
 
+/* records that the cache index has changed without writing it,
+ * the change is written by the next call to write or sync */
+int scr_cache_index_defer(scr_cache_index* cindex)
+{
+  /* check that we have a cindex pointer */
+  if (cindex == NULL) {
+    return SCR_FAILURE;
+  }
+
+  cindex->dirty = 1;
+
+  return SCR_SUCCESS;
+}
+
+/* writes given cache index to specified file if it has deferred changes */
+int scr_cache_index_sync(const spath* file, scr_cache_index* cindex)
+{
+  if (! cindex->dirty) {
+    return SCR_SUCCESS;
+  }
+  return scr_cache_index_write(file, cindex);
+}
+
 /* adds cindex2 into cindex1 */
 int scr_cache_index_merge(scr_cache_index* cindex1, scr_cache_index* cindex2)
 {
-  kvtree_merge(cindex1, cindex2);
+  kvtree_merge(cindex1->hash, cindex2->hash);
   return SCR_SUCCESS;
 }
@@ -40,8 +40,12 @@
 #include "spath.h"
 #include "kvtree.h"
 
-/* a special type of hash */
-typedef kvtree scr_cache_index;
+/* the index of datasets in cache, along with whether it
+ * has changes that have not been written to its file */
+typedef struct {
+  kvtree* hash; /* index of datasets in cache */
+  int dirty;    /* whether hash has changes that are not in the file */
+} scr_cache_index;
 
 /*
 =========================================
@@ -52,10 +56,10 @@ Cache index set/get/unset data functions
 /* set the CURRENT name, used to rememeber if we already proccessed
  * a SCR_CURRENT name a user may have provided to set the current value,
  * we ignore that request in later runs and use this marker to remember */
-int scr_cache_index_set_current(const kvtree* h, const char* current);
+int scr_cache_index_set_current(scr_cache_index* cindex, const char* current);
 
 /* returns the CURRENT name */
-int scr_cache_index_get_current(const kvtree* h, char** current);
+int scr_cache_index_get_current(const scr_cache_index* cindex, char** current);
 
 /* sets the dataset hash for the given dataset id */
 int scr_cache_index_set_dataset(scr_cache_index* cindex, int dset, kvtree* hash);
@@ -81,6 +85,14 @@ int scr_cache_index_set_bypass(scr_cache_index* cindex, int dset, int bypass);
 /* get value of bypass flag for dataset */
 int scr_cache_index_get_bypass(const scr_cache_index* cindex, int dset, int* bypass);
 
+/* record that files of dataset dset are stored as deltas against
+ * files of dataset base */
+int scr_cache_index_add_base(scr_cache_index* cindex, int dset, int base);
+
+/* returns list of datasets in cache whose files are stored as deltas
+ * against files of dataset base, caller must free ids with scr_free */
+int scr_cache_index_list_dependents(const scr_cache_index* cindex, int base, int* n, int** ids);
+
 /*
 =========================================
 Cache index clear and copy functions
@@ -137,7 +149,14 @@ Cache index read/write/free functions
 int scr_cache_index_read(const spath* file, scr_cache_index* cindex);
 
 /* writes given cache index to specified file */
-int scr_cache_index_write(const spath* file, const scr_cache_index* cindex);
+int scr_cache_index_write(const spath* file, scr_cache_index* cindex);
+
+/* records that the cache index has changed without writing it,
+ * the change is written by the next call to write or sync */
+int scr_cache_index_defer(scr_cache_index* cindex);
+
+/* writes given cache index to specified file if it has deferred changes */
+int scr_cache_index_sync(const spath* file, scr_cache_index* cindex);
 
 /* create a new cache index structure */
 scr_cache_index* scr_cache_index_new(void);
@@ -54,7 +54,7 @@ int scr_cache_index_read(const spath* path_file, scr_cache_index* cindex)
     /* attempt to read the file */
     if (scr_file_is_readable(file) == SCR_SUCCESS) {
       /* ok, now try to read the file */
-      if (kvtree_read_file(file, cindex) == KVTREE_SUCCESS) {
+      if (kvtree_read_file(file, cindex->hash) == KVTREE_SUCCESS) {
         /* successfully read the cache index file */
         rc = SCR_SUCCESS;
       } else {
@@ -73,14 +73,14 @@ int scr_cache_index_read(const spath* path_file, scr_cache_index* cindex)
 
   /* bcast data to other ranks sharing the control directory */
   if (rc == SCR_SUCCESS) {
-    kvtree_bcast(cindex, 0, scr_storedesc_cntl->comm);
+    kvtree_bcast(cindex->hash, 0, scr_storedesc_cntl->comm);
   }
 
   return rc;
 }
 
 /* writes given cache index to specified file */
-int scr_cache_index_write(const spath* file, const scr_cache_index* cindex)
+int scr_cache_index_write(const spath* file, scr_cache_index* cindex)
 {
   /* check that we have a cindex pointer */
   if (cindex == NULL) {
@@ -88,8 +88,9 @@ int scr_cache_index_write(const spath* file, const scr_cache_index* cindex)
   }
 
   if (scr_storedesc_cntl->rank == 0) {
-    /* write out the hash */
-    if (kvtree_write_path(file, cindex) != KVTREE_SUCCESS) {
+    /* write out the hash, replacing the old file in a single step so that
+     * a crash or a scavenge never sees a partially written index */
+    if (scr_kvtree_write_atomic(file, cindex->hash) != SCR_SUCCESS) {
       char path_err[SCR_MAX_FILENAME];
       spath_strcpy(path_err, sizeof(path_err), file);
       scr_err("Writing cache index %s @ %s:%d",
@@ -99,5 +100,8 @@ int scr_cache_index_write(const spath* file, const scr_cache_index* cindex)
     }
   }
 
+  /* the file now matches what we have in memory */
+  cindex->dirty = 0;
+
   return SCR_SUCCESS;
 }
@@ -53,7 +53,7 @@ int scr_cache_index_read(const spath* path_file, scr_cache_index* cindex)
   /* attempt to read the file */
   if (scr_file_is_readable(file) == SCR_SUCCESS) {
     /* ok, now try to read the file */
-    if (kvtree_read_file(file, cindex) == KVTREE_SUCCESS) {
+    if (kvtree_read_file(file, cindex->hash) == KVTREE_SUCCESS) {
       /* successfully read the cache index file */
       rc = SCR_SUCCESS;
     } else {
@@ -70,15 +70,15 @@ int scr_cache_index_read(const spath* path_file, scr_cache_index* cindex)
 }
 
 /* writes given cache index to specified file */
-int scr_cache_index_write(const spath* file, const scr_cache_index* cindex)
+int scr_cache_index_write(const spath* file, scr_cache_index* cindex)
 {
   /* check that we have a cindex pointer */
   if (cindex == NULL) {
     return SCR_FAILURE;
   }
 
-  /* write out the hash */
-  if (kvtree_write_path(file, cindex) != KVTREE_SUCCESS) {
+  /* write out the hash, replacing the old file in a single step */
+  if (scr_kvtree_write_atomic(file, cindex->hash) != SCR_SUCCESS) {
     char path_err[SCR_MAX_FILENAME];
     spath_strcpy(path_err, sizeof(path_err), file);
     scr_err("Writing cache index %s @ %s:%d",
@@ -87,5 +87,8 @@ int scr_cache_index_write(const spath* file, const scr_cache_index* cindex)
     return SCR_FAILURE;
   }
 
+  /* the file now matches what we have in memory */
+  cindex->dirty = 0;
+
   return SCR_SUCCESS;
 }
@@ -86,7 +86,7 @@ static int scr_distribute_datasets(scr_cache_index* cindex, int id)
   /* record the descriptor in our cache index */
   scr_cache_index_set_dataset(cindex, id, dataset);
   scr_cache_index_set_bypass(cindex, id, bypass);
-  scr_cache_index_write(scr_cindex_file, cindex);
+  scr_cache_index_defer(cindex);
 
   /* free off dataset object */
   scr_dataset_delete(&dataset);
@@ -211,7 +211,7 @@ int scr_cache_rebuild(scr_cache_index* cindex)
 
     /* set current marker in our cache index */
     scr_cache_index_set_current(cindex, current_name);
-    scr_cache_index_write(scr_cindex_file, cindex);
+    scr_cache_index_defer(cindex);
   }
   scr_free(&current_name);
 
@@ -405,9 +405,8 @@ int scr_cache_rebuild(scr_cache_index* cindex)
 int scr_flush_file_rebuild(const scr_cache_index* cindex)
 {
   if (scr_my_rank_world == 0) {
-    /* read the flush file */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    /* get the flush file state */
+    kvtree* hash = scr_flush_file_state();
 
     /* get ordered list of dataset ids in flush file */
     int flush_ndsets;
@@ -470,11 +469,8 @@ int scr_flush_file_rebuild(const scr_cache_index* cindex)
     /* free our list of flush file dataset ids */
     scr_free(&flush_dsets);
 
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+    /* write the state back to the flush file */
+    scr_flush_file_commit();
   }
   return SCR_SUCCESS;
 }
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Implements compression of files on their way to and from the
+ * parallel file system.  Files are written as gzip streams, so they
+ * can also be uncompressed with standard tools. */
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_io.h"
+#include "scr_util.h"
+#include "scr_compress.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <zlib.h>
+
+/* window bits to have zlib read and write a gzip header */
+#define SCR_COMPRESS_GZIP_BITS (15 + 16)
+
+/* parse a compression setting of the form <codec>[:<level>], e.g., "zlib:6",
+ * returns the codec and level, the level is -1 to use the codec default */
+int scr_compress_parse(const char* value, int* codec, int* level)
+{
+  *codec = SCR_COMPRESS_NONE;
+  *level = -1;
+
+  /* split codec name from level */
+  char* name = strdup(value);
+  char* level_str = strchr(name, ':');
+  if (level_str != NULL) {
+    *level_str = '\0';
+    level_str++;
+  }
+
+  int rc = SCR_SUCCESS;
+  if (strcasecmp(name, "none") == 0 || strcmp(name, "0") == 0) {
+    *codec = SCR_COMPRESS_NONE;
+  } else if (strcasecmp(name, "zlib") == 0 || strcasecmp(name, "gzip") == 0) {
+    *codec = SCR_COMPRESS_ZLIB;
+  } else {
+    scr_err("Unknown compression codec `%s' @ %s:%d",
+      name, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  /* zlib levels run from 1 (fastest) to 9 (smallest) */
+  if (rc == SCR_SUCCESS && level_str != NULL) {
+    int l = atoi(level_str);
+    if (l >= 1 && l <= 9) {
+      *level = l;
+    } else {
+      scr_err("Invalid compression level `%s' @ %s:%d",
+        level_str, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  scr_free(&name);
+  return rc;
+}
+
+/* returns the name of a codec, as recorded in meta data and rank2file */
+const char* scr_compress_name(int codec)
+{
+  switch (codec) {
+  case SCR_COMPRESS_ZLIB:
+    return "ZLIB";
+  }
+  return "NONE";
+}
+
+/* returns the codec for a name recorded in meta data and rank2file */
+int scr_compress_codec(const char* name, int* codec)
+{
+  if (strcmp(name, "ZLIB") == 0) {
+    *codec = SCR_COMPRESS_ZLIB;
+    return SCR_SUCCESS;
+  }
+  if (strcmp(name, "NONE") == 0) {
+    *codec = SCR_COMPRESS_NONE;
+    return SCR_SUCCESS;
+  }
+  return SCR_FAILURE;
+}
+
+/* returns the suffix appended to the name of a file compressed with codec */
+const char* scr_compress_suffix(int codec)
+{
+  switch (codec) {
+  case SCR_COMPRESS_ZLIB:
+    return ".gz";
+  }
+  return "";
+}
+
+/* open src_file for reading and dst_file for writing */
+static int scr_compress_open(
+  const char* src_file, int* src_fd,
+  const char* dst_file, int* dst_fd)
+{
+  *src_fd = scr_open(src_file, O_RDONLY);
+  if (*src_fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      src_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  *dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (*dst_fd < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      dst_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src_file, *src_fd);
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* compress src_file into dst_file with the given codec and level,
+ * reading and writing in chunks of buf_size bytes */
+int scr_compress_file(
+  const char* src_file,
+  const char* dst_file,
+  int codec,
+  int level,
+  unsigned long buf_size)
+{
+  if (codec != SCR_COMPRESS_ZLIB) {
+    scr_err("Unsupported compression codec %d @ %s:%d",
+      codec, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int src_fd, dst_fd;
+  if (scr_compress_open(src_file, &src_fd, dst_file, &dst_fd) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* initialize the stream to write a gzip header */
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (level < 0) {
+    level = Z_DEFAULT_COMPRESSION;
+  }
+  if (deflateInit2(&strm, level, Z_DEFLATED, SCR_COMPRESS_GZIP_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    scr_err("Failed to initialize compression of %s @ %s:%d",
+      src_file, __FILE__, __LINE__
+    );
+    scr_close(dst_file, dst_fd);
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+
+  unsigned char* buf_in  = (unsigned char*) SCR_MALLOC(buf_size);
+  unsigned char* buf_out = (unsigned char*) SCR_MALLOC(buf_size);
+
+  int rc = SCR_SUCCESS;
+  int flush = Z_NO_FLUSH;
+  while (rc == SCR_SUCCESS && flush != Z_FINISH) {
+    /* read the next chunk, and finish the stream at the end of the file */
+    ssize_t nread = scr_read(src_file, src_fd, buf_in, buf_size);
+    if (nread < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    if (nread < (ssize_t) buf_size) {
+      flush = Z_FINISH;
+    }
+    strm.next_in  = buf_in;
+    strm.avail_in = (uInt) nread;
+
+    /* compress the chunk, writing out each full output buffer */
+    do {
+      strm.next_out  = buf_out;
+      strm.avail_out = (uInt) buf_size;
+      if (deflate(&strm, flush) == Z_STREAM_ERROR) {
+        rc = SCR_FAILURE;
+        break;
+      }
+      size_t have = buf_size - strm.avail_out;
+      if (have > 0 && scr_write(dst_file, dst_fd, buf_out, have) != (ssize_t) have) {
+        rc = SCR_FAILURE;
+        break;
+      }
+    } while (strm.avail_out == 0);
+  }
+
+  deflateEnd(&strm);
+
+  scr_free(&buf_out);
+  scr_free(&buf_in);
+
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(src_file, src_fd);
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to compress %s to %s @ %s:%d",
+      src_file, dst_file, __FILE__, __LINE__
+    );
+    scr_file_unlink(dst_file);
+  }
+
+  return rc;
+}
+
+/* uncompress src_file written by scr_compress_file into dst_file,
+ * reading and writing in chunks of buf_size bytes */
+int scr_uncompress_file(
+  const char* src_file,
+  const char* dst_file,
+  int codec,
+  unsigned long buf_size)
+{
+  if (codec != SCR_COMPRESS_ZLIB) {
+    scr_err("Unsupported compression codec %d @ %s:%d",
+      codec, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int src_fd, dst_fd;
+  if (scr_compress_open(src_file, &src_fd, dst_file, &dst_fd) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* initialize the stream to read a gzip header */
+  z_stream strm;
+  memset(&strm, 0, sizeof(strm));
+  if (inflateInit2(&strm, SCR_COMPRESS_GZIP_BITS) != Z_OK) {
+    scr_err("Failed to initialize decompression of %s @ %s:%d",
+      src_file, __FILE__, __LINE__
+    );
+    scr_close(dst_file, dst_fd);
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+
+  unsigned char* buf_in  = (unsigned char*) SCR_MALLOC(buf_size);
+  unsigned char* buf_out = (unsigned char*) SCR_MALLOC(buf_size);
+
+  int rc = SCR_SUCCESS;
+  int zrc = Z_OK;
+  while (rc == SCR_SUCCESS && zrc != Z_STREAM_END) {
+    /* read the next chunk, running out of data before the end
+     * of the stream means the file was truncated */
+    ssize_t nread = scr_read(src_file, src_fd, buf_in, buf_size);
+    if (nread <= 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    strm.next_in  = buf_in;
+    strm.avail_in = (uInt) nread;
+
+    /* uncompress the chunk, writing out each full output buffer */
+    do {
+      strm.next_out  = buf_out;
+      strm.avail_out = (uInt) buf_size;
+      /* Z_BUF_ERROR only means no progress could be made with the
+       * input and output space we have, so it's not fatal */
+      zrc = inflate(&strm, Z_NO_FLUSH);
+      if (zrc != Z_OK && zrc != Z_STREAM_END && zrc != Z_BUF_ERROR) {
+        rc = SCR_FAILURE;
+        break;
+      }
+      size_t have = buf_size - strm.avail_out;
+      if (have > 0 && scr_write(dst_file, dst_fd, buf_out, have) != (ssize_t) have) {
+        rc = SCR_FAILURE;
+        break;
+      }
+    } while (strm.avail_out == 0 && zrc != Z_STREAM_END);
+  }
+
+  inflateEnd(&strm);
+
+  scr_free(&buf_out);
+  scr_free(&buf_in);
+
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(src_file, src_fd);
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to uncompress %s to %s @ %s:%d",
+      src_file, dst_file, __FILE__, __LINE__
+    );
+    scr_file_unlink(dst_file);
+  }
+
+  return rc;
+}
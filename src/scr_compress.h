@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_COMPRESS_H
+#define SCR_COMPRESS_H
+
+/* codecs used to compress files during flush */
+#define SCR_COMPRESS_NONE (0)
+#define SCR_COMPRESS_ZLIB (1)
+
+/* parse a compression setting of the form <codec>[:<level>], e.g., "zlib:6",
+ * returns the codec and level, the level is -1 to use the codec default */
+int scr_compress_parse(const char* value, int* codec, int* level);
+
+/* returns the name of a codec, as recorded in meta data and rank2file */
+const char* scr_compress_name(int codec);
+
+/* returns the codec for a name recorded in meta data and rank2file */
+int scr_compress_codec(const char* name, int* codec);
+
+/* returns the suffix appended to the name of a file compressed with codec */
+const char* scr_compress_suffix(int codec);
+
+/* compress src_file into dst_file with the given codec and level,
+ * reading and writing in chunks of buf_size bytes */
+int scr_compress_file(
+  const char* src_file,
+  const char* dst_file,
+  int codec,
+  int level,
+  unsigned long buf_size
+);
+
+/* uncompress src_file written by scr_compress_file into dst_file,
+ * reading and writing in chunks of buf_size bytes */
+int scr_uncompress_file(
+  const char* src_file,
+  const char* dst_file,
+  int codec,
+  unsigned long buf_size
+);
+
+#endif
@@ -137,6 +137,17 @@
 #define SCR_CACHE_BYPASS (1)
 #endif
 
+/* whether to store checkpoint files as the blocks that changed since the
+ * previous checkpoint in cache, when that checkpoint has a full copy */
+#ifndef SCR_INCREMENTAL
+#define SCR_INCREMENTAL (0)
+#endif
+
+/* size of blocks compared between checkpoints for incremental checkpoints */
+#ifndef SCR_INCREMENTAL_BLOCK_SIZE
+#define SCR_INCREMENTAL_BLOCK_SIZE (1*1024*1024)
+#endif
+
 /* =========================================================================
  * Default buffer sizes for MPI and file I/O operations.
  * ========================================================================= */
@@ -181,6 +192,12 @@
 #define SCR_FETCH_WIDTH (256)
 #endif
 
+/* whether to start a new reader as soon as another finishes during fetch,
+ * rather than reading in waves of SCR_FETCH_WIDTH processes */
+#ifndef SCR_FETCH_PIPELINE
+#define SCR_FETCH_PIPELINE (0)
+#endif
+
 /* AXL type to use when fetching datasets */
 #ifndef SCR_FETCH_TYPE
 #define SCR_FETCH_TYPE ("SYNC")
@@ -191,6 +208,11 @@
 #define SCR_FETCH_BYPASS (0)
 #endif
 
+/* whether to copy files to cache in the background during restart */
+#ifndef SCR_FETCH_STREAM
+#define SCR_FETCH_STREAM (0)
+#endif
+
 /* set to 0 to disable flush, set to a positive number to set how many checkpoints between flushes */
 #ifndef SCR_FLUSH
 #define SCR_FLUSH (10)
@@ -201,11 +223,22 @@
 #define SCR_FLUSH_WIDTH (SCR_FETCH_WIDTH)
 #endif
 
+/* whether to aggregate the files of each store descriptor into a container during flush */
+#ifndef SCR_FLUSH_AGGREGATE
+#define SCR_FLUSH_AGGREGATE (0)
+#endif
+
 /* AXL type to use when flushing datasets */
 #ifndef SCR_FLUSH_TYPE
 #define SCR_FLUSH_TYPE ("SYNC")
 #endif
 
+/* codec and level to compress files with during flush, e.g., "zlib:6",
+ * set to NONE to disable */
+#ifndef SCR_FLUSH_COMPRESS
+#define SCR_FLUSH_COMPRESS ("NONE")
+#endif
+
 /* whether to force a flush on a restart (useful for codes that must restart from parallel file system) */
 #ifndef SCR_FLUSH_ON_RESTART
 #define SCR_FLUSH_ON_RESTART (0)
@@ -226,14 +259,16 @@
 #define SCR_FLUSH_POSTSTAGE (0)
 #endif
 
-/* aggregrate bandwidth limit to impose during asynchronous flushes */
+/* aggregrate bandwidth limit to impose during asynchronous flushes,
+ * this is split evenly across nodes, set to 0 to disable */
 #ifndef SCR_FLUSH_ASYNC_BW
-#define SCR_FLUSH_ASYNC_BW (200*1024*1024)
+#define SCR_FLUSH_ASYNC_BW (0)
 #endif
 
-/* maximum percent cpu time allowed during asynchronous flushes (does not yet work well) */
+/* maximum percent of runtime during which asynchronous flushes may be writing data,
+ * set to 0 to disable */
 #ifndef SCR_FLUSH_ASYNC_PERCENT
-#define SCR_FLUSH_ASYNC_PERCENT (0.0) /* TODO: the fsync complicates this throttling, disable it for now */
+#define SCR_FLUSH_ASYNC_PERCENT (0.0)
 #endif
 
 /* sleep time when polling for an async flush to complete */
@@ -246,6 +281,11 @@
 #define SCR_PREFIX_SIZE (0)
 #endif
 
+/* number of changes to append to the index journal before the index file is rewritten */
+#ifndef SCR_INDEX_JOURNAL_RECORDS
+#define SCR_INDEX_JOURNAL_RECORDS (64)
+#endif
+
 /* =========================================================================
  * Default checksum settings.
  * ========================================================================= */
@@ -265,6 +305,18 @@
 #define SCR_CRC_ON_DELETE (0)
 #endif
 
+/* max number of threads each process uses to compute CRC values of large files,
+ * every process on a node may compute CRC values at the same time, so this
+ * defaults to 1 and should only be raised if processes leave cores idle */
+#ifndef SCR_CRC_THREADS
+#define SCR_CRC_THREADS (1)
+#endif
+
+/* max number of threads each process uses to check and stat its files on completion */
+#ifndef SCR_STAT_THREADS
+#define SCR_STAT_THREADS (8)
+#endif
+
 /* =========================================================================
  * The following settings adjust when SCR_Need_checkpoint() will return true.
  * If all settings are 0, all options are disabled and Need_checkpoint() always returns true.
@@ -0,0 +1,760 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include "spath.h"
+#include "kvtree.h"
+#include "kvtree_util.h"
+#include "kvtree_mpi.h"
+
+/*
+=========================================
+Container file functions
+=========================================
+*/
+
+/* tag used for messages between the leader and other processes,
+ * these are sent on a private communicator duplicated from the one
+ * we are given, so they can't match other traffic */
+#define SCR_CONTAINER_TAG (0)
+
+/* footer at the end of a container that locates its index */
+#define SCR_CONTAINER_MAGIC   ("SCRCTR")
+#define SCR_CONTAINER_VERSION (1)
+#define SCR_CONTAINER_FOOTER  (32)
+
+static void scr_container_put32(unsigned char* p, uint32_t v)
+{
+  int i;
+  for (i = 3; i >= 0; i--) {
+    p[i] = (unsigned char) (v & 0xff);
+    v >>= 8;
+  }
+}
+
+static void scr_container_put64(unsigned char* p, uint64_t v)
+{
+  int i;
+  for (i = 7; i >= 0; i--) {
+    p[i] = (unsigned char) (v & 0xff);
+    v >>= 8;
+  }
+}
+
+static uint32_t scr_container_get32(const unsigned char* p)
+{
+  uint32_t v = 0;
+  int i;
+  for (i = 0; i < 4; i++) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+static uint64_t scr_container_get64(const unsigned char* p)
+{
+  uint64_t v = 0;
+  int i;
+  for (i = 0; i < 8; i++) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+/* given the list of files we have to write, compute the name of the
+ * container file in dir used by our group in comm, and the offset
+ * and length of each of our files in that container, caller must
+ * free container with scr_free, collective over comm */
+int scr_container_layout(
+  MPI_Comm comm,
+  const char* dir,
+  int num_files,
+  const char** files,
+  char** container,
+  unsigned long* offsets,
+  unsigned long* lengths)
+{
+  /* our files are stored back to back */
+  int i;
+  unsigned long total = 0;
+  for (i = 0; i < num_files; i++) {
+    lengths[i] = scr_file_size(files[i]);
+    offsets[i] = total;
+    total += lengths[i];
+  }
+
+  /* and come after the files of lower ranks in the group */
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  unsigned long base = 0;
+  MPI_Exscan(&total, &base, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+  if (rank == 0) {
+    /* the value from exscan is undefined on rank 0 */
+    base = 0;
+  }
+  for (i = 0; i < num_files; i++) {
+    offsets[i] += base;
+  }
+
+  /* name the container after the global rank of the leader */
+  int leader = scr_my_rank_world;
+  MPI_Bcast(&leader, 1, MPI_INT, 0, comm);
+  spath* path = spath_from_str(dir);
+  spath_append_strf(path, "ctr.%d.scr", leader);
+  *container = spath_strdup(path);
+  spath_delete(&path);
+
+  return SCR_SUCCESS;
+}
+
+/* read length bytes from file in chunks and send them to the leader,
+ * alternating between two buffers so that we read the next chunk while
+ * the previous one is sent, if we fail to read the file, we send zeros
+ * so that the leader still receives the number of bytes it expects */
+static int scr_container_send_file(
+  MPI_Comm comm,
+  const char* file,
+  unsigned long length,
+  char** bufs,
+  size_t buf_size)
+{
+  int rc = SCR_SUCCESS;
+
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  MPI_Request reqs[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+  int cur = 0;
+  unsigned long remaining = length;
+  while (remaining > 0) {
+    /* wait for the last send from this buffer before we reuse it */
+    MPI_Wait(&reqs[cur], MPI_STATUS_IGNORE);
+
+    char* buf = bufs[cur];
+    size_t count = (remaining < buf_size) ? (size_t) remaining : buf_size;
+    if (rc == SCR_SUCCESS && scr_read(file, fd, buf, count) != (ssize_t) count) {
+      scr_err("Failed to read %lu bytes from %s @ %s:%d",
+        (unsigned long) count, file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+    if (rc != SCR_SUCCESS) {
+      memset(buf, 0, count);
+    }
+    MPI_Isend(buf, (int) count, MPI_BYTE, 0, SCR_CONTAINER_TAG, comm, &reqs[cur]);
+    remaining -= (unsigned long) count;
+    cur ^= 1;
+  }
+  MPI_Waitall(2, reqs, MPI_STATUSES_IGNORE);
+
+  if (fd >= 0) {
+    scr_close(file, fd);
+  }
+
+  return rc;
+}
+
+/* copy length bytes of file into the container at its current position */
+static int scr_container_copy_file(
+  const char* container,
+  int fd_container,
+  const char* file,
+  unsigned long length,
+  char* buf,
+  size_t buf_size)
+{
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  unsigned long remaining = length;
+  while (remaining > 0 && rc == SCR_SUCCESS) {
+    size_t count = (remaining < buf_size) ? (size_t) remaining : buf_size;
+    if (scr_read(file, fd, buf, count) != (ssize_t) count ||
+        scr_write(container, fd_container, buf, count) != (ssize_t) count)
+    {
+      scr_err("Failed to copy %s into container %s @ %s:%d",
+        file, container, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+    remaining -= (unsigned long) count;
+  }
+
+  scr_close(file, fd);
+
+  return rc;
+}
+
+/* returns the next process after r that has data to send,
+ * or ranks if there is none */
+static int scr_container_next_rank(const unsigned long* totals, int ranks, int r)
+{
+  for (r = r + 1; r < ranks; r++) {
+    if (totals[r] > 0) {
+      break;
+    }
+  }
+  return r;
+}
+
+/* tells process r to start sending its data,
+ * returns the number of bytes it will send */
+static unsigned long scr_container_start_rank(MPI_Comm comm, const unsigned long* totals, int ranks, int r)
+{
+  if (r >= ranks) {
+    return 0;
+  }
+  int go = 1;
+  MPI_Send(&go, 1, MPI_INT, r, SCR_CONTAINER_TAG, comm);
+  return totals[r];
+}
+
+/* append the index and the footer that locates it to the container,
+ * offset is the number of bytes of file data before the index */
+static int scr_container_write_index(
+  const char* container,
+  int fd,
+  unsigned long offset,
+  const kvtree* index)
+{
+  size_t index_size = kvtree_pack_size(index);
+  size_t size = index_size + SCR_CONTAINER_FOOTER;
+  unsigned char* buf = (unsigned char*) SCR_MALLOC(size);
+
+  kvtree_pack((char*) buf, index);
+
+  unsigned char* footer = buf + index_size;
+  memset(footer, 0, SCR_CONTAINER_FOOTER);
+  memcpy(footer, SCR_CONTAINER_MAGIC, strlen(SCR_CONTAINER_MAGIC));
+  scr_container_put32(footer +  8, SCR_CONTAINER_VERSION);
+  scr_container_put64(footer + 16, (uint64_t) offset);
+  scr_container_put64(footer + 24, (uint64_t) index_size);
+
+  int rc = SCR_SUCCESS;
+  if (scr_write(container, fd, buf, size) != (ssize_t) size) {
+    scr_err("Failed to write index to container %s @ %s:%d",
+      container, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  scr_free(&buf);
+
+  return rc;
+}
+
+/* send our files to the leader of comm, which writes the files of
+ * each process in order to the container file followed by an index
+ * that lists each file under its name with the offset and length given
+ * by scr_container_layout, returns SCR_SUCCESS if the files of this
+ * process were written, collective over comm */
+int scr_container_write(
+  MPI_Comm comm_in,
+  const char* container,
+  int num_files,
+  const char** files,
+  const char** names,
+  const unsigned long* offsets,
+  const unsigned long* lengths)
+{
+  int rc = SCR_SUCCESS;
+
+  /* hand off data on a private communicator,
+   * so our messages can't match other traffic on comm */
+  MPI_Comm comm;
+  MPI_Comm_dup(comm_in, &comm);
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* list our files for the index of the container */
+  int i;
+  kvtree* index = kvtree_new();
+  for (i = 0; i < num_files; i++) {
+    kvtree* file_hash = kvtree_set_kv(index, SCR_KEY_FILE, names[i]);
+    kvtree_util_set_unsigned_long(file_hash, SCR_KEY_OFFSET, offsets[i]);
+    kvtree_util_set_unsigned_long(file_hash, SCR_KEY_LENGTH, lengths[i]);
+  }
+
+  /* total up the bytes we have to send */
+  unsigned long total = 0;
+  for (i = 0; i < num_files; i++) {
+    total += lengths[i];
+  }
+
+  /* the leader needs to know how many bytes to expect from each process */
+  unsigned long* totals = NULL;
+  if (rank == 0) {
+    totals = (unsigned long*) SCR_MALLOC(ranks * sizeof(unsigned long));
+  }
+  MPI_Gather(&total, 1, MPI_UNSIGNED_LONG, totals, 1, MPI_UNSIGNED_LONG, 0, comm);
+
+  /* we receive or read the next chunk into one buffer,
+   * while we write or send the chunk in the other */
+  size_t buf_size = (size_t) scr_mpi_buf_size;
+  char* bufs[2];
+  bufs[0] = (char*) SCR_MALLOC(buf_size);
+  bufs[1] = (char*) SCR_MALLOC(buf_size);
+
+  if (rank == 0) {
+    /* create the container, if this fails we still receive
+     * data from others, but we don't write it */
+    mode_t mode_file = scr_getmode(1, 1, 0);
+    int fd = scr_open(container, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+    if (fd < 0) {
+      scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+        container, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+
+    /* write our own files first */
+    for (i = 0; i < num_files && rc == SCR_SUCCESS; i++) {
+      rc = scr_container_copy_file(container, fd, files[i], lengths[i], bufs[0], buf_size);
+    }
+
+    /* then receive files from each process in turn, we tell each
+     * process when to start so that we don't receive from everyone
+     * at once, the receive of the next chunk, which may come from the
+     * next process, is posted before we write the current chunk */
+    int recv_rank = scr_container_next_rank(totals, ranks, 0);
+    unsigned long recv_remaining = scr_container_start_rank(comm, totals, ranks, recv_rank);
+    MPI_Request req = MPI_REQUEST_NULL;
+    int cur = 0;
+    if (recv_rank < ranks) {
+      int count = (recv_remaining < buf_size) ? (int) recv_remaining : (int) buf_size;
+      MPI_Irecv(bufs[cur], count, MPI_BYTE, recv_rank, SCR_CONTAINER_TAG, comm, &req);
+    }
+    while (req != MPI_REQUEST_NULL) {
+      int count;
+      MPI_Status status;
+      MPI_Wait(&req, &status);
+      MPI_Get_count(&status, MPI_BYTE, &count);
+
+      /* move on to the next process once we have all of its data */
+      recv_remaining -= (unsigned long) count;
+      if (recv_remaining == 0) {
+        recv_rank = scr_container_next_rank(totals, ranks, recv_rank);
+        recv_remaining = scr_container_start_rank(comm, totals, ranks, recv_rank);
+      }
+
+      /* post the receive of the next chunk into the other buffer */
+      if (recv_rank < ranks) {
+        int next = (recv_remaining < buf_size) ? (int) recv_remaining : (int) buf_size;
+        MPI_Irecv(bufs[cur ^ 1], next, MPI_BYTE, recv_rank, SCR_CONTAINER_TAG, comm, &req);
+      }
+
+      /* write the chunk we have while the next one arrives */
+      if (rc == SCR_SUCCESS && scr_write(container, fd, bufs[cur], (size_t) count) != (ssize_t) count) {
+        scr_err("Failed to write to container %s @ %s:%d",
+          container, __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+      cur ^= 1;
+    }
+
+    /* collect the index of each process, and append it after the data */
+    unsigned long data_size = 0;
+    int r;
+    for (r = 0; r < ranks; r++) {
+      data_size += totals[r];
+      if (r > 0) {
+        kvtree* hash = kvtree_new();
+        kvtree_recv(hash, r, comm);
+        kvtree_merge(index, hash);
+        kvtree_delete(&hash);
+      }
+    }
+    if (rc == SCR_SUCCESS &&
+        scr_container_write_index(container, fd, data_size, index) != SCR_SUCCESS)
+    {
+      rc = SCR_FAILURE;
+    }
+
+    if (fd >= 0 && scr_close(container, fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  } else {
+    if (total > 0) {
+      /* wait for the leader to ask for our data */
+      int go;
+      MPI_Recv(&go, 1, MPI_INT, 0, SCR_CONTAINER_TAG, comm, MPI_STATUS_IGNORE);
+
+      /* send each of our files in order */
+      for (i = 0; i < num_files; i++) {
+        if (scr_container_send_file(comm, files[i], lengths[i], bufs, buf_size) != SCR_SUCCESS) {
+          rc = SCR_FAILURE;
+        }
+      }
+    }
+
+    /* send our part of the index */
+    kvtree_send(index, 0, comm);
+  }
+
+  kvtree_delete(&index);
+  scr_free(&bufs[0]);
+  scr_free(&bufs[1]);
+  scr_free(&totals);
+
+  /* our files are only in the container if the leader wrote it */
+  int leader_rc = rc;
+  MPI_Bcast(&leader_rc, 1, MPI_INT, 0, comm);
+  if (leader_rc != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  MPI_Comm_free(&comm);
+
+  return rc;
+}
+
+/* copy length bytes from offset in the container into file */
+static int scr_container_extract_file(
+  const char* container,
+  unsigned long offset,
+  unsigned long length,
+  const char* file,
+  char* buf,
+  size_t buf_size)
+{
+  int fd_container = scr_open(container, O_RDONLY);
+  if (fd_container < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      container, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(container, fd_container);
+    return SCR_FAILURE;
+  }
+
+  int rc = scr_lseek(container, fd_container, (off_t) offset, SEEK_SET);
+  unsigned long remaining = length;
+  while (remaining > 0 && rc == SCR_SUCCESS) {
+    size_t count = (remaining < buf_size) ? (size_t) remaining : buf_size;
+    if (scr_read(container, fd_container, buf, count) != (ssize_t) count ||
+        scr_write(file, fd, buf, count) != (ssize_t) count)
+    {
+      scr_err("Failed to extract %s from container %s @ %s:%d",
+        file, container, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+    remaining -= (unsigned long) count;
+  }
+
+  if (scr_close(file, fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(container, fd_container);
+
+  return rc;
+}
+
+/* extract files from containers, if every process in comm reads from
+ * the same container, the leader reads the container and scatters data
+ * to the other processes, otherwise each process reads its own files,
+ * returns SCR_SUCCESS if all files of this process were read, collective over comm */
+int scr_container_read(
+  MPI_Comm comm_in,
+  int num_files,
+  const char** containers,
+  const unsigned long* offsets,
+  const unsigned long* lengths,
+  const char** files)
+{
+  int rc = SCR_SUCCESS;
+
+  /* hand off data on a private communicator,
+   * so our messages can't match other traffic on comm */
+  MPI_Comm comm;
+  MPI_Comm_dup(comm_in, &comm);
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* check whether all of our files are in the same container */
+  int i;
+  int same = (num_files > 0);
+  for (i = 1; i < num_files && same; i++) {
+    if (strcmp(containers[i], containers[0]) != 0) {
+      same = 0;
+    }
+  }
+
+  /* and whether that is the container the leader reads */
+  char* leader_container = NULL;
+  if (rank == 0 && same) {
+    leader_container = strdup(containers[0]);
+  }
+  scr_str_bcast(&leader_container, 0, comm);
+  if (leader_container == NULL || (same && strcmp(containers[0], leader_container) != 0)) {
+    same = 0;
+  }
+
+  size_t buf_size = (size_t) scr_mpi_buf_size;
+  char* buf = (char*) SCR_MALLOC(buf_size);
+
+  /* unless our group is reading back a container it wrote,
+   * each process reads its own files */
+  if (! scr_alltrue(same, comm)) {
+    for (i = 0; i < num_files; i++) {
+      if (scr_container_extract_file(containers[i], offsets[i], lengths[i], files[i], buf, buf_size) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+      }
+    }
+    scr_free(&buf);
+    scr_free(&leader_container);
+    MPI_Comm_free(&comm);
+    return rc;
+  }
+
+  /* gather the offset and length of each file to the leader */
+  int* counts = NULL;
+  int* displs = NULL;
+  unsigned long* all_offsets = NULL;
+  unsigned long* all_lengths = NULL;
+  if (rank == 0) {
+    counts = (int*) SCR_MALLOC(ranks * sizeof(int));
+    displs = (int*) SCR_MALLOC(ranks * sizeof(int));
+  }
+  MPI_Gather(&num_files, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+  if (rank == 0) {
+    int total = 0;
+    int r;
+    for (r = 0; r < ranks; r++) {
+      displs[r] = total;
+      total += counts[r];
+    }
+    all_offsets = (unsigned long*) SCR_MALLOC(total * sizeof(unsigned long));
+    all_lengths = (unsigned long*) SCR_MALLOC(total * sizeof(unsigned long));
+  }
+  MPI_Gatherv((void*) offsets, num_files, MPI_UNSIGNED_LONG,
+    all_offsets, counts, displs, MPI_UNSIGNED_LONG, 0, comm
+  );
+  MPI_Gatherv((void*) lengths, num_files, MPI_UNSIGNED_LONG,
+    all_lengths, counts, displs, MPI_UNSIGNED_LONG, 0, comm
+  );
+
+  if (rank == 0) {
+    /* we still send the expected number of bytes if we fail to read
+     * the container, so others don't hang, but they'll get zeros */
+    int fd_container = scr_open(leader_container, O_RDONLY);
+    if (fd_container < 0) {
+      scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+        leader_container, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+
+    /* read the files of each process in turn */
+    int r;
+    for (r = 0; r < ranks; r++) {
+      int j;
+      for (j = 0; j < counts[r]; j++) {
+        unsigned long offset = all_offsets[displs[r] + j];
+        unsigned long remaining = all_lengths[displs[r] + j];
+
+        /* create our own files as we go */
+        int fd = -1;
+        if (r == 0) {
+          mode_t mode_file = scr_getmode(1, 1, 0);
+          fd = scr_open(files[j], O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+          if (fd < 0) {
+            scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+              files[j], errno, strerror(errno), __FILE__, __LINE__
+            );
+            rc = SCR_FAILURE;
+          }
+        }
+
+        int read_rc = SCR_SUCCESS;
+        if (fd_container < 0 ||
+            scr_lseek(leader_container, fd_container, (off_t) offset, SEEK_SET) != SCR_SUCCESS)
+        {
+          read_rc = SCR_FAILURE;
+        }
+
+        while (remaining > 0) {
+          size_t count = (remaining < buf_size) ? (size_t) remaining : buf_size;
+          if (read_rc == SCR_SUCCESS &&
+              scr_read(leader_container, fd_container, buf, count) != (ssize_t) count)
+          {
+            scr_err("Failed to read %lu bytes from container %s @ %s:%d",
+              (unsigned long) count, leader_container, __FILE__, __LINE__
+            );
+            read_rc = SCR_FAILURE;
+          }
+          if (read_rc != SCR_SUCCESS) {
+            memset(buf, 0, count);
+            rc = SCR_FAILURE;
+          }
+
+          if (r == 0) {
+            if (fd >= 0 && scr_write(files[j], fd, buf, count) != (ssize_t) count) {
+              rc = SCR_FAILURE;
+            }
+          } else {
+            MPI_Send(buf, (int) count, MPI_BYTE, r, SCR_CONTAINER_TAG, comm);
+          }
+          remaining -= (unsigned long) count;
+        }
+
+        if (fd >= 0 && scr_close(files[j], fd) != SCR_SUCCESS) {
+          rc = SCR_FAILURE;
+        }
+      }
+    }
+
+    if (fd_container >= 0) {
+      scr_close(leader_container, fd_container);
+    }
+  } else {
+    /* receive each of our files in order */
+    for (i = 0; i < num_files; i++) {
+      mode_t mode_file = scr_getmode(1, 1, 0);
+      int fd = scr_open(files[i], O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+      if (fd < 0) {
+        scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+          files[i], errno, strerror(errno), __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+
+      unsigned long remaining = lengths[i];
+      while (remaining > 0) {
+        int count = (remaining < buf_size) ? (int) remaining : (int) buf_size;
+        MPI_Recv(buf, count, MPI_BYTE, 0, SCR_CONTAINER_TAG, comm, MPI_STATUS_IGNORE);
+        if (fd >= 0 && scr_write(files[i], fd, buf, (size_t) count) != (ssize_t) count) {
+          rc = SCR_FAILURE;
+        }
+        remaining -= (unsigned long) count;
+      }
+
+      if (fd >= 0 && scr_close(files[i], fd) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+      }
+    }
+  }
+
+  /* if the leader failed to read the container, our data is bad */
+  int leader_rc = rc;
+  MPI_Bcast(&leader_rc, 1, MPI_INT, 0, comm);
+  if (leader_rc != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
+  scr_free(&all_lengths);
+  scr_free(&all_offsets);
+  scr_free(&displs);
+  scr_free(&counts);
+  scr_free(&buf);
+  scr_free(&leader_container);
+  MPI_Comm_free(&comm);
+
+  return rc;
+}
+
+/* read the index of a container into index, which lists each file as
+ * FILE/<name> with its OFFSET and LENGTH in the container */
+int scr_container_read_index(const char* container, kvtree* index)
+{
+  /* the footer is at the end of the container */
+  unsigned long size = scr_file_size(container);
+  if (size < SCR_CONTAINER_FOOTER) {
+    scr_err("Container %s is too small to hold an index @ %s:%d",
+      container, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int fd = scr_open(container, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      container, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* read the footer and check that it locates an index
+   * that ends right where the footer starts */
+  unsigned char footer[SCR_CONTAINER_FOOTER];
+  off_t footer_off = (off_t) (size - SCR_CONTAINER_FOOTER);
+  if (scr_lseek(container, fd, footer_off, SEEK_SET) != SCR_SUCCESS ||
+      scr_read(container, fd, footer, sizeof(footer)) != (ssize_t) sizeof(footer))
+  {
+    scr_err("Failed to read footer of container %s @ %s:%d",
+      container, __FILE__, __LINE__
+    );
+    scr_close(container, fd);
+    return SCR_FAILURE;
+  }
+
+  uint64_t index_off  = scr_container_get64(footer + 16);
+  uint64_t index_size = scr_container_get64(footer + 24);
+  if (memcmp(footer, SCR_CONTAINER_MAGIC, strlen(SCR_CONTAINER_MAGIC)) != 0 ||
+      scr_container_get32(footer + 8) != SCR_CONTAINER_VERSION ||
+      index_size == 0 ||
+      index_off > (uint64_t) footer_off ||
+      index_off + index_size != (uint64_t) footer_off)
+  {
+    scr_err("Container %s has no valid index @ %s:%d",
+      container, __FILE__, __LINE__
+    );
+    scr_close(container, fd);
+    return SCR_FAILURE;
+  }
+
+  /* read and unpack the index */
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) SCR_MALLOC((size_t) index_size);
+  if (scr_lseek(container, fd, (off_t) index_off, SEEK_SET) != SCR_SUCCESS ||
+      scr_read(container, fd, buf, (size_t) index_size) != (ssize_t) index_size)
+  {
+    scr_err("Failed to read index of container %s @ %s:%d",
+      container, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  } else if (kvtree_unpack(buf, index) != (size_t) index_size) {
+    scr_err("Corrupt index in container %s @ %s:%d",
+      container, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  scr_free(&buf);
+  scr_close(container, fd);
+
+  return rc;
+}
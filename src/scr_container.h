@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_CONTAINER_H
+#define SCR_CONTAINER_H
+
+#include "mpi.h"
+#include "kvtree.h"
+
+/* Container files:
+ *
+ * To reduce the number of files created on the parallel file system,
+ * the files of all processes in a group, e.g., the processes sharing
+ * a store descriptor on a node, can be written to a single container
+ * file by the leader of the group.  The files of the group are stored
+ * back to back in order of rank within the group, and the rank2file
+ * map records the container, offset, and length of each file.
+ *
+ * A container ends with its own index, so that its files can be found
+ * without the rank2file map:
+ *
+ *   data    the files of the group, starting at offset 0
+ *   index   packed kvtree listing the offset and length of each file
+ *           by its path relative to the prefix directory
+ *   footer  magic, version, and the offset and size of the index,
+ *           integers are stored in big-endian byte order */
+
+/* given the list of files we have to write, compute the name of the
+ * container file in dir used by our group in comm, and the offset
+ * and length of each of our files in that container, caller must
+ * free container with scr_free, collective over comm */
+int scr_container_layout(
+  MPI_Comm comm,
+  const char* dir,
+  int num_files,
+  const char** files,
+  char** container,
+  unsigned long* offsets,
+  unsigned long* lengths
+);
+
+/* send our files to the leader of comm, which writes the files of
+ * each process in order to the container file followed by an index
+ * that lists each file under its name with the offset and length given
+ * by scr_container_layout, returns SCR_SUCCESS if the files of this
+ * process were written, collective over comm */
+int scr_container_write(
+  MPI_Comm comm,
+  const char* container,
+  int num_files,
+  const char** files,
+  const char** names,
+  const unsigned long* offsets,
+  const unsigned long* lengths
+);
+
+/* read the index of a container into index, which lists each file as
+ * FILE/<name> with its OFFSET and LENGTH in the container */
+int scr_container_read_index(const char* container, kvtree* index);
+
+/* extract files from containers, if every process in comm reads from
+ * the same container, the leader reads the container and scatters data
+ * to the other processes, otherwise each process reads its own files,
+ * returns SCR_SUCCESS if all files of this process were read, collective over comm */
+int scr_container_read(
+  MPI_Comm comm,
+  int num_files,
+  const char** containers,
+  const unsigned long* offsets,
+  const unsigned long* lengths,
+  const char** files
+);
+
+#endif
@@ -42,6 +42,10 @@
 #include <dirent.h>
 #include <regex.h>
 
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #ifdef SCR_GLOBALS_H
 #error "globals.h accessed from tools"
 #endif
@@ -63,6 +67,8 @@ struct arglist {
   char* prefix;           /* prefix directory */
   unsigned long buf_size; /* number of bytes to copy file data to file system */
   int crc_flag;           /* whether to compute crc32 during copy */
+  int threads;            /* number of threads to copy files with */
+  int timing;             /* whether to print time taken to copy each file */
 };
 
 int process_args(int argc, char **argv, struct arglist* args)
@@ -73,7 +79,10 @@ int process_args(int argc, char **argv, struct arglist* args)
     {"id",         required_argument, NULL, 'i'},
     {"prefix",     required_argument, NULL, 'd'},
     {"buf",        required_argument, NULL, 'b'},
+    {"buf-size",   required_argument, NULL, 'b'},
     {"crc",        no_argument,       NULL, 'r'},
+    {"threads",    required_argument, NULL, 't'},
+    {"timing",     no_argument,       NULL, 'T'},
     {0, 0, 0, 0}
   };
 
@@ -83,6 +92,8 @@ int process_args(int argc, char **argv, struct arglist* args)
   args->prefix         = NULL;
   args->buf_size       = SCR_FILE_BUF_SIZE;
   args->crc_flag       = SCR_CRC_ON_FLUSH;
+  args->threads        = 1;
+  args->timing         = 0;
 
   /* loop through and process all options */
   int c, id;
@@ -90,7 +101,7 @@ int process_args(int argc, char **argv, struct arglist* args)
   do {
     /* read in our next option */
     int option_index = 0;
-    c = getopt_long(argc, argv, "c:i:d:b:rh", long_options, &option_index);
+    c = getopt_long(argc, argv, "c:i:d:b:rt:Th", long_options, &option_index);
     switch (c) {
       case 'c':
         /* control directory */
@@ -125,6 +136,20 @@ int process_args(int argc, char **argv, struct arglist* args)
         /* compute and record crc32 during copy */
         args->crc_flag = 1;
         break;
+      case 't':
+        /* number of threads to copy files with */
+        args->threads = atoi(optarg);
+        if (args->threads <= 0) {
+          scr_err("%s: Number of threads must be positive '--threads %s'",
+            PROG, optarg
+          );
+          return 0;
+        }
+        break;
+      case 'T':
+        /* print time taken to copy each file */
+        args->timing = 1;
+        break;
       case 'h':
         /* print help message and exit */
         print_usage();
@@ -262,14 +287,197 @@ static int scr_bool_have_files(scr_filemap* map)
 }
 #endif
 
-static int copy_files_for_filemap(
-  const spath* path_prefix,
-  const spath* path_scr,
+/* directories we've already created, so we only call mkdir once for each */
+static kvtree* created_dirs = NULL;
+
+/* create directory if we have not already done so */
+static int copy_mkdir(const char* dir)
+{
+  if (created_dirs == NULL) {
+    created_dirs = kvtree_new();
+  }
+
+  /* nothing to do if we've already created this directory */
+  if (kvtree_get(created_dirs, dir) != NULL) {
+    return SCR_SUCCESS;
+  }
+
+  int rc = scr_mkdir(dir, S_IRWXU);
+  if (rc == SCR_SUCCESS) {
+    kvtree_set(created_dirs, dir, kvtree_new());
+  }
+  return rc;
+}
+
+/* describes a file to be copied by one of our threads */
+struct copy_task {
+  char* src_file;       /* file to copy */
+  char* dst_file;       /* path to copy file to */
+  int copy;             /* whether the file needs to be copied */
+  int crc_flag;         /* whether to compute crc32 during copy */
+  int rc;               /* SCR_SUCCESS if copy succeeded */
+  uLong crc;            /* crc32 computed during copy */
+  int crc_valid;        /* whether crc was computed */
+  unsigned long bytes;  /* number of bytes copied */
+  double secs;          /* time spent copying file */
+};
+
+/* list of copy tasks shared among threads */
+struct copy_pool {
+  struct copy_task* tasks;    /* list of tasks */
+  int count;                  /* number of tasks */
+  int next;                   /* index of next task to be taken */
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;      /* protects next */
+#endif
+  const struct arglist* args; /* buffer size and flags for copy */
+};
+
+/* a filemap whose files are copied by a range of tasks */
+struct copy_filemap {
+  int rank;             /* rank the filemap belongs to */
+  scr_filemap* map;     /* files and their meta data */
+  char* src_filemap;    /* path to filemap in cache */
+  int first;            /* index of first task for this filemap */
+  int count;            /* number of tasks for this filemap */
+  int valid;            /* whether to copy the filemap to the prefix directory */
+};
+
+/* append a task to copy src_file to dst_file, returns the index of the new task */
+static int copy_task_add(
+  struct copy_task** tasks,
+  int* count,
+  int* capacity,
+  const char* src_file,
+  const char* dst_file,
+  int crc_flag)
+{
+  /* grow our list if needed */
+  if (*count == *capacity) {
+    *capacity = (*capacity > 0) ? 2 * *capacity : 64;
+    *tasks = (struct copy_task*) realloc(*tasks, *capacity * sizeof(struct copy_task));
+    if (*tasks == NULL) {
+      scr_abort(-1, "scr_copy: Failed to allocate list of %d files @ %s:%d",
+        *capacity, __FILE__, __LINE__
+      );
+    }
+  }
+
+  struct copy_task* t = &(*tasks)[*count];
+  t->src_file  = strdup(src_file);
+  t->dst_file  = strdup(dst_file);
+  t->copy      = (strcmp(src_file, dst_file) != 0);
+  t->crc_flag  = crc_flag;
+  t->rc        = SCR_SUCCESS;
+  t->crc       = crc32(0L, Z_NULL, 0);
+  t->crc_valid = 0;
+  t->bytes     = 0;
+  t->secs      = 0.0;
+
+  int index = *count;
+  (*count)++;
+  return index;
+}
+
+/* copy a single file, and compute its crc if requested */
+static void copy_task_run(struct copy_task* t, const struct arglist* args)
+{
+  /* in case of bypass, only copy file if source and dest paths are different */
+  if (! t->copy) {
+    /* TODO: should we stat file and check its size? */
+    /* didn't attempt a copy, so we don't have a valid crc */
+    return;
+  }
+
+  double start = scr_seconds();
+
+  /* copy the file and optionally compute the crc during the copy */
+  uLong* crc_p = NULL;
+  if (t->crc_flag) {
+    t->crc_valid = 1;
+    crc_p = &t->crc;
+  }
+  if (scr_file_copy(t->src_file, t->dst_file, args->buf_size, crc_p, 0) != SCR_SUCCESS) {
+    t->crc_valid = 0;
+    t->rc = SCR_FAILURE;
+  } else {
+    t->bytes = scr_file_size(t->dst_file);
+  }
+
+  t->secs = scr_seconds() - start;
+}
+
+/* take tasks from the pool until none remain */
+static void* copy_thread(void* arg)
+{
+  struct copy_pool* pool = (struct copy_pool*) arg;
+  while (1) {
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&pool->mutex);
+#endif
+    int i = pool->next;
+    pool->next++;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_unlock(&pool->mutex);
+#endif
+
+    if (i >= pool->count) {
+      break;
+    }
+    copy_task_run(&pool->tasks[i], pool->args);
+  }
+  return NULL;
+}
+
+/* execute copy tasks using up to args->threads threads */
+static void copy_tasks(struct copy_task* tasks, int count, const struct arglist* args)
+{
+  struct copy_pool pool;
+  pool.tasks = tasks;
+  pool.count = count;
+  pool.next  = 0;
+  pool.args  = args;
+
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&pool.mutex, NULL);
+#endif
+
+  /* all threads take tasks from the pool, the main thread included,
+   * without threads, we copy every file ourself */
+  int nthreads = args->threads;
+  if (nthreads > count) {
+    nthreads = count;
+  }
+  scr_workers_run(nthreads, copy_thread, (void*) &pool, 0);
+
+#ifdef HAVE_PTHREADS
+  pthread_mutex_destroy(&pool.mutex);
+#endif
+}
+
+/* drop tasks from the end of the list until only count remain */
+static void copy_task_truncate(struct copy_task* tasks, int* num_tasks, int count)
+{
+  while (*num_tasks > count) {
+    (*num_tasks)--;
+    scr_free(&tasks[*num_tasks].src_file);
+    scr_free(&tasks[*num_tasks].dst_file);
+  }
+}
+
+/* read filemap, create the directory for each of its files in the
+ * prefix directory, and add a task to copy each file,
+ * if we give up on the filemap, the tasks we added for it are removed */
+static int prepare_files_for_filemap(
   const spath* cache_path,
   const char* entryname,
   int rank,
   const struct arglist* args,
-  const char* hostname)
+  const char* hostname,
+  struct copy_filemap* fm,
+  struct copy_task** tasks,
+  int* num_tasks,
+  int* max_tasks)
 {
   int rc = 0;
 
@@ -279,17 +487,19 @@ static int copy_files_for_filemap(
   spath_reduce(path_filemap);
 
   /* read in file map */
-  scr_filemap* map = scr_filemap_new();
-  scr_filemap_read(path_filemap, map);
-  const char* src_filemap = spath_strdup(path_filemap);
+  fm->rank = rank;
+  fm->map = scr_filemap_new();
+  scr_filemap_read(path_filemap, fm->map);
+  fm->src_filemap = spath_strdup(path_filemap);
+  fm->first = *num_tasks;
+  fm->count = 0;
+  fm->valid = 1;
   spath_delete(&path_filemap);
 
-  /* allocate a rank filemap object */
-  scr_filemap* rank_map = scr_filemap_new();
-
-  /* step through each file we have for this rank */
+  /* step through each file we have for this rank,
+   * and create its directory in the prefix */
   kvtree_elem* file_elem = NULL;
-  for (file_elem = scr_filemap_first_file(map);
+  for (file_elem = scr_filemap_first_file(fm->map);
        file_elem != NULL;
        file_elem = kvtree_elem_next(file_elem))
   {
@@ -297,10 +507,10 @@ static int copy_files_for_filemap(
     char* file = kvtree_elem_key(file_elem);
   
     /* check that we can read the file */
-    if (scr_bool_have_file(map, file)) {
+    if (scr_bool_have_file(fm->map, file)) {
       /* read the meta data for this file */
       scr_meta* meta = scr_meta_new();
-      scr_filemap_get_meta(map, file, meta);
+      scr_filemap_get_meta(fm->map, file, meta);
   
       /* TODO: filemap no longer lists redundancy files,
        * so need another way to grab those */
@@ -313,22 +523,22 @@ static int copy_files_for_filemap(
         );
         printf("scr_copy: %s: Return code: 1\n", hostname);
         scr_meta_delete(&meta);
-        scr_filemap_delete(&map);
-        scr_filemap_delete(&rank_map);
+        copy_task_truncate(*tasks, num_tasks, fm->first);
+        fm->count = 0;
+        fm->valid = 0;
         return 1;
       }
   
-      /* TODO: keep a cache of directory names that we've already created */
-  
       /* make directory to file */
-      if (scr_mkdir(dst_dir, S_IRWXU) != SCR_SUCCESS) {
+      if (copy_mkdir(dst_dir) != SCR_SUCCESS) {
         printf("scr_copy: %s: Failed to create path for file %s in dataset id %d\n",
           hostname, file, args->id
         );
         printf("scr_copy: %s: Return code: 1\n", hostname);
         scr_meta_delete(&meta);
-        scr_filemap_delete(&map);
-        scr_filemap_delete(&rank_map);
+        copy_task_truncate(*tasks, num_tasks, fm->first);
+        fm->count = 0;
+        fm->valid = 0;
         return 1;
       }
   
@@ -338,88 +548,103 @@ static int copy_files_for_filemap(
       spath_prepend_str(dst_path, dst_dir);
       spath_reduce(dst_path);
       char* dst_file = spath_strdup(dst_path);
-  
-      /* copy the file and optionally compute the crc during the copy */
-      int crc_valid = 0;
-      uLong crc = crc32(0L, Z_NULL, 0);
-      uLong* crc_p = NULL;
-      if (args->crc_flag) {
-        crc_valid = 1;
-        crc_p = &crc;
-      }
-      if (strcmp(file, dst_file) != 0) {
-        /* in case of bypass, only copy file if source and dest paths are different */
-        if (scr_file_copy(file, dst_file, args->buf_size, crc_p) != SCR_SUCCESS) {
-          crc_valid = 0;
-          rc = 1;
-        }
-      } else {
-        /* TODO: should we stat file and check its size? */
-        /* didn't attempt a copy, so we don't have a valid crc */
-        crc_valid = 0;
-      }
 
-      /* apply metadata to file */
-      if (scr_meta_apply_stat(meta, dst_file) != SCR_SUCCESS) {
-        rc = 1;
-        scr_err("scr_copy: Failed to copy file metadata properties from %s to %s @ %s:%d",
-          file, dst_file, __FILE__, __LINE__
-        );
-      }
+      copy_task_add(tasks, num_tasks, max_tasks, file, dst_file, args->crc_flag);
+      fm->count++;
+
+      scr_free(&dst_file);
+      spath_delete(&dst_path);
+      scr_meta_delete(&meta);
+    } else {
+      /* have_file failed, so there was some problem accessing file */
+      rc = 1;
+      scr_err("scr_copy: File is unreadable or incomplete: CheckpointID %d, Rank %d, File: %s",
+        args->id, rank, file
+      );
+    }
+  }
+
+  return rc;
+}
+
+/* after the files of a filemap have been copied, check the result
+ * of each copy and copy the filemap to the prefix directory */
+static int complete_files_for_filemap(
+  const spath* path_scr,
+  const struct arglist* args,
+  struct copy_filemap* fm,
+  const struct copy_task* tasks)
+{
+  int rc = 0;
+
+  /* allocate a rank filemap object */
+  scr_filemap* rank_map = scr_filemap_new();
+
+  int i;
+  for (i = fm->first; i < fm->first + fm->count; i++) {
+    const struct copy_task* t = &tasks[i];
+    const char* file     = t->src_file;
+    const char* dst_file = t->dst_file;
+
+    if (t->rc != SCR_SUCCESS) {
+      rc = 1;
+    }
+
+    /* read the meta data for this file */
+    scr_meta* meta = scr_meta_new();
+    scr_filemap_get_meta(fm->map, file, meta);
+
+    /* apply metadata to file */
+    if (scr_meta_apply_stat(meta, dst_file) != SCR_SUCCESS) {
+      rc = 1;
+      scr_err("scr_copy: Failed to copy file metadata properties from %s to %s @ %s:%d",
+        file, dst_file, __FILE__, __LINE__
+      );
+    }
   
-      /* add this file to the rank_map */
-      scr_filemap_add_file(rank_map, file);
+    /* add this file to the rank_map */
+    scr_filemap_add_file(rank_map, file);
   
-      /* if file has crc32, check it against the one computed during
-       * the copy, otherwise if crc_flag is set, record crc32 */
-      if (crc_valid) {
-        uLong meta_crc;
-        if (scr_meta_get_crc32(meta, &meta_crc) == SCR_SUCCESS) {
-          if (crc != meta_crc) {
-            /* detected a crc mismatch during the copy */
+    /* if file has crc32, check it against the one computed during
+     * the copy, otherwise if crc_flag is set, record crc32 */
+    if (t->crc_valid) {
+      uLong crc = t->crc;
+      uLong meta_crc;
+      if (scr_meta_get_crc32(meta, &meta_crc) == SCR_SUCCESS) {
+        if (crc != meta_crc) {
+          /* detected a crc mismatch during the copy */
   
-            /* TODO: unlink the copied file */
-            /* scr_file_unlink(dst_file); */
+          /* TODO: unlink the copied file */
+          /* scr_file_unlink(dst_file); */
   
-            /* mark the file as invalid */
-            scr_meta_set_complete(meta, 0);
+          /* mark the file as invalid */
+          scr_meta_set_complete(meta, 0);
   
-            rc = 1;
-            scr_err("scr_copy: CRC32 mismatch detected when flushing file %s to %s @ %s:%d",
-              file, dst_file, __FILE__, __LINE__
-            );
+          rc = 1;
+          scr_err("scr_copy: CRC32 mismatch detected when flushing file %s to %s @ %s:%d",
+            file, dst_file, __FILE__, __LINE__
+          );
   
-            /* TODO: would be good to log this, but right now only
-             * rank 0 can write log entries */
-            /*
-            if (scr_log_enable) {
-              scr_log_event("CRC32_MISMATCH", my_flushed_file, NULL, NULL, NULL);
-            }
-            */
+          /* TODO: would be good to log this, but right now only
+           * rank 0 can write log entries */
+          /*
+          if (scr_log_enable) {
+            scr_log_event("CRC32_MISMATCH", my_flushed_file, NULL, NULL, NULL);
           }
-        } else {
-          /* the crc was not already in the metafile, but we just
-           * computed it, so set it */
-          scr_meta_set_crc32(meta, crc);
+          */
         }
+      } else {
+        /* the crc was not already in the metafile, but we just
+         * computed it, so set it */
+        scr_meta_set_crc32(meta, crc);
       }
+    }
   
-      /* record its meta data in the filemap */
-      scr_filemap_set_meta(rank_map, file, meta);
+    /* record its meta data in the filemap */
+    scr_filemap_set_meta(rank_map, file, meta);
   
-      /* free the destination file path and string */
-      scr_free(&dst_file);
-      spath_delete(&dst_path);
-  
-      /* free the meta data object */
-      scr_meta_delete(&meta);
-    } else {
-      /* have_file failed, so there was some problem accessing file */
-      rc = 1;
-      scr_err("scr_copy: File is unreadable or incomplete: CheckpointID %d, Rank %d, File: %s",
-        args->id, rank, file
-      );
-    }
+    /* free the meta data object */
+    scr_meta_delete(&meta);
   }
   
   /* TODO: would be nice to use the updated filemap, since it has the CRC on the file,
@@ -427,37 +652,34 @@ static int copy_files_for_filemap(
    * to rebuild it */
   /* write out the rank filemap for scr_index */
   spath* path_rank = spath_dup(path_scr);
-  spath_append_strf(path_rank, "filemap_%d", rank);
+  spath_append_strf(path_rank, "filemap_%d", fm->rank);
 #if 0
   if (scr_filemap_write(path_rank, rank_map) != SCR_SUCCESS) {
     rc = 1;
   }
 #endif
   char* dst_filemap = spath_strdup(path_rank);
-  if (scr_file_copy(src_filemap, dst_filemap, args->buf_size, NULL) != SCR_SUCCESS) {
+  if (scr_file_copy(fm->src_filemap, dst_filemap, args->buf_size, NULL, 0) != SCR_SUCCESS) {
     rc = 1;
   }
   scr_free(&dst_filemap);
-  scr_free(&src_filemap);
   spath_delete(&path_rank);
 
   /* delete the rank filemap object */
   scr_filemap_delete(&rank_map);
-  scr_filemap_delete(&map);
 
   return rc;
 }
 
-static int copy_files_redset(
-  const spath* path_prefix,
+/* add a task to copy a redset file to the dataset directory in the prefix */
+static void prepare_files_redset(
   const spath* path_scr,
   const spath* cache_path,
   const char* entryname,
-  const struct arglist* args,
-  const char* hostname)
+  struct copy_task** tasks,
+  int* num_tasks,
+  int* max_tasks)
 {
-  int rc = 0;
-
   /* define full path to the source redset file */
   spath* path = spath_dup(cache_path);
   spath_append_str(path, entryname);
@@ -471,17 +693,13 @@ static int copy_files_redset(
   char* dst_file = spath_strdup(dst_path);
 
   /* copy redset file to prefix directory */
-  if (scr_file_copy(file, dst_file, args->buf_size, NULL) != SCR_SUCCESS) {
-    rc = 1;
-  }
+  copy_task_add(tasks, num_tasks, max_tasks, file, dst_file, 0);
 
   /* free our paths */
   scr_free(&dst_file);
   spath_delete(&dst_path);
   scr_free(&file);
   spath_delete(&path);
-
-  return rc;
 }
 
 int main (int argc, char *argv[])
@@ -550,7 +768,7 @@ int main (int argc, char *argv[])
   char* cache_str = spath_strdup(cache_path);
 
   regex_t re_filemap_file;
-  regcomp(&re_filemap_file, "filemap_([0-9]+)", REG_EXTENDED);
+  regcomp(&re_filemap_file, "^filemap_([0-9]+)$", REG_EXTENDED);
 
   regex_t re_redsetmap_file;
   regcomp(&re_redsetmap_file, "reddescmap.er.([0-9]+).redset", REG_EXTENDED);
@@ -566,6 +784,16 @@ int main (int argc, char *argv[])
 
   int rc = 0;
 
+  /* list of files to copy */
+  struct copy_task* tasks = NULL;
+  int num_tasks = 0;
+  int max_tasks = 0;
+
+  /* list of filemaps we found */
+  struct copy_filemap* filemaps = NULL;
+  int num_filemaps = 0;
+  int max_filemaps = 0;
+
   /* iterate over each rank we have for this dataset */
   errno = 0;
   DIR* d = opendir(cache_str);
@@ -590,51 +818,39 @@ int main (int argc, char *argv[])
           scr_free(&value);
         }
 
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_for_filemap(path_prefix, path_scr, cache_path, entryname, rank, &args, hostname);
-        if (tmp_rc != 0) {
-          rc = tmp_rc;
-        }
-        continue;
-      }
-
-      /* look for file names like: "reddescmap.er.0.redset" */
-      if (regexec(&re_redsetmap_file, entryname, nmatch, pmatch, 0) == 0) {
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_redset(path_prefix, path_scr, cache_path, entryname, &args, hostname);
-        if (tmp_rc != 0) {
-          rc = tmp_rc;
-        }
-        continue;
-      }
-
-      /* look for file names like: "reddescmap.er.0.partner.0_1.redset" */
-      if (regexec(&re_redsetmap_type_file, entryname, nmatch, pmatch, 0) == 0) {
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_redset(path_prefix, path_scr, cache_path, entryname, &args, hostname);
-        if (tmp_rc != 0) {
-          rc = tmp_rc;
+        /* grow our list of filemaps if needed */
+        if (num_filemaps == max_filemaps) {
+          max_filemaps = (max_filemaps > 0) ? 2 * max_filemaps : 64;
+          filemaps = (struct copy_filemap*) realloc(filemaps, max_filemaps * sizeof(struct copy_filemap));
+          if (filemaps == NULL) {
+            scr_abort(-1, "scr_copy: Failed to allocate list of %d filemaps @ %s:%d",
+              max_filemaps, __FILE__, __LINE__
+            );
+          }
         }
-        continue;
-      }
 
-      /* look for file names like: "reddesc.er.0.redset" */
-      if (regexec(&re_redset_file, entryname, nmatch, pmatch, 0) == 0) {
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_redset(path_prefix, path_scr, cache_path, entryname, &args, hostname);
+        /* found a filemap, add tasks to copy its files */
+        struct copy_filemap* fm = &filemaps[num_filemaps];
+        num_filemaps++;
+        int tmp_rc = prepare_files_for_filemap(cache_path, entryname, rank, &args, hostname,
+          fm, &tasks, &num_tasks, &max_tasks
+        );
         if (tmp_rc != 0) {
           rc = tmp_rc;
         }
         continue;
       }
 
-      /* look for file names like: "reddesc.er.0.partner.0_1.redset" */
-      if (regexec(&re_redset_type_file, entryname, nmatch, pmatch, 0) == 0) {
-        /* found a filemap, copy its files */
-        int tmp_rc = copy_files_redset(path_prefix, path_scr, cache_path, entryname, &args, hostname);
-        if (tmp_rc != 0) {
-          rc = tmp_rc;
-        }
+      /* look for file names like: "reddescmap.er.0.redset",
+       * "reddescmap.er.0.partner.0_1.redset", "reddesc.er.0.redset",
+       * and "reddesc.er.0.partner.0_1.redset" */
+      if (regexec(&re_redsetmap_file,      entryname, nmatch, pmatch, 0) == 0 ||
+          regexec(&re_redsetmap_type_file, entryname, nmatch, pmatch, 0) == 0 ||
+          regexec(&re_redset_file,         entryname, nmatch, pmatch, 0) == 0 ||
+          regexec(&re_redset_type_file,    entryname, nmatch, pmatch, 0) == 0)
+      {
+        /* found a redset file, add a task to copy it */
+        prepare_files_redset(path_scr, cache_path, entryname, &tasks, &num_tasks, &max_tasks);
         continue;
       }
     }
@@ -652,6 +868,59 @@ int main (int argc, char *argv[])
     rc = 1;
   }
 
+  /* copy all files */
+  double copy_start = scr_seconds();
+  copy_tasks(tasks, num_tasks, &args);
+  double copy_secs = scr_seconds() - copy_start;
+
+  /* check the copies and copy each filemap */
+  int i;
+  for (i = 0; i < num_filemaps; i++) {
+    struct copy_filemap* fm = &filemaps[i];
+    if (fm->valid) {
+      int tmp_rc = complete_files_for_filemap(path_scr, &args, fm, tasks);
+      if (tmp_rc != 0) {
+        rc = tmp_rc;
+      }
+    }
+    scr_free(&fm->src_filemap);
+    scr_filemap_delete(&fm->map);
+  }
+  scr_free(&filemaps);
+
+  /* a failed copy of a file that's not in a filemap is an error as well */
+  unsigned long total_bytes = 0;
+  for (i = 0; i < num_tasks; i++) {
+    if (tasks[i].rc != SCR_SUCCESS) {
+      rc = 1;
+    }
+    total_bytes += tasks[i].bytes;
+  }
+
+  /* print time to copy each file and the total */
+  if (args.timing) {
+    for (i = 0; i < num_tasks; i++) {
+      const struct copy_task* t = &tasks[i];
+      printf("scr_copy: %s: Timing: file=%s bytes=%lu secs=%f rc=%d\n",
+        hostname, t->dst_file, t->bytes, t->secs, (t->rc == SCR_SUCCESS) ? 0 : 1
+      );
+    }
+    double bw = 0.0;
+    if (copy_secs > 0.0) {
+      bw = (double) total_bytes / (1024.0 * 1024.0 * copy_secs);
+    }
+    printf("scr_copy: %s: Timing: files=%d bytes=%lu secs=%f threads=%d MB/s=%f\n",
+      hostname, num_tasks, total_bytes, copy_secs, args.threads, bw
+    );
+  }
+
+  /* free our list of files */
+  for (i = 0; i < num_tasks; i++) {
+    scr_free(&tasks[i].src_file);
+    scr_free(&tasks[i].dst_file);
+  }
+  scr_free(&tasks);
+
   /* free our regular expressions */
   regfree(&re_filemap_file);
   regfree(&re_redsetmap_file);
@@ -671,6 +940,9 @@ int main (int argc, char *argv[])
 
   scr_cache_index_delete(&scr_cindex);
 
+  /* free our list of created directories */
+  kvtree_delete(&created_dirs);
+
   /* print our return code and exit */
   printf("scr_copy: %s: Return code: %d\n", hostname, rc);
   return rc;
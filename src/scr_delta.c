@@ -0,0 +1,972 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+
+#include "spath.h"
+#include "kvtree.h"
+#include "kvtree_util.h"
+
+#include <limits.h>
+
+/*
+=========================================
+Incremental checkpoint functions
+=========================================
+*/
+
+/* Format of a delta file:
+ *   kvtree header, written with kvtree_write_fd, that records
+ *     VERSION   - version of the delta file format
+ *     SIZE      - size of the full file in bytes
+ *     BLOCKSIZE - size of each block in bytes
+ *     BASECRC   - crc32 of the base file the delta was computed against
+ *     RANGE     - index of first block of each run of changed blocks,
+ *                 with the number of blocks in the run as COUNT
+ *   followed by the data of each run of changed blocks,
+ *   in order of increasing block index */
+
+/* Format of a hash file, stored in cache next to each file of an
+ * incremental checkpoint, all integers big-endian:
+ *   8 bytes - magic string "SCRHASH"
+ *   4 bytes - version of the hash file format
+ *   4 bytes - reserved
+ *   8 bytes - size of the file in bytes
+ *   8 bytes - size of each block in bytes
+ *   8 bytes - number of blocks
+ *   followed by the crc32 and adler32 of each block, 4 bytes each */
+#define SCR_DELTA_HASH_MAGIC   ("SCRHASH")
+#define SCR_DELTA_HASH_VERSION (1)
+#define SCR_DELTA_HASH_HEADER  (40)
+
+/* number of bytes used to record the hash of one block */
+#define SCR_DELTA_HASH_BYTES (8)
+
+/* block hashes of a file, values holds the crc32 and adler32
+ * of block i at index 2*i and 2*i+1 */
+typedef struct {
+  unsigned long size;
+  unsigned long block_size;
+  unsigned long blocks;
+  uint32_t* values;
+} scr_delta_hashes;
+
+/* only store a file as a delta if at most this percent of its blocks changed */
+#define SCR_DELTA_MAX_PERCENT (50)
+
+/* returns the number of bytes in block i of a file of given size */
+static unsigned long scr_delta_block_len(unsigned long size, unsigned long block_size, unsigned long i)
+{
+  unsigned long offset = i * block_size;
+  if (offset >= size) {
+    return 0;
+  }
+  unsigned long remaining = size - offset;
+  return (remaining < block_size) ? remaining : block_size;
+}
+
+static void scr_delta_put32(unsigned char* p, uint32_t v)
+{
+  p[0] = (unsigned char) (v >> 24);
+  p[1] = (unsigned char) (v >> 16);
+  p[2] = (unsigned char) (v >>  8);
+  p[3] = (unsigned char) (v      );
+}
+
+static void scr_delta_put64(unsigned char* p, uint64_t v)
+{
+  scr_delta_put32(p,     (uint32_t) (v >> 32));
+  scr_delta_put32(p + 4, (uint32_t) (v      ));
+}
+
+static uint32_t scr_delta_get32(const unsigned char* p)
+{
+  return ((uint32_t) p[0] << 24) |
+         ((uint32_t) p[1] << 16) |
+         ((uint32_t) p[2] <<  8) |
+         ((uint32_t) p[3]      );
+}
+
+static uint64_t scr_delta_get64(const unsigned char* p)
+{
+  return ((uint64_t) scr_delta_get32(p) << 32) | (uint64_t) scr_delta_get32(p + 4);
+}
+
+/* frees block hashes */
+static void scr_delta_hashes_free(scr_delta_hashes* hashes)
+{
+  scr_free(&hashes->values);
+  hashes->size       = 0;
+  hashes->block_size = 0;
+  hashes->blocks     = 0;
+}
+
+/* computes the hash of each block of file */
+static int scr_delta_hash_file(const char* file, unsigned long block_size, scr_delta_hashes* hashes)
+{
+  hashes->values = NULL;
+
+  /* open the file for reading */
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* allocate array for hashes and a buffer to read a block */
+  unsigned long filesize = scr_file_size(file);
+  unsigned long blocks = (filesize + block_size - 1) / block_size;
+  uint32_t* values = (uint32_t*) SCR_MALLOC(blocks * 2 * sizeof(uint32_t));
+  char* buf = (char*) SCR_MALLOC(block_size);
+
+  int rc = SCR_SUCCESS;
+  unsigned long i;
+  for (i = 0; i < blocks; i++) {
+    /* read the next block */
+    ssize_t nread = scr_read(file, fd, buf, block_size);
+    if (nread <= 0) {
+      scr_err("Failed to read block %lu of %s @ %s:%d",
+        i, file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    /* record crc32 and adler32 of the block */
+    uLong crc   = scr_crc32_buf(crc32(0L, Z_NULL, 0), buf, (size_t) nread);
+    uLong adler = adler32(adler32(0L, Z_NULL, 0), (const Bytef*) buf, (uInt) nread);
+    values[2 * i + 0] = (uint32_t) crc;
+    values[2 * i + 1] = (uint32_t) adler;
+  }
+
+  scr_close(file, fd);
+  scr_free(&buf);
+
+  if (rc != SCR_SUCCESS) {
+    scr_free(&values);
+    return rc;
+  }
+
+  hashes->size       = filesize;
+  hashes->block_size = block_size;
+  hashes->blocks     = blocks;
+  hashes->values     = values;
+  return SCR_SUCCESS;
+}
+
+/* returns name of the hash file of file as a newly allocated string */
+static char* scr_delta_hash_name(const char* file)
+{
+  char hash_file[SCR_MAX_FILENAME];
+  snprintf(hash_file, sizeof(hash_file), "%s%s", file, SCR_DELTA_HASH_SUFFIX);
+  return strdup(hash_file);
+}
+
+/* writes block hashes of file to its hash file */
+static int scr_delta_hash_write(const char* file, const scr_delta_hashes* hashes)
+{
+  char* hash_file = scr_delta_hash_name(file);
+
+  /* pack header and hashes into a single buffer */
+  size_t bufsize = SCR_DELTA_HASH_HEADER + hashes->blocks * SCR_DELTA_HASH_BYTES;
+  unsigned char* buf = (unsigned char*) SCR_MALLOC(bufsize);
+  memcpy(buf, SCR_DELTA_HASH_MAGIC, 8);
+  scr_delta_put32(buf +  8, SCR_DELTA_HASH_VERSION);
+  scr_delta_put32(buf + 12, 0);
+  scr_delta_put64(buf + 16, (uint64_t) hashes->size);
+  scr_delta_put64(buf + 24, (uint64_t) hashes->block_size);
+  scr_delta_put64(buf + 32, (uint64_t) hashes->blocks);
+  unsigned long i;
+  for (i = 0; i < hashes->blocks * 2; i++) {
+    scr_delta_put32(buf + SCR_DELTA_HASH_HEADER + i * 4, hashes->values[i]);
+  }
+
+  int rc = SCR_SUCCESS;
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(hash_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      hash_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  } else {
+    if (scr_write(hash_file, fd, buf, bufsize) != (ssize_t) bufsize) {
+      rc = SCR_FAILURE;
+    }
+    if (scr_close(hash_file, fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    if (rc != SCR_SUCCESS) {
+      scr_file_unlink(hash_file);
+    }
+  }
+
+  scr_free(&buf);
+  scr_free(&hash_file);
+  return rc;
+}
+
+/* reads block hashes of file from its hash file, fails if there is
+ * no hash file, or if it does not match the file or the block size */
+static int scr_delta_hash_read(const char* file, unsigned long block_size, scr_delta_hashes* hashes)
+{
+  hashes->values = NULL;
+
+  /* the hash file must be at least as new as the file */
+  char* hash_file = scr_delta_hash_name(file);
+  struct stat file_stat, hash_stat;
+  if (stat(file, &file_stat) != 0 ||
+      stat(hash_file, &hash_stat) != 0 ||
+      hash_stat.st_mtime < file_stat.st_mtime ||
+      hash_stat.st_size < SCR_DELTA_HASH_HEADER)
+  {
+    scr_free(&hash_file);
+    return SCR_FAILURE;
+  }
+
+  int fd = scr_open(hash_file, O_RDONLY);
+  if (fd < 0) {
+    scr_free(&hash_file);
+    return SCR_FAILURE;
+  }
+
+  /* read the whole hash file, it is small compared to the file */
+  size_t bufsize = (size_t) hash_stat.st_size;
+  unsigned char* buf = (unsigned char*) SCR_MALLOC(bufsize);
+  ssize_t nread = scr_read(hash_file, fd, buf, bufsize);
+  scr_close(hash_file, fd);
+
+  /* check header against the file and the size of the hash file */
+  int rc = SCR_FAILURE;
+  unsigned long size = (unsigned long) file_stat.st_size;
+  unsigned long blocks = (size + block_size - 1) / block_size;
+  if (nread == (ssize_t) bufsize &&
+      memcmp(buf, SCR_DELTA_HASH_MAGIC, 8) == 0 &&
+      scr_delta_get32(buf +  8) == SCR_DELTA_HASH_VERSION &&
+      scr_delta_get64(buf + 16) == (uint64_t) size &&
+      scr_delta_get64(buf + 24) == (uint64_t) block_size &&
+      scr_delta_get64(buf + 32) == (uint64_t) blocks &&
+      bufsize == SCR_DELTA_HASH_HEADER + blocks * SCR_DELTA_HASH_BYTES)
+  {
+    uint32_t* values = (uint32_t*) SCR_MALLOC(blocks * 2 * sizeof(uint32_t));
+    unsigned long i;
+    for (i = 0; i < blocks * 2; i++) {
+      values[i] = scr_delta_get32(buf + SCR_DELTA_HASH_HEADER + i * 4);
+    }
+    hashes->size       = size;
+    hashes->block_size = block_size;
+    hashes->blocks     = blocks;
+    hashes->values     = values;
+    rc = SCR_SUCCESS;
+  }
+
+  scr_free(&buf);
+  scr_free(&hash_file);
+  return rc;
+}
+
+/* gets block hashes of file from its hash file, or computes them
+ * and writes the hash file so that the file is only read once */
+static int scr_delta_hash_get(const char* file, unsigned long block_size, scr_delta_hashes* hashes)
+{
+  if (scr_delta_hash_read(file, block_size, hashes) == SCR_SUCCESS) {
+    return SCR_SUCCESS;
+  }
+  if (scr_delta_hash_file(file, block_size, hashes) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+  scr_delta_hash_write(file, hashes);
+  return SCR_SUCCESS;
+}
+
+/* deletes the hash file of file from cache, if any */
+int scr_delta_hash_unlink(const char* file)
+{
+  char* hash_file = scr_delta_hash_name(file);
+  int rc = scr_file_unlink(hash_file);
+  scr_free(&hash_file);
+  return rc;
+}
+
+/* computes the crc32 of a whole file from the crc32 values of its blocks */
+static uLong scr_delta_hash_crc(const scr_delta_hashes* hashes)
+{
+  uLong crc = crc32(0L, Z_NULL, 0);
+  unsigned long i;
+  for (i = 0; i < hashes->blocks; i++) {
+    uLong block_crc = (uLong) hashes->values[2 * i];
+    unsigned long len = scr_delta_block_len(hashes->size, hashes->block_size, i);
+    crc = crc32_combine(crc, block_crc, (z_off_t) len);
+  }
+  return crc;
+}
+
+/* returns 1 if block i has the same length and hash in both files */
+static int scr_delta_block_hash_same(const scr_delta_hashes* hashes, const scr_delta_hashes* base, unsigned long i)
+{
+  return (i < base->blocks &&
+    scr_delta_block_len(hashes->size, hashes->block_size, i) == scr_delta_block_len(base->size, base->block_size, i) &&
+    hashes->values[2 * i + 0] == base->values[2 * i + 0] &&
+    hashes->values[2 * i + 1] == base->values[2 * i + 1]);
+}
+
+/* reads len bytes at offset of file into buf */
+static int scr_delta_read_block(const char* file, int fd, unsigned long offset, char* buf, unsigned long len)
+{
+  if (lseek(fd, (off_t) offset, SEEK_SET) == (off_t)-1) {
+    scr_err("Failed to seek to %lu in %s errno=%d %s @ %s:%d",
+      offset, file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  ssize_t nread = scr_read(file, fd, buf, (size_t) len);
+  if (nread != (ssize_t) len) {
+    scr_err("Failed to read %lu bytes from %s @ %s:%d",
+      len, file, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* sets same[i] to 1 for each block of file that matches the same block of
+ * base_file, crc32 and adler32 together can still collide, so a block whose
+ * hashes match is only counted as the same if its bytes match as well */
+static int scr_delta_blocks_same(
+  const char* file, int fd, const scr_delta_hashes* hashes,
+  const char* base_file, int base_fd, const scr_delta_hashes* base_hashes,
+  char* same)
+{
+  int rc = SCR_SUCCESS;
+
+  unsigned long block_size = hashes->block_size;
+  char* buf      = (char*) SCR_MALLOC(block_size);
+  char* base_buf = (char*) SCR_MALLOC(block_size);
+
+  unsigned long i;
+  for (i = 0; i < hashes->blocks && rc == SCR_SUCCESS; i++) {
+    same[i] = 0;
+    if (scr_delta_block_hash_same(hashes, base_hashes, i)) {
+      unsigned long offset = i * block_size;
+      unsigned long len = scr_delta_block_len(hashes->size, block_size, i);
+      if (scr_delta_read_block(file, fd, offset, buf, len) != SCR_SUCCESS ||
+          scr_delta_read_block(base_file, base_fd, offset, base_buf, len) != SCR_SUCCESS)
+      {
+        rc = SCR_FAILURE;
+      } else if (memcmp(buf, base_buf, (size_t) len) == 0) {
+        same[i] = 1;
+      }
+    }
+  }
+
+  scr_free(&base_buf);
+  scr_free(&buf);
+
+  return rc;
+}
+
+/* copies count bytes from src_fd to dst_fd at their current offsets */
+static int scr_delta_copy_bytes(
+  const char* src_file, int src_fd,
+  const char* dst_file, int dst_fd,
+  unsigned long count, char* buf, unsigned long buf_size)
+{
+  while (count > 0) {
+    size_t len = (count < buf_size) ? (size_t) count : (size_t) buf_size;
+    ssize_t nread = scr_read(src_file, src_fd, buf, len);
+    if (nread != (ssize_t) len) {
+      scr_err("Failed to read %lu bytes from %s @ %s:%d",
+        (unsigned long) len, src_file, __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+    ssize_t nwrite = scr_write(dst_file, dst_fd, buf, len);
+    if (nwrite != (ssize_t) len) {
+      scr_err("Failed to write %lu bytes to %s @ %s:%d",
+        (unsigned long) len, dst_file, __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+    count -= (unsigned long) len;
+  }
+  return SCR_SUCCESS;
+}
+
+/* writes blocks of file that differ from base_file to delta_file,
+ * returns SCR_FAILURE without writing delta_file if too many blocks changed */
+static int scr_delta_write(
+  const char* file,
+  const scr_delta_hashes* hashes,
+  const char* base_file,
+  const scr_delta_hashes* base_hashes,
+  const char* delta_file)
+{
+  unsigned long size       = hashes->size;
+  unsigned long block_size = hashes->block_size;
+  unsigned long blocks     = hashes->blocks;
+
+  /* open the file and its base */
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int base_fd = scr_open(base_file, O_RDONLY);
+  if (base_fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      base_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(file, fd);
+    return SCR_FAILURE;
+  }
+
+  /* find the blocks that are the same as in the base */
+  char* same = (char*) SCR_MALLOC(blocks > 0 ? blocks : 1);
+  int same_rc = scr_delta_blocks_same(file, fd, hashes, base_file, base_fd, base_hashes, same);
+  scr_close(base_file, base_fd);
+  if (same_rc != SCR_SUCCESS) {
+    scr_free(&same);
+    scr_close(file, fd);
+    return SCR_FAILURE;
+  }
+
+  /* build header, recording each run of consecutive changed blocks */
+  kvtree* header = kvtree_new();
+  kvtree_util_set_int(header, SCR_DELTA_KEY_VERSION, SCR_DELTA_FILE_VERSION_1);
+  kvtree_util_set_bytecount(header, SCR_DELTA_1_KEY_SIZE, size);
+  kvtree_util_set_bytecount(header, SCR_DELTA_1_KEY_BLOCKSIZE, block_size);
+  kvtree_util_set_crc32(header, SCR_DELTA_1_KEY_BASECRC,
+    scr_delta_hash_crc(base_hashes)
+  );
+
+  unsigned long changed = 0;
+  unsigned long i = 0;
+  while (i < blocks) {
+    if (same[i]) {
+      i++;
+      continue;
+    }
+
+    /* find the end of this run of changed blocks */
+    unsigned long start = i;
+    while (i < blocks && ! same[i]) {
+      i++;
+    }
+
+    kvtree* range = kvtree_set_kv_int(header, SCR_DELTA_1_KEY_RANGE, (int) start);
+    kvtree_util_set_unsigned_long(range, SCR_DELTA_1_KEY_COUNT, i - start);
+    changed += i - start;
+  }
+
+  scr_free(&same);
+
+  /* not worth storing a delta if most of the file changed */
+  if (changed * 100 > blocks * SCR_DELTA_MAX_PERCENT) {
+    scr_close(file, fd);
+    kvtree_delete(&header);
+    return SCR_FAILURE;
+  }
+
+  /* create the delta file */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int delta_fd = scr_open(delta_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (delta_fd < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      delta_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(file, fd);
+    kvtree_delete(&header);
+    return SCR_FAILURE;
+  }
+
+  /* write the header followed by the data of each run */
+  int rc = SCR_SUCCESS;
+  if (kvtree_write_fd(delta_file, delta_fd, header) < 0) {
+    scr_err("Failed to write header to %s @ %s:%d",
+      delta_file, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  char* buf = (char*) SCR_MALLOC(block_size);
+  kvtree* ranges = kvtree_get(header, SCR_DELTA_1_KEY_RANGE);
+  kvtree_sort_int(ranges, KVTREE_SORT_ASCENDING);
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(ranges);
+       elem != NULL && rc == SCR_SUCCESS;
+       elem = kvtree_elem_next(elem))
+  {
+    unsigned long start = (unsigned long) kvtree_elem_key_int(elem);
+    unsigned long count = 0;
+    kvtree_util_get_unsigned_long(kvtree_elem_hash(elem), SCR_DELTA_1_KEY_COUNT, &count);
+
+    /* copy the bytes of this run, the last block of the file may be short */
+    unsigned long offset = start * block_size;
+    unsigned long len = count * block_size;
+    if (offset + len > size) {
+      len = size - offset;
+    }
+    if (lseek(fd, (off_t) offset, SEEK_SET) == (off_t)-1) {
+      scr_err("Failed to seek to %lu in %s errno=%d %s @ %s:%d",
+        offset, file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+    rc = scr_delta_copy_bytes(file, fd, delta_file, delta_fd, len, buf, block_size);
+  }
+  scr_free(&buf);
+
+  if (scr_close(delta_file, delta_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(file, fd);
+  kvtree_delete(&header);
+
+  /* don't leave a partial delta file behind */
+  if (rc != SCR_SUCCESS) {
+    scr_file_unlink(delta_file);
+  }
+
+  return rc;
+}
+
+/* writes file by copying base_file and applying the changed blocks
+ * stored in delta_file, fails if base_file does not match the file
+ * the delta was computed against */
+int scr_delta_apply(const char* base_file, const char* delta_file, const char* file)
+{
+  /* open the delta file and read its header */
+  int delta_fd = scr_open(delta_file, O_RDONLY);
+  if (delta_fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      delta_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  kvtree* header = kvtree_new();
+  ssize_t header_size = kvtree_read_fd(delta_file, delta_fd, header);
+
+  int version = 0;
+  unsigned long size, block_size;
+  uLong base_crc;
+  if (header_size < 0 ||
+      kvtree_util_get_int(header, SCR_DELTA_KEY_VERSION, &version) != KVTREE_SUCCESS ||
+      version != SCR_DELTA_FILE_VERSION_1 ||
+      kvtree_util_get_bytecount(header, SCR_DELTA_1_KEY_SIZE, &size) != KVTREE_SUCCESS ||
+      kvtree_util_get_bytecount(header, SCR_DELTA_1_KEY_BLOCKSIZE, &block_size) != KVTREE_SUCCESS ||
+      kvtree_util_get_crc32(header, SCR_DELTA_1_KEY_BASECRC, &base_crc) != KVTREE_SUCCESS ||
+      block_size == 0)
+  {
+    scr_err("Invalid header in delta file %s @ %s:%d",
+      delta_file, __FILE__, __LINE__
+    );
+    kvtree_delete(&header);
+    scr_close(delta_file, delta_fd);
+    return SCR_FAILURE;
+  }
+
+  /* start from a copy of the base file, computing its crc on the way */
+  uLong crc;
+  if (scr_file_copy(base_file, file, scr_file_buf_size, &crc, 0) != SCR_SUCCESS) {
+    kvtree_delete(&header);
+    scr_close(delta_file, delta_fd);
+    return SCR_FAILURE;
+  }
+  if (crc != base_crc) {
+    scr_err("Base file %s does not match base of delta file %s @ %s:%d",
+      base_file, delta_file, __FILE__, __LINE__
+    );
+    scr_file_unlink(file);
+    kvtree_delete(&header);
+    scr_close(delta_file, delta_fd);
+    return SCR_FAILURE;
+  }
+
+  int fd = scr_open(file, O_WRONLY);
+  if (fd < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    kvtree_delete(&header);
+    scr_close(delta_file, delta_fd);
+    return SCR_FAILURE;
+  }
+
+  /* the data of the changed blocks follows the header */
+  int rc = SCR_SUCCESS;
+  if (lseek(delta_fd, (off_t) header_size, SEEK_SET) == (off_t)-1) {
+    rc = SCR_FAILURE;
+  }
+
+  /* overwrite each run of changed blocks */
+  char* buf = (char*) SCR_MALLOC(block_size);
+  kvtree* ranges = kvtree_get(header, SCR_DELTA_1_KEY_RANGE);
+  kvtree_sort_int(ranges, KVTREE_SORT_ASCENDING);
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(ranges);
+       elem != NULL && rc == SCR_SUCCESS;
+       elem = kvtree_elem_next(elem))
+  {
+    unsigned long start = (unsigned long) kvtree_elem_key_int(elem);
+    unsigned long count = 0;
+    kvtree_util_get_unsigned_long(kvtree_elem_hash(elem), SCR_DELTA_1_KEY_COUNT, &count);
+
+    unsigned long offset = start * block_size;
+    unsigned long len = count * block_size;
+    if (offset + len > size) {
+      len = size - offset;
+    }
+    if (lseek(fd, (off_t) offset, SEEK_SET) == (off_t)-1) {
+      scr_err("Failed to seek to %lu in %s errno=%d %s @ %s:%d",
+        offset, file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+    rc = scr_delta_copy_bytes(delta_file, delta_fd, file, fd, len, buf, block_size);
+  }
+  scr_free(&buf);
+
+  /* the file may be shorter than its base */
+  if (rc == SCR_SUCCESS && ftruncate(fd, (off_t) size) != 0) {
+    scr_err("Failed to truncate %s to %lu bytes errno=%d %s @ %s:%d",
+      file, size, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  if (scr_close(file, fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(delta_file, delta_fd);
+  kvtree_delete(&header);
+
+  return rc;
+}
+
+/* given a file in map and a full copy of a file with the same name in
+ * an older checkpoint, write the delta of the file against the base */
+static int scr_delta_create(
+  scr_filemap* map,
+  const char* file,
+  int base_id,
+  const char* base_file,
+  const scr_meta* base_meta,
+  unsigned long block_size)
+{
+  int rc = SCR_SUCCESS;
+
+  /* get block hashes of our file, written in scr_delta_complete_output */
+  scr_delta_hashes hashes;
+  if (scr_delta_hash_read(file, block_size, &hashes) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* get block hashes of the base, they are computed from the base file
+   * only if the base was fetched, rebuilt, or hashed with a different
+   * block size, and then saved for later checkpoints */
+  scr_delta_hashes base_hashes;
+  if (scr_delta_hash_get(base_file, block_size, &base_hashes) != SCR_SUCCESS) {
+    scr_delta_hashes_free(&hashes);
+    return SCR_FAILURE;
+  }
+
+  /* get full path to the base file in the prefix directory */
+  char* base_orig = NULL;
+  char* origpath;
+  char* origname;
+  if (scr_meta_get_origpath(base_meta, &origpath) == SCR_SUCCESS &&
+      scr_meta_get_origname(base_meta, &origname) == SCR_SUCCESS)
+  {
+    spath* path = spath_from_str(origpath);
+    spath_append_str(path, origname);
+    base_orig = spath_strdup(path);
+    spath_delete(&path);
+  } else {
+    rc = SCR_FAILURE;
+  }
+
+  /* write the delta and record it in the meta data of our file */
+  if (rc == SCR_SUCCESS) {
+    char delta_file[SCR_MAX_FILENAME];
+    snprintf(delta_file, sizeof(delta_file), "%s%s", file, SCR_DELTA_SUFFIX);
+    rc = scr_delta_write(file, &hashes, base_file, &base_hashes, delta_file);
+    if (rc == SCR_SUCCESS) {
+      scr_meta* meta = scr_filemap_edit_meta(map, file);
+      if (meta != NULL) {
+        scr_meta_set_delta(meta, delta_file, base_id, base_file, base_orig);
+      }
+      scr_dbg(2, "Stored changed blocks of %s against %s in %s",
+        file, base_file, delta_file
+      );
+    }
+  }
+
+  scr_free(&base_orig);
+  scr_delta_hashes_free(&base_hashes);
+  scr_delta_hashes_free(&hashes);
+
+  return rc;
+}
+
+/* hashes blocks of each file in map for checkpoint dataset id, and for each
+ * file that has a full copy in an older checkpoint in cache, writes its
+ * changed blocks to a delta file and records the delta in the file meta data */
+int scr_delta_complete_output(scr_cache_index* cindex, int id, scr_filemap* map)
+{
+  unsigned long block_size = scr_incremental_block_size;
+  if (block_size == 0) {
+    return SCR_FAILURE;
+  }
+
+  /* hash blocks of each of our complete files into its hash file, and index
+   * files by name so we can look for a base file with the same name in older
+   * datasets, the hashes are kept out of the filemap so its size does not
+   * grow with the size of the files */
+  kvtree* names = kvtree_new();
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    char* file = kvtree_elem_key(elem);
+
+    const scr_meta* meta = scr_filemap_peek_meta(map, file);
+    if (meta == NULL) {
+      continue;
+    }
+
+    unsigned long size = 0;
+    scr_meta_get_filesize(meta, &size);
+
+    char* name;
+    scr_delta_hashes hashes;
+    if (scr_meta_is_complete(meta) == SCR_SUCCESS && size > 0 &&
+        scr_meta_get_origname(meta, &name) == SCR_SUCCESS &&
+        scr_delta_hash_file(file, block_size, &hashes) == SCR_SUCCESS)
+    {
+      if (scr_delta_hash_write(file, &hashes) == SCR_SUCCESS) {
+        kvtree_set_kv(names, name, file);
+      }
+      scr_delta_hashes_free(&hashes);
+    }
+  }
+
+  /* search older checkpoints in cache from newest to oldest for a full
+   * copy of each file, a file whose newest copy is itself a delta uses
+   * the full copy that delta was computed against */
+  int ndsets;
+  int* dsets;
+  scr_cache_index_list_datasets(cindex, &ndsets, &dsets);
+  int i;
+  for (i = ndsets - 1; i >= 0 && kvtree_size(names) > 0; i--) {
+    int base_id = dsets[i];
+    if (base_id >= id) {
+      continue;
+    }
+
+    /* only complete checkpoints in cache can serve as a base */
+    scr_dataset* dataset = scr_dataset_new();
+    scr_cache_index_get_dataset(cindex, base_id, dataset);
+    int complete = 0;
+    scr_dataset_get_complete(dataset, &complete);
+    int is_ckpt = scr_dataset_is_ckpt(dataset);
+    scr_dataset_delete(&dataset);
+
+    int bypass = 0;
+    scr_cache_index_get_bypass(cindex, base_id, &bypass);
+    if (! complete || ! is_ckpt || bypass) {
+      continue;
+    }
+
+    scr_filemap* base_map = scr_filemap_new();
+    scr_cache_get_map(cindex, base_id, base_map);
+    for (elem = scr_filemap_first_file(base_map);
+         elem != NULL;
+         elem = kvtree_elem_next(elem))
+    {
+      char* base_file = kvtree_elem_key(elem);
+
+      const scr_meta* base_meta = scr_filemap_peek_meta(base_map, base_file);
+      if (base_meta == NULL) {
+        continue;
+      }
+
+      /* look for our file with the same name, skip names that are not unique */
+      char* name;
+      kvtree* files = NULL;
+      if (scr_meta_get_origname(base_meta, &name) == SCR_SUCCESS) {
+        files = kvtree_get(names, name);
+      }
+      if (files != NULL && kvtree_size(files) == 1 &&
+          scr_meta_get_delta(base_meta, NULL, NULL, NULL, NULL) != SCR_SUCCESS &&
+          scr_meta_is_complete(base_meta) == SCR_SUCCESS &&
+          scr_file_is_readable(base_file) == SCR_SUCCESS)
+      {
+        /* found a full copy, write the delta against it, and note in
+         * the cache index that this dataset needs the base dataset */
+        char* file = kvtree_elem_key(kvtree_elem_first(files));
+        if (scr_delta_create(map, file, base_id, base_file, base_meta, block_size) == SCR_SUCCESS) {
+          scr_cache_index_add_base(cindex, id, base_id);
+        }
+        kvtree_unset(names, name);
+      }
+    }
+    scr_filemap_delete(&base_map);
+  }
+  scr_free(&dsets);
+  kvtree_delete(&names);
+
+  return SCR_SUCCESS;
+}
+
+/* returns 1 if any process has a dataset in cache with deltas against
+ * dataset id that has not yet been flushed to the parallel file system,
+ * 0 otherwise, as recorded in the cache index, collective */
+int scr_delta_is_base(const scr_cache_index* cindex, int id)
+{
+  /* datasets record the ids of their bases in the cache index
+   * as their deltas are written */
+  int ndeps;
+  int* deps;
+  scr_cache_index_list_dependents(cindex, id, &ndeps, &deps);
+
+  /* step through dependent ids of any process in increasing order,
+   * once a dependent is on the parallel file system, a restart no longer
+   * needs the base in cache, and a lost dependent is fetched instead of
+   * being rebuilt, so only dependents still in cache alone pin the base */
+  int is_base = 0;
+  int current = -1;
+  while (! is_base) {
+    /* find our smallest dependent id larger than current */
+    int next = INT_MAX;
+    int i;
+    for (i = 0; i < ndeps; i++) {
+      if (deps[i] > current && deps[i] < next) {
+        next = deps[i];
+      }
+    }
+
+    /* get smallest such id across all processes */
+    int min_next;
+    MPI_Allreduce(&next, &min_next, 1, MPI_INT, MPI_MIN, scr_comm_world);
+    if (min_next == INT_MAX) {
+      break;
+    }
+
+    /* the base is still needed if this dependent has not been flushed */
+    if (scr_flush_file_location_test(min_next, SCR_FLUSH_KEY_LOCATION_PFS) != SCR_SUCCESS) {
+      is_base = 1;
+    }
+    current = min_next;
+  }
+  scr_free(&deps);
+
+  return is_base;
+}
+
+/* recreates any full file of dataset id that is missing from cache
+ * from its base file and delta file, returns SCR_SUCCESS if all
+ * processes succeed, collective */
+int scr_delta_restore(const scr_cache_index* cindex, int id)
+{
+  int rc = SCR_SUCCESS;
+
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, id, map);
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    char* file = kvtree_elem_key(elem);
+    const scr_meta* meta = scr_filemap_peek_meta(map, file);
+    if (meta == NULL) {
+      continue;
+    }
+
+    /* rebuild the full file if it was lost, its base was rebuilt
+     * before this dataset since the base is older */
+    char* delta_file;
+    char* base_file;
+    unsigned long size = 0;
+    scr_meta_get_filesize(meta, &size);
+    if (scr_meta_get_delta(meta, &delta_file, NULL, &base_file, NULL) == SCR_SUCCESS &&
+        (scr_file_is_readable(file) != SCR_SUCCESS || scr_file_size(file) != size))
+    {
+      if (scr_delta_apply(base_file, delta_file, file) == SCR_SUCCESS) {
+        /* the meta data in the filemap still describes the file,
+         * so only the file needs its recorded mode and times back */
+        scr_meta_apply_stat(meta, file);
+      } else {
+        scr_err("Failed to restore %s from %s and %s @ %s:%d",
+          file, base_file, delta_file, __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+    }
+  }
+  scr_filemap_delete(&map);
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, scr_comm_world)) {
+    rc = SCR_FAILURE;
+  }
+  return rc;
+}
+
+/* records in flushed the ids of base datasets referenced by deltas in map
+ * that have been flushed to the parallel file system, collective */
+int scr_delta_flushed_bases(const scr_filemap* map, kvtree* flushed)
+{
+  /* step through base ids referenced by any process in increasing order */
+  int current = -1;
+  while (1) {
+    /* find our smallest base id larger than current */
+    int next = INT_MAX;
+    kvtree_elem* elem;
+    for (elem = scr_filemap_first_file(map);
+         elem != NULL;
+         elem = kvtree_elem_next(elem))
+    {
+      char* file = kvtree_elem_key(elem);
+      const scr_meta* meta = scr_filemap_peek_meta(map, file);
+      int base_id;
+      if (meta != NULL &&
+          scr_meta_get_delta(meta, NULL, &base_id, NULL, NULL) == SCR_SUCCESS &&
+          base_id > current && base_id < next)
+      {
+        next = base_id;
+      }
+    }
+
+    /* get smallest such id across all processes */
+    int min_next;
+    MPI_Allreduce(&next, &min_next, 1, MPI_INT, MPI_MIN, scr_comm_world);
+    if (min_next == INT_MAX) {
+      break;
+    }
+
+    /* check whether this base is on the parallel file system */
+    if (scr_flush_file_location_test(min_next, SCR_FLUSH_KEY_LOCATION_PFS) == SCR_SUCCESS) {
+      kvtree_set_kv_int(flushed, SCR_KEY_BASE, min_next);
+    }
+    current = min_next;
+  }
+
+  return SCR_SUCCESS;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_DELTA_H
+#define SCR_DELTA_H
+
+#include "kvtree.h"
+#include "scr_cache_index.h"
+#include "scr_filemap.h"
+
+/* Incremental checkpoints:
+ *
+ * When enabled, SCR hashes fixed-size blocks of each file in
+ * scr_complete_output.  If an older checkpoint in cache has a full copy
+ * of a file with the same name, the blocks that differ from that base
+ * file are written to a delta file next to the full file.  The full file
+ * stays in cache so that a restart from cache is unchanged, while the
+ * redundancy encoding and the flush operate on the delta file instead.
+ * A base file is always a full file, so a delta never depends on
+ * another delta.  The block hashes of each file are kept in a binary
+ * hash file next to it in cache, so a base file is read at most once,
+ * and the base checkpoint is only kept in cache until the checkpoints
+ * that depend on it have been flushed. */
+
+/* suffix appended to the name of a file to name its delta file */
+#define SCR_DELTA_SUFFIX ".scrdelta"
+
+/* suffix appended to the name of a file to name a copy of its base file
+ * written to cache while the file is fetched */
+#define SCR_DELTA_BASE_SUFFIX ".scrbase"
+
+/* suffix appended to the name of a file to name the file that records
+ * the hashes of its blocks */
+#define SCR_DELTA_HASH_SUFFIX ".scrhash"
+
+/* hashes blocks of each file in map for checkpoint dataset id, and for each
+ * file that has a full copy in an older checkpoint in cache, writes its
+ * changed blocks to a delta file and records the delta in the file meta data */
+int scr_delta_complete_output(scr_cache_index* cindex, int id, scr_filemap* map);
+
+/* returns 1 if any process has a dataset in cache with deltas against
+ * dataset id that has not yet been flushed to the parallel file system,
+ * 0 otherwise, as recorded in the cache index, collective */
+int scr_delta_is_base(const scr_cache_index* cindex, int id);
+
+/* recreates any full file of dataset id that is missing from cache
+ * from its base file and delta file, returns SCR_SUCCESS if all
+ * processes succeed, collective */
+int scr_delta_restore(const scr_cache_index* cindex, int id);
+
+/* records in flushed the ids of base datasets referenced by deltas in map
+ * that have been flushed to the parallel file system, collective */
+int scr_delta_flushed_bases(const scr_filemap* map, kvtree* flushed);
+
+/* deletes the hash file of file from cache, if any */
+int scr_delta_hash_unlink(const char* file);
+
+/* writes file by copying base_file and applying the changed blocks
+ * stored in delta_file, fails if base_file does not match the file
+ * the delta was computed against */
+int scr_delta_apply(const char* base_file, const char* delta_file, const char* file);
+
+#endif
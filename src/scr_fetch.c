@@ -37,6 +37,12 @@
 #include "kvtree_util.h"
 #include "axl_mpi.h"
 
+#include <limits.h>
+
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 /*
 =========================================
 Fetch functions
@@ -59,6 +65,251 @@ Fetch functions
  *      and repeat #2
  */
 
+/* state of each file in a streaming fetch */
+#define SCR_FETCH_STREAM_PENDING (0)
+#define SCR_FETCH_STREAM_COPYING (1)
+#define SCR_FETCH_STREAM_DONE    (2)
+#define SCR_FETCH_STREAM_FAILED  (3)
+
+/* a streaming fetch returns to the application as soon as the filemap is
+ * written, while a thread copies files into cache in the background,
+ * files are copied in order except that a file the application routes
+ * during restart is copied next */
+typedef struct {
+  int active;             /* whether a streaming fetch is in progress */
+  scr_workers* thread;    /* thread copying files, NULL once joined */
+  int dset_id;            /* id of dataset being fetched */
+  scr_reddesc rd;         /* redundancy descriptor to apply once all files are in cache */
+  int num_files;          /* number of files to copy */
+  char** src_files;       /* path to each file in prefix directory */
+  char** dst_files;       /* path to each file in cache */
+  kvtree* index;          /* maps path of each file in cache to its index in dst_files */
+  int* state;             /* SCR_FETCH_STREAM state of each file */
+  int next;               /* index of next file to copy in order */
+  int priority;           /* index of file the application is waiting on, or -1 */
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;  /* protects state, next, and priority */
+  pthread_cond_t  cond;   /* signaled each time a file is copied */
+#endif
+} scr_fetch_stream_t;
+
+static scr_fetch_stream_t scr_fetch_stream_state;
+
+/* copy files of a streaming fetch from prefix directory to cache */
+static void* scr_fetch_stream_thread(void* arg)
+{
+  scr_fetch_stream_t* s = (scr_fetch_stream_t*) arg;
+
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&s->mutex);
+#endif
+  while (1) {
+    /* copy the file the application is waiting on if any,
+     * otherwise the next file in order */
+    int i = -1;
+    if (s->priority >= 0 && s->state[s->priority] == SCR_FETCH_STREAM_PENDING) {
+      i = s->priority;
+    } else {
+      while (s->next < s->num_files && s->state[s->next] != SCR_FETCH_STREAM_PENDING) {
+        s->next++;
+      }
+      if (s->next < s->num_files) {
+        i = s->next;
+      }
+    }
+
+    /* stop when all files have been copied */
+    if (i < 0) {
+      break;
+    }
+    s->state[i] = SCR_FETCH_STREAM_COPYING;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_unlock(&s->mutex);
+#endif
+
+    int rc = scr_file_copy(s->src_files[i], s->dst_files[i], scr_file_buf_size, NULL, 0);
+
+    /* wake anyone waiting on this file */
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&s->mutex);
+#endif
+    s->state[i] = (rc == SCR_SUCCESS) ? SCR_FETCH_STREAM_DONE : SCR_FETCH_STREAM_FAILED;
+#ifdef HAVE_PTHREADS
+    pthread_cond_broadcast(&s->cond);
+#endif
+  }
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&s->mutex);
+#endif
+
+  return NULL;
+}
+
+/* start a thread to copy files from prefix to cache for dataset id */
+static int scr_fetch_stream_start(int id, int num_files, const char** src_files, const char** dst_files)
+{
+  scr_fetch_stream_t* s = &scr_fetch_stream_state;
+
+  s->active    = 1;
+  s->dset_id   = id;
+  s->num_files = num_files;
+  s->src_files = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  s->dst_files = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  s->state     = (int*)   SCR_MALLOC(num_files * sizeof(int));
+  s->index     = kvtree_new();
+  s->next      = 0;
+  s->priority  = -1;
+
+  int i;
+  for (i = 0; i < num_files; i++) {
+    s->src_files[i] = strdup(src_files[i]);
+    s->dst_files[i] = strdup(dst_files[i]);
+    s->state[i] = SCR_FETCH_STREAM_PENDING;
+    kvtree_util_set_int(s->index, dst_files[i], i);
+  }
+
+  /* if we can't start a thread, copy the files before returning */
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&s->mutex, NULL);
+  pthread_cond_init(&s->cond, NULL);
+#endif
+  s->thread = scr_workers_start(1, scr_fetch_stream_thread, (void*) s, 0);
+
+  return SCR_SUCCESS;
+}
+
+/* returns 1 if a streaming fetch is in progress, 0 otherwise */
+int scr_fetch_stream_in_progress(void)
+{
+  return scr_fetch_stream_state.active;
+}
+
+/* if file is being copied to cache by a streaming fetch, wait until it
+ * has been copied, returns SCR_FAILURE if the copy failed */
+int scr_fetch_stream_wait(const char* file)
+{
+  scr_fetch_stream_t* s = &scr_fetch_stream_state;
+
+  /* nothing to wait on if we're not streaming */
+  if (! s->active) {
+    return SCR_SUCCESS;
+  }
+
+  /* look for this file in our list */
+  int i;
+  if (kvtree_util_get_int(s->index, file, &i) != KVTREE_SUCCESS) {
+    return SCR_SUCCESS;
+  }
+
+  /* ask for this file to be copied next, and wait for it,
+   * without a thread all files were copied when we started */
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&s->mutex);
+  if (s->state[i] == SCR_FETCH_STREAM_PENDING) {
+    s->priority = i;
+  }
+  while (s->state[i] == SCR_FETCH_STREAM_PENDING || s->state[i] == SCR_FETCH_STREAM_COPYING) {
+    pthread_cond_wait(&s->cond, &s->mutex);
+  }
+#endif
+  int rc = (s->state[i] == SCR_FETCH_STREAM_DONE) ? SCR_SUCCESS : SCR_FAILURE;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&s->mutex);
+#endif
+
+  return rc;
+}
+
+/* wait for all files of a streaming fetch to be copied to cache, then mark
+ * them complete in the filemap and apply the redundancy scheme, returns
+ * SCR_FAILURE if any process failed, in which case the caller should
+ * delete the dataset from cache, collective over scr_comm_world */
+int scr_fetch_stream_complete(scr_cache_index* cindex)
+{
+  scr_fetch_stream_t* s = &scr_fetch_stream_state;
+
+  /* nothing to do if we're not streaming */
+  if (! s->active) {
+    return SCR_SUCCESS;
+  }
+
+  /* wait for our thread to copy the rest of our files */
+  scr_workers_join(&s->thread);
+#ifdef HAVE_PTHREADS
+  pthread_cond_destroy(&s->cond);
+  pthread_mutex_destroy(&s->mutex);
+#endif
+
+  int success = 1;
+  int i;
+  for (i = 0; i < s->num_files; i++) {
+    if (s->state[i] != SCR_FETCH_STREAM_DONE) {
+      scr_err("Failed to fetch %s to %s @ %s:%d",
+        s->src_files[i], s->dst_files[i], __FILE__, __LINE__
+      );
+      success = 0;
+    }
+  }
+
+  int id = s->dset_id;
+  int rc = SCR_SUCCESS;
+  if (scr_alltrue(success, scr_comm_world)) {
+    /* record size of each file now that it's in cache, and mark it complete */
+    scr_filemap* map = scr_filemap_new();
+    scr_cache_get_map(cindex, id, map);
+    for (i = 0; i < s->num_files; i++) {
+      const char* file = s->dst_files[i];
+      scr_meta* meta = scr_filemap_edit_meta(map, file);
+      if (meta == NULL) {
+        continue;
+      }
+
+      struct stat stat_buf;
+      if (stat(file, &stat_buf) == 0) {
+        unsigned long filesize = (unsigned long) stat_buf.st_size;
+        scr_meta_set_filesize(meta, filesize);
+        scr_meta_set_stat(meta, &stat_buf);
+      }
+      scr_meta_set_complete(meta, 1);
+    }
+    scr_cache_set_map(cindex, id, map);
+
+    /* apply redundancy scheme */
+    rc = scr_reddesc_apply(map, &s->rd, id, 0);
+    if (rc == SCR_SUCCESS) {
+      /* this checkpoint is now in cache as well as the parallel file system */
+      scr_flush_file_location_set(id, SCR_FLUSH_KEY_LOCATION_CACHE);
+      scr_flush_file_location_set(id, SCR_FLUSH_KEY_LOCATION_PFS);
+      scr_flush_file_location_unset(id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
+    }
+    scr_filemap_delete(&map);
+  } else {
+    if (scr_my_rank_world == 0) {
+      scr_dbg(1, "One or more processes failed to read its files @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+    rc = SCR_FAILURE;
+  }
+
+  /* free our file list */
+  for (i = 0; i < s->num_files; i++) {
+    scr_free(&s->src_files[i]);
+    scr_free(&s->dst_files[i]);
+  }
+  scr_free(&s->src_files);
+  scr_free(&s->dst_files);
+  scr_free(&s->state);
+  kvtree_delete(&s->index);
+
+  /* free our copy of the redundancy descriptor */
+  scr_reddesc_free(&s->rd);
+
+  s->active = 0;
+
+  return rc;
+}
+
 /* read contents of summary file */
 static int scr_fetch_summary(
   const char* summary_dir,
@@ -149,11 +400,172 @@ cleanup:
   return rc;
 }
 
-/* fetch files from fetch_dir into cache_dir and update filemap */
+/* the changed blocks of an incremental checkpoint name their base file
+ * by the path it had in the prefix directory before its dataset was
+ * flushed, since that dataset may have been flushed compressed or into
+ * containers, look up each base file in the rank2file map of its dataset,
+ * and if it is not stored as is, write a copy of it to cache_dir,
+ * replaces the path in base_filelist with the copy and sets base_tmp
+ * for each copy to be deleted once its file is rebuilt, collective */
+static int scr_fetch_bases(
+  int num_files,
+  const char** base_filelist,
+  const int* base_id_list,
+  int* base_tmp,
+  const char* cache_dir)
+{
+  int rc = SCR_SUCCESS;
+
+  /* step through base ids referenced by any process in increasing order */
+  int current = -1;
+  while (1) {
+    /* find our smallest base id larger than current */
+    int next = INT_MAX;
+    int i;
+    for (i = 0; i < num_files; i++) {
+      if (base_id_list[i] > current && base_id_list[i] < next) {
+        next = base_id_list[i];
+      }
+    }
+
+    /* get smallest such id across all processes */
+    int min_next;
+    MPI_Allreduce(&next, &min_next, 1, MPI_INT, MPI_MIN, scr_comm_world);
+    if (min_next == INT_MAX) {
+      break;
+    }
+    current = min_next;
+
+    /* read the rank2file map of the base dataset, if we can't, we try
+     * the base files where they were before the flush */
+    spath* rank2file_path = spath_from_str(scr_prefix_scr);
+    spath_append_strf(rank2file_path, "scr.dataset.%d", current);
+    spath_append_str(rank2file_path, "rank2file");
+    char* rank2file = spath_strdup(rank2file_path);
+    spath_delete(&rank2file_path);
+
+    kvtree* filelist = kvtree_new();
+    if (kvtree_read_scatter(rank2file, filelist, scr_comm_world) != KVTREE_SUCCESS) {
+      if (scr_my_rank_world == 0) {
+        scr_dbg(1, "Failed to read rank2file map of base dataset %d: `%s'", current, rank2file);
+      }
+      kvtree_delete(&filelist);
+      scr_free(&rank2file);
+      continue;
+    }
+    scr_free(&rank2file);
+
+    kvtree* files = kvtree_get(filelist, SCR_KEY_FILE);
+    for (i = 0; i < num_files; i++) {
+      if (base_id_list[i] != current) {
+        continue;
+      }
+
+      kvtree_elem* elem;
+      for (elem = kvtree_elem_first(files);
+           elem != NULL;
+           elem = kvtree_elem_next(elem))
+      {
+        kvtree* hash = kvtree_elem_hash(elem);
+
+        /* build full path to the file as it was flushed */
+        spath* path = spath_from_str(scr_prefix);
+        spath_append_str(path, kvtree_elem_key(elem));
+        spath_reduce(path);
+        char* file = spath_strdup(path);
+        spath_delete(&path);
+
+        /* drop the codec suffix of a compressed file to compare names */
+        char* codec_name;
+        int codec = SCR_COMPRESS_NONE;
+        char* name = strdup(file);
+        if (kvtree_util_get_str(hash, SCR_KEY_COMPRESS, &codec_name) == KVTREE_SUCCESS &&
+            scr_compress_codec(codec_name, &codec) == SCR_SUCCESS)
+        {
+          size_t suffix_len = strlen(scr_compress_suffix(codec));
+          size_t name_len = strlen(name);
+          if (name_len > suffix_len) {
+            name[name_len - suffix_len] = '\0';
+          }
+        }
+
+        char* container;
+        int found = (strcmp(name, base_filelist[i]) == 0);
+        int in_ctr = (kvtree_util_get_str(hash, SCR_KEY_CONTAINER, &container) == KVTREE_SUCCESS);
+        if (found && (codec != SCR_COMPRESS_NONE || in_ctr)) {
+          /* write a copy of the base file into cache */
+          spath* tmp_path = spath_from_str(name);
+          spath_basename(tmp_path);
+          spath_prepend_str(tmp_path, cache_dir);
+          spath_reduce(tmp_path);
+          char* tmp_name = spath_strdup(tmp_path);
+          spath_delete(&tmp_path);
+
+          char tmp_file[SCR_MAX_FILENAME];
+          snprintf(tmp_file, sizeof(tmp_file), "%s%s", tmp_name, SCR_DELTA_BASE_SUFFIX);
+          scr_free(&tmp_name);
+
+          int copied;
+          if (in_ctr) {
+            /* extract the base file from its container */
+            spath* container_path = spath_from_str(scr_prefix);
+            spath_append_str(container_path, container);
+            spath_reduce(container_path);
+            const char* container_file = spath_strdup(container_path);
+            spath_delete(&container_path);
+
+            unsigned long offset = 0;
+            unsigned long length = 0;
+            kvtree_util_get_unsigned_long(hash, SCR_KEY_OFFSET, &offset);
+            kvtree_util_get_unsigned_long(hash, SCR_KEY_LENGTH, &length);
+
+            const char* tmp_ptr = tmp_file;
+            copied = (scr_container_read(MPI_COMM_SELF, 1, &container_file,
+              &offset, &length, &tmp_ptr) == SCR_SUCCESS
+            );
+            scr_free(&container_file);
+          } else {
+            /* uncompress the base file */
+            copied = (scr_uncompress_file(file, tmp_file, codec, scr_file_buf_size) == SCR_SUCCESS);
+          }
+
+          if (copied) {
+            scr_free(&base_filelist[i]);
+            base_filelist[i] = strdup(tmp_file);
+            base_tmp[i] = 1;
+          } else {
+            scr_err("Failed to copy base file %s into cache @ %s:%d",
+              name, __FILE__, __LINE__
+            );
+            scr_file_unlink(tmp_file);
+            rc = SCR_FAILURE;
+          }
+        }
+
+        scr_free(&name);
+        scr_free(&file);
+
+        if (found) {
+          break;
+        }
+      }
+    }
+
+    kvtree_delete(&filelist);
+  }
+
+  return rc;
+}
+
+/* fetch files from fetch_dir into cache_dir and update filemap,
+ * if bypass is set, files are read in place from the prefix directory,
+ * unless some must be uncompressed, extracted, or rebuilt, in which
+ * case they are written to cache_dir and bypass is cleared */
 static int scr_fetch_data(
   const kvtree* summary_hash,
   const char* fetch_dir,
   const char* cache_dir,
+  int* bypass,
   scr_cache_index* cindex,
   int id)
 {
@@ -177,15 +589,19 @@ static int scr_fetch_data(
   scr_free(&rank2file);
   spath_delete(&rank2file_path);
 
-  /* TODO: gather list of files to leader for each store descriptor,
-   * then use comm of store descriptor leaders in axl call,
-   * have leaders bcast success/fail back to all procs */
-
   /* allocate list of file names */
   kvtree* files = kvtree_get(filelist, "FILE");
   int num_files = kvtree_size(files);
   const char** src_filelist  = (const char**) SCR_MALLOC(num_files * sizeof(char*));
   const char** dest_filelist = (const char**) SCR_MALLOC(num_files * sizeof(char*));
+  const char** base_filelist = (const char**) SCR_MALLOC(num_files * sizeof(char*));
+  int* base_id_list = (int*) SCR_MALLOC(num_files * sizeof(int));
+  int* base_tmp     = (int*) SCR_MALLOC(num_files * sizeof(int));
+  int* codec_list = (int*) SCR_MALLOC(num_files * sizeof(int));
+  const char** container_list = (const char**) SCR_MALLOC(num_files * sizeof(char*));
+  unsigned long* offset_list  = (unsigned long*) SCR_MALLOC(num_files * sizeof(unsigned long));
+  unsigned long* length_list  = (unsigned long*) SCR_MALLOC(num_files * sizeof(unsigned long));
+  int num_containers = 0;
 
   /* create list of file names */
   int i = 0;
@@ -204,10 +620,90 @@ static int scr_fetch_data(
     src_filelist[i] = spath_strdup(srcpath);
     spath_delete(&srcpath);
 
-    /* compute and strdup detination name into dest list */
-    if (cache_dir != NULL) {
+    /* get codec the file was compressed with during flush, if any */
+    codec_list[i] = SCR_COMPRESS_NONE;
+    char* codec;
+    if (kvtree_util_get_str(kvtree_elem_hash(elem), SCR_KEY_COMPRESS, &codec) == KVTREE_SUCCESS &&
+        scr_compress_codec(codec, &codec_list[i]) != SCR_SUCCESS)
+    {
+      /* we'll fail to uncompress this file after reading it */
+      scr_err("Unknown compression codec `%s' for %s @ %s:%d",
+        codec, file, __FILE__, __LINE__
+      );
+      codec_list[i] = -1;
+    }
+
+    /* the changed blocks of an incremental checkpoint file list the path
+     * to their base file, and the id of the older dataset that holds it */
+    base_filelist[i] = NULL;
+    base_id_list[i]  = -1;
+    base_tmp[i]      = 0;
+    char* base;
+    if (kvtree_util_get_str(kvtree_elem_hash(elem), SCR_KEY_BASE, &base) == KVTREE_SUCCESS) {
+      spath* basepath = spath_from_str(scr_prefix);
+      spath_append_str(basepath, base);
+      spath_reduce(basepath);
+      base_filelist[i] = spath_strdup(basepath);
+      spath_delete(&basepath);
+
+      kvtree* base_hash = kvtree_get_kv(kvtree_elem_hash(elem), SCR_KEY_BASE, base);
+      kvtree_util_get_int(base_hash, SCR_KEY_ID, &base_id_list[i]);
+    }
+
+    /* files flushed with aggregation are stored in a container file */
+    container_list[i] = NULL;
+    char* container;
+    if (kvtree_util_get_str(kvtree_elem_hash(elem), SCR_KEY_CONTAINER, &container) == KVTREE_SUCCESS) {
+      spath* container_path = spath_from_str(scr_prefix);
+      spath_append_str(container_path, container);
+      spath_reduce(container_path);
+      container_list[i] = spath_strdup(container_path);
+      spath_delete(&container_path);
+
+      offset_list[i] = 0;
+      length_list[i] = 0;
+      kvtree_util_get_unsigned_long(kvtree_elem_hash(elem), SCR_KEY_OFFSET, &offset_list[i]);
+      kvtree_util_get_unsigned_long(kvtree_elem_hash(elem), SCR_KEY_LENGTH, &length_list[i]);
+      num_containers++;
+    }
+
+    /* move on to the next file */
+    i++;
+  }
+
+  /* free the list of files */
+  kvtree_delete(&filelist);
+
+  /* determine whether the dataset was flushed to container files */
+  int have_containers = (num_containers > 0);
+  int any_containers;
+  MPI_Allreduce(&have_containers, &any_containers, 1, MPI_INT, MPI_MAX, scr_comm_world);
+
+  /* we can only read files in place from the prefix directory if they
+   * were flushed as is, otherwise we write what we make of them to cache
+   * rather than leave extra copies in the prefix directory */
+  if (*bypass) {
+    int in_place = ! any_containers;
+    for (i = 0; i < num_files; i++) {
+      if (codec_list[i] != SCR_COMPRESS_NONE || base_filelist[i] != NULL) {
+        in_place = 0;
+      }
+    }
+    if (! scr_alltrue(in_place, scr_comm_world)) {
+      if (scr_my_rank_world == 0) {
+        scr_dbg(1, "Fetching dataset %d into cache rather than bypass", id);
+      }
+      *bypass = 0;
+      scr_cache_index_set_bypass(cindex, id, 0);
+      scr_cache_index_write(scr_cindex_file, cindex);
+    }
+  }
+
+  /* compute and strdup destination name into dest list */
+  for (i = 0; i < num_files; i++) {
+    if (! *bypass) {
       /* take basename of file and prepend cache directory */
-      spath* destpath = spath_from_str(file);
+      spath* destpath = spath_from_str(src_filelist[i]);
       spath_basename(destpath);
       spath_prepend_str(destpath, cache_dir);
       spath_reduce(destpath);
@@ -217,17 +713,48 @@ static int scr_fetch_data(
       /* otherwise, we don't transfer */
       dest_filelist[i] = strdup(src_filelist[i]);
     }
-
-    /* move on to the next file */
-    i++;
   }
 
-  /* free the list of files */
-  kvtree_delete(&filelist);
+  /* stream files to cache in the background if every file can be copied
+   * as is, files in containers or that must be uncompressed or rebuilt
+   * from a base file are all fetched before we return */
+  int stream = 0;
+  if (scr_fetch_stream && ! *bypass && ! any_containers) {
+    int can_stream = 1;
+    for (i = 0; i < num_files; i++) {
+      if (codec_list[i] != SCR_COMPRESS_NONE || base_filelist[i] != NULL) {
+        can_stream = 0;
+      }
+    }
+    stream = scr_alltrue(can_stream, scr_comm_world);
+  }
 
   /* now we can finally fetch the actual files */
   int success = 1;
-  if (cache_dir != NULL) {
+  if (stream) {
+    /* the application waits on each file as it routes it during restart */
+    scr_fetch_stream_start(id, num_files, src_filelist, dest_filelist);
+  } else if (any_containers) {
+    /* every file must be in a container, if we're missing some,
+     * we still participate in the read but don't extract anything */
+    int count = num_files;
+    if (num_containers != num_files) {
+      scr_err("Missing container for %d files @ %s:%d",
+        num_files - num_containers, __FILE__, __LINE__
+      );
+      success = 0;
+      count = 0;
+    }
+
+    /* read files from containers, using the communicator of
+     * the store descriptor to read each container once */
+    const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+    if (scr_container_read(storedesc->comm, count, container_list,
+      offset_list, length_list, dest_filelist) != SCR_SUCCESS)
+    {
+      success = 0;
+    }
+  } else if (! *bypass) {
     /* get the dataset corresponding to this id */
     scr_dataset* dataset = scr_dataset_new();
     scr_cache_index_get_dataset(cindex, id, dataset);
@@ -240,11 +767,42 @@ static int scr_fetch_data(
     //const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
     axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(SCR_FETCH_TYPE);
 
-    /* fetch these files into the directory */
-    if (scr_axl(dset_name, NULL, num_files, src_filelist, dest_filelist, xfer_type, scr_comm_world) != SCR_SUCCESS) {
+    /* fetch these files into the directory, reading in waves of
+     * at most scr_fetch_width processes at a time */
+    kvtree* stats = kvtree_new();
+    if (scr_axl_window(dset_name, NULL, num_files, src_filelist, dest_filelist,
+      xfer_type, scr_fetch_width, scr_fetch_pipeline, stats, scr_comm_world) != SCR_SUCCESS)
+    {
       success = 0;
     }
 
+    /* log timing of each wave */
+    if (scr_my_rank_world == 0 && scr_log_enable) {
+      kvtree* windows = kvtree_get(stats, SCR_WINDOW_KEY_WINDOW);
+      kvtree_elem* elem;
+      for (elem = kvtree_elem_first(windows);
+           elem != NULL;
+           elem = kvtree_elem_next(elem))
+      {
+        kvtree* hash = kvtree_elem_hash(elem);
+
+        unsigned long start = 0;
+        double secs  = 0.0;
+        double bytes = 0.0;
+        int files    = 0;
+        kvtree_util_get_unsigned_long(hash, SCR_WINDOW_KEY_START, &start);
+        kvtree_util_get_double(hash, SCR_WINDOW_KEY_SECS,  &secs);
+        kvtree_util_get_double(hash, SCR_WINDOW_KEY_BYTES, &bytes);
+        kvtree_util_get_int(hash,    SCR_WINDOW_KEY_FILES, &files);
+
+        time_t timestamp_start = (time_t) start;
+        scr_log_transfer("FETCH_WINDOW", fetch_dir, cache_dir, &id, dset_name,
+          &timestamp_start, &secs, &bytes, &files
+        );
+      }
+    }
+    kvtree_delete(&stats);
+
     /* free datase */
     scr_dataset_delete(&dataset);
   } else {
@@ -258,6 +816,83 @@ static int scr_fetch_data(
     }
   }
 
+  /* uncompress files that were compressed during flush */
+  for (i = 0; i < num_files && success; i++) {
+    if (codec_list[i] == SCR_COMPRESS_NONE) {
+      continue;
+    }
+
+    /* drop the codec suffix from the file names */
+    char* src_file  = strdup(src_filelist[i]);
+    char* dest_file = strdup(dest_filelist[i]);
+    size_t suffix_len = strlen(scr_compress_suffix(codec_list[i]));
+    size_t src_len  = strlen(src_file);
+    size_t dest_len = strlen(dest_file);
+    if (src_len > suffix_len && dest_len > suffix_len) {
+      src_file[src_len - suffix_len]   = '\0';
+      dest_file[dest_len - suffix_len] = '\0';
+    }
+
+    if (scr_uncompress_file(dest_filelist[i], dest_file, codec_list[i], scr_file_buf_size) != SCR_SUCCESS) {
+      success = 0;
+    }
+
+    /* we no longer need the compressed copy in cache */
+    scr_file_unlink(dest_filelist[i]);
+
+    /* record the uncompressed file in place of the compressed file */
+    scr_free(&src_filelist[i]);
+    scr_free(&dest_filelist[i]);
+    src_filelist[i]  = src_file;
+    dest_filelist[i] = dest_file;
+  }
+
+  /* get a copy of any base file that is not in the prefix directory as is */
+  if (scr_fetch_bases(num_files, base_filelist, base_id_list, base_tmp, cache_dir) != SCR_SUCCESS) {
+    success = 0;
+  }
+
+  /* recreate full files of an incremental checkpoint from their changed blocks */
+  for (i = 0; i < num_files && success; i++) {
+    if (base_filelist[i] == NULL) {
+      continue;
+    }
+
+    /* drop the suffix from the names of the changed blocks to get the full file */
+    char* src_file  = strdup(src_filelist[i]);
+    char* dest_file = strdup(dest_filelist[i]);
+    size_t suffix_len = strlen(SCR_DELTA_SUFFIX);
+    size_t src_len  = strlen(src_file);
+    size_t dest_len = strlen(dest_file);
+    if (src_len > suffix_len && dest_len > suffix_len) {
+      src_file[src_len - suffix_len]   = '\0';
+      dest_file[dest_len - suffix_len] = '\0';
+    }
+
+    if (scr_delta_apply(base_filelist[i], dest_filelist[i], dest_file) != SCR_SUCCESS) {
+      scr_err("Failed to recreate %s from base file %s @ %s:%d",
+        dest_file, base_filelist[i], __FILE__, __LINE__
+      );
+      success = 0;
+    }
+
+    /* we no longer need the changed blocks in cache */
+    scr_file_unlink(dest_filelist[i]);
+
+    /* record the full file in place of its changed blocks */
+    scr_free(&src_filelist[i]);
+    scr_free(&dest_filelist[i]);
+    src_filelist[i]  = src_file;
+    dest_filelist[i] = dest_file;
+  }
+
+  /* delete any copy of a base file we wrote to cache */
+  for (i = 0; i < num_files; i++) {
+    if (base_tmp[i]) {
+      scr_file_unlink(base_filelist[i]);
+    }
+  }
+
   /* check that all processes copied their file successfully */
   if (! scr_alltrue(success, scr_comm_world)) {
     /* TODO: auto delete files? */
@@ -276,7 +911,7 @@ static int scr_fetch_data(
 
     /* define meta for file */
     scr_meta* meta = scr_meta_new();
-    scr_meta_set_complete(meta, 1);
+    scr_meta_set_complete(meta, ! stream);
     scr_meta_set_ranks(meta, scr_ranks_world);
     scr_meta_set_orig(meta, src_file);
 
@@ -299,9 +934,10 @@ static int scr_fetch_data(
     spath_delete(&path_name);
     spath_delete(&path_abs);
 
-    /* stat the file to get its size and other metadata */
+    /* stat the file to get its size and other metadata,
+     * a streamed file is marked complete once it's in cache */
     struct stat stat_buf;
-    int stat_rc = stat(dest_file, &stat_buf);
+    int stat_rc = stream ? -1 : stat(dest_file, &stat_buf);
     if (stat_rc == 0) {
       unsigned long filesize = (unsigned long) stat_buf.st_size;
       scr_meta_set_filesize(meta, filesize);
@@ -322,9 +958,18 @@ static int scr_fetch_data(
     /* free filename strings */
     scr_free(&src_filelist[i]);
     scr_free(&dest_filelist[i]);
+    scr_free(&base_filelist[i]);
+    scr_free(&container_list[i]);
   }
   scr_free(&src_filelist);
   scr_free(&dest_filelist);
+  scr_free(&base_filelist);
+  scr_free(&base_id_list);
+  scr_free(&base_tmp);
+  scr_free(&container_list);
+  scr_free(&offset_list);
+  scr_free(&length_list);
+  scr_free(&codec_list);
 
   return rc;
 }
@@ -444,18 +1089,14 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
   /* create the cache directory */
   scr_cache_dir_create(c, dset_id);
 
-  /* we fetch into the cache directory, but we use NULL to indicate
-   * that we're in bypass mode and shouldn't actually transfer files */
-  char* target_dir = cache_dir;
-  if (c->bypass) {
-    target_dir = NULL;
-  }
-
-  /* now we can finally fetch the actual files */
+  /* now we can finally fetch the actual files, in bypass mode we read
+   * them in place unless they must be written to cache */
   int success = 1;
-  if (scr_fetch_data(summary_hash, fetch_dir, target_dir, cindex, dset_id) != SCR_SUCCESS) {
+  int bypass = c->bypass;
+  if (scr_fetch_data(summary_hash, fetch_dir, cache_dir, &bypass, cindex, dset_id) != SCR_SUCCESS) {
     success = 0;
   }
+  c->bypass = bypass;
 
   /* free the hash holding the summary file data */
   kvtree_delete(&summary_hash);
@@ -487,13 +1128,23 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
     return SCR_FAILURE;
   }
 
+  /* if files are still streaming into cache, we apply the redundancy
+   * scheme in scr_fetch_stream_complete, so hand off our descriptor */
+  if (scr_fetch_stream_state.active) {
+    scr_fetch_stream_state.rd = rd;
+    c = NULL;
+  }
+
   /* read file map for this dataset */
   scr_filemap* map = scr_filemap_new();
   scr_cache_get_map(cindex, dset_id, map);
 
   /* apply redundancy scheme */
-  int rc = scr_reddesc_apply(map, c, dset_id);
-  if (rc == SCR_SUCCESS) {
+  int rc = SCR_SUCCESS;
+  if (c == NULL) {
+    /* record checkpoint id */
+    *checkpoint_id = ckpt_id;
+  } else if ((rc = scr_reddesc_apply(map, c, dset_id, 0)) == SCR_SUCCESS) {
     /* record checkpoint id */
     *checkpoint_id = ckpt_id;
 
@@ -513,7 +1164,9 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
   scr_filemap_delete(&map);
 
   /* free our temporary fetch redudancy descriptor */
-  scr_reddesc_free(c);
+  if (c != NULL) {
+    scr_reddesc_free(c);
+  }
 
   /* stop timer, compute bandwidth, and report performance */
   if (scr_my_rank_world == 0) {
@@ -614,7 +1267,7 @@ int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
 
       /* record current marker on each node to not do this again */
       scr_cache_index_set_current(cindex, scr_fetch_current);
-      scr_cache_index_write(scr_cindex_file, cindex);
+      scr_cache_index_defer(cindex);
     }
 
     /* forget this value so that if we call fetch_latest again
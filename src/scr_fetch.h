@@ -13,10 +13,23 @@
 #define SCR_FETCH_H
 
 /* attempt to fetch most recent checkpoint from prefix directory into cache */
-int scr_fetch_latest(scr_filemap* map, int* fetch_attempted);
+int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted);
 
 /* fetch files from given dataset id and name from parallel file system,
  * return its checkpoint id */
 int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name, int* checkpoint_id);
 
+/* returns 1 if a streaming fetch is in progress, 0 otherwise */
+int scr_fetch_stream_in_progress(void);
+
+/* if file is being copied to cache by a streaming fetch, wait until it
+ * has been copied, returns SCR_FAILURE if the copy failed */
+int scr_fetch_stream_wait(const char* file);
+
+/* wait for all files of a streaming fetch to be copied to cache, then mark
+ * them complete in the filemap and apply the redundancy scheme, returns
+ * SCR_FAILURE if any process failed, in which case the caller should
+ * delete the dataset from cache, collective over scr_comm_world */
+int scr_fetch_stream_complete(scr_cache_index* cindex);
+
 #endif
@@ -43,11 +43,14 @@ WRITE:
 #include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
 
 #include "scr.h"
 #include "scr_io.h"
 #include "scr_err.h"
 #include "scr_util.h"
+#include "scr_keys.h"
 #include "scr_filemap.h"
 
 #include "spath.h"
@@ -160,6 +163,30 @@ int scr_filemap_get_meta(const scr_filemap* map, const char* file, scr_meta* met
   return SCR_FAILURE;
 }
 
+/* returns metadata for file without copying it, or NULL if it has none,
+ * the pointer is valid until metadata for the file is set or unset */
+const scr_meta* scr_filemap_peek_meta(const scr_filemap* map, const char* file)
+{
+  kvtree* f = scr_filemap_get_f(map, file);
+  return kvtree_get(f, SCR_FILEMAP_KEY_META);
+}
+
+/* returns metadata for file to be updated in place, adds empty metadata
+ * if the file has none, returns NULL if the file is not in the filemap */
+scr_meta* scr_filemap_edit_meta(scr_filemap* map, const char* file)
+{
+  kvtree* f = scr_filemap_get_f(map, file);
+  if (f == NULL) {
+    return NULL;
+  }
+
+  scr_meta* meta = kvtree_get(f, SCR_FILEMAP_KEY_META);
+  if (meta == NULL) {
+    meta = kvtree_set(f, SCR_FILEMAP_KEY_META, scr_meta_new());
+  }
+  return meta;
+}
+
 /* unsets metadata for file */
 int scr_filemap_unset_meta(scr_filemap* map, const char* file)
 {
@@ -252,6 +279,425 @@ int scr_filemap_merge(scr_filemap* map1, scr_filemap* map2)
   return SCR_SUCCESS;
 }
 
+/*
+=========================================
+Filemap binary format
+=========================================
+*/
+
+/* A filemap file is written in a binary format that can be mapped into
+ * memory and searched without building a kvtree.  All integers are
+ * stored in big-endian byte order.
+ *
+ *   header  magic, version, counts, the offset and size of each section,
+ *           and the crc32 of the tree
+ *   records one fixed-size record per file with its name, original path and
+ *           name, size, crc, mode, mtime, ranks, and complete flag
+ *   buckets hash table of file names, each bucket holds the index of the
+ *           first record in its chain, records link to the next one
+ *   strtab  NUL-terminated strings referenced by the records
+ *   tree    the full filemap as a packed kvtree, so fields that have no
+ *           place in a record are kept and scr_filemap_read loses nothing
+ *
+ * Files without the magic value are read as kvtree files, so filemaps
+ * written by earlier versions can still be read. */
+
+#define SCR_FILEMAP_BIN_MAGIC   ("SCRFMAP")
+#define SCR_FILEMAP_BIN_VERSION (2)
+#define SCR_FILEMAP_BIN_HEADER  (80)
+#define SCR_FILEMAP_BIN_RECORD  (56)
+#define SCR_FILEMAP_BIN_NONE    (0xffffffff)
+
+/* bits set in a record for the fields it holds */
+#define SCR_FILEMAP_BIN_COMPLETE (1)
+#define SCR_FILEMAP_BIN_SIZE     (2)
+#define SCR_FILEMAP_BIN_CRC      (4)
+#define SCR_FILEMAP_BIN_MODE     (8)
+#define SCR_FILEMAP_BIN_MTIME    (16)
+#define SCR_FILEMAP_BIN_RANKS    (32)
+
+struct scr_filemap_view_struct {
+  unsigned char* buf;           /* contents of filemap file */
+  size_t size;                  /* number of bytes in buf */
+  int mapped;                   /* whether buf was mapped with mmap or allocated */
+  uint32_t nfiles;              /* number of file records */
+  uint32_t nbuckets;            /* number of hash buckets, a power of two */
+  uint32_t record_size;         /* bytes per file record */
+  const unsigned char* records; /* start of file records */
+  const unsigned char* buckets; /* start of hash buckets */
+  const char* strtab;           /* start of string table */
+  uint64_t strtab_size;         /* bytes in string table */
+  const char* tree;             /* start of packed kvtree */
+  uint64_t tree_size;           /* bytes in packed kvtree */
+  uint64_t tree_off;            /* offset of packed kvtree in buf */
+  uint32_t tree_crc;            /* crc32 of packed kvtree */
+};
+
+static void scr_filemap_put32(unsigned char* p, uint32_t v)
+{
+  int i;
+  for (i = 3; i >= 0; i--) {
+    p[i] = (unsigned char) (v & 0xff);
+    v >>= 8;
+  }
+}
+
+static void scr_filemap_put64(unsigned char* p, uint64_t v)
+{
+  int i;
+  for (i = 7; i >= 0; i--) {
+    p[i] = (unsigned char) (v & 0xff);
+    v >>= 8;
+  }
+}
+
+static uint32_t scr_filemap_get32(const unsigned char* p)
+{
+  uint32_t v = 0;
+  int i;
+  for (i = 0; i < 4; i++) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+static uint64_t scr_filemap_get64(const unsigned char* p)
+{
+  uint64_t v = 0;
+  int i;
+  for (i = 0; i < 8; i++) {
+    v = (v << 8) | p[i];
+  }
+  return v;
+}
+
+/* FNV-1a hash of a file name */
+static uint32_t scr_filemap_hash(const char* str)
+{
+  uint32_t hash = 2166136261U;
+  while (*str != '\0') {
+    hash ^= (unsigned char) *str;
+    hash *= 16777619U;
+    str++;
+  }
+  return hash;
+}
+
+/* copy str into string table at offset and return its offset,
+ * returns SCR_FILEMAP_BIN_NONE if str is NULL */
+static uint32_t scr_filemap_strtab_add(char* strtab, size_t* offset, const char* str)
+{
+  if (str == NULL) {
+    return SCR_FILEMAP_BIN_NONE;
+  }
+  uint32_t start = (uint32_t) *offset;
+  size_t len = strlen(str) + 1;
+  memcpy(strtab + *offset, str, len);
+  *offset += len;
+  return start;
+}
+
+/* encode filemap in binary format, caller must free buffer */
+static int scr_filemap_encode(const scr_filemap* map, unsigned char** out_buf, size_t* out_size)
+{
+  kvtree* fh = scr_filemap_get_fh(map);
+  uint32_t nfiles = (uint32_t) kvtree_size(fh);
+
+  /* use a power of two buckets, at least one per file */
+  uint32_t nbuckets = 1;
+  while (nbuckets < nfiles) {
+    nbuckets <<= 1;
+  }
+
+  /* size the string table, records usually share their original path
+   * with the record before, so we store it only once in that case */
+  size_t strtab_size = 0;
+  const char* last_path = NULL;
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(fh); elem != NULL; elem = kvtree_elem_next(elem)) {
+    const char* file = kvtree_elem_key(elem);
+    const scr_meta* meta = kvtree_get(kvtree_elem_hash(elem), SCR_FILEMAP_KEY_META);
+    strtab_size += strlen(file) + 1;
+
+    char* origpath = NULL;
+    char* origname = NULL;
+    if (meta != NULL && scr_meta_get_origpath(meta, &origpath) == SCR_SUCCESS) {
+      if (last_path == NULL || strcmp(last_path, origpath) != 0) {
+        strtab_size += strlen(origpath) + 1;
+        last_path = origpath;
+      }
+    }
+    if (meta != NULL && scr_meta_get_origname(meta, &origname) == SCR_SUCCESS) {
+      strtab_size += strlen(origname) + 1;
+    }
+  }
+
+  /* string offsets are stored in 32 bits */
+  if (strtab_size >= SCR_FILEMAP_BIN_NONE) {
+    scr_err("Filemap string table too large (%lu bytes) @ %s:%d",
+      (unsigned long) strtab_size, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* compute offset of each section */
+  size_t tree_size    = kvtree_pack_size(map);
+  size_t records_off  = SCR_FILEMAP_BIN_HEADER;
+  size_t buckets_off  = records_off + (size_t) nfiles * SCR_FILEMAP_BIN_RECORD;
+  size_t strtab_off   = buckets_off + (size_t) nbuckets * 4;
+  size_t tree_off     = strtab_off + strtab_size;
+  size_t size         = tree_off + tree_size;
+
+  unsigned char* buf = (unsigned char*) SCR_MALLOC(size);
+  memset(buf, 0, tree_off);
+
+  /* fill in the header */
+  memcpy(buf, SCR_FILEMAP_BIN_MAGIC, 8);
+  scr_filemap_put32(buf +  8, SCR_FILEMAP_BIN_VERSION);
+  scr_filemap_put32(buf + 12, nfiles);
+  scr_filemap_put32(buf + 16, nbuckets);
+  scr_filemap_put32(buf + 20, SCR_FILEMAP_BIN_RECORD);
+  scr_filemap_put64(buf + 24, records_off);
+  scr_filemap_put64(buf + 32, buckets_off);
+  scr_filemap_put64(buf + 40, strtab_off);
+  scr_filemap_put64(buf + 48, strtab_size);
+  scr_filemap_put64(buf + 56, tree_off);
+  scr_filemap_put64(buf + 64, tree_size);
+
+  /* all buckets start out empty */
+  uint32_t b;
+  for (b = 0; b < nbuckets; b++) {
+    scr_filemap_put32(buf + buckets_off + b * 4, SCR_FILEMAP_BIN_NONE);
+  }
+
+  /* fill in a record for each file */
+  char* strtab = (char*) (buf + strtab_off);
+  size_t stroff = 0;
+  uint32_t last_path_off = SCR_FILEMAP_BIN_NONE;
+  last_path = NULL;
+  uint32_t i = 0;
+  for (elem = kvtree_elem_first(fh); elem != NULL; elem = kvtree_elem_next(elem)) {
+    const char* file = kvtree_elem_key(elem);
+    const scr_meta* meta = kvtree_get(kvtree_elem_hash(elem), SCR_FILEMAP_KEY_META);
+    unsigned char* rec = buf + records_off + (size_t) i * SCR_FILEMAP_BIN_RECORD;
+
+    uint32_t name_off = scr_filemap_strtab_add(strtab, &stroff, file);
+    uint32_t path_off = SCR_FILEMAP_BIN_NONE;
+    uint32_t orig_off = SCR_FILEMAP_BIN_NONE;
+    uint32_t flags = 0;
+    if (meta != NULL) {
+      char* origpath;
+      if (scr_meta_get_origpath(meta, &origpath) == SCR_SUCCESS) {
+        if (last_path == NULL || strcmp(last_path, origpath) != 0) {
+          last_path_off = scr_filemap_strtab_add(strtab, &stroff, origpath);
+          last_path = origpath;
+        }
+        path_off = last_path_off;
+      }
+
+      char* origname;
+      if (scr_meta_get_origname(meta, &origname) == SCR_SUCCESS) {
+        orig_off = scr_filemap_strtab_add(strtab, &stroff, origname);
+      }
+
+      if (scr_meta_is_complete(meta) == SCR_SUCCESS) {
+        flags |= SCR_FILEMAP_BIN_COMPLETE;
+      }
+
+      unsigned long filesize;
+      if (scr_meta_get_filesize(meta, &filesize) == SCR_SUCCESS) {
+        flags |= SCR_FILEMAP_BIN_SIZE;
+        scr_filemap_put64(rec + 16, (uint64_t) filesize);
+      }
+
+      unsigned long mtime_secs, mtime_nsecs;
+      if (kvtree_util_get_unsigned_long(meta, SCR_META_KEY_MTIME_SECS,  &mtime_secs)  == KVTREE_SUCCESS &&
+          kvtree_util_get_unsigned_long(meta, SCR_META_KEY_MTIME_NSECS, &mtime_nsecs) == KVTREE_SUCCESS)
+      {
+        flags |= SCR_FILEMAP_BIN_MTIME;
+        scr_filemap_put64(rec + 24, (uint64_t) mtime_secs);
+        scr_filemap_put32(rec + 32, (uint32_t) mtime_nsecs);
+      }
+
+      uLong crc;
+      if (scr_meta_get_crc32(meta, &crc) == SCR_SUCCESS) {
+        flags |= SCR_FILEMAP_BIN_CRC;
+        scr_filemap_put32(rec + 36, (uint32_t) crc);
+      }
+
+      unsigned long mode;
+      if (kvtree_util_get_unsigned_long(meta, SCR_META_KEY_MODE, &mode) == KVTREE_SUCCESS) {
+        flags |= SCR_FILEMAP_BIN_MODE;
+        scr_filemap_put32(rec + 40, (uint32_t) mode);
+      }
+
+      int ranks;
+      if (scr_meta_get_ranks(meta, &ranks) == SCR_SUCCESS) {
+        flags |= SCR_FILEMAP_BIN_RANKS;
+        scr_filemap_put32(rec + 44, (uint32_t) ranks);
+      }
+    }
+
+    /* link record into its hash chain */
+    uint32_t hash = scr_filemap_hash(file);
+    unsigned char* bucket = buf + buckets_off + (hash & (nbuckets - 1)) * 4;
+
+    scr_filemap_put32(rec +  0, name_off);
+    scr_filemap_put32(rec +  4, path_off);
+    scr_filemap_put32(rec +  8, orig_off);
+    scr_filemap_put32(rec + 12, flags);
+    scr_filemap_put32(rec + 48, scr_filemap_get32(bucket));
+    scr_filemap_put32(rec + 52, hash);
+    scr_filemap_put32(bucket, i);
+
+    i++;
+  }
+
+  /* append the full filemap, and record its crc so that a reader
+   * can check the tree before it unpacks it */
+  kvtree_pack((char*) (buf + tree_off), map);
+  uLong tree_crc = scr_crc32_buf(crc32(0L, Z_NULL, 0), (char*) (buf + tree_off), tree_size);
+  scr_filemap_put32(buf + 72, (uint32_t) tree_crc);
+
+  *out_buf  = buf;
+  *out_size = size;
+  return SCR_SUCCESS;
+}
+
+/* check that buffer holds a binary filemap we understand and fill in
+ * the section pointers of the view */
+static int scr_filemap_view_init(scr_filemap_view* view, const char* file)
+{
+  const unsigned char* buf = view->buf;
+  uint64_t size = (uint64_t) view->size;
+
+  uint32_t version = scr_filemap_get32(buf + 8);
+  if (version != SCR_FILEMAP_BIN_VERSION) {
+    scr_err("Unsupported filemap version %lu in %s @ %s:%d",
+      (unsigned long) version, file, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  uint32_t nfiles      = scr_filemap_get32(buf + 12);
+  uint32_t nbuckets    = scr_filemap_get32(buf + 16);
+  uint32_t record_size = scr_filemap_get32(buf + 20);
+  uint64_t records_off = scr_filemap_get64(buf + 24);
+  uint64_t buckets_off = scr_filemap_get64(buf + 32);
+  uint64_t strtab_off  = scr_filemap_get64(buf + 40);
+  uint64_t strtab_size = scr_filemap_get64(buf + 48);
+  uint64_t tree_off    = scr_filemap_get64(buf + 56);
+  uint64_t tree_size   = scr_filemap_get64(buf + 64);
+  uint32_t tree_crc    = scr_filemap_get32(buf + 72);
+
+  /* check that each section lies within the file, every string
+   * ends before the end of the table, and the bucket count is a
+   * power of two */
+  int valid = (record_size >= SCR_FILEMAP_BIN_RECORD &&
+    nbuckets > 0 && (nbuckets & (nbuckets - 1)) == 0 &&
+    records_off <= size && (uint64_t) nfiles * record_size <= size - records_off &&
+    buckets_off <= size && (uint64_t) nbuckets * 4 <= size - buckets_off &&
+    strtab_off  <= size && strtab_size <= size - strtab_off &&
+    tree_off    <= size && tree_size   <= size - tree_off &&
+    (strtab_size == 0 || buf[strtab_off + strtab_size - 1] == '\0'));
+  if (! valid) {
+    scr_err("Corrupt filemap %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  view->nfiles      = nfiles;
+  view->nbuckets    = nbuckets;
+  view->record_size = record_size;
+  view->records     = buf + records_off;
+  view->buckets     = buf + buckets_off;
+  view->strtab      = (const char*) (buf + strtab_off);
+  view->strtab_size = strtab_size;
+  view->tree        = (const char*) (buf + tree_off);
+  view->tree_size   = tree_size;
+  view->tree_off    = tree_off;
+  view->tree_crc    = tree_crc;
+
+  return SCR_SUCCESS;
+}
+
+/* free the contents of a view */
+static void scr_filemap_view_release(scr_filemap_view* view)
+{
+  if (view->buf != NULL) {
+    if (view->mapped) {
+      munmap(view->buf, view->size);
+    } else {
+      scr_free(&view->buf);
+    }
+  }
+  view->buf = NULL;
+}
+
+/* map file into view, sets is_binary to 0 and returns SCR_SUCCESS
+ * without keeping the mapping if the file is not in binary format */
+static int scr_filemap_view_map(scr_filemap_view* view, const char* file, int* is_binary)
+{
+  *is_binary = 0;
+
+  /* can't read file, return error (special case so as not to print error message below) */
+  if (scr_file_is_readable(file) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening filemap for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) != 0) {
+    scr_err("Failed to stat filemap %s errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(file, fd);
+    return SCR_FAILURE;
+  }
+
+  /* files too small to hold a header are not in binary format */
+  size_t size = (size_t) statbuf.st_size;
+  if (size < SCR_FILEMAP_BIN_HEADER) {
+    scr_close(file, fd);
+    return SCR_SUCCESS;
+  }
+
+  void* buf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  scr_close(file, fd);
+  if (buf == MAP_FAILED) {
+    scr_err("Failed to map filemap %s errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* leave files written as a kvtree to the caller */
+  if (memcmp(buf, SCR_FILEMAP_BIN_MAGIC, 8) != 0) {
+    munmap(buf, size);
+    return SCR_SUCCESS;
+  }
+
+  view->buf    = (unsigned char*) buf;
+  view->size   = size;
+  view->mapped = 1;
+  *is_binary   = 1;
+
+  if (scr_filemap_view_init(view, file) != SCR_SUCCESS) {
+    scr_filemap_view_release(view);
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
 /* reads specified file and fills in filemap structure */
 int scr_filemap_read(const spath* path_file, scr_filemap* map)
 {
@@ -266,13 +712,41 @@ int scr_filemap_read(const spath* path_file, scr_filemap* map)
   /* get file name */
   char* file = spath_strdup(path_file);
 
-  /* can't read file, return error (special case so as not to print error message below) */
-  if (scr_file_is_readable(file) != SCR_SUCCESS) {
+  /* try to read the file in binary format */
+  int is_binary;
+  scr_filemap_view view;
+  memset(&view, 0, sizeof(view));
+  if (scr_filemap_view_map(&view, file, &is_binary) != SCR_SUCCESS) {
     goto cleanup;
   }
 
-  /* ok, now try to read the file */
-  if (kvtree_read_file(file, map) != KVTREE_SUCCESS) {
+  if (is_binary) {
+    /* the full filemap is stored as a packed kvtree, kvtree_unpack trusts
+     * the lengths inside the tree, so before we unpack it, check that the
+     * section lies after the header and within the file as given by its
+     * st_size, and that its bytes are the ones the writer packed */
+    int valid = (view.tree_size > 0 &&
+      view.tree_off >= SCR_FILEMAP_BIN_HEADER &&
+      view.tree_off <= (uint64_t) view.size &&
+      view.tree_size <= (uint64_t) view.size - view.tree_off &&
+      (uint32_t) scr_crc32_buf(crc32(0L, Z_NULL, 0), view.tree, (size_t) view.tree_size) == view.tree_crc);
+
+    /* then check that it fills exactly the section the header gives for it */
+    size_t tree_size = 0;
+    if (valid) {
+      tree_size = kvtree_unpack(view.tree, map);
+    }
+    scr_filemap_view_release(&view);
+    if (tree_size == 0 || (uint64_t) tree_size != view.tree_size) {
+      scr_err("Corrupt filemap tree in %s, expected %llu bytes, read %llu @ %s:%d",
+        file, (unsigned long long) view.tree_size, (unsigned long long) tree_size,
+        __FILE__, __LINE__
+      );
+      scr_filemap_clear(map);
+      goto cleanup;
+    }
+  } else if (kvtree_read_file(file, map) != KVTREE_SUCCESS) {
+    /* files written by earlier versions are kvtree files */
     scr_err("Reading filemap %s @ %s:%d",
       file, __FILE__, __LINE__
     );
@@ -292,22 +766,198 @@ cleanup:
 }
 
 /* writes given filemap to specified file */
-int scr_filemap_write(const spath* file, const scr_filemap* map)
+int scr_filemap_write(const spath* path_file, const scr_filemap* map)
 {
   /* check that we have a map pointer */
   if (map == NULL) {
     return SCR_FAILURE;
   }
 
-  /* write out the hash */
-  if (kvtree_write_path(file, map) != KVTREE_SUCCESS) {
-    char path_err[SCR_MAX_FILENAME];
-    spath_strcpy(path_err, sizeof(path_err), file);
+  /* encode the filemap */
+  unsigned char* buf;
+  size_t size;
+  if (scr_filemap_encode(map, &buf, &size) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* write to a temporary file and rename it into place,
+   * so that readers never see a partial filemap */
+  int rc = SCR_SUCCESS;
+  char* file = spath_strdup(path_file);
+  char tmpfile[SCR_MAX_FILENAME];
+  if (scr_file_tmpname(file, tmpfile, sizeof(tmpfile)) != SCR_SUCCESS) {
+    scr_free(&file);
+    scr_free(&buf);
+    return SCR_FAILURE;
+  }
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd < 0) {
+    scr_err("Opening filemap for write: scr_open(%s) errno=%d %s @ %s:%d",
+      tmpfile, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  } else {
+    if (scr_write(tmpfile, fd, buf, size) != (ssize_t) size) {
+      rc = SCR_FAILURE;
+    }
+    /* the filemap lives in cache, so skip the fsync in scr_close */
+    if (close(fd) != 0) {
+      scr_err("Closing filemap %s: errno=%d %s @ %s:%d",
+        tmpfile, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  /* move the temporary file in place of the original */
+  if (rc == SCR_SUCCESS) {
+    rc = scr_file_replace(tmpfile, file);
+  }
+
+  if (rc != SCR_SUCCESS) {
     scr_err("Writing filemap %s @ %s:%d",
-      path_err, __FILE__, __LINE__
+      file, __FILE__, __LINE__
     );
+    scr_file_unlink(tmpfile);
+  }
+
+  scr_free(&file);
+  scr_free(&buf);
+
+  return rc;
+}
+
+/*
+=========================================
+Filemap view functions
+=========================================
+*/
+
+/* open a read-only view of the filemap in the given file */
+scr_filemap_view* scr_filemap_view_open(const spath* path_file)
+{
+  char* file = spath_strdup(path_file);
+
+  scr_filemap_view* view = (scr_filemap_view*) SCR_MALLOC(sizeof(scr_filemap_view));
+  memset(view, 0, sizeof(scr_filemap_view));
+
+  /* map the file if it is in binary format */
+  int is_binary;
+  if (scr_filemap_view_map(view, file, &is_binary) != SCR_SUCCESS) {
+    scr_free(&view);
+    scr_free(&file);
+    return NULL;
+  }
+
+  /* otherwise read it as a kvtree and encode it in memory */
+  if (! is_binary) {
+    scr_filemap* map = scr_filemap_new();
+    int rc = SCR_FAILURE;
+    if (kvtree_read_file(file, map) == KVTREE_SUCCESS &&
+        scr_filemap_encode(map, &view->buf, &view->size) == SCR_SUCCESS)
+    {
+      view->mapped = 0;
+      rc = scr_filemap_view_init(view, file);
+    } else {
+      scr_err("Reading filemap %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+    }
+    scr_filemap_delete(&map);
+
+    if (rc != SCR_SUCCESS) {
+      scr_filemap_view_release(view);
+      scr_free(&view);
+    }
+  }
+
+  scr_free(&file);
+  return view;
+}
+
+/* close a filemap view, records and strings taken from it are no longer valid */
+int scr_filemap_view_close(scr_filemap_view** ptr_view)
+{
+  if (ptr_view != NULL && *ptr_view != NULL) {
+    scr_filemap_view_release(*ptr_view);
+    scr_free(ptr_view);
+  }
+  return SCR_SUCCESS;
+}
+
+/* return the number of files in the view */
+int scr_filemap_view_num_files(const scr_filemap_view* view)
+{
+  return (int) view->nfiles;
+}
+
+/* return string at given offset in string table, or NULL if not set */
+static const char* scr_filemap_view_str(const scr_filemap_view* view, uint32_t offset)
+{
+  if (offset == SCR_FILEMAP_BIN_NONE || (uint64_t) offset >= view->strtab_size) {
+    return NULL;
+  }
+  return view->strtab + offset;
+}
+
+/* fill in record for the file at the given index, returns SCR_FAILURE
+ * if the index is out of range */
+int scr_filemap_view_get(const scr_filemap_view* view, int index, scr_filemap_record* rec)
+{
+  if (index < 0 || (uint32_t) index >= view->nfiles) {
     return SCR_FAILURE;
   }
 
+  const unsigned char* r = view->records + (size_t) index * view->record_size;
+  uint32_t flags = scr_filemap_get32(r + 12);
+
+  rec->file     = scr_filemap_view_str(view, scr_filemap_get32(r + 0));
+  rec->origpath = scr_filemap_view_str(view, scr_filemap_get32(r + 4));
+  rec->origname = scr_filemap_view_str(view, scr_filemap_get32(r + 8));
+  rec->complete = (flags & SCR_FILEMAP_BIN_COMPLETE) ? 1 : 0;
+
+  rec->have_filesize = (flags & SCR_FILEMAP_BIN_SIZE) ? 1 : 0;
+  rec->filesize      = (unsigned long) scr_filemap_get64(r + 16);
+
+  rec->have_mtime  = (flags & SCR_FILEMAP_BIN_MTIME) ? 1 : 0;
+  rec->mtime_secs  = scr_filemap_get64(r + 24);
+  rec->mtime_nsecs = scr_filemap_get32(r + 32);
+
+  rec->have_crc32 = (flags & SCR_FILEMAP_BIN_CRC) ? 1 : 0;
+  rec->crc32      = (uLong) scr_filemap_get32(r + 36);
+
+  rec->have_mode = (flags & SCR_FILEMAP_BIN_MODE) ? 1 : 0;
+  rec->mode      = (mode_t) scr_filemap_get32(r + 40);
+
+  rec->ranks = (flags & SCR_FILEMAP_BIN_RANKS) ? (int) scr_filemap_get32(r + 44) : -1;
+
+  if (rec->file == NULL) {
+    return SCR_FAILURE;
+  }
   return SCR_SUCCESS;
 }
+
+/* return index of the named file in the view, or -1 if it is not listed */
+int scr_filemap_view_find(const scr_filemap_view* view, const char* file)
+{
+  uint32_t hash = scr_filemap_hash(file);
+  uint32_t index = scr_filemap_get32(view->buckets + (hash & (view->nbuckets - 1)) * 4);
+
+  /* walk the chain, stopping after nfiles steps in case the file is corrupt */
+  uint32_t steps = 0;
+  while (index != SCR_FILEMAP_BIN_NONE && index < view->nfiles && steps <= view->nfiles) {
+    const unsigned char* r = view->records + (size_t) index * view->record_size;
+    if (scr_filemap_get32(r + 52) == hash) {
+      const char* name = scr_filemap_view_str(view, scr_filemap_get32(r + 0));
+      if (name != NULL && strcmp(name, file) == 0) {
+        return (int) index;
+      }
+    }
+    index = scr_filemap_get32(r + 48);
+    steps++;
+  }
+
+  return -1;
+}
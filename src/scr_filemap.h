@@ -33,6 +33,8 @@
 #ifndef SCR_FILEMAP_H
 #define SCR_FILEMAP_H
 
+#include <stdint.h>
+
 #include "scr.h"
 #include "scr_meta.h"
 #include "scr_dataset.h"
@@ -70,6 +72,14 @@ int scr_filemap_set_meta(scr_filemap* map, const char* file, const scr_meta* met
 /* gets metadata for file */
 int scr_filemap_get_meta(const scr_filemap* map, const char* file, scr_meta* meta);
 
+/* returns metadata for file without copying it, or NULL if it has none,
+ * the pointer is valid until metadata for the file is set or unset */
+const scr_meta* scr_filemap_peek_meta(const scr_filemap* map, const char* file);
+
+/* returns metadata for file to be updated in place, adds empty metadata
+ * if the file has none, returns NULL if the file is not in the filemap */
+scr_meta* scr_filemap_edit_meta(scr_filemap* map, const char* file);
+
 /* unsets metadata for file */
 int scr_filemap_unset_meta(scr_filemap* map, const char* file);
 
@@ -131,4 +141,52 @@ scr_filemap* scr_filemap_new(void);
 /* free memory resources assocaited with filemap */
 int scr_filemap_delete(scr_filemap** ptr_map);
 
+/*
+=========================================
+Filemap view functions
+=========================================
+*/
+
+/* read-only view of a filemap file for looking up files without
+ * building a kvtree, filemaps in binary format are mapped into memory,
+ * filemaps written as a kvtree by earlier versions are converted on open,
+ * a view may be read from several threads at once */
+typedef struct scr_filemap_view_struct scr_filemap_view;
+
+/* fields recorded for a file in a filemap view, strings point into
+ * the view and are NULL if not set, have_* fields are 0 if the
+ * matching value is not set */
+typedef struct {
+  const char* file;      /* name of file in cache */
+  const char* origpath;  /* original directory of file */
+  const char* origname;  /* original name of file */
+  int complete;          /* 1 if file is marked complete */
+  int ranks;             /* number of ranks that wrote the dataset, -1 if not set */
+  int have_filesize;
+  unsigned long filesize;
+  int have_crc32;
+  uLong crc32;
+  int have_mode;
+  mode_t mode;
+  int have_mtime;
+  uint64_t mtime_secs;
+  uint64_t mtime_nsecs;
+} scr_filemap_record;
+
+/* open a read-only view of the filemap in the given file, returns NULL on failure */
+scr_filemap_view* scr_filemap_view_open(const spath* file);
+
+/* close a filemap view, records and strings taken from it are no longer valid */
+int scr_filemap_view_close(scr_filemap_view** ptr_view);
+
+/* return the number of files in the view */
+int scr_filemap_view_num_files(const scr_filemap_view* view);
+
+/* fill in record for the file at the given index, returns SCR_FAILURE
+ * if the index is out of range */
+int scr_filemap_view_get(const scr_filemap_view* view, int index, scr_filemap_record* rec);
+
+/* return index of the named file in the view, or -1 if it is not listed */
+int scr_filemap_view_find(const scr_filemap_view* view, const char* file);
+
 #endif
@@ -17,6 +17,8 @@
 #include "dtcmp.h"
 #include "scr_flush_nompi.h"
 
+#include <limits.h>
+
 /*
 =========================================
 Prepare for flush by building list of files, creating directories,
@@ -123,86 +125,277 @@ int scr_flush_list_free(
   return SCR_SUCCESS;
 }
 
-/* create directories from basepath down to each file as needed */
+/* given file list from flush_prepare and the source and destination
+ * paths of one of its files, add an entry for the file to the rank2file
+ * list, recording its path relative to the prefix directory, and for
+ * changed blocks of an incremental checkpoint, the path of its base file
+ * and the id of the dataset that holds it, returns the entry added for the file */
+kvtree* scr_flush_rank2file_add(
+  kvtree* filelist,
+  const kvtree* file_list,
+  const char* src_file,
+  const char* dst_file)
+{
+  /* compute path relative to prefix directory */
+  spath* base = spath_from_str(scr_prefix);
+  spath* dest = spath_from_str(dst_file);
+  spath* rel = spath_relative(base, dest);
+  char* relfile = spath_strdup(rel);
+
+  kvtree* file_hash = kvtree_set_kv(filelist, SCR_KEY_FILE, relfile);
+
+  scr_free(&relfile);
+  spath_delete(&rel);
+  spath_delete(&dest);
+
+  /* record the base file the changed blocks apply to, along with
+   * the id of its dataset, the base file may have been written to the
+   * prefix directory compressed or in a container, so a fetch looks it
+   * up in the rank2file map of that dataset */
+  kvtree* hash = kvtree_get_kv(file_list, SCR_KEY_FILE, src_file);
+  scr_meta* meta = kvtree_get(hash, SCR_KEY_META);
+  int base_id;
+  char* base_orig;
+  if (meta != NULL &&
+      scr_meta_get_delta(meta, NULL, &base_id, NULL, &base_orig) == SCR_SUCCESS)
+  {
+    spath* base_path = spath_from_str(base_orig);
+    spath* base_rel = spath_relative(base, base_path);
+    char* base_relfile = spath_strdup(base_rel);
+
+    kvtree* base_hash = kvtree_set_kv(file_hash, SCR_KEY_BASE, base_relfile);
+    kvtree_util_set_int(base_hash, SCR_KEY_ID, base_id);
+
+    scr_free(&base_relfile);
+    spath_delete(&base_rel);
+    spath_delete(&base_path);
+  }
+
+  /* record the codec the file was compressed with */
+  char* codec;
+  if (meta != NULL &&
+      scr_meta_get_compress(meta, &codec, NULL) == SCR_SUCCESS)
+  {
+    kvtree_util_set_str(file_hash, SCR_KEY_COMPRESS, codec);
+  }
+
+  spath_delete(&base);
+
+  return file_hash;
+}
+
+/* directories this process knows to exist because the last flush
+ * needed them, so that the next flush can skip them, this only holds
+ * the directories of the last flush so that it does not grow with
+ * the number of datasets written during the job */
+static kvtree* scr_flush_dirs_created = NULL;
+
+/* forget directories created by earlier flushes, to be called
+ * whenever directories may have been deleted from the prefix directory */
+void scr_flush_create_dirs_reset()
+{
+  kvtree_delete(&scr_flush_dirs_created);
+}
+
+/* create directories from basepath down to each file as needed,
+ * each directory is created by a single process, parent directories
+ * are created before their children, and at most scr_flush_width
+ * processes create directories at the same time, the directories of
+ * this flush replace those remembered from the last one */
 int scr_flush_create_dirs(
   const char* basepath,       /* top-level directory, assumed to exist */
   int count,                  /* number of files */
   const char** dest_filelist, /* list of files */
   MPI_Comm comm)              /* communicator of participating processes */
 {
-  /* TODO: need to list dirs in order from parent to child */
+  spath* base_path = spath_from_str(basepath);
+  spath_reduce(base_path);
+  int base_components = spath_components(base_path);
 
-  /* allocate buffers to hold the directory needed for each file */
-  int* leader           = (int*)         SCR_MALLOC(sizeof(int)         * count);
-  const char** dirs     = (const char**) SCR_MALLOC(sizeof(const char*) * count);
-  uint64_t* group_id    = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * count);
-  uint64_t* group_ranks = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * count);
-  uint64_t* group_rank  = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * count);
-
-  /* lookup directory from meta data for each file */
+  /* list the directories between basepath and each file along with
+   * their depth, we only need to create those we don't know to exist,
+   * and the parents of a directory we know to exist must also exist */
   int i;
+  kvtree* current = kvtree_new();
+  kvtree* needed  = kvtree_new();
   for (i = 0; i < count; i++) {
     /* extract directory from filename */
-    const char* filename = dest_filelist[i];
-    spath* path = spath_from_str(filename);
+    spath* path = spath_from_str(dest_filelist[i]);
+    spath_reduce(path);
     spath_dirname(path);
-    dirs[i] = spath_strdup(path);
+
+    /* a directory outside of basepath is created recursively on its own */
+    int components = spath_components(path);
+    int stop = spath_is_child(base_path, path) ? base_components : components - 1;
+    int known = 0;
+    while (components > stop) {
+      /* we have already listed this directory and its parents */
+      char* dir = spath_strdup(path);
+      if (kvtree_get(current, dir) != NULL) {
+        scr_free(&dir);
+        break;
+      }
+      kvtree_set(current, dir, kvtree_new());
+
+      if (! known) {
+        known = (scr_flush_dirs_created != NULL &&
+          kvtree_get(scr_flush_dirs_created, dir) != NULL);
+      }
+      if (! known) {
+        kvtree_util_set_int(needed, dir, components);
+      }
+      scr_free(&dir);
+
+      /* chop off another component and try again */
+      spath_dirname(path);
+      components--;
+    }
+
     spath_delete(&path);
+  }
+  spath_delete(&base_path);
+
+  /* copy directories into arrays for DTCMP */
+  int num_dirs = kvtree_size(needed);
+  const char** dirs = (const char**) SCR_MALLOC(num_dirs * sizeof(const char*));
+  int* depths       = (int*)         SCR_MALLOC(num_dirs * sizeof(int));
+  int min_depth = INT_MAX;
+  int max_depth = -1;
+  kvtree_elem* elem;
+  i = 0;
+  for (elem = kvtree_elem_first(needed);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    dirs[i] = kvtree_elem_key(elem);
+    kvtree_util_get_int(needed, dirs[i], &depths[i]);
+    if (depths[i] < min_depth) {
+      min_depth = depths[i];
+    }
+    if (depths[i] > max_depth) {
+      max_depth = depths[i];
+    }
+    i++;
+  }
 
-    /* we'll use DTCMP to select one leader for each directory later */
-    leader[i] = 0;
+  /* get the range of depths across all procs in a single reduction,
+   * nothing to do if every directory already exists */
+  int range[2], range_global[2];
+  range[0] = -min_depth;
+  range[1] = max_depth;
+  MPI_Allreduce(range, range_global, 2, MPI_INT, MPI_MAX, comm);
+  int min_global = -range_global[0];
+  int max_global = range_global[1];
+  if (max_global < 0) {
+    /* remember the directories of this flush for the next one */
+    kvtree_delete(&scr_flush_dirs_created);
+    scr_flush_dirs_created = current;
+    scr_free(&depths);
+    scr_free(&dirs);
+    kvtree_delete(&needed);
+    return SCR_SUCCESS;
   }
 
   /* with DTCMP we identify a single process to create each directory */
-
-  /* identify the set of unique directories */
   uint64_t groups;
+  uint64_t* group_id    = (uint64_t*) SCR_MALLOC(sizeof(uint64_t) * num_dirs);
+  uint64_t* group_ranks = (uint64_t*) SCR_MALLOC(sizeof(uint64_t) * num_dirs);
+  uint64_t* group_rank  = (uint64_t*) SCR_MALLOC(sizeof(uint64_t) * num_dirs);
   DTCMP_Rankv_strings(
-    count, dirs, &groups, group_id, group_ranks, group_rank,
+    num_dirs, dirs, &groups, group_id, group_ranks, group_rank,
     DTCMP_FLAG_NONE, comm
   );
 
-  /* select leader for each directory */
-  for (i = 0; i < count; i++) {
+  /* get file mode for directory permissions */
+  mode_t mode_dir = scr_getmode(1, 1, 1);
+
+  /* determine whether we lead any directory at each level */
+  int levels = max_global - min_global + 1;
+  int* have_dirs = (int*) SCR_MALLOC(levels * sizeof(int));
+  int* indices   = (int*) SCR_MALLOC(levels * sizeof(int));
+  int* totals    = (int*) SCR_MALLOC(levels * sizeof(int));
+  int level;
+  for (level = 0; level < levels; level++) {
+    have_dirs[level] = 0;
+    indices[level]   = 0;
+  }
+  for (i = 0; i < num_dirs; i++) {
     if (group_rank[i] == 0) {
-      leader[i] = 1;
+      have_dirs[depths[i] - min_global] = 1;
     }
   }
 
-  /* get file mode for directory permissions */
-  mode_t mode_dir = scr_getmode(1, 1, 1);
-
-  /* TODO: add flow control here */
+  /* number the processes that have directories to create at each level,
+   * and count how many there are, for all levels at once */
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Exscan(have_dirs, indices, levels, MPI_INT, MPI_SUM, comm);
+  if (rank == 0) {
+    /* the values from exscan are undefined on rank 0 */
+    for (level = 0; level < levels; level++) {
+      indices[level] = 0;
+    }
+  }
+  MPI_Allreduce(have_dirs, totals, levels, MPI_INT, MPI_SUM, comm);
 
-  /* create other directories in file list */
+  /* create directories from top level to bottom */
   int success = 1;
-  for (i = 0; i < count; i++) {
-    /* get directory name */
-    const char* dir = dirs[i];
+  for (level = 0; level < levels; level++) {
+    int depth = min_global + level;
+    int index = indices[level];
+    int total = totals[level];
+    if (total == 0) {
+      continue;
+    }
 
-    /* if we're the leader, create directory */
-    if (leader[i]) {
-      if (scr_mkdir(dir, mode_dir) != SCR_SUCCESS) {
-        success = 0;
+    /* create directories in windows of at most scr_flush_width processes,
+     * execute a barrier after each window so that no more than that
+     * many processes are active, and so that the whole level exists
+     * before we move a level down */
+    int width = (scr_flush_width > 0) ? scr_flush_width : total;
+    int windows = (total + width - 1) / width;
+    int window;
+    for (window = 0; window < windows; window++) {
+      if (have_dirs[level] && index / width == window) {
+        for (i = 0; i < num_dirs; i++) {
+          if (depths[i] == depth && group_rank[i] == 0) {
+            if (scr_mkdir(dirs[i], mode_dir) != SCR_SUCCESS) {
+              success = 0;
+            }
+          }
+        }
       }
+      MPI_Barrier(comm);
     }
+  }
+
+  /* determine whether all leaders successfully created their directories */
+  int rc = SCR_SUCCESS;
+  if (! scr_alltrue(success == 1, comm)) {
+    rc = SCR_FAILURE;
+  }
 
-    /* free the dirname we strdup'd */
-    scr_free(&dir);
+  /* remember the directories of this flush so the next one can skip them,
+   * if we failed, we can't be sure which of them exist */
+  kvtree_delete(&scr_flush_dirs_created);
+  if (rc == SCR_SUCCESS) {
+    scr_flush_dirs_created = current;
+  } else {
+    kvtree_delete(&current);
   }
 
   /* free buffers */
+  scr_free(&have_dirs);
+  scr_free(&indices);
+  scr_free(&totals);
   scr_free(&group_id);
   scr_free(&group_ranks);
   scr_free(&group_rank);
+  scr_free(&depths);
   scr_free(&dirs);
-  scr_free(&leader);
+  kvtree_delete(&needed);
 
-  /* determine whether all leaders successfully created their directories */
-  if (! scr_alltrue(success == 1, comm)) {
-    return SCR_FAILURE;
-  }
-  return SCR_SUCCESS;
+  return rc;
 }
 
 /* given a dataset, return a newly allocated string specifying the
@@ -260,6 +453,29 @@ int scr_flush_prepare(const scr_cache_index* cindex, int id, kvtree* file_list)
   scr_filemap* map = scr_filemap_new();
   scr_cache_get_map(cindex, id, map);
 
+  /* an incremental checkpoint file can only be flushed as its changed
+   * blocks if its base dataset is already on the parallel file system,
+   * record the ids of those bases in the file list, all processes
+   * get the same list, so that the index can note which datasets
+   * must be kept to fetch this one */
+  scr_delta_flushed_bases(map, file_list);
+
+  /* files of a bypass dataset are already in the prefix directory,
+   * so we only compress files we copy out of cache, files are compressed
+   * as they are written, so we can't hand them to AXL for a poststage
+   * transfer */
+  int bypass = 0;
+  scr_cache_index_get_bypass(cindex, id, &bypass);
+  int compress = (scr_flush_compress != SCR_COMPRESS_NONE &&
+    ! bypass && ! scr_flush_poststage
+  );
+
+  /* record the codec for the whole list, so that every process
+   * agrees on how to transfer its files */
+  if (compress) {
+    kvtree_util_set_str(file_list, SCR_KEY_COMPRESS, scr_compress_name(scr_flush_compress));
+  }
+
   /* identify which files we need to flush as part of the specified
    * dataset id */
   kvtree_elem* elem = NULL;
@@ -273,6 +489,41 @@ int scr_flush_prepare(const scr_cache_index* cindex, int id, kvtree* file_list)
     /* read meta data for file and attach it to file list */
     scr_meta* meta = scr_meta_new();
     if (scr_filemap_get_meta(map, file, meta) == SCR_SUCCESS) {
+      /* flush the changed blocks in place of the full file if we can,
+       * they are written next to the file with a suffix on its name */
+      char* delta_file;
+      int base_id;
+      if (scr_meta_get_delta(meta, &delta_file, &base_id, NULL, NULL) == SCR_SUCCESS) {
+        char* origname;
+        if (kvtree_get_kv_int(file_list, SCR_KEY_BASE, base_id) != NULL &&
+            scr_meta_get_origname(meta, &origname) == SCR_SUCCESS)
+        {
+          char delta_name[SCR_MAX_FILENAME];
+          snprintf(delta_name, sizeof(delta_name), "%s%s", origname, SCR_DELTA_SUFFIX);
+          scr_meta_set_origname(meta, delta_name);
+          scr_meta_set_filesize(meta, scr_file_size(delta_file));
+          file = delta_file;
+        } else {
+          scr_meta_unset_delta(meta);
+        }
+      }
+
+      /* the file is compressed as it is written to the prefix directory,
+       * record the codec and the size of the file before compression,
+       * and add the codec suffix to the name of the file we write */
+      char* origname;
+      if (compress && scr_meta_get_origname(meta, &origname) == SCR_SUCCESS) {
+        unsigned long size = 0;
+        scr_meta_get_filesize(meta, &size);
+        scr_meta_set_compress(meta, scr_compress_name(scr_flush_compress), size);
+
+        char compress_name[SCR_MAX_FILENAME];
+        snprintf(compress_name, sizeof(compress_name), "%s%s",
+          origname, scr_compress_suffix(scr_flush_compress)
+        );
+        scr_meta_set_origname(meta, compress_name);
+      }
+
       /* if we need to flush this file, add it to the list and attach
        * its meta data */
       kvtree* file_hash = kvtree_set_kv(file_list, SCR_KEY_FILE, file);
@@ -304,6 +555,51 @@ int scr_flush_prepare(const scr_cache_index* cindex, int id, kvtree* file_list)
   return rc;
 }
 
+/* returns 1 if the files of dataset are written to container files when
+ * flushed, only checkpoints that are not also output are aggregated,
+ * since output is meant to be read directly from the prefix directory */
+int scr_flush_dataset_aggregate(const scr_dataset* dataset)
+{
+  return (scr_flush_aggregate &&
+    scr_dataset_is_ckpt(dataset) && ! scr_dataset_is_output(dataset)
+  );
+}
+
+/* given file list from flush_prepare, return the codec its files are
+ * compressed with as they are written, or SCR_COMPRESS_NONE,
+ * this is the same on all processes */
+int scr_flush_list_codec(const kvtree* file_list)
+{
+  int codec = SCR_COMPRESS_NONE;
+  char* name;
+  if (kvtree_util_get_str(file_list, SCR_KEY_COMPRESS, &name) == KVTREE_SUCCESS) {
+    scr_compress_codec(name, &codec);
+  }
+  return codec;
+}
+
+/* compress each file in src_filelist from cache into the file at the
+ * same index in dst_filelist in the prefix directory */
+int scr_flush_compress_files(
+  int num_files,
+  const char** src_filelist,
+  const char** dst_filelist,
+  int codec)
+{
+  int rc = SCR_SUCCESS;
+
+  int i;
+  for (i = 0; i < num_files; i++) {
+    if (scr_compress_file(src_filelist[i], dst_filelist[i], codec,
+        scr_flush_compress_level, scr_file_buf_size) != SCR_SUCCESS)
+    {
+      rc = SCR_FAILURE;
+    }
+  }
+
+  return rc;
+}
+
 /* write summary file for flush */
 static int scr_flush_summary(
   const scr_dataset* dataset,
@@ -430,15 +726,35 @@ int scr_flush_complete(const scr_cache_index* cindex, int id, kvtree* file_list)
       /* record flushed tag */
       scr_index_mark_flushed(index_hash, id, name);
 
+      /* record the datasets holding base files of our deltas,
+       * so they are not deleted while we need them */
+      kvtree* bases = kvtree_get(file_list, SCR_KEY_BASE);
+      kvtree_elem* elem;
+      for (elem = kvtree_elem_first(bases);
+           elem != NULL;
+           elem = kvtree_elem_next(elem))
+      {
+        int base_id = kvtree_elem_key_int(elem);
+        scr_index_set_base(index_hash, id, name, base_id);
+      }
+
       /* remove any failed marker, since we may have flushed over
        * a previously failed dataset */
       scr_index_clear_failed(index_hash, id, name);
 
       /* if this is a checkpoint, update current to point to new dataset,
        * this must come after index_set_dataset above because set_current
-       * checks that named dataset is a checkpoint */
+       * checks that named dataset is a checkpoint, async flushes may
+       * complete out of order, so only move current to a newer checkpoint */
       if (scr_dataset_is_ckpt(dataset)) {
-        scr_index_set_current(index_hash, name);
+        int current_id = -1;
+        char* current;
+        if (scr_index_get_current(index_hash, &current) == SCR_SUCCESS) {
+          scr_index_get_id_by_name(index_hash, current, &current_id);
+        }
+        if (id > current_id) {
+          scr_index_set_current(index_hash, name);
+        }
       }
 
       /* write the index file and delete the hash */
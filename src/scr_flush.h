@@ -32,7 +32,24 @@ int scr_flush_list_free(
   char*** ptr_dst_filelist
 );
 
-/* create directories from basepath down to each file as needed */
+/* given file list from flush_prepare and the source and destination
+ * paths of one of its files, add an entry for the file to the rank2file list,
+ * returns the entry added for the file */
+kvtree* scr_flush_rank2file_add(
+  kvtree* filelist,
+  const kvtree* file_list,
+  const char* src_file,
+  const char* dst_file
+);
+
+/* forget directories created by earlier flushes, to be called
+ * whenever directories may have been deleted from the prefix directory */
+void scr_flush_create_dirs_reset();
+
+/* create directories from basepath down to each file as needed,
+ * each directory is created by a single process, parent directories
+ * are created before their children, and at most scr_flush_width
+ * processes create directories at the same time */
 int scr_flush_create_dirs(
   const char* basepath,       /* top-level directory, assumed to exist */
   int count,                  /* number of files */
@@ -52,6 +69,24 @@ int scr_flush_init_index(scr_dataset* dataset);
 /* given a cache index and a dataset id, prepare and return a list of files to be flushed */
 int scr_flush_prepare(const scr_cache_index* cindex, int id, kvtree* file_list);
 
+/* returns 1 if the files of dataset are written to container files when
+ * flushed, only checkpoints that are not also output are aggregated */
+int scr_flush_dataset_aggregate(const scr_dataset* dataset);
+
+/* given file list from flush_prepare, return the codec its files are
+ * compressed with as they are written, or SCR_COMPRESS_NONE,
+ * this is the same on all processes */
+int scr_flush_list_codec(const kvtree* file_list);
+
+/* compress each file in src_filelist from cache into the file at the
+ * same index in dst_filelist in the prefix directory */
+int scr_flush_compress_files(
+  int num_files,
+  const char** src_filelist,
+  const char** dst_filelist,
+  int codec
+);
+
 /* given a dataset id that has been flushed and the list provided by scr_flush_prepare,
  * complete the flush by writing the summary file */
 int scr_flush_complete(const scr_cache_index* cindex, int id, kvtree* file_list);
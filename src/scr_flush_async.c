@@ -16,16 +16,48 @@
 #include "kvtree_util.h"
 #include "axl_mpi.h"
 
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #define ASYNC_KEY_OUT_DSET   "DSET"   /* list items by dataset id */
 #define ASYNC_KEY_OUT_STATUS "STATUS" /* tracks whether flush has failed in any stage */
 #define ASYNC_KEY_OUT_FILES  "FILES"  /* list of files to be transferred */
 #define ASYNC_KEY_OUT_AXL    "AXL"    /* tracks AXL id for outstanding transfer */
 #define ASYNC_KEY_OUT_TIME   "TIME"   /* start time of transfer from time */
 #define ASYNC_KEY_OUT_WTIME  "WTIME"  /* start time of transfer from Wtime */
+#define ASYNC_KEY_OUT_THREAD "THREAD" /* whether SCR writes files with its own thread rather than AXL */
 
 /* tracks info for all outstanding transfers */
 static kvtree* scr_flush_async_list = NULL;
 
+/* bandwidth limit for this node (bytes/sec), SCR_FLUSH_ASYNC_BW is split
+ * evenly across nodes, and then across the processes on each node that write */
+static double scr_flush_async_node_bw = 0.0;
+
+/* when files are compressed as they are flushed, or when the flush is
+ * throttled and SCR can copy the files itself, a thread on each process
+ * writes its files in place of an AXL transfer */
+typedef struct scr_flush_async_copy_struct {
+  int id;                 /* dataset id */
+  int num_files;          /* number of files to write */
+  char** src_files;       /* path to each file in cache */
+  char** dst_files;       /* path to each file in prefix directory */
+  int codec;              /* codec to compress files with, or SCR_COMPRESS_NONE */
+  double bw;              /* bytes per second this process may write, 0 for no limit */
+  double percent;         /* percent of time this process may spend writing, 0 for no limit */
+  int done;               /* set once all files have been written */
+  int rc;                 /* SCR_SUCCESS if all files were written */
+  scr_workers* thread;    /* thread writing the files, NULL once joined */
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex;  /* protects done and rc */
+#endif
+  struct scr_flush_async_copy_struct* next;
+} scr_flush_async_copy_t;
+
+/* list of datasets whose files are being written by SCR */
+static scr_flush_async_copy_t* scr_flush_async_copy_list = NULL;
+
 /*
 =========================================
 Asynchronous flush functions
@@ -139,6 +171,9 @@ static int scr_axl_wait(int dset_id, MPI_Comm comm)
       );
       rc = SCR_FAILURE;
     }
+
+    /* forget the id, since the handle is no longer valid */
+    kvtree_unset(dset_hash, ASYNC_KEY_OUT_AXL);
   } else {
     /* failed to lookup id */
     rc = SCR_FAILURE;
@@ -147,6 +182,337 @@ static int scr_axl_wait(int dset_id, MPI_Comm comm)
   return rc;
 }
 
+/* given the time the copy started, the secs spent writing, and the bytes
+ * written so far, sleep long enough to keep this process within its
+ * bandwidth limit and within the percent of time it may spend writing */
+static void scr_flush_async_copy_pace(
+  const scr_flush_async_copy_t* c,
+  double time_start,
+  double busy,
+  double bytes)
+{
+  double elapsed = scr_seconds() - time_start;
+
+  double wait = 0.0;
+  if (c->bw > 0.0) {
+    double t = bytes / c->bw - elapsed;
+    if (t > wait) {
+      wait = t;
+    }
+  }
+  if (c->percent > 0.0 && c->percent < 100.0) {
+    double t = busy * 100.0 / c->percent - elapsed;
+    if (t > wait) {
+      wait = t;
+    }
+  }
+
+  if (wait > 0.0) {
+    usleep((useconds_t) (wait * 1000000.0));
+  }
+}
+
+/* copy src_file to dst_file in chunks of scr_file_buf_size bytes,
+ * pacing after each chunk */
+static int scr_flush_async_copy_file(
+  const scr_flush_async_copy_t* c,
+  const char* src_file,
+  const char* dst_file,
+  double time_start,
+  double* busy,
+  double* bytes)
+{
+  int src_fd = scr_open(src_file, O_RDONLY);
+  if (src_fd < 0) {
+    scr_err("Opening file for read: scr_open(%s) errno=%d %s @ %s:%d",
+      src_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (dst_fd < 0) {
+    scr_err("Opening file for write: scr_open(%s) errno=%d %s @ %s:%d",
+      dst_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src_file, src_fd);
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) SCR_MALLOC(scr_file_buf_size);
+  while (rc == SCR_SUCCESS) {
+    double chunk_start = scr_seconds();
+    ssize_t nread = scr_read(src_file, src_fd, buf, scr_file_buf_size);
+    if (nread < 0) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    if (nread == 0) {
+      break;
+    }
+    if (scr_write(dst_file, dst_fd, buf, (size_t) nread) != nread) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    *busy  += scr_seconds() - chunk_start;
+    *bytes += (double) nread;
+
+    scr_flush_async_copy_pace(c, time_start, *busy, *bytes);
+  }
+  scr_free(&buf);
+
+  if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(src_file, src_fd);
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to copy %s to %s @ %s:%d",
+      src_file, dst_file, __FILE__, __LINE__
+    );
+  }
+
+  return rc;
+}
+
+/* write the files of this process from cache into the prefix directory,
+ * we pace plain copies after each chunk, and compressed files after
+ * each file, since those are written by the compression stage */
+static void* scr_flush_async_copy_thread(void* arg)
+{
+  scr_flush_async_copy_t* c = (scr_flush_async_copy_t*) arg;
+
+  int rc = SCR_SUCCESS;
+  double time_start = scr_seconds();
+  double busy  = 0.0;
+  double bytes = 0.0;
+  int i;
+  for (i = 0; i < c->num_files; i++) {
+    const char* src_file = c->src_files[i];
+    const char* dst_file = c->dst_files[i];
+    if (c->codec == SCR_COMPRESS_NONE) {
+      if (scr_flush_async_copy_file(c, src_file, dst_file, time_start, &busy, &bytes) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+      }
+    } else {
+      double file_start = scr_seconds();
+      if (scr_flush_compress_files(1, &src_file, &dst_file, c->codec) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+      }
+      busy  += scr_seconds() - file_start;
+      bytes += (double) scr_file_size(dst_file);
+
+      scr_flush_async_copy_pace(c, time_start, busy, bytes);
+    }
+  }
+
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&c->mutex);
+#endif
+  c->rc   = rc;
+  c->done = 1;
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&c->mutex);
+#endif
+
+  return NULL;
+}
+
+/* start a thread to write the files of this process for dataset id,
+ * limited to bw bytes per second and to percent of the time if those are
+ * positive */
+static int scr_flush_async_copy_start(
+  int dset_id,
+  int num_files,
+  const char** src_filelist,
+  const char** dst_filelist,
+  int codec,
+  double bw,
+  double percent)
+{
+  scr_flush_async_copy_t* c = (scr_flush_async_copy_t*) SCR_MALLOC(sizeof(scr_flush_async_copy_t));
+  c->id        = dset_id;
+  c->num_files = num_files;
+  c->src_files = NULL;
+  c->dst_files = NULL;
+  c->codec     = codec;
+  c->bw        = bw;
+  c->percent   = percent;
+  c->done      = 0;
+  c->rc        = SCR_SUCCESS;
+
+  if (num_files > 0) {
+    c->src_files = (char**) SCR_MALLOC(num_files * sizeof(char*));
+    c->dst_files = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  }
+  int i;
+  for (i = 0; i < num_files; i++) {
+    c->src_files[i] = strdup(src_filelist[i]);
+    c->dst_files[i] = strdup(dst_filelist[i]);
+  }
+
+  /* add record to our list */
+  c->next = scr_flush_async_copy_list;
+  scr_flush_async_copy_list = c;
+
+  /* if we can't start a thread, write the files before returning */
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&c->mutex, NULL);
+#endif
+  c->thread = scr_workers_start(1, scr_flush_async_copy_thread, (void*) c, 0);
+
+  return SCR_SUCCESS;
+}
+
+/* lookup record for the files of dataset id being written, or NULL */
+static scr_flush_async_copy_t* scr_flush_async_copy_find(int dset_id)
+{
+  scr_flush_async_copy_t* c = scr_flush_async_copy_list;
+  while (c != NULL && c->id != dset_id) {
+    c = c->next;
+  }
+  return c;
+}
+
+/* wait for the thread writing files of a dataset to finish */
+static void scr_flush_async_copy_join(scr_flush_async_copy_t* c)
+{
+  scr_workers_join(&c->thread);
+}
+
+/* remove record from our list and free it */
+static void scr_flush_async_copy_free(scr_flush_async_copy_t* c)
+{
+  /* unlink record from our list */
+  scr_flush_async_copy_t** ptr = &scr_flush_async_copy_list;
+  while (*ptr != c) {
+    ptr = &(*ptr)->next;
+  }
+  *ptr = c->next;
+
+  scr_flush_async_copy_join(c);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_destroy(&c->mutex);
+#endif
+
+  int i;
+  for (i = 0; i < c->num_files; i++) {
+    scr_free(&c->src_files[i]);
+    scr_free(&c->dst_files[i]);
+  }
+  scr_free(&c->src_files);
+  scr_free(&c->dst_files);
+  scr_free(&c);
+}
+
+/* returns SCR_SUCCESS on all procs if every process has written
+ * its files of dataset id */
+static int scr_flush_async_copy_test(int dset_id, MPI_Comm comm)
+{
+  int done = 0;
+  scr_flush_async_copy_t* c = scr_flush_async_copy_find(dset_id);
+  if (c != NULL) {
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&c->mutex);
+#endif
+    done = c->done;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_unlock(&c->mutex);
+#endif
+  }
+
+  if (! scr_alltrue(done, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* wait for all processes to write their files of dataset id,
+ * returns SCR_SUCCESS on all procs if all succeeded */
+static int scr_flush_async_copy_wait(int dset_id, MPI_Comm comm)
+{
+  int rc = SCR_FAILURE;
+  scr_flush_async_copy_t* c = scr_flush_async_copy_find(dset_id);
+  if (c != NULL) {
+    scr_flush_async_copy_join(c);
+    rc = c->rc;
+    scr_flush_async_copy_free(c);
+  }
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* start writing the files of the given dataset, either with our own thread
+ * or via AXL, all processes start at once, since a window of writers could
+ * only be advanced within an SCR call */
+static int scr_flush_async_start_xfer(
+  scr_cache_index* cindex,
+  int id,
+  const char* state_file)
+{
+  /* lookup record for this dataset */
+  kvtree* dset_hash = kvtree_get_kv_int(scr_flush_async_list, ASYNC_KEY_OUT_DSET, id);
+
+  /* get list of files for this transfer */
+  kvtree* file_list = kvtree_get(dset_hash, ASYNC_KEY_OUT_FILES);
+
+  /* allocate lists of source and destination paths */
+  int numfiles;
+  char** src_filelist;
+  char** dst_filelist;
+  scr_flush_list_alloc(file_list, &numfiles, &src_filelist, &dst_filelist);
+
+  /* get the dataset name */
+  scr_dataset* dataset = kvtree_get(file_list, SCR_KEY_DATASET);
+  char* dset_name = NULL;
+  scr_dataset_get_name(dataset, &dset_name);
+
+  /* get AXL transfer type to use */
+  const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+  axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
+
+  /* start writing files into the prefix directory with our own thread
+   * if we compress or pace them as we flush, otherwise start writing
+   * files via AXL */
+  int rc;
+  int thread = 0;
+  kvtree_util_get_int(dset_hash, ASYNC_KEY_OUT_THREAD, &thread);
+  if (thread) {
+    /* split the bandwidth limit for this node among the procs
+     * on the node that write files */
+    double bw = 0.0;
+    if (scr_flush_async_node_bw > 0.0) {
+      int writing = (numfiles > 0);
+      int writers = 0;
+      MPI_Allreduce(&writing, &writers, 1, MPI_INT, MPI_SUM, scr_comm_node);
+      if (writers > 0) {
+        bw = scr_flush_async_node_bw / (double) writers;
+      }
+    }
+
+    int codec = scr_flush_list_codec(file_list);
+    rc = scr_flush_async_copy_start(id, numfiles,
+      (const char**) src_filelist, (const char**) dst_filelist,
+      codec, bw, scr_flush_async_percent
+    );
+  } else {
+    rc = scr_axl_start(id, dset_name, state_file, numfiles,
+      (const char**) src_filelist, (const char**) dst_filelist,
+      xfer_type, scr_comm_world
+    );
+  }
+
+  /* free our file list */
+  scr_flush_list_free(numfiles, &src_filelist, &dst_filelist);
+
+  return rc;
+}
+
 /* stop all ongoing asynchronous flush operations */
 int scr_flush_async_stop()
 {
@@ -160,6 +526,13 @@ int scr_flush_async_stop()
     return SCR_FAILURE;
   }
 
+  /* we don't interrupt files that our own thread is writing,
+   * so wait for those threads to finish */
+  scr_flush_async_copy_t* c;
+  for (c = scr_flush_async_copy_list; c != NULL; c = c->next) {
+    scr_flush_async_copy_join(c);
+  }
+
   /* remove FLUSHING state from flush file */
   /*
   scr_flush_file_location_unset(id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
@@ -305,18 +678,8 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
     /* get path to destination file */
     const char* filename = dst_filelist[i];
 
-    /* compute path relative to prefix directory */
-    spath* base = spath_from_str(scr_prefix);
-    spath* dest = spath_from_str(filename);
-    spath* rel = spath_relative(base, dest);
-    char* relfile = spath_strdup(rel);
-
-    kvtree_set_kv(filelist, "FILE", relfile);
-
-    scr_free(&relfile);
-    spath_delete(&rel);
-    spath_delete(&dest);
-    spath_delete(&base);
+    /* add file to our list with its path relative to the prefix directory */
+    scr_flush_rank2file_add(filelist, file_list, src_filelist[i], filename);
   }
 
   /* save our file list to disk */
@@ -327,10 +690,6 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
   /* create directories */
   scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist, scr_comm_world);
 
-  /* get AXL transfer type to use */
-  const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
-  axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
-
   /* TODO: gather list of files to leader of store descriptor,
    * use communicator of leaders for AXL, then bcast result back */
 
@@ -343,11 +702,25 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
     spath_delete(&state_file_spath);
   }
 
-  /* start writing files via AXL */
+  /* we write files with our own thread if we compress them, or if the flush
+   * is throttled and the transfer type copies the files through this node
+   * anyway, so that we can pace the bytes as they are written, for other
+   * transfer types AXL moves the bytes, and we have no way to limit them */
+  int throttled = (scr_flush_async_node_bw > 0.0 || scr_flush_async_percent > 0.0);
+  const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+  axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
+  int copy_ok = ((xfer_type == AXL_XFER_SYNC || xfer_type == AXL_XFER_PTHREAD) && ! scr_flush_poststage);
+  int thread = (scr_flush_list_codec(file_list) != SCR_COMPRESS_NONE || (throttled && copy_ok));
+  kvtree_util_set_int(dset_hash, ASYNC_KEY_OUT_THREAD, thread);
+  if (throttled && ! thread && scr_my_rank_world == 0) {
+    scr_warn("SCR_FLUSH_ASYNC_BW and SCR_FLUSH_ASYNC_PERCENT cannot be enforced for %s transfers @ %s:%d",
+      storedesc->xfer, __FILE__, __LINE__
+    );
+  }
+
+  /* start writing files */
   int rc = SCR_SUCCESS;
-  if (scr_axl_start(id, dset_name, state_file, numfiles, (const char**) src_filelist, (const char**) dst_filelist,
-    xfer_type, scr_comm_world) != SCR_SUCCESS)
-  {
+  if (scr_flush_async_start_xfer(cindex, id, state_file) != SCR_SUCCESS) {
     /* failed to initiate AXL transfer */
     /* TODO: auto delete files? */
     kvtree_util_set_int(dset_hash, ASYNC_KEY_OUT_STATUS, SCR_FAILURE);
@@ -405,7 +778,11 @@ int scr_flush_async_test(scr_cache_index* cindex, int id)
 
   /* test whether transfer is done */
   int rc = SCR_SUCCESS;
-  if (scr_axl_test(id, scr_comm_world) != SCR_SUCCESS) {
+  int thread = 0;
+  kvtree_util_get_int(dset_hash, ASYNC_KEY_OUT_THREAD, &thread);
+  if (thread) {
+    rc = scr_flush_async_copy_test(id, scr_comm_world);
+  } else if (scr_axl_test(id, scr_comm_world) != SCR_SUCCESS) {
     rc = SCR_FAILURE;
   }
 
@@ -434,7 +811,15 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
   kvtree* dset_hash = kvtree_get_kv_int(scr_flush_async_list, ASYNC_KEY_OUT_DSET, id);
 
   /* wait for transfer to complete */
-  if (scr_axl_wait(id, scr_comm_world) != SCR_SUCCESS) {
+  int wait_rc;
+  int thread = 0;
+  kvtree_util_get_int(dset_hash, ASYNC_KEY_OUT_THREAD, &thread);
+  if (thread) {
+    wait_rc = scr_flush_async_copy_wait(id, scr_comm_world);
+  } else {
+    wait_rc = scr_axl_wait(id, scr_comm_world);
+  }
+  if (wait_rc != SCR_SUCCESS) {
     kvtree_util_set_int(dset_hash, ASYNC_KEY_OUT_STATUS, SCR_FAILURE);
   }
 
@@ -557,12 +942,11 @@ int scr_flush_async_wait(scr_cache_index* cindex, int id)
     scr_dataset_delete(&dataset);
 
     while (scr_flush_file_is_flushing(id)) {
-      /* test whether the flush has completed, and if so complete the flush */
-      if (scr_flush_async_test(cindex, id) == SCR_SUCCESS) {
-        /* complete the flush */
-        scr_flush_async_complete(cindex, id);
-      } else {
-        /* otherwise, sleep for a bit to get out of the way */
+      /* complete this flush and any others that finish while we wait */
+      scr_flush_async_progall(cindex);
+
+      /* if still going, sleep for a bit to get out of the way */
+      if (scr_flush_file_is_flushing(id)) {
         usleep(scr_flush_async_usleep);
       }
     }
@@ -595,8 +979,9 @@ int scr_flush_async_waitall(scr_cache_index* cindex)
   return SCR_SUCCESS;
 }
 
-/* progress each dataset in turn until all are complete,
- * or we find the first that is still going */
+/* progress each dataset, completing any whose transfer has finished,
+ * flushes may complete out of order, since scr_flush_complete only
+ * moves the current marker forward to newer checkpoints */
 int scr_flush_async_progall(scr_cache_index* cindex)
 {
   if (scr_flush_async_in_progress()) {
@@ -607,7 +992,8 @@ int scr_flush_async_progall(scr_cache_index* cindex)
     int* ids;
     kvtree_list_int(dsets, &num, &ids);
 
-    /* iterate over each dataset and wait for it to complete */
+    /* iterate over each dataset and complete those that are done,
+     * a slow flush does not hold up newer ones that have finished */
     int i;
     for (i = 0; i < num; i++) {
       int id = ids[i];
@@ -616,12 +1002,6 @@ int scr_flush_async_progall(scr_cache_index* cindex)
         if (scr_flush_async_test(cindex, id) == SCR_SUCCESS) {
           /* complete the flush */
           scr_flush_async_complete(cindex, id);
-        } else {
-          /* TODO: allow flushes to complete out of order */
-
-          /* flush is still going, so that we don't complete datasets
-           * out of order, break the loop and stop here */
-          break;
         }
       }
     }
@@ -655,12 +1035,26 @@ int scr_flush_async_init()
 {
   scr_flush_async_list = kvtree_new();
 
+  /* split the aggregate bandwidth limit evenly across nodes */
+  int leader = (scr_my_rank_host == 0);
+  int nodes = 0;
+  MPI_Allreduce(&leader, &nodes, 1, MPI_INT, MPI_SUM, scr_comm_world);
+  scr_flush_async_node_bw = 0.0;
+  if (scr_flush_async_bw > 0.0 && nodes > 0) {
+    scr_flush_async_node_bw = scr_flush_async_bw / (double) nodes;
+  }
+
   return SCR_SUCCESS;
 }
 
 /* stop all ongoing asynchronous flush operations */
 int scr_flush_async_finalize()
 {
+  /* free any records of files still being written by our own thread */
+  while (scr_flush_async_copy_list != NULL) {
+    scr_flush_async_copy_free(scr_flush_async_copy_list);
+  }
+
   kvtree_delete(&scr_flush_async_list);
 
   return SCR_SUCCESS;
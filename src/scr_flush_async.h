@@ -38,8 +38,8 @@ int scr_flush_async_wait(scr_cache_index* cindex, int id);
 /* wait until all datasets currently being flushed complete */
 int scr_flush_async_waitall(scr_cache_index* cindex);
 
-/* progress each dataset in turn until all are complete,
- * or we find the first that is still going */
+/* progress each dataset, completing any whose transfer has finished,
+ * even if an older dataset is still being flushed */
 int scr_flush_async_progall(scr_cache_index* cindex);
 
 /* get ordered list of ids being flushed,
@@ -21,16 +21,49 @@ Flush file functions
 =========================================
 */
 
+/* Rank 0 holds the contents of the flush file in memory, so queries
+ * need not read the file from the prefix directory.  The scavenge,
+ * poststage, and watchdog scripts read the file in the prefix directory
+ * after a failure, so every change is written through right away, and
+ * updates that change nothing are not written at all. */
+
+/* contents of flush file, only valid on rank 0 */
+static kvtree* scr_flush_file_hash = NULL;
+
+/* returns the in-memory flush state, reading it on first use,
+ * should only be called on rank 0 */
+static kvtree* scr_flush_file_get()
+{
+  if (scr_flush_file_hash == NULL) {
+    scr_flush_file_hash = kvtree_new();
+    kvtree_read_path(scr_flush_file, scr_flush_file_hash);
+  }
+  return scr_flush_file_hash;
+}
+
+/* write the in-memory flush state to the prefix directory */
+static void scr_flush_file_changed()
+{
+  kvtree_write_path(scr_flush_file, scr_flush_file_hash);
+}
+
+/* free the in-memory flush state */
+int scr_flush_file_finalize()
+{
+  if (scr_my_rank_world == 0) {
+    kvtree_delete(&scr_flush_file_hash);
+  }
+  return SCR_SUCCESS;
+}
+
 /* returns true if the given dataset id needs to be flushed */
 int scr_flush_file_need_flush(int id)
 {
   int need_flush = 0;
 
-  /* just have rank 0 read the file */
+  /* just have rank 0 check the state */
   if (scr_my_rank_world == 0) {
-    /* read the flush file */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get();
 
     /* if we have the dataset in cache, but not on the parallel file system,
      * then it needs to be flushed */
@@ -40,9 +73,6 @@ int scr_flush_file_need_flush(int id)
     if (in_cache != NULL && in_pfs == NULL) {
       need_flush = 1;
     }
-
-    /* free the hash object */
-    kvtree_delete(&hash);
   }
 
   /* broadcast decision from rank 0 */
@@ -57,11 +87,9 @@ int scr_flush_file_is_flushing(int id)
   /* assume we are not flushing this checkpoint */
   int is_flushing = 0;
 
-  /* only rank 0 tests the file */
+  /* only rank 0 tests the state */
   if (scr_my_rank_world == 0) {
-    /* read flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get();
 
     /* attempt to look up the FLUSHING state for this checkpoint */
     kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
@@ -69,9 +97,6 @@ int scr_flush_file_is_flushing(int id)
     if (flushing_hash != NULL) {
       is_flushing = 1;
     }
-
-    /* delete the hash */
-    kvtree_delete(&hash);
   }
 
   /* broadcast decision from rank 0 */
@@ -83,9 +108,15 @@ int scr_flush_file_is_flushing(int id)
 /* removes entries in flush file for given dataset id */
 int scr_flush_file_dataset_remove(int id)
 {
-  /* only rank 0 needs to write the file */
+  /* only rank 0 updates the state */
   if (scr_my_rank_world == 0) {
-    scr_flush_file_dataset_remove_with_path(id, scr_flush_file);
+    kvtree* hash = scr_flush_file_get();
+
+    /* delete this dataset id if we have it */
+    if (kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id) != NULL) {
+      kvtree_unset_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+      scr_flush_file_changed();
+    }
   }
   return SCR_SUCCESS;
 }
@@ -93,21 +124,16 @@ int scr_flush_file_dataset_remove(int id)
 /* adds a location for the specified dataset id to the flush file */
 int scr_flush_file_location_set(int id, const char* location)
 {
-  /* only rank 0 updates the file */
+  /* only rank 0 updates the state */
   if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get();
 
-    /* set the location for this dataset */
+    /* set the location for this dataset if it's not already set */
     kvtree* dset_hash = kvtree_set_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-    kvtree_set_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
-
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+    if (kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location) == NULL) {
+      kvtree_set_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
+      scr_flush_file_changed();
+    }
   }
   return SCR_SUCCESS;
 }
@@ -118,9 +144,7 @@ int scr_flush_file_location_test(int id, const char* location)
   /* only rank 0 checks the status, bcasts the results to everyone else */
   int at_location = 0;
   if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get();
 
     /* check the location for this dataset */
     kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
@@ -128,9 +152,6 @@ int scr_flush_file_location_test(int id, const char* location)
     if (value != NULL) {
       at_location = 1;
     }
-
-    /* delete the hash */
-    kvtree_delete(&hash);
   }
   MPI_Bcast(&at_location, 1, MPI_INT, 0, scr_comm_world);
 
@@ -143,11 +164,16 @@ int scr_flush_file_location_test(int id, const char* location)
 /* removes a location for the specified dataset id from the flush file */
 int scr_flush_file_location_unset(int id, const char* location)
 {
-  /* only rank 0 updates the file */
+  /* only rank 0 updates the state */
   if (scr_my_rank_world == 0) {
-    char* scr_flush_path = spath_strdup(scr_flush_file);
-    scr_flush_file_location_unset_with_path(id, location, scr_flush_path);
-    scr_free(&scr_flush_path);
+    kvtree* hash = scr_flush_file_get();
+
+    /* unset the location for this dataset if it's set */
+    kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+    if (kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location) != NULL) {
+      kvtree_unset_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
+      scr_flush_file_changed();
+    }
   }
   return SCR_SUCCESS;
 }
@@ -156,11 +182,9 @@ int scr_flush_file_location_unset(int id, const char* location)
  * including name, location, and flags */
 int scr_flush_file_new_entry(int id, const char* name, const scr_dataset* dataset, const char* location, int ckpt, int output)
 {
-  /* only rank 0 updates the file */
+  /* only rank 0 updates the state */
   if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get();
 
     /* set the name, location, and flags for this dataset */
     kvtree* dset_hash = kvtree_set_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
@@ -179,12 +203,27 @@ int scr_flush_file_new_entry(int id, const char* name, const scr_dataset* datase
     kvtree_merge(dataset_copy, dataset);
     kvtree_set(dset_hash, SCR_FLUSH_KEY_DSETDESC, dataset_copy);
 
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+    /* scavenge needs to know about the new dataset */
+    scr_flush_file_changed();
   }
   return SCR_SUCCESS;
 }
 
+/* returns the in-memory flush state on rank 0 for callers that edit it directly,
+ * caller should call scr_flush_file_commit when done, returns NULL on other ranks */
+kvtree* scr_flush_file_state()
+{
+  if (scr_my_rank_world == 0) {
+    return scr_flush_file_get();
+  }
+  return NULL;
+}
+
+/* write the flush state to the prefix directory after editing it directly */
+int scr_flush_file_commit()
+{
+  if (scr_my_rank_world == 0 && scr_flush_file_hash != NULL) {
+    scr_flush_file_changed();
+  }
+  return SCR_SUCCESS;
+}
@@ -34,4 +34,14 @@ int scr_flush_file_location_unset(int id, const char* location);
  * including name, location, and flags */
 int scr_flush_file_new_entry(int id, const char* name, const scr_dataset* dataset, const char* location, int ckpt, int output);
 
+/* returns the in-memory flush state on rank 0 for callers that edit it directly,
+ * caller should call scr_flush_file_commit when done, returns NULL on other ranks */
+kvtree* scr_flush_file_state();
+
+/* write the flush state to the prefix directory after editing it directly */
+int scr_flush_file_commit();
+
+/* free the in-memory flush state */
+int scr_flush_file_finalize();
+
 #endif
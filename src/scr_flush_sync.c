@@ -23,6 +23,79 @@ Synchronous flush functions
 =========================================
 */
 
+/* compress files from cache into the prefix directory, limiting the number
+ * of processes writing to the file system at the same time to scr_flush_width,
+ * windows are striped across ranks so that each window spans many nodes */
+static int scr_flush_sync_compress(
+  int numfiles,
+  const char** src_filelist,
+  const char** dst_filelist,
+  int codec)
+{
+  int rc = SCR_SUCCESS;
+
+  int windows = 1;
+  if (scr_flush_width > 0) {
+    windows = (scr_ranks_world + scr_flush_width - 1) / scr_flush_width;
+  }
+
+  int window;
+  for (window = 0; window < windows; window++) {
+    if (scr_my_rank_world % windows == window) {
+      rc = scr_flush_compress_files(numfiles, src_filelist, dst_filelist, codec);
+    }
+    MPI_Barrier(scr_comm_world);
+  }
+
+  return rc;
+}
+
+/* gathers files to the leader of each store descriptor, which writes them
+ * to its container, only the leaders write to the file system, so the
+ * number of leaders writing at the same time is limited to scr_flush_width,
+ * windows are striped across groups so that each window spans many nodes */
+static int scr_flush_sync_container(
+  const scr_storedesc* storedesc,
+  const char* container,
+  int numfiles,
+  const char** src_filelist,
+  const char** names,
+  const unsigned long* offsets,
+  const unsigned long* lengths)
+{
+  int rc = SCR_SUCCESS;
+
+  /* number the leaders, and give each process the number of its leader */
+  int is_leader = (storedesc->rank == 0);
+  int leader_id = 0;
+  MPI_Exscan(&is_leader, &leader_id, 1, MPI_INT, MPI_SUM, scr_comm_world);
+  if (scr_my_rank_world == 0) {
+    /* the value from exscan is undefined on rank 0 */
+    leader_id = 0;
+  }
+  MPI_Bcast(&leader_id, 1, MPI_INT, 0, storedesc->comm);
+
+  int leaders;
+  MPI_Allreduce(&is_leader, &leaders, 1, MPI_INT, MPI_SUM, scr_comm_world);
+
+  int windows = 1;
+  if (scr_flush_width > 0) {
+    windows = (leaders + scr_flush_width - 1) / scr_flush_width;
+  }
+
+  int window;
+  for (window = 0; window < windows; window++) {
+    if (leader_id % windows == window) {
+      rc = scr_container_write(storedesc->comm, container, numfiles,
+        src_filelist, names, offsets, lengths
+      );
+    }
+    MPI_Barrier(scr_comm_world);
+  }
+
+  return rc;
+}
+
 /* flushes data for files specified in file_list (with flow control),
  * and records status of each file in data */
 static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_list)
@@ -68,46 +141,94 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
     spath_delete(&state_file_path);
   }
 
-  /* define path for rank2file map */
-  spath_append_str(dataset_path, "rank2file");
-  const char* rank2file = spath_strdup(dataset_path);
-
   /* we can skip transfer if all paths match */
-  int skip_transfer = 1;
-
-  /* build a list of files for this rank */
   int i;
-  kvtree* filelist = kvtree_new();
+  int skip_transfer = 1;
   for (i = 0; i < numfiles; i++) {
-    /* get path to destination file */
-    const char* filename = dst_filelist[i];
-
     /* found a source and destination path that are different */
-    if (strcmp(src_filelist[i], filename) != 0) {
+    if (strcmp(src_filelist[i], dst_filelist[i]) != 0) {
       skip_transfer = 0;
     }
+  }
+  skip_transfer = scr_alltrue(skip_transfer, scr_comm_world);
+
+  /* if aggregating, the leader of each store descriptor writes the files
+   * of its group to a container in the dataset directory, this only
+   * applies to checkpoints, output and files we compress as we write
+   * them are left as individual files */
+  const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+  int aggregate = (scr_flush_dataset_aggregate(dataset) && ! skip_transfer &&
+    scr_flush_list_codec(file_list) == SCR_COMPRESS_NONE
+  );
+  char* container = NULL;
+  char* container_rel = NULL;
+  char** names = NULL;
+  unsigned long* offsets = NULL;
+  unsigned long* lengths = NULL;
+  if (aggregate) {
+    offsets = (unsigned long*) SCR_MALLOC(numfiles * sizeof(unsigned long));
+    lengths = (unsigned long*) SCR_MALLOC(numfiles * sizeof(unsigned long));
+
+    /* the index of the container lists files relative to the prefix directory */
+    spath* prefix = spath_from_str(scr_prefix);
+    names = (char**) SCR_MALLOC(numfiles * sizeof(char*));
+    for (i = 0; i < numfiles; i++) {
+      spath* dst_path = spath_from_str(dst_filelist[i]);
+      spath* rel = spath_relative(prefix, dst_path);
+      names[i] = spath_strdup(rel);
+      spath_delete(&rel);
+      spath_delete(&dst_path);
+    }
+    spath_delete(&prefix);
 
-    /* compute path relative to prefix directory */
-    spath* base = spath_from_str(scr_prefix);
-    spath* dest = spath_from_str(filename);
-    spath* rel = spath_relative(base, dest);
-    char* relfile = spath_strdup(rel);
-
-    kvtree_set_kv(filelist, "FILE", relfile);
+    char* dir = spath_strdup(dataset_path);
+    scr_container_layout(storedesc->comm, dir, numfiles, (const char**) src_filelist,
+      &container, offsets, lengths
+    );
+    scr_free(&dir);
 
-    scr_free(&relfile);
+    /* record container relative to the prefix directory */
+    spath* base = spath_from_str(scr_prefix);
+    spath* container_path = spath_from_str(container);
+    spath* rel = spath_relative(base, container_path);
+    container_rel = spath_strdup(rel);
     spath_delete(&rel);
-    spath_delete(&dest);
+    spath_delete(&container_path);
     spath_delete(&base);
   }
 
+  /* define path for rank2file map */
+  spath_append_str(dataset_path, "rank2file");
+  const char* rank2file = spath_strdup(dataset_path);
+
+  /* build a list of files for this rank */
+  kvtree* filelist = kvtree_new();
+  for (i = 0; i < numfiles; i++) {
+    /* add file to our list with its path relative to the prefix directory */
+    kvtree* file_hash = scr_flush_rank2file_add(filelist, file_list, src_filelist[i], dst_filelist[i]);
+
+    /* record where to find the file in its container */
+    if (aggregate) {
+      kvtree_util_set_str(file_hash, SCR_KEY_CONTAINER, container_rel);
+      kvtree_util_set_unsigned_long(file_hash, SCR_KEY_OFFSET, offsets[i]);
+      kvtree_util_set_unsigned_long(file_hash, SCR_KEY_LENGTH, lengths[i]);
+    }
+  }
+
   /* save our file list to disk */
   kvtree_write_gather(rank2file, filelist, scr_comm_world);
   kvtree_delete(&filelist);
 
   /* after writing out file above, see if we can skip the transfer */
   int success = 1;
-  if (! scr_alltrue(skip_transfer, scr_comm_world)) {
+  if (aggregate) {
+    /* gather files to the leader of each store descriptor */
+    if (scr_flush_sync_container(storedesc, container, numfiles,
+      (const char**) src_filelist, (const char**) names, offsets, lengths) != SCR_SUCCESS)
+    {
+      success = 0;
+    }
+  } else if (! skip_transfer) {
     /* create directories */
     scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist, scr_comm_world);
 
@@ -116,15 +237,24 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
     scr_dataset_get_name(dataset, &dset_name);
 
     /* get AXL transfer type to use */
-    const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
     axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
 
-    /* TODO: gather list of files to leader of store descriptor,
-     * use communicator of leaders for AXL, then bcast result back */
-
-    /* write files (via AXL) */
-    if (scr_axl(dset_name, state_file, numfiles, (const char**) src_filelist, (const char **) dst_filelist, xfer_type, scr_comm_world) != SCR_SUCCESS) {
-      success = 0;
+    int codec = scr_flush_list_codec(file_list);
+    if (codec != SCR_COMPRESS_NONE) {
+      /* compress files as we write them, with the same flow control */
+      if (scr_flush_sync_compress(numfiles, (const char**) src_filelist, (const char**) dst_filelist,
+        codec) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
+    } else {
+      /* write files (via AXL), limiting the number of processes
+       * writing to the file system at the same time */
+      if (scr_axl_window(dset_name, state_file, numfiles, (const char**) src_filelist, (const char **) dst_filelist,
+        xfer_type, scr_flush_width, 1, NULL, scr_comm_world) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
     }
   } else {
     /* just stat the file to check that it exists */
@@ -137,6 +267,18 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
     }
   }
 
+  /* free container layout */
+  if (names != NULL) {
+    for (i = 0; i < numfiles; i++) {
+      scr_free(&names[i]);
+    }
+    scr_free(&names);
+  }
+  scr_free(&lengths);
+  scr_free(&offsets);
+  scr_free(&container_rel);
+  scr_free(&container);
+
   /* free path and file name */
   scr_free(&rank2file);
   scr_free(&state_file);
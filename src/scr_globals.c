@@ -119,16 +119,23 @@ int   scr_purge            = 0;                    /* whether to delete all data
 int   scr_distribute       = SCR_DISTRIBUTE;       /* whether to call scr_distribute_files during SCR_Init */
 int   scr_fetch_enable     = SCR_FETCH;            /* whether to call scr_fetch_files during SCR_Init */
 int   scr_fetch_width      = SCR_FETCH_WIDTH;      /* specify number of processes to read files simultaneously */
+int   scr_fetch_pipeline   = SCR_FETCH_PIPELINE;   /* whether to start new readers as soon as others finish */
 int   scr_fetch_bypass     = SCR_FETCH_BYPASS;     /* whether to use implied bypass mode on fetch */
+int   scr_fetch_stream     = SCR_FETCH_STREAM;     /* whether to copy files to cache in the background during restart */
 char* scr_fetch_current    = NULL;                 /* name of checkpoint to start with during fetch */
 int   scr_flush            = SCR_FLUSH;            /* how many checkpoints between flushes */
 char* scr_flush_type       = NULL;                 /* AXL type to use when flushing data */
 int   scr_flush_width      = SCR_FLUSH_WIDTH;      /* specify number of processes to write files simultaneously */
+int   scr_flush_aggregate  = SCR_FLUSH_AGGREGATE;  /* whether to write files to container files during flush */
+int   scr_flush_compress   = SCR_COMPRESS_NONE;    /* codec to compress files with during flush */
+int   scr_flush_compress_level = -1;               /* compression level, -1 for codec default */
 int   scr_flush_on_restart = SCR_FLUSH_ON_RESTART; /* specify whether to flush cache on restart */
 int   scr_global_restart   = SCR_GLOBAL_RESTART;   /* set if code must be restarted from parallel file system */
 int   scr_drop_after_current = 0;                  /* whether to drop datasets from index that come after dataset named in SCR_Current */
 
 int    scr_flush_async         = SCR_FLUSH_ASYNC;         /* whether to use asynchronous flush */
+int    scr_incremental         = SCR_INCREMENTAL;         /* whether to store changed blocks of checkpoint files */
+unsigned long scr_incremental_block_size = SCR_INCREMENTAL_BLOCK_SIZE; /* size of blocks compared for incremental checkpoints */
 double scr_flush_async_bw      = SCR_FLUSH_ASYNC_BW;      /* bandwidth limit imposed during async flush */
 double scr_flush_async_percent = SCR_FLUSH_ASYNC_PERCENT; /* runtime limit imposed during async flush */
 int    scr_flush_async_usleep  = SCR_FLUSH_ASYNC_USLEEP;  /* number of microsecs to sleep between polling async transfer */
@@ -136,11 +143,14 @@ int    scr_flush_async_usleep  = SCR_FLUSH_ASYNC_USLEEP;  /* number of microsecs
 int scr_flush_poststage = SCR_FLUSH_POSTSTAGE; /* Use scr_poststage to finalize transfers */
 
 int scr_prefix_size  = SCR_PREFIX_SIZE; /* max number of checkpoints to keep in prefix directory */
+int scr_index_journal_records = SCR_INDEX_JOURNAL_RECORDS; /* number of index journal records before the index file is rewritten */
 int scr_prefix_purge = 0;               /* whether to delete all datasets listed in index file during SCR_Init */
 
 int scr_crc_on_copy   = SCR_CRC_ON_COPY;   /* whether to enable crc32 checks during scr_swap_files() */
 int scr_crc_on_flush  = SCR_CRC_ON_FLUSH;  /* whether to enable crc32 checks during flush and fetch */
 int scr_crc_on_delete = SCR_CRC_ON_DELETE; /* whether to enable crc32 checks when deleting checkpoints */
+int scr_crc_threads   = SCR_CRC_THREADS;   /* max number of threads used to compute crc32 of a file */
+int scr_stat_threads  = SCR_STAT_THREADS;  /* max number of threads used to stat files of a dataset */
 
 int    scr_checkpoint_interval = SCR_CHECKPOINT_INTERVAL; /* times to call Need_checkpoint between checkpoints */
 int    scr_checkpoint_seconds  = SCR_CHECKPOINT_SECONDS;  /* min number of seconds between checkpoints */
@@ -102,6 +102,9 @@
 #include "scr_flush.h"
 #include "scr_flush_sync.h"
 #include "scr_flush_async.h"
+#include "scr_delta.h"
+#include "scr_compress.h"
+#include "scr_container.h"
 
 /*
 =========================================
@@ -173,19 +176,27 @@ extern int   scr_purge;            /* delete all datasets from cache on restart
 extern int   scr_distribute;       /* whether to call scr_distribute_files during SCR_Init */
 extern int   scr_fetch_enable;     /* whether to call scr_fetch_files during SCR_Init */
 extern int   scr_fetch_width;      /* specify number of processes to read files simultaneously */
+extern int   scr_fetch_pipeline;   /* whether to start new readers as soon as others finish */
 extern int   scr_fetch_bypass;     /* whether to use implied bypass on fetch operations */
+extern int   scr_fetch_stream;     /* whether to copy files to cache in the background during restart */
 extern char* scr_fetch_current;    /* specify name of checkpoint to start with in fetch_latest */
 extern int   scr_flush;            /* how many checkpoints between flushes */
 extern char* scr_flush_type;       /* AXL type to use when flushing datasets */
 extern int   scr_flush_width;      /* specify number of processes to write files simultaneously */
+extern int   scr_flush_aggregate;  /* whether to write files to container files during flush */
+extern int   scr_flush_compress;   /* codec to compress files with during flush */
+extern int   scr_flush_compress_level; /* compression level, -1 for codec default */
 extern int   scr_flush_on_restart; /* specify whether to flush cache on restart */
 extern int   scr_global_restart;   /* set if code must be restarted from parallel file system */
 extern int   scr_drop_after_current; /* auto-drop datasets from index that come after named checkpoint when calling SCR_Current */
 
 extern int scr_prefix_size;  /* max number of checkpoints to keep in prefix directory */
+extern int scr_index_journal_records; /* number of index journal records before the index file is rewritten */
 extern int scr_prefix_purge; /* whether to delete all datasets listed in index file during SCR_Init */
 
 extern int scr_flush_async;            /* whether to use asynchronous flush */
+extern int scr_incremental;            /* whether to store changed blocks of checkpoint files */
+extern unsigned long scr_incremental_block_size; /* size of blocks compared for incremental checkpoints */
 extern double scr_flush_async_bw;      /* bandwidth limit imposed during async flush */
 extern double scr_flush_async_percent; /* runtime limit imposed during async flush */
 extern int scr_flush_async_usleep;     /* number of microsecs to sleep between polling async transfer */
@@ -195,6 +206,8 @@ extern int scr_flush_poststage; /* whether to use scr_poststage.sh to finalize t
 extern int scr_crc_on_copy;   /* whether to enable crc32 checks during scr_swap_files() */
 extern int scr_crc_on_flush;  /* whether to enable crc32 checks during flush and fetch */
 extern int scr_crc_on_delete; /* whether to enable crc32 checks when deleting checkpoints */
+extern int scr_crc_threads;   /* max number of threads used to compute crc32 of a file */
+extern int scr_stat_threads;  /* max number of threads used to stat files of a dataset */
 
 extern int    scr_checkpoint_interval;   /* times to call Need_checkpoint between checkpoints */
 extern int    scr_checkpoint_seconds;    /* min number of seconds between checkpoints */
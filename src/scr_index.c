@@ -30,6 +30,7 @@
 #include "scr_filemap.h"
 #include "scr_param.h"
 #include "scr_index_api.h"
+#include "scr_rebuild.h"
 
 #include "spath.h"
 #include "kvtree.h"
@@ -45,21 +46,20 @@
 #include <errno.h>
 #include <time.h>
 #include <unistd.h>
-#include <sys/wait.h>
 #include <getopt.h>
+#include <sys/wait.h>
 
-#include <dirent.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
-#include <regex.h>
+#include <dirent.h>
 
 #define SCR_IO_KEY_DIR     ("DIR")
 #define SCR_IO_KEY_FILE    ("FILE")
 #define SCR_IO_KEY_UNKNOWN ("UNKNOWN")
 
 #define SCR_SUMMARY_FILENAME "summary.scr"
-#define BUILD_PARTNER_CMD (X_LIBEXECDIR"/scr_rebuild_partner")
-#define BUILD_XOR_CMD     (X_LIBEXECDIR"/scr_rebuild_xor")
-#define BUILD_RS_CMD      (X_LIBEXECDIR"/scr_rebuild_rs")
 
 #define SCR_SCAN_KEY_MAP "MAP"
 
@@ -408,40 +408,123 @@ int scr_summary_write(const spath* prefix, const spath* dir, kvtree* hash)
   return rc;
 }
 
-/* forks and execs processes to rebuild missing files and waits for them to complete,
- * returns SCR_FAILURE if any dataset failed to rebuild, SCR_SUCCESS otherwise */
-int scr_fork_rebuilds(const spath* dir, const char* build_cmd, kvtree* cmds)
+/* maximum number of scan threads and of decode processes to run at once,
+ * 0 to use the number of cores */
+static int scr_index_jobs = 0;
+
+/* return number of threads or processes to use to process count items */
+static int scr_index_jobs_for(int count)
+{
+  int jobs = scr_index_jobs;
+  if (jobs <= 0) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    jobs = (cores > 0) ? (int) cores : 1;
+  }
+  if (jobs > count) {
+    jobs = count;
+  }
+  if (jobs < 1) {
+    jobs = 1;
+  }
+  return jobs;
+}
+
+/* describes a rebuild command and the process decoding it */
+struct scr_rebuild {
+  int id;               /* index of build command */
+  kvtree* cmd_hash;     /* argument values for this command */
+  unsigned long bytes;  /* total size of redundancy files read by this rebuild */
+  pid_t pid;            /* process decoding this rebuild, or -1 */
+  double start;         /* time at which the decode started */
+  int rc;               /* return code of rebuild */
+};
+
+/* sort rebuilds by decreasing number of bytes */
+static int scr_rebuild_cmp(const void* a, const void* b)
+{
+  const struct scr_rebuild* ra = (const struct scr_rebuild*) a;
+  const struct scr_rebuild* rb = (const struct scr_rebuild*) b;
+  if (ra->bytes > rb->bytes) {
+    return -1;
+  }
+  if (ra->bytes < rb->bytes) {
+    return 1;
+  }
+  return ra->id - rb->id;
+}
+
+/* prepare a single rebuild command, whose arguments are the
+ * redundancy scheme, the type of files to rebuild, and the list of
+ * redundancy files, returns NULL if the set can't be rebuilt */
+static scr_rebuild_set* scr_rebuild_prepare_cmd(const spath* dir, kvtree* cmd_hash, scr_rebuild_cache* cache)
+{
+  /* arguments are sorted by their index */
+  int argc = kvtree_size(cmd_hash);
+  if (argc < 2) {
+    return NULL;
+  }
+
+  /* build the argv array */
+  char** argv = (char**) SCR_MALLOC(argc * sizeof(char*));
+  int index = 0;
+  kvtree_elem* arg_elem = NULL;
+  for (arg_elem = kvtree_elem_first(cmd_hash);
+       arg_elem != NULL;
+       arg_elem = kvtree_elem_next(arg_elem))
+  {
+    char* key = kvtree_elem_key(arg_elem);
+    argv[index] = kvtree_elem_get_first_val(cmd_hash, key);
+    index++;
+  }
+
+  /* rebuild filemaps if given map command, otherwise rebuild data files */
+  const char* scheme = argv[0];
+  int build_data = (strcmp(argv[1], "map") != 0);
+  scr_rebuild_set* set = scr_rebuild_prepare(dir, scheme, build_data, argc - 2, (const char**) &argv[2], cache);
+
+  scr_free(&argv);
+
+  return set;
+}
+
+/* rebuilds missing files and waits for the rebuilds to complete,
+ * the paths and filemaps of each set are worked out in this process,
+ * and each set is then decoded in a child process, with at most
+ * scr_index_jobs decodes running at a time, starting with the rebuilds
+ * that read the most data, returns SCR_FAILURE if any dataset failed
+ * to rebuild, SCR_SUCCESS otherwise */
+int scr_run_rebuilds(const spath* dir, kvtree* cmds, scr_rebuild_cache* cache)
 {
   int rc = SCR_SUCCESS;
 
   /* count the number of build commands */
   int builds = kvtree_size(cmds);
+  if (builds == 0) {
+    return rc;
+  }
 
-  /* allocate space to hold the pid for each child */
-  pid_t* pids = NULL;
-  if (builds > 0) {
-    pids = (pid_t*) malloc(builds * sizeof(pid_t));
-    if (pids == NULL) {
-      scr_err("Failed to allocate space to record pids @ %s:%d",
-        __FILE__, __LINE__
-      );
-      return SCR_FAILURE;
-    }
+  /* allocate space to hold the state of each rebuild */
+  struct scr_rebuild* rebuilds = (struct scr_rebuild*) malloc(builds * sizeof(struct scr_rebuild));
+  if (rebuilds == NULL) {
+    scr_err("Failed to allocate space to record rebuilds @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
   }
 
-  /* allocate character string for chdir */
+  /* allocate character string for directory */
   char* dir_str = spath_strdup(dir);
 
-  /* TODO: flow control the number of builds ongoing at a time */
-
-  /* step through and fork off each of our build commands */
-  int pid_count = 0;
+  /* record each build command, and total up the size of the
+   * redundancy files it reads, which are listed after the
+   * scheme name and the type option */
+  int count = 0;
   kvtree_elem* elem = NULL;
   for (elem = kvtree_elem_first(cmds);
        elem != NULL;
        elem = kvtree_elem_next(elem))
   {
-    /* get the hash of argv values for this command */
+    /* get the hash of argument values for this command */
     kvtree* cmd_hash = kvtree_elem_hash(elem);
 
     /* sort the arguments by their index */
@@ -450,6 +533,10 @@ int scr_fork_rebuilds(const spath* dir, const char* build_cmd, kvtree* cmds)
     /* print the command to screen, so the user knows what's happening */
     int offset = 0;
     char full_cmd[SCR_MAX_FILENAME];
+    full_cmd[0] = '\0';
+
+    unsigned long bytes = 0;
+    int index = 0;
     kvtree_elem* arg_elem = NULL;
     for (arg_elem = kvtree_elem_first(cmd_hash);
          arg_elem != NULL;
@@ -457,80 +544,125 @@ int scr_fork_rebuilds(const spath* dir, const char* build_cmd, kvtree* cmds)
     {
       char* key = kvtree_elem_key(arg_elem);
       char* arg_str = kvtree_elem_get_first_val(cmd_hash, key);
+
       int remaining = sizeof(full_cmd) - offset;
       if (remaining > 0) {
         offset += snprintf(full_cmd + offset, remaining, "%s ", arg_str);
       }
+
+      if (index >= 2) {
+        spath* file_path = spath_from_str(dir_str);
+        spath_append_str(file_path, arg_str);
+        char* file = spath_strdup(file_path);
+        bytes += scr_file_size(file);
+        scr_free(&file);
+        spath_delete(&file_path);
+      }
+      index++;
     }
-    scr_dbg(0, "Rebuild command: %s\n", full_cmd);
+    scr_dbg(0, "Rebuild %d: %s", count, full_cmd);
 
-    /* count the number of command line arguments */
-    int argc = kvtree_size(cmd_hash);
+    rebuilds[count].id       = count;
+    rebuilds[count].cmd_hash = cmd_hash;
+    rebuilds[count].bytes    = bytes;
+    rebuilds[count].pid      = -1;
+    rebuilds[count].start    = 0.0;
+    rebuilds[count].rc       = SCR_FAILURE;
+    count++;
+  }
 
-    /* issue build command */
-    pids[pid_count] = fork();
-    if (pids[pid_count] == 0) {
-      /* this is the child, which will do the exec, build the argv array */
+  /* start the largest rebuilds first, so they don't hold up the end */
+  qsort(rebuilds, builds, sizeof(struct scr_rebuild), scr_rebuild_cmp);
 
-      /* allocate space for the argv array */
-      char** argv = (char**) malloc((argc + 1) * sizeof(char*));
-      if (argv == NULL) {
-        scr_err("Failed to allocate memory for build execv @ %s:%d",
-          __FILE__, __LINE__
-        );
-        exit(1);
-      }
+  /* determine how many decodes we can run at once */
+  int jobs = scr_index_jobs_for(builds);
 
-      /* fill in our argv values and null-terminate the array */
-      int index = 0;
-      kvtree_elem* arg_elem = NULL;
-      for (arg_elem = kvtree_elem_first(cmd_hash);
-           arg_elem != NULL;
-           arg_elem = kvtree_elem_next(arg_elem))
-      {
-        char* key = kvtree_elem_key(arg_elem);
-        argv[index] = kvtree_elem_get_first_val(cmd_hash, key);
-        index++;
+  /* fork off decodes as slots become available */
+  int next = 0;
+  int running = 0;
+  while (next < builds || running > 0) {
+    /* start as many decodes as we have free slots */
+    while (next < builds && running < jobs) {
+      struct scr_rebuild* r = &rebuilds[next];
+      next++;
+
+      /* read the redundancy headers and filemaps of this set */
+      scr_rebuild_set* set = scr_rebuild_prepare_cmd(dir, r->cmd_hash, cache);
+      if (set == NULL) {
+        continue;
       }
-      argv[index] = NULL;
 
-      /* cd to current working directory */
-      if (chdir(dir_str) != 0) {
-        scr_err("Failed to change to directory %s @ %s:%d",
-          dir_str, __FILE__, __LINE__
+      /* don't let the child write out our buffered messages a second time */
+      fflush(stdout);
+      fflush(stderr);
+
+      /* decode the missing files in a child process */
+      r->start = scr_seconds();
+      r->pid = fork();
+      if (r->pid == 0) {
+        int child_rc = scr_rebuild_decode(set);
+        exit((child_rc == SCR_SUCCESS) ? 0 : 1);
+      } else if (r->pid < 0) {
+        scr_err("Failed to fork rebuild %d (errno=%d %s) @ %s:%d",
+          r->id, errno, strerror(errno), __FILE__, __LINE__
         );
-        exit(1);
+      } else {
+        running++;
       }
 
-      /* execv the build command */
-      execv(build_cmd, argv);
+      scr_rebuild_set_delete(&set);
     }
-    pid_count++;
-  }
 
-  /* wait for for each child to finish */
-  while (pid_count > 0) {
+    /* nothing left to wait on if we failed to start the rest */
+    if (running == 0) {
+      continue;
+    }
+
+    /* wait for a decode to finish to free up its slot */
     int stat = 0;
-    int ret = wait(&stat);
-    if (ret == -1 || ret == (pid_t)-1) {
+    pid_t ret = wait(&stat);
+    if (ret == (pid_t)-1) {
       scr_err("Got a -1 from wait @ %s:%d",
         __FILE__, __LINE__
       );
-      rc = SCR_FAILURE;
-    } else if (stat != 0) {
-      scr_err("Child returned with non-zero @ %s:%d",
-        __FILE__, __LINE__
+      break;
+    }
+    running--;
+
+    /* record the result and report how long the decode took */
+    int i;
+    for (i = 0; i < next; i++) {
+      struct scr_rebuild* r = &rebuilds[i];
+      if (r->pid == ret) {
+        if (WIFEXITED(stat) && WEXITSTATUS(stat) == 0) {
+          r->rc = SCR_SUCCESS;
+        }
+        double secs = scr_seconds() - r->start;
+        scr_dbg(0, "Rebuild %d: %f secs, %lu bytes, rc %d",
+          r->id, secs, r->bytes, r->rc
+        );
+        r->pid = -1;
+        break;
+      }
+    }
+  }
+
+  /* check that every rebuild succeeded */
+  int i;
+  for (i = 0; i < builds; i++) {
+    if (rebuilds[i].rc != SCR_SUCCESS) {
+      scr_err("Rebuild %d failed in %s @ %s:%d",
+        rebuilds[i].id, dir_str, __FILE__, __LINE__
       );
       rc = SCR_FAILURE;
     }
-    pid_count--;
   }
 
   /* free the directory string */
   scr_free(&dir_str);
 
-  /* free the pid array */
-  scr_free(&pids);
+  /* free the rebuild array */
+  scr_free(&rebuilds);
 
   return rc;
 }
@@ -543,8 +675,9 @@ static int scr_rebuild_redset(
   const kvtree* missing_hash,
   const char* type_key,
   const char* type_cmd,
-  const char* rebuild_cmd,
-  int max_missing)
+  const char* scheme,
+  int max_missing,
+  scr_rebuild_cache* cache)
 {
   int rc = SCR_SUCCESS;
 
@@ -617,8 +750,8 @@ static int scr_rebuild_redset(
 
       int argc = 0;
 
-      /* write the command name */
-      kvtree_setf(buildcmd_hash, NULL, "%d %s", argc, rebuild_cmd);
+      /* write the redundancy scheme */
+      kvtree_setf(buildcmd_hash, NULL, "%d %s", argc, scheme);
       argc++;
 
       /* option to build data files or map files */
@@ -649,7 +782,7 @@ static int scr_rebuild_redset(
   } else {
     /* we have a shot to rebuild everything, let's give it a go */
     kvtree* builds_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_BUILD);
-    if (scr_fork_rebuilds(dir, rebuild_cmd, builds_hash) != SCR_SUCCESS) {
+    if (scr_run_rebuilds(dir, builds_hash, cache) != SCR_SUCCESS) {
       scr_err("At least one rebuild failed for dataset %d in %s @ %s:%d",
         dset_id, dir_str, __FILE__, __LINE__
       );
@@ -662,7 +795,7 @@ static int scr_rebuild_redset(
 }
 
 /* returns SCR_FAILURE if any dataset failed to rebuild, SCR_SUCCESS otherwise */
-int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
+int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan, scr_rebuild_cache* cache)
 {
   /* assume we'll be successful */
   int rc = SCR_SUCCESS;
@@ -694,7 +827,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild filemap files with PARTNER */
       kvtree* mappartner_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_MAPPARTNER);
       if (mappartner_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_MAPPARTNER, "map", BUILD_PARTNER_CMD, -1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_MAPPARTNER, "map", SCR_REBUILD_PARTNER, -1, cache);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -703,7 +836,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild filemap files with XOR */
       kvtree* mapxor_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_MAPXOR);
       if (mapxor_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_MAPXOR, "map", BUILD_XOR_CMD, 1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_MAPXOR, "map", SCR_REBUILD_XOR, 1, cache);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -712,7 +845,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild filemap files with RS */
       kvtree* maprs_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_MAPRS);
       if (maprs_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_MAPRS, "map", BUILD_RS_CMD, -1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_MAPRS, "map", SCR_REBUILD_RS, -1, cache);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -721,7 +854,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild data files with PARTNER */
       kvtree* partner_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_PARTNER);
       if (partner_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_PARTNER, "partner", BUILD_PARTNER_CMD, -1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_PARTNER, "partner", SCR_REBUILD_PARTNER, -1, cache);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -730,7 +863,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild data files with XOR */
       kvtree* xor_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_XOR);
       if (xor_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_XOR, "xor", BUILD_XOR_CMD, 1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_XOR, "xor", SCR_REBUILD_XOR, 1, cache);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -739,7 +872,7 @@ int scr_rebuild_scan(const spath* prefix, const spath* dir, kvtree* scan)
       /* rebuild data files with RS */
       kvtree* rs_hash = kvtree_get(dset_hash, SCR_SCAN_KEY_RS);
       if (rs_hash != NULL) {
-        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_RS, "rs", BUILD_RS_CMD, -1);
+        int tmp_rc = scr_rebuild_redset(prefix, dir, dset_id, dset_hash, missing_hash, SCR_SCAN_KEY_RS, "rs", SCR_REBUILD_RS, -1, cache);
         if (tmp_rc != SCR_SUCCESS) {
           rc = SCR_FAILURE;
         }
@@ -974,19 +1107,16 @@ int scr_scan_flush(const spath* path_prefix, int dset_id, kvtree* scan)
 
 /* Reads fmap files from given dataset directory and adds them to scan hash.
  * Returns SCR_SUCCESS if the files could be scanned */
-int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int dset_id, int rank_id, int* ranks, kvtree* scan)
+int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int dset_id, int rank_id, int* ranks, kvtree* scan, scr_rebuild_cache* cache)
 {
-  /* create an empty filemap to store contents */
-  scr_filemap* rank_map = scr_filemap_new();
-
   /* read in the filemap */
-  if (scr_filemap_read(path_filemap, rank_map) != SCR_SUCCESS) {
+  scr_filemap_view* rank_map = scr_filemap_view_open(path_filemap);
+  if (rank_map == NULL) {
     char* path_err = spath_strdup(path_filemap);
     scr_err("Error reading filemap: %s @ %s:%d",
       path_err, __FILE__, __LINE__
     );
     scr_free(&path_err);
-    scr_filemap_delete(&rank_map);
     return SCR_FAILURE;
   }
 
@@ -1001,70 +1131,47 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
     kvtree_set(list_hash, SCR_SUMMARY_6_KEY_RANK2FILE, rank2file_hash);
   }
 
-#if 0
-  /* read dataset hash from filemap and record in summary */
-  scr_dataset* rank_dset = scr_dataset_new();
-  scr_filemap_get_dataset(rank_map, dset_id, rank_id, rank_dset);
-  scr_dataset* current_dset = kvtree_get(list_hash, SCR_SUMMARY_6_KEY_DATASET);
-  if (current_dset == NULL ) {
-    /* there is no dataset hash currently assigned, so use the one for the current rank */
-    kvtree_set(list_hash, SCR_SUMMARY_6_KEY_DATASET, rank_dset);
-  } else {
-    /* TODODSET */
-    /* check that the dataset for this rank matches the one we already have */
-    /* if rank_dset != current_dset, then problem */
-    scr_dataset_delete(&rank_dset);
-  }
-#endif
-
   /* lookup rank hash for this rank */
   kvtree* rank_hash = kvtree_set_kv_int(rank2file_hash, SCR_SUMMARY_6_KEY_RANK, rank_id);
 
   /* set number of expected files for this rank */
-  int num_expect = scr_filemap_num_files(rank_map);
+  int num_expect = scr_filemap_view_num_files(rank_map);
   kvtree_set_kv_int(rank_hash, SCR_SUMMARY_6_KEY_FILES, num_expect);
 
   /* TODO: check that we have each named file for this rank */
-  kvtree_elem* file_elem = NULL;
-  for (file_elem = scr_filemap_first_file(rank_map);
-       file_elem != NULL;
-       file_elem = kvtree_elem_next(file_elem))
-  {
-    /* get the file name (relative to dir) */
-    char* cache_file_name = kvtree_elem_key(file_elem);
-
+  int index;
+  for (index = 0; index < num_expect; index++) {
     /* get meta data for this file */
-    scr_meta* meta = scr_meta_new();
-    if (scr_filemap_get_meta(rank_map, cache_file_name, meta) != SCR_SUCCESS) {
-      scr_err("Failed to read meta data for %s from dataset %d @ %s:%d",
-        cache_file_name, dset_id, __FILE__, __LINE__
+    scr_filemap_record rec;
+    if (scr_filemap_view_get(rank_map, index, &rec) != SCR_SUCCESS) {
+      scr_err("Failed to read meta data for file %d from dataset %d @ %s:%d",
+        index, dset_id, __FILE__, __LINE__
       );
       continue;
     }
 
+    /* get the file name (relative to dir) */
+    const char* cache_file_name = rec.file;
+
     /* get path to file build the full file name */
-    char* meta_path;
-    if (scr_meta_get_origpath(meta, &meta_path) != SCR_SUCCESS) {
+    if (rec.origpath == NULL) {
       scr_err("Reading path from meta data from %s @ %s:%d",
         cache_file_name, __FILE__, __LINE__
       );
-      scr_meta_delete(&meta);
       continue;
     }
 
     /* get name of file */
-    char* meta_name;
-    if (scr_meta_get_origname(meta, &meta_name) != SCR_SUCCESS) {
+    if (rec.origname == NULL) {
       scr_err("Reading path from meta data from %s @ %s:%d",
         cache_file_name, __FILE__, __LINE__
       );
-      scr_meta_delete(&meta);
       continue;
     }
 
     /* build the full file name */
-    spath* path_full_filename = spath_from_str(meta_path);
-    spath_append_str(path_full_filename, meta_name);
+    spath* path_full_filename = spath_from_str(rec.origpath);
+    spath_append_str(path_full_filename, rec.origname);
     char* full_filename = spath_strdup(path_full_filename);
 
     /* compute path to file relative to prefix (for rank2file) */
@@ -1081,42 +1188,27 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
      *   check that ranks agree
      *   check that checkpoint id agrees */
 
-#if 0
-    /* read the rank from the meta data */
-    int meta_rank = -1;
-    if (scr_meta_get_rank(meta, &meta_rank) != SCR_SUCCESS) {
-      scr_err("Reading rank from meta data from %s @ %s:%d",
-        full_filename, __FILE__, __LINE__
-      );
-      scr_meta_delete(&meta);
-      scr_free(&full_filename);
-      continue;
-    }
-#endif
-
     /* read the ranks from the meta data */
-    int meta_ranks = -1;
-    if (scr_meta_get_ranks(meta, &meta_ranks) != SCR_SUCCESS) {
+    int meta_ranks = rec.ranks;
+    if (meta_ranks == -1) {
       scr_err("Reading ranks from meta data from %s @ %s:%d",
         full_filename, __FILE__, __LINE__
       );
-      scr_meta_delete(&meta);
       scr_free(&relative_filename);
       scr_free(&full_filename);
       continue;
     }
 
     /* read filesize from meta data */
-    unsigned long meta_filesize = 0;
-    if (scr_meta_get_filesize(meta, &meta_filesize) != SCR_SUCCESS) {
+    if (! rec.have_filesize) {
       scr_err("Reading filesize from meta data from %s @ %s:%d",
         full_filename, __FILE__, __LINE__
       );
-      scr_meta_delete(&meta);
       scr_free(&relative_filename);
       scr_free(&full_filename);
       continue;
     }
+    unsigned long meta_filesize = rec.filesize;
 
     /* set our ranks if it's not been set */
     if (*ranks == -1) {
@@ -1126,11 +1218,10 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
     /* TODO: need to check directories on all of these file names */
 
     /* check that the file is complete */
-    if (scr_meta_is_complete(meta) != SCR_SUCCESS) {
+    if (! rec.complete) {
       scr_err("File is not complete: %s @ %s:%d",
         full_filename, __FILE__, __LINE__
       );
-      scr_meta_delete(&meta);
       scr_free(&relative_filename);
       scr_free(&full_filename);
       continue;
@@ -1141,7 +1232,6 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
       scr_err("File does not exist: %s @ %s:%d",
         full_filename, __FILE__, __LINE__
       );
-      scr_meta_delete(&meta);
       scr_free(&relative_filename);
       scr_free(&full_filename);
       continue;
@@ -1153,7 +1243,6 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
       scr_err("File is %lu bytes but expected to be %lu bytes: %s @ %s:%d",
         size, meta_filesize, full_filename, __FILE__, __LINE__
       );
-      scr_meta_delete(&meta);
       scr_free(&relative_filename);
       scr_free(&full_filename);
       continue;
@@ -1164,7 +1253,6 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
       scr_err("File was created with %d ranks, but expected %d ranks: %s @ %s:%d",
         meta_ranks, *ranks, full_filename, __FILE__, __LINE__
       );
-      scr_meta_delete(&meta);
       scr_free(&relative_filename);
       scr_free(&full_filename);
       continue;
@@ -1182,26 +1270,20 @@ int scr_scan_filemap(const spath* path_prefix, const spath* path_filemap, int ds
      *         <rank>
      *           FILE
      *             <filename_relative_to_prefix> */
-    /* TODODSET: rank2file_hash may not exist yet */
-    kvtree* list_hash = kvtree_set_kv_int(scan, SCR_SCAN_KEY_DLIST, dset_id);
-    //kvtree_setf(list_hash, NULL, "%s %s %s", SCR_SCAN_KEY_MAP, cache_file_name, full_filename);
-    kvtree* rank2file_hash = kvtree_get(list_hash, SCR_SUMMARY_6_KEY_RANK2FILE);
     kvtree_set_kv_int(rank2file_hash, SCR_SUMMARY_6_KEY_RANKS, meta_ranks);
-    kvtree* rank_hash = kvtree_set_kv_int(rank2file_hash, SCR_SUMMARY_6_KEY_RANK, rank_id);
     kvtree_set_kv(rank_hash, SCR_SUMMARY_6_KEY_FILE, relative_filename);
 
-    uLong meta_crc;
-    if (scr_meta_get_crc32(meta, &meta_crc) == SCR_SUCCESS) {
-      //kvtree_util_set_crc32(file_hash, SCR_SUMMARY_6_KEY_CRC, meta_crc);
-    }
-
-    scr_meta_delete(&meta);
     scr_free(&relative_filename);
     scr_free(&full_filename);
   }
 
-  /* delete the filemap */
-  scr_filemap_delete(&rank_map);
+  /* hand the filemap to the cache so a rebuild need not read it again,
+   * otherwise close it */
+  if (cache != NULL) {
+    scr_rebuild_cache_add(cache, rank_id, &rank_map);
+  } else {
+    scr_filemap_view_close(&rank_map);
+  }
 
   return SCR_SUCCESS;
 }
@@ -1251,276 +1333,208 @@ int scr_scan_redset(
   return rc;
 }
 
-/* returns 1 if name matches "filemap_<rank>" regex and extracts rank value,
- * returns 0 if no match */
-int match_filemap(const char* name, const regex_t* re, int* rank)
-{
-  /* assume we don't match */
-  int rc = 0;
+/* types of files we look for in a dataset directory */
+#define SCR_SCAN_NAME_NONE    (0)
+#define SCR_SCAN_NAME_FILEMAP (1)
+#define SCR_SCAN_NAME_REDSET  (2)
+
+/* values extracted from the name of a file in a dataset directory */
+struct scr_scan_name {
+  int type;             /* one of the SCR_SCAN_NAME_* values */
+  const char* keyname;  /* scan key to record a redset file under */
+  int rank;             /* rank that wrote the file */
+  int group_id;         /* id of redundancy set */
+  int group_num;        /* number of redundancy sets */
+  int group_rank;       /* rank within redundancy set */
+  int group_size;       /* size of redundancy set */
+};
 
-  /* check whether the regex matches */
-  size_t nmatch = 2;
-  regmatch_t pmatch[nmatch];
-  if (regexec(re, name, nmatch, pmatch, 0) == 0) {
-    /* made a match, now extract the rank value */
-    char* value = strndup(name + pmatch[1].rm_so, (size_t)(pmatch[1].rm_eo - pmatch[1].rm_so));
-    if (value != NULL) {
-      /* got the rank as a string */
-      rc = 1;
-      *rank = atoi(value);
-      scr_free(&value);
-    }
+/* if str starts with prefix, advance str past prefix and return 1,
+ * otherwise return 0 */
+static int scr_scan_token_str(const char** str, const char* prefix)
+{
+  size_t len = strlen(prefix);
+  if (strncmp(*str, prefix, len) == 0) {
+    *str += len;
+    return 1;
   }
-
-  return rc;
+  return 0;
 }
 
-/* returns 1 if name matches partner regex and extracts rank and partner rank,
- * returns 0 if no match */
-int match_partner(
-  const char* name,
-  const regex_t* re,
-  int* rank,
-  int* group_id,
-  int* group_num,
-  int* group_rank,
-  int* group_size)
+/* if str starts with a decimal integer, advance str past it,
+ * set value, and return 1, otherwise return 0 */
+static int scr_scan_token_int(const char** str, int* value)
 {
-  /* assume we don't match */
-  int rc = 0;
-
-  /* if the file is an partner file, read in the partner parameters */
-  size_t nmatch = 6;
-  regmatch_t pmatch[nmatch];
-  if (regexec(re, name, nmatch, pmatch, 0) == 0) {
-    /* got a match */
-    rc = 1;
-
-    /* intialize output variables */
-    *rank       = -1;
-    *group_id   = -1;
-    *group_num  = -1;
-    *group_rank = -1;
-    *group_size = -1;
-
-    /* get our global rank */
-    char* value = strndup(name + pmatch[1].rm_so, (size_t)(pmatch[1].rm_eo - pmatch[1].rm_so));
-    if (value != NULL) {
-      *rank = atoi(value);
-      scr_free(&value);
-    }
-
-    /* get our group_id */
-    value = strndup(name + pmatch[2].rm_so, (size_t)(pmatch[2].rm_eo - pmatch[2].rm_so));
-    if (value != NULL) {
-      *group_id = atoi(value);
-      scr_free(&value);
-    }
-
-    /* get the number of groups */
-    value = strndup(name + pmatch[3].rm_so, (size_t)(pmatch[3].rm_eo - pmatch[3].rm_so));
-    if (value != NULL) {
-      *group_num = atoi(value);
-      scr_free(&value);
-    }
-
-    /* get the rank */
-    value = strndup(name + pmatch[4].rm_so, (size_t)(pmatch[4].rm_eo - pmatch[4].rm_so));
-    if (value != NULL) {
-      *group_rank = atoi(value);
-      scr_free(&value);
-    }
-
-    /* get the rank of our right partner */
-    value = strndup(name + pmatch[5].rm_so, (size_t)(pmatch[5].rm_eo - pmatch[5].rm_so));
-    if (value != NULL) {
-      *group_size = atoi(value);
-      scr_free(&value);
-    }
+  const char* p = *str;
+  int val = 0;
+  while (*p >= '0' && *p <= '9') {
+    val = val * 10 + (*p - '0');
+    p++;
   }
-
-  return rc;
+  if (p == *str) {
+    return 0;
+  }
+  *value = val;
+  *str = p;
+  return 1;
 }
 
-/* returns 1 if name matches XOR regex and extracts rank, group, group size, and group rank,
- w returns 0 if no match */
-int match_xor(
-  const char* name,
-  const regex_t* re,
-  int* rank,
-  int* group_id,
-  int* group_num,
-  int* group_rank,
-  int* group_size)
+/* identify a file in the dataset directory by its name in a single pass
+ * and extract the values encoded in the name, names have the form:
+ *   filemap_<rank>
+ *   reddesc.er.<rank>.<scheme>.grp_<id>_of_<num>.mem_<rank>_of_<size>.redset
+ *   reddescmap.er.<rank>.<scheme>.grp_<id>_of_<num>.mem_<rank>_of_<size>.redset
+ * where scheme is one of partner, xor, or rs,
+ * returns the type of file, which is SCR_SCAN_NAME_NONE if it matches no form */
+static int scr_scan_parse_name(const char* name, struct scr_scan_name* n)
 {
-  /* assume we don't match */
-  int rc = 0;
-
-  /* if the file is an XOR file, read in the XOR set parameters */
-  size_t nmatch = 6;
-  regmatch_t pmatch[nmatch];
-  if (regexec(re, name, nmatch, pmatch, 0) == 0) {
-    /* got a match */
-    rc = 1;
-
-    /* intialize output variables */
-    *rank       = -1;
-    *group_id   = -1;
-    *group_num  = -1;
-    *group_rank = -1;
-    *group_size = -1;
-
-    /* get the rank of the xor set */
-    char* value = strndup(name + pmatch[1].rm_so, (size_t)(pmatch[1].rm_eo - pmatch[1].rm_so));
-    if (value != NULL) {
-      *rank = atoi(value);
-      scr_free(&value);
-    }
+  const char* p = name;
+
+  n->type       = SCR_SCAN_NAME_NONE;
+  n->keyname    = NULL;
+  n->rank       = -1;
+  n->group_id   = -1;
+  n->group_num  = -1;
+  n->group_rank = -1;
+  n->group_size = -1;
+
+  /* filemap files */
+  if (scr_scan_token_str(&p, "filemap_")) {
+    if (scr_scan_token_int(&p, &n->rank) && *p == '\0') {
+      n->type = SCR_SCAN_NAME_FILEMAP;
+    }
+    return n->type;
+  }
 
-    /* get the id of the xor set */
-    value = strndup(name + pmatch[2].rm_so, (size_t)(pmatch[2].rm_eo - pmatch[2].rm_so));
-    if (value != NULL) {
-      *group_id = atoi(value);
-      scr_free(&value);
-    }
+  /* redundancy files, either for filemaps or for user data files */
+  int map;
+  if (scr_scan_token_str(&p, "reddescmap.er.")) {
+    map = 1;
+  } else if (scr_scan_token_str(&p, "reddesc.er.")) {
+    map = 0;
+  } else {
+    return n->type;
+  }
 
-    /* get the number of xor sets */
-    value = strndup(name + pmatch[3].rm_so, (size_t)(pmatch[3].rm_eo - pmatch[3].rm_so));
-    if (value != NULL) {
-      *group_num = atoi(value);
-      scr_free(&value);
-    }
+  if (! scr_scan_token_int(&p, &n->rank) ||
+      ! scr_scan_token_str(&p, "."))
+  {
+    return n->type;
+  }
 
-    /* get the rank in the xor set */
-    value = strndup(name + pmatch[4].rm_so, (size_t)(pmatch[4].rm_eo - pmatch[4].rm_so));
-    if (value != NULL) {
-      *group_rank = atoi(value);
-      scr_free(&value);
-    }
+  /* redundancy scheme */
+  if (scr_scan_token_str(&p, "partner.")) {
+    n->keyname = map ? SCR_SCAN_KEY_MAPPARTNER : SCR_SCAN_KEY_PARTNER;
+  } else if (scr_scan_token_str(&p, "xor.")) {
+    n->keyname = map ? SCR_SCAN_KEY_MAPXOR : SCR_SCAN_KEY_XOR;
+  } else if (scr_scan_token_str(&p, "rs.")) {
+    n->keyname = map ? SCR_SCAN_KEY_MAPRS : SCR_SCAN_KEY_RS;
+  } else {
+    return n->type;
+  }
 
-    /* get the size of the xor set */
-    value = strndup(name + pmatch[5].rm_so, (size_t)(pmatch[5].rm_eo - pmatch[5].rm_so));
-    if (value != NULL) {
-      *group_size = atoi(value);
-      scr_free(&value);
-    }
+  /* redundancy set and our place in it */
+  if (scr_scan_token_str(&p, "grp_") &&
+      scr_scan_token_int(&p, &n->group_id) &&
+      scr_scan_token_str(&p, "_of_") &&
+      scr_scan_token_int(&p, &n->group_num) &&
+      scr_scan_token_str(&p, ".mem_") &&
+      scr_scan_token_int(&p, &n->group_rank) &&
+      scr_scan_token_str(&p, "_of_") &&
+      scr_scan_token_int(&p, &n->group_size) &&
+      scr_scan_token_str(&p, ".redset") &&
+      *p == '\0')
+  {
+    n->type = SCR_SCAN_NAME_REDSET;
   }
 
-  return rc;
+  return n->type;
 }
 
-/* returns 1 if name matches XOR regex and extracts rank, group, group size, and group rank,
- * returns 0 if no match */
-int match_rs(
-  const char* name,
-  const regex_t* re,
-  int* rank,
-  int* group_id,
-  int* group_num,
-  int* group_rank,
-  int* group_size)
-{
-  /* assume we don't match */
-  int rc = 0;
+/* a filemap found in the dataset directory and the result of scanning it */
+struct scr_scan_item {
+  char* name;   /* name of filemap file */
+  int rank;     /* rank that filemap belongs to */
+  kvtree* scan; /* scan results for this filemap */
+  int rc;       /* return code from scanning filemap */
+};
 
-  /* if the file is an RS file, read in the RS set parameters */
-  size_t nmatch = 6;
-  regmatch_t pmatch[nmatch];
-  if (regexec(re, name, nmatch, pmatch, 0) == 0) {
-    /* got a match */
-    rc = 1;
+/* state shared by threads scanning a list of filemaps */
+struct scr_scan_pool {
+  const spath* prefix;         /* prefix directory */
+  const spath* dir;            /* dataset directory */
+  int dset_id;                 /* dataset id */
+  scr_rebuild_cache* cache;    /* cache to keep filemaps in, may be NULL */
+  struct scr_scan_item* list;  /* list of filemaps to scan */
+  int count;                   /* number of filemaps in list */
+  int next;                    /* index of next filemap to scan */
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t lock;        /* protects next */
+#endif
+};
 
-    /* intialize output variables */
-    *rank       = -1;
-    *group_id   = -1;
-    *group_num  = -1;
-    *group_rank = -1;
-    *group_size = -1;
-
-    /* get the rank of the xor set */
-    char* value = strndup(name + pmatch[1].rm_so, (size_t)(pmatch[1].rm_eo - pmatch[1].rm_so));
-    if (value != NULL) {
-      *rank = atoi(value);
-      scr_free(&value);
-    }
+/* scan filemaps from the pool until none are left, each filemap
+ * is scanned into its own hash, which is merged in later */
+static void* scr_scan_worker(void* arg)
+{
+  struct scr_scan_pool* pool = (struct scr_scan_pool*) arg;
 
-    /* get the id of the xor set */
-    value = strndup(name + pmatch[2].rm_so, (size_t)(pmatch[2].rm_eo - pmatch[2].rm_so));
-    if (value != NULL) {
-      *group_id = atoi(value);
-      scr_free(&value);
+  while (1) {
+    /* get the next filemap to scan */
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&pool->lock);
+#endif
+    int i = pool->next;
+    if (i < pool->count) {
+      pool->next++;
     }
+#ifdef HAVE_PTHREADS
+    pthread_mutex_unlock(&pool->lock);
+#endif
 
-    /* get the number of xor sets */
-    value = strndup(name + pmatch[3].rm_so, (size_t)(pmatch[3].rm_eo - pmatch[3].rm_so));
-    if (value != NULL) {
-      *group_num = atoi(value);
-      scr_free(&value);
+    /* stop when there is no more work */
+    if (i >= pool->count) {
+      break;
     }
 
-    /* get the rank in the xor set */
-    value = strndup(name + pmatch[4].rm_so, (size_t)(pmatch[4].rm_eo - pmatch[4].rm_so));
-    if (value != NULL) {
-      *group_rank = atoi(value);
-      scr_free(&value);
-    }
+    struct scr_scan_item* item = &pool->list[i];
 
-    /* get the size of the xor set */
-    value = strndup(name + pmatch[5].rm_so, (size_t)(pmatch[5].rm_eo - pmatch[5].rm_so));
-    if (value != NULL) {
-      *group_size = atoi(value);
-      scr_free(&value);
-    }
+    /* create a full path of the file name */
+    spath* filemap_path = spath_dup(pool->dir);
+    spath_append_str(filemap_path, item->name);
+
+    /* read file contents into the scan hash for this filemap,
+     * a mismatch in the number of ranks across filemaps shows up
+     * as multiple RANKS values once the hashes are merged */
+    int ranks = -1;
+    item->scan = kvtree_new();
+    item->rc = scr_scan_filemap(pool->prefix, filemap_path, pool->dset_id,
+      item->rank, &ranks, item->scan, pool->cache
+    );
+
+    spath_delete(&filemap_path);
   }
 
-  return rc;
+  return NULL;
 }
 
-/* Reads fmap files from given dataset directory and adds them to scan hash.
+/* Reads fmap files from given dataset directory and adds them to scan hash,
+ * keeps the filemaps that were read in cache if it is not NULL.
  * Returns SCR_SUCCESS if the files could be scanned */
-int scr_scan_files(const spath* prefix, const spath* dir, int dset_id, kvtree* scan)
+int scr_scan_files(const spath* prefix, const spath* dir, int dset_id, kvtree* scan, scr_rebuild_cache* cache)
 {
   int rc = SCR_SUCCESS;
 
   /* get dataset info from flush file */
   scr_scan_flush(prefix, dset_id, scan);
 
-  /* create path to scr subdirectory */
-  spath* meta_path = spath_dup(dir);
-
   /* allocate directory in string form */
-  char* dir_str = spath_strdup(meta_path);
-
-  /* regex to identify filemap files and extract rank from filename */
-  regex_t re_filemap_file;
-  regcomp(&re_filemap_file, "filemap_([0-9]+)", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the partner set information from a file */
-  regex_t re_partner_file;
-  regcomp(&re_partner_file, "reddesc.er.([0-9]+).partner.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the partner set information for filemaps */
-  regex_t re_mappartner_file;
-  regcomp(&re_mappartner_file, "reddescmap.er.([0-9]+).partner.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the xor set information from a file */
-  regex_t re_xor_file;
-  regcomp(&re_xor_file, "reddesc.er.([0-9]+).xor.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the xor set information for filemaps */
-  regex_t re_mapxor_file;
-  regcomp(&re_mapxor_file, "reddescmap.er.([0-9]+).xor.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the rs set information from a file */
-  regex_t re_rs_file;
-  regcomp(&re_rs_file, "reddesc.er.([0-9]+).rs.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
-
-  /* set up a regular expression so we can extract the rs set information for filemaps */
-  regex_t re_maprs_file;
-  regcomp(&re_maprs_file, "reddescmap.er.([0-9]+).rs.grp_([0-9]+)_of_([0-9]+).mem_([0-9]+)_of_([0-9]+).redset", REG_EXTENDED);
+  char* dir_str = spath_strdup(dir);
 
-  /* function to track ranks value across a set of files to be scanned */
-  int ranks = -1;
+  /* list of filemaps to be scanned once we've read the directory */
+  int items_count = 0;
+  int items_max   = 0;
+  struct scr_scan_item* items = NULL;
 
   /* open the directory */
   DIR* dirp = opendir(dir_str);
@@ -1528,13 +1542,14 @@ int scr_scan_files(const spath* prefix, const spath* dir, int dset_id, kvtree* s
     scr_err("Failed to open directory %s (errno=%d %s) @ %s:%d",
       dir_str, errno, strerror(errno), __FILE__, __LINE__
     );
-    rc = SCR_FAILURE;
-    goto cleanup;
+    scr_free(&dir_str);
+    return SCR_FAILURE;
   }
 
-  /* read each file from the directory */
+  /* read each file from the directory, redundancy files are recorded
+   * directly from their names, while filemaps are set aside to be read
+   * in parallel below */
   struct dirent* dp = NULL;
-  int rank, group_id, group_num, group_rank, group_size;
   do {
     errno = 0;
     dp = readdir(dirp);
@@ -1551,72 +1566,35 @@ int scr_scan_files(const spath* prefix, const spath* dir, int dset_id, kvtree* s
         name = dp->d_name;
       #endif
 
-      /* we only process fmap files */
-      if (name != NULL) {
-        if (match_filemap(name, &re_filemap_file, &rank)) {
-          /* create a full path of the file name */
-          spath* filemap_path = spath_dup(meta_path);
-          spath_append_str(filemap_path, name);
-
-          /* read file contents into our scan hash */
-          int tmp_rc = scr_scan_filemap(prefix, filemap_path, dset_id, rank, &ranks, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            spath_delete(&filemap_path);
-            break;
-          }
+      /* we only process filemap and redundancy files */
+      struct scr_scan_name n;
+      if (name == NULL || scr_scan_parse_name(name, &n) == SCR_SCAN_NAME_NONE) {
+        continue;
+      }
 
-          /* delete the path */
-          spath_delete(&filemap_path);
-        } else if (match_partner(name, &re_partner_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for XOR file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_PARTNER;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_partner(name, &re_mappartner_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for XOR file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_MAPPARTNER;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_xor(name, &re_xor_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for XOR file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_XOR;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_xor(name, &re_mapxor_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for XOR file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_MAPXOR;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_rs(name, &re_rs_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for RS file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_RS;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
-          }
-        } else if (match_rs(name, &re_maprs_file, &rank, &group_id, &group_num, &group_rank, &group_size)) {
-          /* add info for RS file to our scan hash */
-          const char* keyname = SCR_SCAN_KEY_MAPRS;
-          int tmp_rc = scr_scan_redset(name, dset_id, keyname, rank, group_id, group_num, group_rank, group_size, scan);
-          if (tmp_rc != SCR_SUCCESS) {
-            rc = tmp_rc;
-            break;
+      if (n.type == SCR_SCAN_NAME_FILEMAP) {
+        /* add filemap to our list, growing the list as needed */
+        if (items_count == items_max) {
+          items_max = (items_max > 0) ? 2 * items_max : 1024;
+          items = (struct scr_scan_item*) realloc(items, items_max * sizeof(struct scr_scan_item));
+          if (items == NULL) {
+            scr_abort(-1, "Failed to allocate list of filemaps @ %s:%d",
+              __FILE__, __LINE__
+            );
           }
         }
+        items[items_count].name = strdup(name);
+        items[items_count].rank = n.rank;
+        items[items_count].scan = NULL;
+        items[items_count].rc   = SCR_FAILURE;
+        items_count++;
+      } else {
+        /* add info for redundancy file to our scan hash */
+        int tmp_rc = scr_scan_redset(name, dset_id, n.keyname, n.rank, n.group_id, n.group_num, n.group_rank, n.group_size, scan);
+        if (tmp_rc != SCR_SUCCESS) {
+          rc = tmp_rc;
+          break;
+        }
       }
     } else {
       if (errno != 0) {
@@ -1637,22 +1615,50 @@ int scr_scan_files(const spath* prefix, const spath* dir, int dset_id, kvtree* s
     rc = SCR_FAILURE;
   }
 
-cleanup:
-  /* free the xor regular expression */
-  regfree(&re_filemap_file);
-  regfree(&re_partner_file);
-  regfree(&re_mappartner_file);
-  regfree(&re_xor_file);
-  regfree(&re_mapxor_file);
-  regfree(&re_rs_file);
-  regfree(&re_maprs_file);
+  /* read and check the filemaps */
+  if (rc == SCR_SUCCESS && items_count > 0) {
+    struct scr_scan_pool pool;
+    pool.prefix  = prefix;
+    pool.dir     = dir;
+    pool.dset_id = dset_id;
+    pool.cache   = cache;
+    pool.list    = items;
+    pool.count   = items_count;
+    pool.next    = 0;
+
+    /* start our worker threads, the main thread scans too,
+     * without threads, we scan each filemap in turn */
+#ifdef HAVE_PTHREADS
+    pthread_mutex_init(&pool.lock, NULL);
+#endif
+    int jobs = scr_index_jobs_for(items_count);
+    scr_workers_run(jobs, scr_scan_worker, (void*) &pool, 0);
+#ifdef HAVE_PTHREADS
+    pthread_mutex_destroy(&pool.lock);
+#endif
+
+    /* merge results into our scan hash */
+    int i;
+    for (i = 0; i < items_count; i++) {
+      if (items[i].rc == SCR_SUCCESS) {
+        kvtree_merge(scan, items[i].scan);
+      } else {
+        rc = SCR_FAILURE;
+      }
+    }
+  }
+
+  /* free the list of filemaps */
+  int i;
+  for (i = 0; i < items_count; i++) {
+    scr_free(&items[i].name);
+    kvtree_delete(&items[i].scan);
+  }
+  scr_free(&items);
 
   /* free our directory string */
   scr_free(&dir_str);
 
-  /* delete scr path */
-  spath_delete(&meta_path);
-
   return rc;
 }
 
@@ -1674,24 +1680,30 @@ int scr_summary_build(const spath* prefix, const spath* dir, int id)
     /* create a new hash to store our scan results */
     kvtree* scan = kvtree_new();
 
+    /* keep the filemaps we read during the scan in case we need to rebuild */
+    scr_rebuild_cache* cache = scr_rebuild_cache_new();
+
     /* scan the files in the given directory */
-    scr_scan_files(prefix, dir, id, scan);
+    scr_scan_files(prefix, dir, id, scan, cache);
 
     /* determine whether we are missing any files */
     if (scr_inspect_scan(scan) != SCR_SUCCESS) {
       /* missing some files, see if we can rebuild them */
-      if (scr_rebuild_scan(prefix, dir, scan) == SCR_SUCCESS) {
+      if (scr_rebuild_scan(prefix, dir, scan, cache) == SCR_SUCCESS) {
         /* the rebuild succeeded, clear our scan hash */
         kvtree_unset_all(scan);
 
         /* rescan the files */
-        scr_scan_files(prefix, dir, id, scan);
+        scr_scan_files(prefix, dir, id, scan, NULL);
 
         /* reinspect the files */
         scr_inspect_scan(scan);
       }
     }
 
+    /* done with the filemaps */
+    scr_rebuild_cache_delete(&cache);
+
     /* build summary:
      *   should only have one dataset
      *   remove BUILD, MISSING, UNRECOVERABLE, INVALID, XOR
@@ -1907,6 +1919,18 @@ int index_drop(const spath* prefix, const char* name)
     goto cleanup;
   }
 
+  /* refuse to drop a dataset whose files a newer dataset needs */
+  int id;
+  if (scr_index_get_id_by_name(index, name, &id) == SCR_SUCCESS &&
+      scr_index_is_base(index, id))
+  {
+    scr_err("Named dataset holds base files of a newer dataset: %s @ %s:%d",
+      name, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+    goto cleanup;
+  }
+
   /* remove dataset from index */
   if (scr_index_remove(index, name) == SCR_SUCCESS) {
     /* write out new index file */
@@ -2266,6 +2290,7 @@ int print_usage()
   printf("        --drop-after=<name> Drop all datasets after <name> from index (does not delete files)\n");
   printf("    -c, --current=<name>    Set <name> as current restart dataset\n");
   printf("    -p, --prefix=<dir>      Specify prefix directory (defaults to current working directory)\n");
+  printf("    -j, --jobs=<n>          Run at most <n> scan threads or rebuild processes at a time (defaults to number of cores)\n");
   printf("    -h, --help              Print usage\n");
   printf("\n");
   return SCR_SUCCESS;
@@ -2281,6 +2306,7 @@ struct arglist {
   int drop;
   int drop_after;
   int current;
+  int jobs;
 };
 
 /* free any memory allocation during get_args */
@@ -2303,8 +2329,9 @@ int get_args(int argc, char **argv, struct arglist* args)
   args->drop       = 0;
   args->drop_after = 0;
   args->current    = 0;
+  args->jobs       = 0;
 
-  static const char *opt_string = "lb:a:d:p:h";
+  static const char *opt_string = "lb:a:d:p:j:h";
   static struct option long_options[] = {
     {"list",       no_argument,       NULL, 'l'},
     {"build",      required_argument, NULL, 'b'},
@@ -2313,6 +2340,7 @@ int get_args(int argc, char **argv, struct arglist* args)
     {"drop-after", required_argument, NULL, 'z'},
     {"current",    required_argument, NULL, 'c'},
     {"prefix",     required_argument, NULL, 'p'},
+    {"jobs",       required_argument, NULL, 'j'},
     {"help",       no_argument,       NULL, 'h'},
     {NULL,         no_argument,       NULL,   0}
   };
@@ -2352,6 +2380,13 @@ int get_args(int argc, char **argv, struct arglist* args)
       case 'p':
         args->prefix = spath_from_str(optarg);
         break;
+      case 'j':
+        args->jobs = atoi(optarg);
+        if (args->jobs <= 0) {
+          scr_err("Number of jobs must be positive: --jobs %s", optarg);
+          return SCR_FAILURE;
+        }
+        break;
       case 'h':
         return SCR_FAILURE;
       default:
@@ -2392,6 +2427,9 @@ int main(int argc, char *argv[])
     return 1;
   }
 
+  /* limit the number of threads we scan and rebuild with */
+  scr_index_jobs = args.jobs;
+
   /* get references to prefix and subdirectory paths */
   spath* prefix = args.prefix;
   char* name = args.name;
@@ -42,6 +42,10 @@
 #include <unistd.h>
 #include <libgen.h>
 
+/* crc32 of journal records */
+#include <stdint.h>
+#include <zlib.h>
+
 #define SCR_INDEX_FILENAME "index.scr"
 
 /* Example contents of an index file:
@@ -129,6 +133,501 @@
  *          1
  */
 
+/* The index file is rewritten in full only occasionally.  In between,
+ * each call to scr_index_write appends just the entries that changed
+ * to a journal file, and scr_index_read replays the journal on top of
+ * the index file.  Each journal record is a kvtree of the form:
+ *
+ *  SET
+ *    <top-level key, e.g., DSET>
+ *      <value, e.g., 6>
+ *        <full contents of this entry, which replaces any existing entry>
+ *  UNSET
+ *    <top-level key>
+ *      <value of entry to be removed>
+ *
+ * stored in the file as an 8-byte length and 4-byte crc32 of the packed
+ * kvtree, both big-endian, followed by the packed kvtree itself.
+ * Replaying a record more than once has no further effect, so a journal
+ * left behind after its contents were compacted into the index file
+ * does no harm. */
+
+#define SCR_INDEX_JOURNAL_FILENAME "index.scr.journal"
+#define SCR_INDEX_JOURNAL_KEY_SET   "SET"
+#define SCR_INDEX_JOURNAL_KEY_UNSET "UNSET"
+#define SCR_INDEX_JOURNAL_HEADER (12)
+
+/* what we know about the index in the prefix directory we last read or wrote */
+struct scr_index_journal {
+  char* dir;           /* prefix directory */
+  kvtree* state;       /* contents of the index as of our last read or write */
+  int records;         /* number of records in the journal file */
+  off_t base_size;     /* size of the index file */
+  time_t base_mtime;   /* modification time of the index file */
+  ino_t base_ino;      /* inode of the index file */
+  off_t journal_size;  /* size of the journal file, -1 if there is none */
+};
+
+static struct scr_index_journal scr_index_journal = {NULL, NULL, 0, -1, 0, 0, -1};
+
+/* number of records to append to the journal before the index file is rewritten */
+static int scr_index_journal_max = SCR_INDEX_JOURNAL_RECORDS;
+
+/* set the number of records to append to the journal before the index file
+ * is rewritten, 0 rewrites the index file on every write */
+void scr_index_set_journal_records(int records)
+{
+  scr_index_journal_max = (records > 0) ? records : 0;
+}
+
+/* dataset ids of the index we last searched, sorted in ascending order,
+ * kept up to date as datasets are added to and removed from that index */
+struct scr_index_ids {
+  const kvtree* index; /* index the list belongs to */
+  const kvtree* dsets; /* DSET hash of that index when the list was last updated */
+  int count;           /* number of ids in the list */
+  int capacity;        /* number of ids the list has room for */
+  int* ids;            /* sorted list of ids */
+};
+
+static struct scr_index_ids scr_index_ids = {NULL, NULL, 0, 0, NULL};
+
+/* drop the sorted list of dataset ids */
+static void scr_index_ids_forget(void)
+{
+  scr_free(&scr_index_ids.ids);
+  scr_index_ids.index    = NULL;
+  scr_index_ids.dsets    = NULL;
+  scr_index_ids.count    = 0;
+  scr_index_ids.capacity = 0;
+}
+
+/* return position of id in the sorted list, or where it would be inserted */
+static int scr_index_ids_search(int id)
+{
+  int low  = 0;
+  int high = scr_index_ids.count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (scr_index_ids.ids[mid] < id) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/* add id to the sorted list after it has been added to the given index */
+static void scr_index_ids_add(const kvtree* index, int id)
+{
+  if (scr_index_ids.index != index) {
+    return;
+  }
+
+  int pos = scr_index_ids_search(id);
+  if (pos == scr_index_ids.count || scr_index_ids.ids[pos] != id) {
+    if (scr_index_ids.count == scr_index_ids.capacity) {
+      int capacity = (scr_index_ids.capacity > 0) ? 2 * scr_index_ids.capacity : 16;
+      int* ids = (int*) SCR_MALLOC(capacity * sizeof(int));
+      if (scr_index_ids.count > 0) {
+        memcpy(ids, scr_index_ids.ids, scr_index_ids.count * sizeof(int));
+      }
+      scr_free(&scr_index_ids.ids);
+      scr_index_ids.ids      = ids;
+      scr_index_ids.capacity = capacity;
+    }
+    memmove(&scr_index_ids.ids[pos + 1], &scr_index_ids.ids[pos],
+      (scr_index_ids.count - pos) * sizeof(int)
+    );
+    scr_index_ids.ids[pos] = id;
+    scr_index_ids.count++;
+  }
+
+  scr_index_ids.dsets = kvtree_get(index, SCR_INDEX_1_KEY_DATASET);
+}
+
+/* remove id from the sorted list after it has been removed from the given index */
+static void scr_index_ids_remove(const kvtree* index, int id)
+{
+  if (scr_index_ids.index != index) {
+    return;
+  }
+
+  int pos = scr_index_ids_search(id);
+  if (pos < scr_index_ids.count && scr_index_ids.ids[pos] == id) {
+    memmove(&scr_index_ids.ids[pos], &scr_index_ids.ids[pos + 1],
+      (scr_index_ids.count - pos - 1) * sizeof(int)
+    );
+    scr_index_ids.count--;
+  }
+
+  scr_index_ids.dsets = kvtree_get(index, SCR_INDEX_1_KEY_DATASET);
+}
+
+/* build path to a file in the .scr directory of the given prefix directory */
+static char* scr_index_file_path(const spath* dir, const char* name)
+{
+  spath* path = spath_dup(dir);
+  spath_append_str(path, ".scr");
+  spath_append_str(path, name);
+  char* file = spath_strdup(path);
+  spath_delete(&path);
+  return file;
+}
+
+/* drop what we know about the index */
+static void scr_index_journal_forget(void)
+{
+  scr_free(&scr_index_journal.dir);
+  kvtree_delete(&scr_index_journal.state);
+  scr_index_journal.records      = 0;
+  scr_index_journal.base_size    = -1;
+  scr_index_journal.journal_size = -1;
+}
+
+/* record the current state of the index file and journal in the given directory */
+static void scr_index_journal_remember(const spath* dir, const kvtree* index, int records)
+{
+  scr_index_journal_forget();
+
+  scr_index_journal.dir = spath_strdup(dir);
+  scr_index_journal.state = kvtree_new();
+  kvtree_merge(scr_index_journal.state, index);
+  scr_index_journal.records = records;
+
+  struct stat st;
+  char* index_file = scr_index_file_path(dir, SCR_INDEX_FILENAME);
+  if (stat(index_file, &st) == 0) {
+    scr_index_journal.base_size  = st.st_size;
+    scr_index_journal.base_mtime = st.st_mtime;
+    scr_index_journal.base_ino   = st.st_ino;
+  }
+  scr_free(&index_file);
+
+  char* journal_file = scr_index_file_path(dir, SCR_INDEX_JOURNAL_FILENAME);
+  if (stat(journal_file, &st) == 0) {
+    scr_index_journal.journal_size = st.st_size;
+  }
+  scr_free(&journal_file);
+}
+
+/* returns 1 if the index file and journal in the given directory are as
+ * we last left them, so that changes can be appended to the journal */
+static int scr_index_journal_current(const spath* dir)
+{
+  if (scr_index_journal.dir == NULL || scr_index_journal.base_size < 0) {
+    return 0;
+  }
+
+  /* check that we're looking at the same directory */
+  char* dir_str = spath_strdup(dir);
+  int same_dir = (strcmp(dir_str, scr_index_journal.dir) == 0);
+  scr_free(&dir_str);
+  if (! same_dir) {
+    return 0;
+  }
+
+  /* check that no one has rewritten the index file since we saw it */
+  int current = 1;
+  struct stat st;
+  char* index_file = scr_index_file_path(dir, SCR_INDEX_FILENAME);
+  if (stat(index_file, &st) != 0 ||
+      st.st_size  != scr_index_journal.base_size  ||
+      st.st_mtime != scr_index_journal.base_mtime ||
+      st.st_ino   != scr_index_journal.base_ino)
+  {
+    current = 0;
+  }
+  scr_free(&index_file);
+
+  /* check that no one has added to or removed the journal since we saw it */
+  off_t journal_size = -1;
+  char* journal_file = scr_index_file_path(dir, SCR_INDEX_JOURNAL_FILENAME);
+  if (stat(journal_file, &st) == 0) {
+    journal_size = st.st_size;
+  }
+  scr_free(&journal_file);
+  if (journal_size != scr_index_journal.journal_size) {
+    current = 0;
+  }
+
+  return current;
+}
+
+/* returns 1 if the two hashes have the same contents, 0 otherwise */
+static int scr_index_journal_equal(const kvtree* a, const kvtree* b)
+{
+  if (a == NULL || b == NULL) {
+    return (a == b);
+  }
+
+  size_t size_a = kvtree_pack_size(a);
+  size_t size_b = kvtree_pack_size(b);
+  if (size_a != size_b) {
+    return 0;
+  }
+
+  char* buf_a = (char*) SCR_MALLOC(size_a);
+  char* buf_b = (char*) SCR_MALLOC(size_b);
+  kvtree_pack(buf_a, a);
+  kvtree_pack(buf_b, b);
+  int equal = (memcmp(buf_a, buf_b, size_a) == 0);
+  scr_free(&buf_a);
+  scr_free(&buf_b);
+
+  return equal;
+}
+
+/* given the old and new contents of the index, return a journal record
+ * holding the entries that differ, returns NULL if nothing changed */
+static kvtree* scr_index_journal_diff(const kvtree* old_index, const kvtree* new_index)
+{
+  kvtree* record = kvtree_new();
+  int changes = 0;
+
+  /* add or replace entries that are new or have changed */
+  kvtree_elem* key_elem;
+  for (key_elem = kvtree_elem_first(new_index);
+       key_elem != NULL;
+       key_elem = kvtree_elem_next(key_elem))
+  {
+    char* key = kvtree_elem_key(key_elem);
+    kvtree* key_hash = kvtree_elem_hash(key_elem);
+
+    kvtree_elem* val_elem;
+    for (val_elem = kvtree_elem_first(key_hash);
+         val_elem != NULL;
+         val_elem = kvtree_elem_next(val_elem))
+    {
+      char* val = kvtree_elem_key(val_elem);
+      kvtree* val_hash = kvtree_elem_hash(val_elem);
+      kvtree* old_hash = kvtree_get_kv(old_index, key, val);
+      if (! scr_index_journal_equal(old_hash, val_hash)) {
+        kvtree* set_hash = kvtree_get(record, SCR_INDEX_JOURNAL_KEY_SET);
+        if (set_hash == NULL) {
+          set_hash = kvtree_set(record, SCR_INDEX_JOURNAL_KEY_SET, kvtree_new());
+        }
+        kvtree* entry = kvtree_set_kv(set_hash, key, val);
+        kvtree_merge(entry, val_hash);
+        changes++;
+      }
+    }
+  }
+
+  /* remove entries that no longer exist */
+  for (key_elem = kvtree_elem_first(old_index);
+       key_elem != NULL;
+       key_elem = kvtree_elem_next(key_elem))
+  {
+    char* key = kvtree_elem_key(key_elem);
+    kvtree* key_hash = kvtree_elem_hash(key_elem);
+
+    kvtree_elem* val_elem;
+    for (val_elem = kvtree_elem_first(key_hash);
+         val_elem != NULL;
+         val_elem = kvtree_elem_next(val_elem))
+    {
+      char* val = kvtree_elem_key(val_elem);
+      if (kvtree_get_kv(new_index, key, val) == NULL) {
+        kvtree* unset_hash = kvtree_get(record, SCR_INDEX_JOURNAL_KEY_UNSET);
+        if (unset_hash == NULL) {
+          unset_hash = kvtree_set(record, SCR_INDEX_JOURNAL_KEY_UNSET, kvtree_new());
+        }
+        kvtree_set_kv(unset_hash, key, val);
+        changes++;
+      }
+    }
+  }
+
+  if (changes == 0) {
+    kvtree_delete(&record);
+  }
+
+  return record;
+}
+
+/* apply a journal record to the index */
+static void scr_index_journal_apply(kvtree* index, const kvtree* record)
+{
+  /* remove entries first, since a record may remove one value
+   * of a key and set another, as when CURRENT changes */
+  kvtree_elem* key_elem;
+  kvtree* unset_hash = kvtree_get(record, SCR_INDEX_JOURNAL_KEY_UNSET);
+  for (key_elem = kvtree_elem_first(unset_hash);
+       key_elem != NULL;
+       key_elem = kvtree_elem_next(key_elem))
+  {
+    char* key = kvtree_elem_key(key_elem);
+    kvtree* key_hash = kvtree_elem_hash(key_elem);
+
+    kvtree_elem* val_elem;
+    for (val_elem = kvtree_elem_first(key_hash);
+         val_elem != NULL;
+         val_elem = kvtree_elem_next(val_elem))
+    {
+      char* val = kvtree_elem_key(val_elem);
+      kvtree_unset_kv(index, key, val);
+    }
+  }
+
+  /* replace each entry in the SET list */
+  kvtree* set_hash = kvtree_get(record, SCR_INDEX_JOURNAL_KEY_SET);
+  for (key_elem = kvtree_elem_first(set_hash);
+       key_elem != NULL;
+       key_elem = kvtree_elem_next(key_elem))
+  {
+    char* key = kvtree_elem_key(key_elem);
+    kvtree* key_hash = kvtree_elem_hash(key_elem);
+
+    kvtree_elem* val_elem;
+    for (val_elem = kvtree_elem_first(key_hash);
+         val_elem != NULL;
+         val_elem = kvtree_elem_next(val_elem))
+    {
+      char* val = kvtree_elem_key(val_elem);
+      kvtree* val_hash = kvtree_elem_hash(val_elem);
+      kvtree_unset_kv(index, key, val);
+      kvtree* entry = kvtree_set_kv(index, key, val);
+      kvtree_merge(entry, val_hash);
+    }
+  }
+}
+
+/* read records from the journal file and apply them to the index,
+ * sets records to the number of good records, returns SCR_FAILURE
+ * if the journal ends with a partial or corrupt record */
+static int scr_index_journal_replay(const char* file, kvtree* index, int* records)
+{
+  *records = 0;
+
+  /* nothing to do if there is no journal */
+  if (scr_file_exists(file) != SCR_SUCCESS) {
+    return SCR_SUCCESS;
+  }
+
+  /* read the journal into memory */
+  unsigned long size = scr_file_size(file);
+  char* buf = NULL;
+  if (size > 0) {
+    buf = (char*) SCR_MALLOC(size);
+    int fd = scr_open(file, O_RDONLY);
+    if (fd < 0) {
+      scr_err("Opening index journal for read: scr_open(%s) errno=%d %s @ %s:%d",
+        file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      scr_free(&buf);
+      return SCR_FAILURE;
+    }
+    ssize_t nread = scr_read(file, fd, buf, size);
+    scr_close(file, fd);
+    if (nread != (ssize_t) size) {
+      scr_free(&buf);
+      return SCR_FAILURE;
+    }
+  }
+
+  /* apply each complete record */
+  int rc = SCR_SUCCESS;
+  unsigned long offset = 0;
+  while (offset < size) {
+    /* decode the record header */
+    if (size - offset < SCR_INDEX_JOURNAL_HEADER) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    const unsigned char* header = (const unsigned char*) (buf + offset);
+    uint64_t length = 0;
+    uint32_t crc = 0;
+    int i;
+    for (i = 0; i < 8; i++) {
+      length = (length << 8) | header[i];
+    }
+    for (i = 8; i < 12; i++) {
+      crc = (crc << 8) | header[i];
+    }
+    offset += SCR_INDEX_JOURNAL_HEADER;
+
+    /* check that we have the whole record and that it's intact */
+    if (length > size - offset) {
+      rc = SCR_FAILURE;
+      break;
+    }
+    uLong crc_record = crc32(0L, Z_NULL, 0);
+    crc_record = crc32(crc_record, (const Bytef*) (buf + offset), (uInt) length);
+    if ((uint32_t) crc_record != crc) {
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    /* apply the record */
+    kvtree* record = kvtree_new();
+    kvtree_unpack(buf + offset, record);
+    scr_index_journal_apply(index, record);
+    kvtree_delete(&record);
+
+    offset += length;
+    (*records)++;
+  }
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Ignoring partial record at end of index journal %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+  }
+
+  scr_free(&buf);
+
+  return rc;
+}
+
+/* append a record to the journal file */
+static int scr_index_journal_append(const char* file, const kvtree* record)
+{
+  /* pack the record behind its header */
+  size_t length = kvtree_pack_size(record);
+  size_t size = SCR_INDEX_JOURNAL_HEADER + length;
+  unsigned char* buf = (unsigned char*) SCR_MALLOC(size);
+  kvtree_pack((char*) buf + SCR_INDEX_JOURNAL_HEADER, record);
+
+  /* fill in length and crc of record, big-endian */
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, (const Bytef*) buf + SCR_INDEX_JOURNAL_HEADER, (uInt) length);
+  uint64_t length64 = (uint64_t) length;
+  uint32_t crc32_val = (uint32_t) crc;
+  int i;
+  for (i = 7; i >= 0; i--) {
+    buf[i] = (unsigned char) (length64 & 0xff);
+    length64 >>= 8;
+  }
+  for (i = 11; i >= 8; i--) {
+    buf[i] = (unsigned char) (crc32_val & 0xff);
+    crc32_val >>= 8;
+  }
+
+  /* append the record with a single write */
+  int rc = SCR_SUCCESS;
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(file, O_WRONLY | O_CREAT | O_APPEND, mode_file);
+  if (fd >= 0) {
+    if (scr_write(file, fd, buf, size) != (ssize_t) size) {
+      rc = SCR_FAILURE;
+    }
+    if (scr_close(file, fd) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  } else {
+    scr_err("Opening index journal for append: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  scr_free(&buf);
+
+  return rc;
+}
+
 /* read the index file from given directory and merge its contents into the given hash */
 int scr_index_read(const spath* dir, kvtree* index)
 {
@@ -153,8 +652,23 @@ int scr_index_read(const spath* dir, kvtree* index)
       if (kvtree_util_get_int(tmp, SCR_INDEX_KEY_VERSION, &version) == KVTREE_SUCCESS) {
         /* got a version number, check that it's what we expect */
         if (version == SCR_INDEX_FILE_VERSION_2) {
-          /* got the correct version, copy file contents into caller's kvtree */
+          /* got the correct version, apply changes from the journal */
+          int records = 0;
+          char* journal_file = scr_index_file_path(dir, SCR_INDEX_JOURNAL_FILENAME);
+          if (scr_index_journal_replay(journal_file, tmp, &records) != SCR_SUCCESS) {
+            /* don't append after a partial record, rewrite the index on the next write */
+            records = scr_index_journal_max;
+          }
+          scr_free(&journal_file);
+
+          /* remember what we read, so the next write only appends changes */
+          scr_index_journal_remember(dir, tmp, records);
+
+          /* copy file contents into caller's kvtree */
           kvtree_merge(index, tmp);
+          if (scr_index_ids.index == index) {
+            scr_index_ids_forget();
+          }
         } else {
           /* failed to find the version number in the file */
           scr_err("Found file format version %d but expected %d in index file: %s @ %s:%d",
@@ -182,24 +696,63 @@ int scr_index_read(const spath* dir, kvtree* index)
   return rc;
 }
 
-/* overwrite the contents of the index file in given directory with given hash */
+/* overwrite the contents of the index file in given directory with given hash,
+ * if the index file is as we last read or wrote it, this only appends the
+ * entries that changed to the journal, and the index file is rewritten
+ * once the journal holds SCR_INDEX_JOURNAL_RECORDS records */
 int scr_index_write(const spath* dir, kvtree* index)
 {
-  /* build the file name for the index file */
-  spath* path_index = spath_dup(dir);
-  spath_append_str(path_index, ".scr");
-  spath_append_str(path_index, SCR_INDEX_FILENAME);
-
   /* set the index file version key if it's not set already */
   kvtree* version = kvtree_get(index, SCR_INDEX_KEY_VERSION);
   if (version == NULL) {
     kvtree_util_set_int(index, SCR_INDEX_KEY_VERSION, SCR_INDEX_FILE_VERSION_2);
   }
 
+  /* append changes to the journal if we can */
+  if (scr_index_journal_current(dir) &&
+      scr_index_journal.records < scr_index_journal_max)
+  {
+    kvtree* record = scr_index_journal_diff(scr_index_journal.state, index);
+    if (record == NULL) {
+      /* nothing changed */
+      return SCR_SUCCESS;
+    }
+
+    char* journal_file = scr_index_file_path(dir, SCR_INDEX_JOURNAL_FILENAME);
+    int append_rc = scr_index_journal_append(journal_file, record);
+    scr_free(&journal_file);
+    kvtree_delete(&record);
+
+    if (append_rc == SCR_SUCCESS) {
+      scr_index_journal_remember(dir, index, scr_index_journal.records + 1);
+      return SCR_SUCCESS;
+    }
+
+    /* failed to append, fall back to rewriting the index file */
+  }
+
+  /* build the file name for the index file */
+  spath* path_index = spath_dup(dir);
+  spath_append_str(path_index, ".scr");
+  spath_append_str(path_index, SCR_INDEX_FILENAME);
+
   /* write out the file */
   int kvtree_rc = kvtree_write_path(path_index, index);
   int rc = (kvtree_rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
 
+  if (rc == SCR_SUCCESS) {
+    /* the index file now holds everything, so start a new journal */
+    char* journal_file = scr_index_file_path(dir, SCR_INDEX_JOURNAL_FILENAME);
+    if (scr_file_exists(journal_file) == SCR_SUCCESS) {
+      scr_file_unlink(journal_file);
+    }
+    scr_free(&journal_file);
+
+    scr_index_journal_remember(dir, index, 0);
+  } else {
+    scr_index_journal_forget();
+  }
+
   /* free path */
   spath_delete(&path_index);
 
@@ -264,6 +817,14 @@ static int scr_index_set_directory(kvtree* hash, const char* name, int id)
   return SCR_SUCCESS;
 }
 
+/* get the entry for the given dataset id, adding it if needed */
+static kvtree* scr_index_set_dset(kvtree* index, int id)
+{
+  kvtree* dset_hash = kvtree_set_kv_int(index, SCR_INDEX_1_KEY_DATASET, id);
+  scr_index_ids_add(index, id);
+  return dset_hash;
+}
+
 /* remove given dataset name from hash */
 int scr_index_remove(kvtree* index, const char* name)
 {
@@ -275,6 +836,7 @@ int scr_index_remove(kvtree* index, const char* name)
 
     /* delete the dataset id field */
     kvtree_unset_kv_int(index, SCR_INDEX_1_KEY_DATASET, id);
+    scr_index_ids_remove(index, id);
 
     /* if this is the current dataset, update current */
     char* current = NULL;
@@ -349,7 +911,7 @@ int scr_index_unset_current(kvtree* index)
 int scr_index_set_complete(kvtree* index, int id, const char* name, int complete)
 {
   /* mark the dataset as complete or incomplete */
-  kvtree* dset_hash = kvtree_set_kv_int(index, SCR_INDEX_1_KEY_DATASET, id);
+  kvtree* dset_hash = scr_index_set_dset(index, id);
   kvtree_util_set_int(dset_hash, SCR_INDEX_1_KEY_COMPLETE, complete);
 
   /* add entry to directory index (maps name to dataset id) */
@@ -366,7 +928,7 @@ int scr_index_set_dataset(kvtree* index, int id, const char* name, const scr_dat
   kvtree_merge(dataset_copy, dataset);
 
   /* get pointer to dataset hash */
-  kvtree* dset_hash = kvtree_set_kv_int(index, SCR_INDEX_1_KEY_DATASET, id);
+  kvtree* dset_hash = scr_index_set_dset(index, id);
 
   /* record dataset hash in index */
   kvtree_set(dset_hash, SCR_INDEX_1_KEY_DATASET, dataset_copy);
@@ -391,7 +953,7 @@ int scr_index_mark_fetched(kvtree* index, int id, const char* name)
   /* NOTE: we use set_kv instead of util_set_str so that multiple fetch
    * timestamps can be recorded */
   /* mark the dataset as fetched at current timestamp */
-  kvtree* dset_hash = kvtree_set_kv_int(index, SCR_INDEX_1_KEY_DATASET, id);
+  kvtree* dset_hash = scr_index_set_dset(index, id);
   kvtree_set_kv(dset_hash, SCR_INDEX_1_KEY_FETCHED, timestamp);
 
   /* add entry to directory index (maps name to dataset id) */
@@ -409,7 +971,7 @@ int scr_index_mark_failed(kvtree* index, int id, const char* name)
   strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
 
   /* mark the dataset as failed at current timestamp */
-  kvtree* dset_hash = kvtree_set_kv_int(index, SCR_INDEX_1_KEY_DATASET, id);
+  kvtree* dset_hash = scr_index_set_dset(index, id);
   kvtree_util_set_str(dset_hash, SCR_INDEX_1_KEY_FAILED, timestamp);
 
   /* add entry to directory index (maps name to dataset id) */
@@ -422,7 +984,7 @@ int scr_index_mark_failed(kvtree* index, int id, const char* name)
 int scr_index_clear_failed(kvtree* index, int id, const char* name)
 {
   /* mark the dataset as failed at current timestamp */
-  kvtree* dset_hash = kvtree_set_kv_int(index, SCR_INDEX_1_KEY_DATASET, id);
+  kvtree* dset_hash = scr_index_set_dset(index, id);
   kvtree_unset(dset_hash, SCR_INDEX_1_KEY_FAILED);
 
   /* add entry to directory index (maps name to dataset id) */
@@ -440,7 +1002,7 @@ int scr_index_mark_flushed(kvtree* index, int id, const char* name)
   strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
 
   /* mark the dataset as flushed at current timestamp */
-  kvtree* dset_hash = kvtree_set_kv_int(index, SCR_INDEX_1_KEY_DATASET, id);
+  kvtree* dset_hash = scr_index_set_dset(index, id);
   kvtree_util_set_str(dset_hash, SCR_INDEX_1_KEY_FLUSHED, timestamp);
 
   /* add entry to directory index (maps name to dataset id) */
@@ -449,6 +1011,38 @@ int scr_index_mark_flushed(kvtree* index, int id, const char* name)
   return SCR_SUCCESS;
 }
 
+/* record that files of given dataset id and name are stored as deltas
+ * against files of dataset base_id */
+int scr_index_set_base(kvtree* index, int id, const char* name, int base_id)
+{
+  /* add the base id to the dataset */
+  kvtree* dset_hash = scr_index_set_dset(index, id);
+  kvtree_set_kv_int(dset_hash, SCR_INDEX_1_KEY_BASE, base_id);
+
+  /* add entry to directory index (maps name to dataset id) */
+  scr_index_set_directory(index, name, id);
+
+  return SCR_SUCCESS;
+}
+
+/* returns 1 if files of some other dataset in the index are stored as
+ * deltas against files of dataset id, 0 otherwise */
+int scr_index_is_base(const kvtree* index, int id)
+{
+  kvtree* dsets = kvtree_get(index, SCR_INDEX_1_KEY_DATASET);
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(dsets);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    kvtree* dset_hash = kvtree_elem_hash(elem);
+    if (kvtree_get_kv_int(dset_hash, SCR_INDEX_1_KEY_BASE, id) != NULL) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 /* copy dataset into given dataset object,
  * returns SCR_FAILURE if not found */
 int scr_index_get_dataset(kvtree* index, int id, const char* name, scr_dataset* dataset)
@@ -507,49 +1101,88 @@ int scr_index_get_id_by_name(const kvtree* index, const char* name, int* id)
   return SCR_FAILURE;
 }
 
-/* lookup the most recent complete dataset id and name whose id is less than earlier_than
- * setting earlier_than = -1 disables this filter */
-int scr_index_get_most_recent_complete(const kvtree* index, int earlier_than, int* id, char* name)
+/* compare two ints for qsort */
+static int scr_index_cmp_int(const void* a, const void* b)
 {
-  /* assume that we won't find a valid dataset */
-  *id = -1;
+  int int_a = *(const int*) a;
+  int int_b = *(const int*) b;
+  if (int_a < int_b) {
+    return -1;
+  }
+  if (int_a > int_b) {
+    return 1;
+  }
+  return 0;
+}
 
-  /* search for the checkpoint with the maximum dataset id which is
-   * complete and less than earlier_than if earlier_than is set */
-  int max_id = -1;
+/* get list of dataset ids in index sorted in ascending order, the list
+ * is kept from one call to the next and belongs to this file, so the
+ * caller must not free it, and it is only valid until the index changes */
+static const int* scr_index_sorted_ids(const kvtree* index, int* count)
+{
   kvtree* dsets = kvtree_get(index, SCR_INDEX_1_KEY_DATASET);
-  kvtree_elem* dset = NULL;
-  for (dset = kvtree_elem_first(dsets);
-       dset != NULL;
-       dset = kvtree_elem_next(dset))
+  int size = (dsets != NULL) ? kvtree_size(dsets) : 0;
+
+  /* rebuild the list if it is for some other index or if the index
+   * was changed other than through the functions in this file */
+  if (scr_index_ids.index != index ||
+      scr_index_ids.dsets != dsets ||
+      scr_index_ids.count != size)
   {
-    /* get the id for this dataset */
-    char* key = kvtree_elem_key(dset);
-    if (key == NULL) {
-      continue;
+    scr_index_ids_forget();
+    if (dsets != NULL) {
+      kvtree_list_int(dsets, &scr_index_ids.count, &scr_index_ids.ids);
+      if (scr_index_ids.count > 1) {
+        qsort(scr_index_ids.ids, scr_index_ids.count, sizeof(int), scr_index_cmp_int);
+      }
     }
-    int current_id = atoi(key);
+    scr_index_ids.capacity = scr_index_ids.count;
+    scr_index_ids.index    = index;
+    scr_index_ids.dsets    = dsets;
+  }
 
-    /* if we have a limit and the current id is beyond that limit,
-     * skip it */
-    if (earlier_than != -1 && current_id >= earlier_than) {
-      continue;
-    }
+  *count = scr_index_ids.count;
+  return scr_index_ids.ids;
+}
 
-    /* if the current id is earlier than the lastest we've found so far,
-     * skip it */
-    if (current_id < max_id) {
-      continue;
+/* lookup the most recent complete dataset id and name whose id is less than earlier_than
+ * setting earlier_than = -1 disables this filter */
+int scr_index_get_most_recent_complete(const kvtree* index, int earlier_than, int* id, char* name)
+{
+  /* assume that we won't find a valid dataset */
+  *id = -1;
+
+  /* get dataset ids in order */
+  int count;
+  const int* ids = scr_index_sorted_ids(index, &count);
+
+  /* binary search for the first id that is not earlier than earlier_than */
+  int end = count;
+  if (earlier_than != -1) {
+    int low  = 0;
+    int high = count;
+    while (low < high) {
+      int mid = low + (high - low) / 2;
+      if (ids[mid] < earlier_than) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
     }
+    end = low;
+  }
 
-    kvtree* dset_hash = kvtree_elem_hash(dset);
+  /* step back from the most recent dataset within range,
+   * and stop at the first complete checkpoint */
+  int i;
+  for (i = end - 1; i >= 0; i--) {
+    int current_id = ids[i];
+    kvtree* dset_hash = kvtree_get_kv_int(index, SCR_INDEX_1_KEY_DATASET, current_id);
 
-    /* alright, this dataset id is within range to be the most recent,
-     * now scan the various names we have for this dataset looking for a complete */
+    /* assume this dataset is good until we find otherwise */
     int found_one = 1;
 
-    /* this dataset id is less than our limit and it's more than
-     * our current max, check whether it's complete */
+    /* check whether it's complete */
     int complete;
     if (kvtree_util_get_int(dset_hash, SCR_INDEX_1_KEY_COMPLETE, &complete) == KVTREE_SUCCESS) {
       if (complete != 1) {
@@ -578,17 +1211,15 @@ int scr_index_get_most_recent_complete(const kvtree* index, int earlier_than, in
       found_one = 0;
     }
 
-    /* get the name of the dataset */
-    char* current_name;
-    scr_dataset_get_name(dataset_hash, &current_name);
-
-    /* if we found one, copy the dataset id and name, and update our max */
+    /* if we found one, copy the dataset id and name */
     if (found_one) {
+      /* get the name of the dataset */
+      char* current_name;
+      scr_dataset_get_name(dataset_hash, &current_name);
+
       *id = current_id;
       strcpy(name, current_name);
-
-      /* update our max */
-      max_id = current_id;
+      break;
     }
   }
 
@@ -602,41 +1233,60 @@ int scr_index_get_oldest(const kvtree* index, int* id, char* name)
   /* assume that we won't find a valid dataset */
   *id = -1;
 
-  /* search for the checkpoint with the minimum dataset id */
-  int min_id = -1;
-  kvtree* dsets = kvtree_get(index, SCR_INDEX_1_KEY_DATASET);
-  kvtree_elem* dset = NULL;
-  for (dset = kvtree_elem_first(dsets);
-       dset != NULL;
-       dset = kvtree_elem_next(dset))
-  {
-    /* get the id for this dataset */
-    char* key = kvtree_elem_key(dset);
-    if (key == NULL) {
-      continue;
-    }
-    int current_id = atoi(key);
+  /* get dataset ids in order, the first is the oldest */
+  int count;
+  const int* ids = scr_index_sorted_ids(index, &count);
+
+  if (count > 0) {
+    /* get dataset info */
+    int current_id = ids[0];
+    kvtree* dset_hash = kvtree_get_kv_int(index, SCR_INDEX_1_KEY_DATASET, current_id);
+    kvtree* dataset_hash = kvtree_get(dset_hash, SCR_INDEX_1_KEY_DATASET);
+
+    /* get the name of the dataset */
+    char* current_name;
+    scr_dataset_get_name(dataset_hash, &current_name);
 
-    /* if the current id is more recent than the oldest we've found so far,
-     * skip it */
-    if (min_id != -1 && current_id > min_id) {
+    /* copy the dataset id and name */
+    *id = current_id;
+    strcpy(name, current_name);
+  }
+
+  return SCR_FAILURE;
+}
+
+/* lookup the dataset having the lowest id that is not the base of
+ * another dataset in the index, return its id and name,
+ * sets id to -1 to indicate no such dataset is left */
+int scr_index_get_oldest_deletable(const kvtree* index, int* id, char* name)
+{
+  /* assume that we won't find a valid dataset */
+  *id = -1;
+
+  /* get dataset ids in order, oldest first */
+  int count;
+  const int* ids = scr_index_sorted_ids(index, &count);
+
+  int i;
+  for (i = 0; i < count; i++) {
+    /* skip datasets that others need to rebuild their files */
+    int current_id = ids[i];
+    if (scr_index_is_base(index, current_id)) {
       continue;
     }
 
     /* get dataset info */
-    kvtree* dset_hash = kvtree_elem_hash(dset);
+    kvtree* dset_hash = kvtree_get_kv_int(index, SCR_INDEX_1_KEY_DATASET, current_id);
     kvtree* dataset_hash = kvtree_get(dset_hash, SCR_INDEX_1_KEY_DATASET);
 
     /* get the name of the dataset */
     char* current_name;
     scr_dataset_get_name(dataset_hash, &current_name);
 
-    /* if we found one, copy the dataset id and name, and update our max */
+    /* copy the dataset id and name */
     *id = current_id;
     strcpy(name, current_name);
-
-    /* update our min */
-    min_id = current_id;
+    return SCR_SUCCESS;
   }
 
   return SCR_FAILURE;
@@ -25,6 +25,10 @@ int scr_index_read(const spath* dir, kvtree* index);
 /* overwrite the contents of the index file in given directory with given hash */
 int scr_index_write(const spath* dir, kvtree* index);
 
+/* set the number of records to append to the journal before the index file
+ * is rewritten, 0 rewrites the index file on every write */
+void scr_index_set_journal_records(int records);
+
 /* read index file and return max dataset and checkpoint ids,
  * returns SCR_SUCCESS if file read successfully */
 int scr_index_get_max_ids(const spath* dir, int* dset_id, int* ckpt_id, int* ckpt_dset_id);
@@ -59,6 +63,14 @@ int scr_index_clear_failed(kvtree* index, int id, const char* name);
 /* record flush time for given dataset id and name in given hash */
 int scr_index_mark_flushed(kvtree* index, int id, const char* name);
 
+/* record that files of given dataset id and name are stored as deltas
+ * against files of dataset base_id */
+int scr_index_set_base(kvtree* index, int id, const char* name, int base_id);
+
+/* returns 1 if files of some other dataset in the index are stored as
+ * deltas against files of dataset id, 0 otherwise */
+int scr_index_is_base(const kvtree* index, int id);
+
 /* copy dataset into given dataset object,
  * returns SCR_FAILURE if key is not set */
 int scr_index_get_dataset(kvtree* index, int id, const char* name, scr_dataset* dataset);
@@ -79,6 +91,11 @@ int scr_index_get_most_recent_complete(const kvtree* index, int earlier_than, in
  * sets id to -1 to indicate no dataset is left */
 int scr_index_get_oldest(const kvtree* index, int* id, char* name);
 
+/* lookup the dataset having the lowest id that is not the base of
+ * another dataset in the index, return its id and name,
+ * sets id to -1 to indicate no such dataset is left */
+int scr_index_get_oldest_deletable(const kvtree* index, int* id, char* name);
+
 /* remove checkpoints from index that are later than given dataset id */
 int scr_index_remove_later(kvtree* index, int id);
 
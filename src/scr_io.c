@@ -33,6 +33,11 @@
 /* Implements a reliable open/read/write/close interface via open and close.
  * Implements directory manipulation functions. */
 
+/* for statx and copy_file_range */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "scr_conf.h"
 #include "scr.h"
 #include "scr_err.h"
@@ -66,6 +71,34 @@
 /* gettimeofday */
 #include <sys/time.h>
 
+/* reader and writer threads for file copy */
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+/* compute crc32 with carry-less multiply instructions when available */
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SCR_CRC32_PCLMUL
+#include <immintrin.h>
+#endif
+
+/* copy file data within the kernel */
+#ifdef __linux__
+#include <sys/sendfile.h>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 27))
+#define SCR_HAVE_COPY_FILE_RANGE
+#endif
+#endif
+
+/* minimum number of files to assign to each thread when checking files */
+#define SCR_FILE_CHECK_MIN_FILES (16)
+
+/* minimum number of bytes to assign to each thread when computing crc32 */
+#define SCR_CRC32_MIN_RANGE (16*1024*1024)
+
+/* size of buffer used to read file data when computing crc32 */
+#define SCR_CRC32_BUF_SIZE (1024*1024)
+
 /*
 =========================================
 open/lock/close/read/write functions
@@ -532,141 +565,149 @@ ssize_t scr_writef(const char* file, int fd, const char* format, ...)
   return rc;
 }
 
-/* logically concatenate n opened files and read count bytes from this logical file into buf starting
- * from offset, pad with zero on end if missing data */
-int scr_read_pad_n(int n, char** files, int* fds,
-                   char* buf, unsigned long count, unsigned long offset, unsigned long* filesizes)
+/* make a good attempt to read size bytes from file at offset without
+ * changing the file position (retries, if necessary, return error if fail) */
+static ssize_t scr_pread_attempt(const char* file, int fd, void* buf, size_t size, off_t offset)
 {
-  int i = 0;
-  size_t pos = 0;
-  off_t nseek = 0;
-  off_t nread = 0;
-
-  /* pass through files until we find the one containing our offset */
-  while (i < n && (nseek + filesizes[i]) <= offset) {
-    nseek += filesizes[i];
-    i++;
-  }
-
-  /* seek to the proper position in the current file */
-  if (i < n) {
-      pos = offset - nseek;
-      nseek += pos;
-      if (lseek(fds[i], pos, SEEK_SET) == (off_t)-1) {
-        /* our seek failed, return an error */
-        scr_err("Failed to seek to byte %lu in %s @ %s:%d",
-          pos, files[i], __FILE__, __LINE__
-        );
-        return SCR_FAILURE;
+  ssize_t n = 0;
+  int retries = 10;
+  while (n < size)
+  {
+    ssize_t rc = pread(fd, (char*) buf + n, size - n, offset + n);
+    if (rc  > 0) {
+      n += rc;
+    } else if (rc == 0) {
+      /* EOF */
+      return n;
+    } else { /* (rc < 0) */
+      /* got an error, check whether it was serious */
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
       }
-  }
-
-  /* read data from files */
-  while (nread < count && i < n) {
-    /* assume we'll read the remainder of the current file */
-    size_t num_to_read = filesizes[i] - pos;
-
-    /* if we don't need to read the whole remainder of the file, adjust to the smaller amount */
-    if (num_to_read > count - nread) {
-      num_to_read = count - nread;
-    }
-
-    /* read data from file and add to the total read count */
-    if (scr_read_attempt(files[i], fds[i], buf + nread, num_to_read) != num_to_read) {
-      /* our read failed, return an error */
-      return SCR_FAILURE;
-    }
-    nread += num_to_read;
 
-    /* advance to next file and seek to byte 0 */
-    i++;
-    if (i < n) {
-      pos = 0;
-      if (lseek(fds[i], pos, SEEK_SET) == (off_t)-1) {
-        /* our seek failed, return an error */
-        scr_err("Failed to seek to byte %lu in %s @ %s:%d",
-          pos, files[i], __FILE__, __LINE__
+      /* something worth printing an error about */
+      retries--;
+      if (retries) {
+        /* print an error and try again */
+        scr_err("Error reading file %s errno=%d %s @ %s:%d",
+          file, errno, strerror(errno), __FILE__, __LINE__
         );
-        return SCR_FAILURE;
+      } else {
+        /* too many failed retries, give up */
+        scr_err("Giving up read on file %s errno=%d %s @ %s:%d",
+          file, errno, strerror(errno), __FILE__, __LINE__
+        );
+        return -1;
       }
     }
   }
-
-  /* if count is bigger than all of our file data, pad with zeros on the end */
-  if (nread < count) {
-    memset(buf + nread, 0, count - nread);
-  }
-
-  return SCR_SUCCESS;
+  return n;
 }
 
-/* write to an array of open files with known filesizes treating them as one single large file */
-int scr_write_pad_n(int n, char** files, int* fds,
-                    char* buf, unsigned long count, unsigned long offset, unsigned long* filesizes)
+/* make a good attempt to write size bytes to file at offset without
+ * changing the file position (retries, if necessary, return error if fail) */
+static ssize_t scr_pwrite_attempt(const char* file, int fd, const void* buf, size_t size, off_t offset)
 {
-  int i = 0;
-  size_t pos = 0;
-  off_t nseek  = 0;
-  off_t nwrite = 0;
-
-  /* pass through files until we find the one containing our offset */
-  while (i < n && (nseek + filesizes[i]) <= offset) {
-    nseek += filesizes[i];
-    i++;
-  }
-
-  /* seek to the proper position in the current file */
-  if (i < n) {
-      pos = offset - nseek;
-      nseek += pos;
-      if (lseek(fds[i], pos, SEEK_SET) == (off_t)-1) {
-        /* our seek failed, return an error */
-        scr_err("Failed to seek to byte %lu in %s @ %s:%d",
-          pos, files[i], __FILE__, __LINE__
-        );
-        return SCR_FAILURE;
+  ssize_t n = 0;
+  int retries = 10;
+  while (n < size)
+  {
+    ssize_t rc = pwrite(fd, (const char*) buf + n, size - n, offset + n);
+    if (rc > 0) {
+      n += rc;
+    } else if (rc == 0) {
+      /* something bad happened, print an error and abort */
+      scr_err("Error writing file %s write returned 0 @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+      return -1;
+    } else { /* (rc < 0) */
+      /* got an error, check whether it was serious */
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
       }
-  }
-
-  /* write data to files */
-  while (nwrite < count && i < n) {
-    /* assume we'll write the remainder of the current file */
-    size_t num_to_write = filesizes[i] - pos;
 
-    /* if we don't need to write the whole remainder of the file, adjust to the smaller amount */
-    if (num_to_write > count - nwrite) {
-      num_to_write = count - nwrite;
+      /* something worth printing an error about */
+      retries--;
+      if (retries) {
+        /* print an error and try again */
+        scr_err("Error writing file %s errno=%d %s @ %s:%d",
+          file, errno, strerror(errno), __FILE__, __LINE__
+        );
+      } else {
+        /* too many failed retries, give up */
+        scr_err("Giving up write to file %s errno=%d %s @ %s:%d",
+          file, errno, strerror(errno), __FILE__, __LINE__
+        );
+        return -1;
+      }
     }
+  }
+  return n;
+}
 
-    /* write data to file and add to the total write count */
-    if (scr_write_attempt(files[i], fds[i], buf + nwrite, num_to_write) != num_to_write) {
-      /* our write failed, return an error */
-      return SCR_FAILURE;
-    }
-    nwrite += num_to_write;
+/* read (or write if write is set) count bytes at offset in the logical
+ * concatenation of n files with the given sizes, walks the file sizes
+ * rather than building an index, so it allocates nothing, each file
+ * covers one contiguous range of the logical file, so we issue at
+ * most one pread or pwrite per file */
+static int scr_pad_n_rw(int n, char** files, int* fds, char* buf,
+                        unsigned long count, unsigned long offset,
+                        const unsigned long* filesizes, int write)
+{
+  unsigned long done  = 0;
+  unsigned long start = 0;
+  int i;
+  for (i = 0; i < n && done < count; i++) {
+    /* skip files that end before the current position */
+    unsigned long end = start + filesizes[i];
+    unsigned long cur = offset + done;
+    if (cur < end) {
+      /* transfer the remainder of the file or as much as we still need */
+      unsigned long pos = cur - start;
+      unsigned long len = end - cur;
+      if (len > count - done) {
+        len = count - done;
+      }
 
-    /* advance to next file and seek to byte 0 */
-    i++;
-    if (i < n) {
-      pos = 0;
-      if (lseek(fds[i], pos, SEEK_SET) == (off_t)-1) {
-        /* our seek failed, return an error */
-        scr_err("Failed to seek to byte %lu in %s @ %s:%d",
-          pos, files[i], __FILE__, __LINE__
-        );
+      ssize_t got;
+      if (write) {
+        got = scr_pwrite_attempt(files[i], fds[i], buf + done, len, (off_t) pos);
+      } else {
+        got = scr_pread_attempt(files[i], fds[i], buf + done, len, (off_t) pos);
+      }
+      if (got != (ssize_t) len) {
         return SCR_FAILURE;
       }
+      done += len;
     }
+    start = end;
   }
 
-  /* if count is bigger than all of our file data, just throw the data away */
-  if (nwrite < count) {
-    /* NOTHING TO DO */
+  /* if count is bigger than all of our file data, pad reads with zeros
+   * on the end, and just throw away data to be written */
+  if (! write && done < count) {
+    memset(buf + done, 0, count - done);
   }
 
   return SCR_SUCCESS;
 }
 
+/* logically concatenate n opened files and read count bytes from this logical file into buf starting
+ * from offset, pad with zero on end if missing data */
+int scr_read_pad_n(int n, char** files, int* fds,
+                   char* buf, unsigned long count, unsigned long offset, unsigned long* filesizes)
+{
+  return scr_pad_n_rw(n, files, fds, buf, count, offset, filesizes, 0);
+}
+
+/* write to an array of open files with known filesizes treating them as one single large file */
+int scr_write_pad_n(int n, char** files, int* fds,
+                    char* buf, unsigned long count, unsigned long offset, unsigned long* filesizes)
+{
+  return scr_pad_n_rw(n, files, fds, buf, count, offset, filesizes, 1);
+}
+
 /* given a filename, return number of bytes in file */
 unsigned long scr_file_size(const char* file)
 {
@@ -683,6 +724,95 @@ unsigned long scr_file_size(const char* file)
   return bytes;
 }
 
+/* stat file, using statx on Linux to request only the basic fields,
+ * and fill in statbuf with the result, returns 0 on success */
+static int scr_file_check_stat(const char* file, struct stat* statbuf)
+{
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+  struct statx stx;
+  if (statx(AT_FDCWD, file, 0, STATX_BASIC_STATS, &stx) == 0) {
+    memset(statbuf, 0, sizeof(struct stat));
+    statbuf->st_mode          = (mode_t) stx.stx_mode;
+    statbuf->st_uid           = (uid_t)  stx.stx_uid;
+    statbuf->st_gid           = (gid_t)  stx.stx_gid;
+    statbuf->st_size          = (off_t)  stx.stx_size;
+    statbuf->st_nlink         = (nlink_t) stx.stx_nlink;
+    statbuf->st_ino           = (ino_t)  stx.stx_ino;
+    statbuf->st_atim.tv_sec   = (time_t) stx.stx_atime.tv_sec;
+    statbuf->st_atim.tv_nsec  = (long)   stx.stx_atime.tv_nsec;
+    statbuf->st_mtim.tv_sec   = (time_t) stx.stx_mtime.tv_sec;
+    statbuf->st_mtim.tv_nsec  = (long)   stx.stx_mtime.tv_nsec;
+    statbuf->st_ctim.tv_sec   = (time_t) stx.stx_ctime.tv_sec;
+    statbuf->st_ctim.tv_nsec  = (long)   stx.stx_ctime.tv_nsec;
+    return 0;
+  }
+
+  /* fall back to stat if statx is not supported by the kernel */
+  if (errno != ENOSYS) {
+    return -1;
+  }
+#endif
+  return stat(file, statbuf);
+}
+
+/* check each file in a range of the given list */
+static void scr_file_check_range(scr_file_check* checks, int start, int stride, int n)
+{
+  int i;
+  for (i = start; i < n; i += stride) {
+    scr_file_check* c = &checks[i];
+    c->readable = (access(c->file, R_OK) == 0);
+    c->stat_rc  = scr_file_check_stat(c->file, &c->statbuf);
+  }
+}
+
+/* arguments for a thread checking files */
+typedef struct {
+  scr_file_check* checks; /* list of files to check */
+  int start;              /* index of first file for this thread */
+  int stride;             /* distance between consecutive files for this thread */
+  int n;                  /* number of files in list */
+} scr_file_check_args;
+
+static void* scr_file_check_thread(void* arg)
+{
+  scr_file_check_args* a = (scr_file_check_args*) arg;
+  scr_file_check_range(a->checks, a->start, a->stride, a->n);
+  return NULL;
+}
+
+/* checks whether each of n files is readable and stats it, spreading the
+ * work over up to threads threads, the file field of each entry must be set */
+int scr_file_check_batch(int n, scr_file_check* checks, int threads)
+{
+  /* use fewer threads for a smaller number of files */
+  int nthreads = 1;
+#ifdef HAVE_PTHREADS
+  nthreads = threads;
+  if (nthreads > n / SCR_FILE_CHECK_MIN_FILES) {
+    nthreads = n / SCR_FILE_CHECK_MIN_FILES;
+  }
+#endif
+  if (nthreads <= 1) {
+    scr_file_check_range(checks, 0, 1, n);
+    return SCR_SUCCESS;
+  }
+
+  /* interleave files across threads, the calling thread takes the first share */
+  scr_file_check_args* args = (scr_file_check_args*) SCR_MALLOC(nthreads * sizeof(scr_file_check_args));
+  int t;
+  for (t = 0; t < nthreads; t++) {
+    args[t].checks = checks;
+    args[t].start  = t;
+    args[t].stride = nthreads;
+    args[t].n      = n;
+  }
+  scr_workers_run(nthreads, scr_file_check_thread, (void*) args, sizeof(scr_file_check_args));
+  scr_free(&args);
+
+  return SCR_SUCCESS;
+}
+
 /* tests whether the file or directory exists */
 int scr_file_exists(const char* file)
 {
@@ -747,8 +877,274 @@ int scr_file_unlink(const char* file)
   return SCR_SUCCESS;
 }
 
-/* opens, reads, and computes the crc32 value for the given filename */
-int scr_crc32(const char* filename, uLong* crc)
+/* define the name of the temporary file used to replace file, this is
+ * the basename of file prefixed with a dot and suffixed with .tmp in the
+ * same directory, so it never matches a pattern that matches file */
+int scr_file_tmpname(const char* file, char* tmpfile, size_t size)
+{
+  /* split the path into its directory and basename */
+  const char* base = strrchr(file, '/');
+  int dirlen = 0;
+  if (base != NULL) {
+    base++;
+    dirlen = (int) (base - file);
+  } else {
+    base = file;
+  }
+
+  int len = snprintf(tmpfile, size, "%.*s.%s.tmp", dirlen, file, base);
+  if (len < 0 || (size_t) len >= size) {
+    scr_err("Temporary file name for %s is too long @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* rename tmpfile to file, so that readers and a restarted process see
+ * either the old or all of the new contents of file, this does not fsync,
+ * since it is used for control files in cache, which don't outlive the node,
+ * deletes tmpfile on failure */
+int scr_file_replace(const char* tmpfile, const char* file)
+{
+  /* replace the original file with the temporary file */
+  if (rename(tmpfile, file) != 0) {
+    scr_err("Failed to rename %s to %s: errno=%d %s @ %s:%d",
+      tmpfile, file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_file_unlink(tmpfile);
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
+#ifdef SCR_CRC32_PCLMUL
+/* computes crc32 of len bytes in buf by folding 64 bytes at a time with
+ * carry-less multiplication, as described in "Fast CRC Computation for
+ * Generic Polynomials Using PCLMULQDQ Instruction" by Gopal et al. (Intel),
+ * requires len >= 64 and a multiple of 16, and crc is the bit-inverted
+ * running crc value (as opposed to the value returned by zlib) */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t scr_crc32_pclmul(const unsigned char* buf, size_t len, uint32_t crc)
+{
+  /* folding constants and Barrett reduction constants for the
+   * bit-reflected crc32 polynomial 0x04c11db7 */
+  static const uint64_t __attribute__((aligned(16))) k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+  static const uint64_t __attribute__((aligned(16))) k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+  static const uint64_t __attribute__((aligned(16))) k5k0[] = { 0x0163cd6124, 0x0000000000 };
+  static const uint64_t __attribute__((aligned(16))) poly[] = { 0x01db710641, 0x01f7011641 };
+
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+  /* load first 64 bytes and mix in the incoming crc */
+  x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+  x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+  x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+  x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+  x0 = _mm_load_si128((const __m128i*) k1k2);
+  buf += 64;
+  len -= 64;
+
+  /* fold four 128-bit lanes in parallel over each 64 byte block */
+  while (len >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+    y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+    buf += 64;
+    len -= 64;
+  }
+
+  /* fold the four lanes into one */
+  x0 = _mm_load_si128((const __m128i*) k3k4);
+
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+  x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+  x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+  /* fold any remaining 16 byte blocks */
+  while (len >= 16) {
+    x2 = _mm_loadu_si128((const __m128i*) buf);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    buf += 16;
+    len -= 16;
+  }
+
+  /* fold 128 bits down to 64 bits */
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_srli_si128(x1, 8);
+  x1 = _mm_xor_si128(x1, x2);
+
+  x0 = _mm_loadl_epi64((const __m128i*) k5k0);
+
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  /* Barrett reduce to 32 bits */
+  x0 = _mm_load_si128((const __m128i*) poly);
+
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return (uint32_t) _mm_extract_epi32(x1, 1);
+}
+#endif /* SCR_CRC32_PCLMUL */
+
+/* updates crc with len bytes from buf, same as zlib crc32(),
+ * but uses hardware acceleration when available */
+uLong scr_crc32_buf(uLong crc, const void* buf, size_t len)
+{
+  const unsigned char* ptr = (const unsigned char*) buf;
+
+#ifdef SCR_CRC32_PCLMUL
+  /* check once whether this processor supports the instructions we need */
+  static int have_pclmul = -1;
+  if (have_pclmul < 0) {
+    have_pclmul = (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"));
+  }
+
+  /* process as many 16 byte blocks as we can in hardware */
+  if (have_pclmul && len >= 64) {
+    size_t blocks = len & ~((size_t) 15);
+    uint32_t value = scr_crc32_pclmul(ptr, blocks, ~((uint32_t) crc));
+    crc = (uLong) ~value;
+    ptr += blocks;
+    len -= blocks;
+  }
+#endif
+
+  /* process the remaining bytes with zlib,
+   * which takes an unsigned int for the length */
+  while (len > 0) {
+    uInt count = (len > (size_t) UINT32_MAX) ? (uInt) UINT32_MAX : (uInt) len;
+    crc = crc32(crc, (const Bytef*) ptr, count);
+    ptr += count;
+    len -= count;
+  }
+
+  return crc;
+}
+
+/* describes a contiguous range of a file to compute a crc32 over */
+typedef struct {
+  const char* filename; /* name of file */
+  int fd;               /* open file descriptor */
+  off_t offset;         /* starting offset of range */
+  off_t length;         /* length of range, reads to end of file if negative,
+                         * set to number of bytes read on return */
+  uLong crc;            /* crc32 of range on return */
+  int rc;               /* SCR_SUCCESS if crc32 was computed */
+} scr_crc32_range_t;
+
+/* computes the crc32 of a range of a file, uses pread so that
+ * multiple threads can share a file descriptor */
+static void* scr_crc32_range(void* arg)
+{
+  scr_crc32_range_t* r = (scr_crc32_range_t*) arg;
+
+  r->crc = crc32(0L, Z_NULL, 0);
+  r->rc  = SCR_FAILURE;
+
+  char* buf = (char*) malloc(SCR_CRC32_BUF_SIZE);
+  if (buf == NULL) {
+    scr_dbg(1, "Failed to allocate buffer to compute crc: %s @ %s:%d",
+      r->filename, __FILE__, __LINE__
+    );
+    return NULL;
+  }
+
+  off_t offset = r->offset;
+  off_t total  = 0;
+  int reading = 1;
+  while (reading) {
+    /* determine how many bytes to read next */
+    size_t count = SCR_CRC32_BUF_SIZE;
+    if (r->length >= 0 && (off_t) count > r->length - total) {
+      count = (size_t) (r->length - total);
+    }
+    if (count == 0) {
+      break;
+    }
+
+    ssize_t nread = pread(r->fd, buf, count, offset);
+    if (nread < 0) {
+      if (errno == EINTR || errno == EAGAIN) {
+        continue;
+      }
+
+      /* got a real error, bail out */
+      scr_dbg(1, "Error while reading file to compute crc: %s errno=%d @ %s:%d",
+        r->filename, errno, __FILE__, __LINE__
+      );
+      scr_free(&buf);
+      return NULL;
+    } else if (nread == 0) {
+      /* hit end of file */
+      reading = 0;
+    } else {
+      r->crc = scr_crc32_buf(r->crc, buf, (size_t) nread);
+      offset += nread;
+      total  += nread;
+    }
+  }
+
+  /* a range in the middle of the file must be read in full */
+  if (r->length >= 0 && total != r->length) {
+    scr_dbg(1, "File changed size while computing crc: %s @ %s:%d",
+      r->filename, __FILE__, __LINE__
+    );
+    scr_free(&buf);
+    return NULL;
+  }
+
+  r->length = total;
+  r->rc = SCR_SUCCESS;
+
+  scr_free(&buf);
+  return NULL;
+}
+
+/* opens, reads, and computes the crc32 value for the given filename,
+ * large files are split into ranges whose crc values are computed by
+ * up to threads threads and then combined */
+int scr_crc32_parallel(const char* filename, int threads, uLong* crc)
 {
   /* check that we got a variable to write our answer to */
   if (crc == NULL) {
@@ -767,22 +1163,54 @@ int scr_crc32(const char* filename, uLong* crc)
     return SCR_FAILURE;
   }
 
-  /* read the file data in and compute its crc32 */
-  int nread = 0;
-  unsigned long buffer_size = 1024*1024;
-  char buf[buffer_size];
-  do {
-    nread = scr_read(filename, fd, buf, buffer_size);
-    if (nread > 0) {
-      *crc = crc32(*crc, (const Bytef*) buf, (uInt) nread);
+  /* get the file size so that we can split it into ranges */
+  off_t size = 0;
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) == 0) {
+    size = statbuf.st_size;
+  }
+
+  /* use fewer ranges for smaller files so each thread has enough work */
+  int ranges = 1;
+#ifdef HAVE_PTHREADS
+  ranges = threads;
+  while (ranges > 1 && size / ranges < SCR_CRC32_MIN_RANGE) {
+    ranges--;
+  }
+#endif
+  if (ranges < 1) {
+    ranges = 1;
+  }
+
+  /* define the range for each thread, the last range reads to the end
+   * of the file in case the file grew since we checked its size */
+  scr_crc32_range_t* r = (scr_crc32_range_t*) SCR_MALLOC(ranges * sizeof(scr_crc32_range_t));
+  off_t range_size = size / ranges;
+  int i;
+  for (i = 0; i < ranges; i++) {
+    r[i].filename = filename;
+    r[i].fd       = fd;
+    r[i].offset   = range_size * i;
+    r[i].length   = (i < ranges - 1) ? range_size : -1;
+  }
+
+  /* compute crc of each range in its own thread, we take the first range */
+  scr_workers_run(ranges, scr_crc32_range, (void*) r, sizeof(scr_crc32_range_t));
+
+  /* stitch the crc values of the ranges together in order */
+  int rc = SCR_SUCCESS;
+  for (i = 0; i < ranges; i++) {
+    if (r[i].rc != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+      break;
     }
-  } while (nread == buffer_size);
+    *crc = crc32_combine(*crc, r[i].crc, (z_off_t) r[i].length);
+  }
+
+  scr_free(&r);
 
   /* if we got an error, don't print anything and bailout */
-  if (nread < 0) {
-    scr_dbg(1, "Error while reading file to compute crc: %s @ %s:%d",
-      filename, __FILE__, __LINE__
-    );
+  if (rc != SCR_SUCCESS) {
     close(fd);
     return SCR_FAILURE;
   }
@@ -793,6 +1221,22 @@ int scr_crc32(const char* filename, uLong* crc)
   return SCR_SUCCESS;
 }
 
+/* max number of threads used by scr_crc32 */
+static int scr_crc32_threads = SCR_CRC_THREADS;
+
+/* set max number of threads scr_crc32 uses to compute the crc32 of a file,
+ * defaults to SCR_CRC_THREADS */
+void scr_crc32_set_threads(int threads)
+{
+  scr_crc32_threads = threads;
+}
+
+/* opens, reads, and computes the crc32 value for the given filename */
+int scr_crc32(const char* filename, uLong* crc)
+{
+  return scr_crc32_parallel(filename, scr_crc32_threads, crc);
+}
+
 /*
 =========================================
 Directory functions
@@ -893,14 +1337,330 @@ File Copy Functions
 =========================================
 */
 
-/* TODO: could perhaps use O_DIRECT here as an optimization */
-/* TODO: could apply compression/decompression here */
-/* copy src_file (full path) to dest_path and return new full path in dest_file */
+/* number of buffers in flight during a file copy */
+#define SCR_FILE_COPY_BUFS (3)
+
+/* files of at most this many buffers are copied serially, since starting
+ * the reader and writer threads costs more than overlapping them saves */
+#define SCR_FILE_COPY_PIPELINE_MIN (8)
+
+/* alignment of buffers, offsets, and lengths when using O_DIRECT */
+#define SCR_FILE_COPY_ALIGN (4096)
+
+/* states of a buffer in the file copy pipeline */
+#define SCR_FILE_COPY_EMPTY (0) /* buffer is free to be read into */
+#define SCR_FILE_COPY_READ  (1) /* buffer holds data, crc not yet computed */
+#define SCR_FILE_COPY_READY (2) /* buffer holds data ready to be written */
+
+/* state shared by the stages of a file copy */
+typedef struct {
+  const char* src_file; /* name of source file */
+  int src_fd;           /* open file descriptor to source file */
+  off_t src_size;       /* size of source file when opened, -1 if unknown */
+  const char* dst_file; /* name of destination file */
+  int dst_fd;           /* open file descriptor to destination file */
+  int direct;           /* whether dst_fd was opened with O_DIRECT */
+  size_t buf_size;      /* size of each buffer in bytes */
+  uLong* crc;           /* running crc value, NULL if not computed */
+  int error;            /* set to 1 if any stage hits an error */
+
+  char*   bufs[SCR_FILE_COPY_BUFS];  /* data buffers */
+  ssize_t lens[SCR_FILE_COPY_BUFS];  /* number of valid bytes in each buffer */
+  int     state[SCR_FILE_COPY_BUFS]; /* state of each buffer */
+
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t mutex; /* protects error, lens, and state */
+  pthread_cond_t  cond;  /* signaled on any change to state or error */
+#endif
+} scr_file_copy_t;
+
+/* write nwrite bytes from buf to the destination file, returns SCR_SUCCESS
+ * if all bytes are written, O_DIRECT requires the length to be a multiple of
+ * the block size, so we disable O_DIRECT to write the tail of the file */
+static int scr_file_copy_write(scr_file_copy_t* c, const char* buf, ssize_t nwrite)
+{
+  ssize_t head = nwrite;
+#ifdef O_DIRECT
+  if (c->direct) {
+    head = nwrite - (nwrite % SCR_FILE_COPY_ALIGN);
+  }
+#endif
+
+  /* write the aligned portion of the buffer */
+  if (head > 0) {
+    if (scr_write_attempt(c->dst_file, c->dst_fd, buf, head) != head) {
+      return SCR_FAILURE;
+    }
+  }
+
+  /* write any remaining bytes without O_DIRECT */
+  ssize_t tail = nwrite - head;
+  if (tail > 0) {
+#ifdef O_DIRECT
+    int flags = fcntl(c->dst_fd, F_GETFL);
+    if (flags < 0 || fcntl(c->dst_fd, F_SETFL, flags & ~O_DIRECT) < 0) {
+      scr_err("Failed to disable O_DIRECT on %s errno=%d %s @ %s:%d",
+        c->dst_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+    c->direct = 0;
+#endif
+    if (scr_write_attempt(c->dst_file, c->dst_fd, buf + head, tail) != tail) {
+      return SCR_FAILURE;
+    }
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* copy file by reading, computing the crc, and writing one buffer at a time */
+static int scr_file_copy_serial(scr_file_copy_t* c)
+{
+  int rc = SCR_SUCCESS;
+
+  char* buf = c->bufs[0];
+  int copying = 1;
+  while (copying) {
+    /* attempt to read buf_size bytes from file */
+    ssize_t nread = scr_read_attempt(c->src_file, c->src_fd, buf, c->buf_size);
+
+    /* if we read some bytes, write them out */
+    if (nread > 0) {
+      /* optionally compute crc value as we go */
+      if (c->crc != NULL) {
+        *c->crc = scr_crc32_buf(*c->crc, buf, (size_t) nread);
+      }
+
+      /* write our nread bytes out */
+      if (scr_file_copy_write(c, buf, nread) != SCR_SUCCESS) {
+        /* write had a problem, stop copying and return an error */
+        copying = 0;
+        rc = SCR_FAILURE;
+      }
+    }
+
+    /* assume a short read means we hit the end of the file */
+    if (nread < (ssize_t) c->buf_size) {
+      copying = 0;
+    }
+
+    /* check for a read error, stop copying and return an error */
+    if (nread < 0) {
+      /* read had a problem, stop copying and return an error */
+      copying = 0;
+      rc = SCR_FAILURE;
+    }
+  }
+
+  return rc;
+}
+
+#ifdef HAVE_PTHREADS
+/* wait until buffer i reaches the given state, returns 1 if it did,
+ * and 0 if some other stage hit an error first */
+static int scr_file_copy_wait(scr_file_copy_t* c, int i, int state)
+{
+  pthread_mutex_lock(&c->mutex);
+  while (c->state[i] != state && ! c->error) {
+    pthread_cond_wait(&c->cond, &c->mutex);
+  }
+  int ok = ! c->error;
+  pthread_mutex_unlock(&c->mutex);
+  return ok;
+}
+
+/* move buffer i to the given state, and flag an error if error is set */
+static void scr_file_copy_post(scr_file_copy_t* c, int i, int state, int error)
+{
+  pthread_mutex_lock(&c->mutex);
+  c->state[i] = state;
+  if (error) {
+    c->error = 1;
+  }
+  pthread_cond_broadcast(&c->cond);
+  pthread_mutex_unlock(&c->mutex);
+}
+
+/* reader stage, reads successive chunks of the source file into free buffers,
+ * a buffer holding fewer than buf_size bytes marks the end of the file */
+static void* scr_file_copy_reader(void* arg)
+{
+  scr_file_copy_t* c = (scr_file_copy_t*) arg;
+
+  int i = 0;
+  int reading = 1;
+  while (reading && scr_file_copy_wait(c, i, SCR_FILE_COPY_EMPTY)) {
+    ssize_t nread = scr_read_attempt(c->src_file, c->src_fd, c->bufs[i], c->buf_size);
+    if (nread < (ssize_t) c->buf_size) {
+      reading = 0;
+    }
+    c->lens[i] = nread;
+    scr_file_copy_post(c, i, SCR_FILE_COPY_READ, (nread < 0));
+    i = (i + 1) % SCR_FILE_COPY_BUFS;
+  }
+
+  return NULL;
+}
+
+/* writer stage, writes out buffers in order and returns them to the reader */
+static void* scr_file_copy_writer(void* arg)
+{
+  scr_file_copy_t* c = (scr_file_copy_t*) arg;
+
+  int i = 0;
+  int writing = 1;
+  while (writing && scr_file_copy_wait(c, i, SCR_FILE_COPY_READY)) {
+    ssize_t nwrite = c->lens[i];
+    int error = 0;
+    if (nwrite > 0 && scr_file_copy_write(c, c->bufs[i], nwrite) != SCR_SUCCESS) {
+      error = 1;
+    }
+    if (nwrite < (ssize_t) c->buf_size) {
+      writing = 0;
+    }
+    scr_file_copy_post(c, i, SCR_FILE_COPY_EMPTY, error);
+    i = (i + 1) % SCR_FILE_COPY_BUFS;
+  }
+
+  return NULL;
+}
+
+/* copy file with separate reader and writer threads, the calling thread
+ * computes the crc of each buffer between the read and the write, so
+ * reading, checksumming, and writing all proceed at the same time */
+static int scr_file_copy_pipeline(scr_file_copy_t* c)
+{
+  pthread_mutex_init(&c->mutex, NULL);
+  pthread_cond_init(&c->cond, NULL);
+
+  /* start the reader and writer threads */
+  pthread_t reader, writer;
+  if (pthread_create(&reader, NULL, scr_file_copy_reader, (void*) c) != 0) {
+    /* could not start the pipeline, just copy the file ourself */
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->mutex);
+    return scr_file_copy_serial(c);
+  }
+  if (pthread_create(&writer, NULL, scr_file_copy_writer, (void*) c) != 0) {
+    scr_err("Failed to create writer thread to copy %s @ %s:%d",
+      c->src_file, __FILE__, __LINE__
+    );
+    scr_file_copy_post(c, 0, SCR_FILE_COPY_EMPTY, 1);
+    pthread_join(reader, NULL);
+    pthread_cond_destroy(&c->cond);
+    pthread_mutex_destroy(&c->mutex);
+    return SCR_FAILURE;
+  }
+
+  /* compute crc of each buffer as it arrives from the reader */
+  int i = 0;
+  int checking = 1;
+  while (checking && scr_file_copy_wait(c, i, SCR_FILE_COPY_READ)) {
+    ssize_t nread = c->lens[i];
+    if (nread > 0 && c->crc != NULL) {
+      *c->crc = scr_crc32_buf(*c->crc, c->bufs[i], (size_t) nread);
+    }
+    if (nread < (ssize_t) c->buf_size) {
+      checking = 0;
+    }
+    scr_file_copy_post(c, i, SCR_FILE_COPY_READY, 0);
+    i = (i + 1) % SCR_FILE_COPY_BUFS;
+  }
+
+  /* wait for both threads to finish */
+  pthread_join(reader, NULL);
+  pthread_join(writer, NULL);
+
+  pthread_cond_destroy(&c->cond);
+  pthread_mutex_destroy(&c->mutex);
+
+  return (c->error ? SCR_FAILURE : SCR_SUCCESS);
+}
+#endif /* HAVE_PTHREADS */
+
+/* max number of bytes to ask the kernel to copy in one call */
+#define SCR_FILE_COPY_KERNEL_CHUNK (1024*1024*1024)
+
+/* copy the file within the kernel using copy_file_range() or sendfile(),
+ * which avoids moving data through a user-space buffer, these calls advance
+ * the file offsets of both descriptors, so if the kernel does not support
+ * either call for these files, we set *done to 0 and the caller finishes
+ * the copy from the current offsets with read and write */
+static int scr_file_copy_kernel(scr_file_copy_t* c, int* done)
+{
+  *done = 0;
+
+#ifdef __linux__
+  /* a zero-byte return before we reach the size of the
+   * source file means the kernel did not copy the data */
+  off_t size = c->src_size;
+  if (size < 0) {
+    return SCR_SUCCESS;
+  }
+  off_t copied = 0;
+
+#ifdef SCR_HAVE_COPY_FILE_RANGE
+  /* copy_file_range lets the file system copy data directly,
+   * which may avoid moving the data at all */
+  int use_range = 1;
+  while (use_range) {
+    ssize_t n = copy_file_range(c->src_fd, NULL, c->dst_fd, NULL, SCR_FILE_COPY_KERNEL_CHUNK, 0);
+    if (n > 0) {
+      copied += n;
+    } else if (n == 0 && copied >= size) {
+      /* hit end of file */
+      *done = 1;
+      return SCR_SUCCESS;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else {
+      /* not supported for these files (e.g., EXDEV or EINVAL),
+       * or it stopped short, so try sendfile instead */
+      use_range = 0;
+    }
+  }
+#endif
+
+  /* sendfile copies through the page cache without a user-space buffer */
+  while (1) {
+    ssize_t n = sendfile(c->dst_fd, c->src_fd, NULL, SCR_FILE_COPY_KERNEL_CHUNK);
+    if (n > 0) {
+      copied += n;
+    } else if (n == 0 && copied >= size) {
+      /* hit end of file */
+      *done = 1;
+      return SCR_SUCCESS;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && errno != EINVAL && errno != ENOSYS) {
+      /* hit a real error, like running out of space */
+      scr_err("Failed to copy %s to %s: sendfile() errno=%d %s @ %s:%d",
+        c->src_file, c->dst_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    } else {
+      /* not supported, or stopped short, fall back to read and write */
+      return SCR_SUCCESS;
+    }
+  }
+#endif
+
+  return SCR_SUCCESS;
+}
+
+/* copy src_file (full path) to dest_path and return new full path in dest_file,
+ * data moves through buffers of buf_size bytes, and for files that span many
+ * buffers, reads, crc computation, and writes overlap, set SCR_FILE_COPY_DIRECT
+ * in flags to bypass the page cache with O_DIRECT where the file system
+ * supports it, if neither a crc nor O_DIRECT is requested, the kernel copies
+ * the data without a user-space buffer if it can */
 int scr_file_copy(
   const char* src_file,
   const char* dst_file,
   unsigned long buf_size,
-  uLong* crc)
+  uLong* crc,
+  int flags)
 {
   /* check that we got something for a source file */
   if (src_file == NULL || strcmp(src_file, "") == 0) {
@@ -918,10 +1678,31 @@ int scr_file_copy(
     return SCR_FAILURE;
   }
 
+  /* O_DIRECT requires aligned buffers and lengths, so round up buffer size */
+  int direct = 0;
+#ifdef O_DIRECT
+  if (flags & SCR_FILE_COPY_DIRECT) {
+    direct = 1;
+    buf_size = (buf_size + SCR_FILE_COPY_ALIGN - 1) / SCR_FILE_COPY_ALIGN * SCR_FILE_COPY_ALIGN;
+    if (buf_size == 0) {
+      buf_size = SCR_FILE_COPY_ALIGN;
+    }
+  }
+#endif
+
   int rc = SCR_SUCCESS;
 
-  /* open src_file for reading */
-  int src_fd = scr_open(src_file, O_RDONLY);
+  /* open src_file for reading, some file systems (like tmpfs)
+   * do not support O_DIRECT, so fall back to buffered I/O */
+  int src_fd = -1;
+#ifdef O_DIRECT
+  if (direct) {
+    src_fd = open(src_file, O_RDONLY | O_DIRECT);
+  }
+#endif
+  if (src_fd < 0) {
+    src_fd = scr_open(src_file, O_RDONLY);
+  }
   if (src_fd < 0) {
     scr_err("Opening file to copy: scr_open(%s) errno=%d %s @ %s:%d",
       src_file, errno, strerror(errno), __FILE__, __LINE__
@@ -931,7 +1712,18 @@ int scr_file_copy(
 
   /* open dest_file for writing */
   mode_t mode_file = scr_getmode(1, 1, 0);
-  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  int dst_fd = -1;
+#ifdef O_DIRECT
+  if (direct) {
+    dst_fd = open(dst_file, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, mode_file);
+    if (dst_fd < 0) {
+      direct = 0;
+    }
+  }
+#endif
+  if (dst_fd < 0) {
+    dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  }
   if (dst_fd < 0) {
     scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
       dst_file, errno, strerror(errno), __FILE__, __LINE__
@@ -950,15 +1742,22 @@ int scr_file_copy(
   posix_fadvise(dst_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
 #endif
 
-  /* allocate buffer to read in file chunks */
-  char* buf = (char*) malloc(buf_size);
-  if (buf == NULL) {
-    scr_err("Allocating memory: malloc(%llu) errno=%d %s @ %s:%d",
-      buf_size, errno, strerror(errno), __FILE__, __LINE__
-    );
-    scr_close(dst_file, dst_fd);
-    scr_close(src_file, src_fd);
-    return SCR_FAILURE;
+  /* define the state of our copy */
+  scr_file_copy_t c;
+  memset(&c, 0, sizeof(c));
+  c.src_file = src_file;
+  c.src_fd   = src_fd;
+  c.src_size = -1;
+  c.dst_file = dst_file;
+  c.dst_fd   = dst_fd;
+  c.direct   = direct;
+  c.buf_size = (size_t) buf_size;
+  c.crc      = crc;
+
+  /* get the size of the source file to pick how to copy it */
+  struct stat statbuf;
+  if (fstat(src_fd, &statbuf) == 0) {
+    c.src_size = statbuf.st_size;
   }
 
   /* initialize crc values */
@@ -966,45 +1765,52 @@ int scr_file_copy(
     *crc = crc32(0L, Z_NULL, 0);
   }
 
-  /* write chunks */
-  int copying = 1;
-  while (copying) {
-    /* attempt to read buf_size bytes from file */
-    int nread = scr_read_attempt(src_file, src_fd, buf, buf_size);
-
-    /* if we read some bytes, write them out */
-    if (nread > 0) {
-      /* optionally compute crc value as we go */
-      if (crc != NULL) {
-        *crc = crc32(*crc, (const Bytef*) buf, (uInt) nread);
-      }
-
-      /* write our nread bytes out */
-      int nwrite = scr_write_attempt(dst_file, dst_fd, buf, nread);
+  /* without a crc or O_DIRECT, we don't need to see the data,
+   * so first try to have the kernel copy it for us */
+  int done = 0;
+  if (crc == NULL && ! direct) {
+    rc = scr_file_copy_kernel(&c, &done);
+  }
 
-      /* check for a write error or a short write */
-      if (nwrite != nread) {
-        /* write had a problem, stop copying and return an error */
-        copying = 0;
+  /* only overlap reads and writes for files that span many buffers,
+   * the serial copy needs just one buffer */
+  int pipeline = 0;
+#ifdef HAVE_PTHREADS
+  pipeline = (c.src_size > (off_t) c.buf_size * SCR_FILE_COPY_PIPELINE_MIN);
+#endif
+  int bufs = pipeline ? SCR_FILE_COPY_BUFS : 1;
+
+  /* copy the file, or whatever the kernel did not copy */
+  int i;
+  if (rc == SCR_SUCCESS && ! done) {
+    /* allocate buffers to read in file chunks, aligned for O_DIRECT */
+    for (i = 0; i < bufs; i++) {
+      c.bufs[i] = (char*) scr_align_malloc(c.buf_size, SCR_FILE_COPY_ALIGN);
+      if (c.bufs[i] == NULL) {
+        scr_err("Allocating memory: scr_align_malloc(%llu) errno=%d %s @ %s:%d",
+          buf_size, errno, strerror(errno), __FILE__, __LINE__
+        );
         rc = SCR_FAILURE;
       }
     }
 
-    /* assume a short read means we hit the end of the file */
-    if (nread < buf_size) {
-      copying = 0;
-    }
-
-    /* check for a read error, stop copying and return an error */
-    if (nread < 0) {
-      /* read had a problem, stop copying and return an error */
-      copying = 0;
-      rc = SCR_FAILURE;
+    if (rc == SCR_SUCCESS) {
+#ifdef HAVE_PTHREADS
+      if (pipeline) {
+        rc = scr_file_copy_pipeline(&c);
+      } else {
+        rc = scr_file_copy_serial(&c);
+      }
+#else
+      rc = scr_file_copy_serial(&c);
+#endif
     }
   }
 
-  /* free buffer */
-  scr_free(&buf);
+  /* free buffers */
+  for (i = 0; i < SCR_FILE_COPY_BUFS; i++) {
+    scr_align_free(&c.bufs[i]);
+  }
 
   /* close source and destination files */
   if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
@@ -15,6 +15,7 @@
 #include <config.h>
 #include <stdarg.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 
 /* compute crc32 */
 #include <zlib.h>
@@ -71,7 +72,8 @@ ssize_t scr_read_line(const char* file, int fd, char* buf, size_t size);
 ssize_t scr_writef(const char* file, int fd, const char* format, ...);
 
 /* logically concatenate n opened files and read count bytes from this logical file into buf starting
- * from offset, pad with zero on end if missing data */
+ * from offset, pad with zero on end if missing data, uses pread so multiple threads may read
+ * from the same files at once */
 int scr_read_pad_n(
   int n,
   char** files,
@@ -82,7 +84,8 @@ int scr_read_pad_n(
   unsigned long* filesizes
 );
 
-/* write to an array of open files with known filesizes and treat them as one single large file */
+/* write to an array of open files with known filesizes and treat them as one single large file,
+ * uses pwrite so multiple threads may write to the same files at once */
 int scr_write_pad_n(
   int n,
   char** files,
@@ -96,6 +99,18 @@ int scr_write_pad_n(
 /* given a filename, return number of bytes in file */
 unsigned long scr_file_size(const char* file);
 
+/* records whether a file is readable and the result of stat on it */
+typedef struct {
+  const char* file;    /* name of file to check */
+  int readable;        /* 1 if caller can read the file, 0 otherwise */
+  int stat_rc;         /* 0 if stat succeeded, in which case statbuf is valid */
+  struct stat statbuf; /* result of stat */
+} scr_file_check;
+
+/* checks whether each of n files is readable and stats it, spreading the
+ * work over up to threads threads, the file field of each entry must be set */
+int scr_file_check_batch(int n, scr_file_check* checks, int threads);
+
 /* tests whether the file or directory exists */
 int scr_file_exists(const char* file);
 
@@ -108,9 +123,30 @@ int scr_file_is_writeable(const char* file);
 /* delete a file */
 int scr_file_unlink(const char* file);
 
+/* define the name of the temporary file used to replace file, this is
+ * the basename of file prefixed with a dot and suffixed with .tmp in the
+ * same directory, so it never matches a pattern that matches file */
+int scr_file_tmpname(const char* file, char* tmpfile, size_t size);
+
+/* rename tmpfile to file, so that readers see either the old or all of
+ * the new contents of file, does not fsync, deletes tmpfile on failure */
+int scr_file_replace(const char* tmpfile, const char* file);
+
+/* updates crc with len bytes from buf, same as zlib crc32(),
+ * but uses hardware acceleration when available */
+uLong scr_crc32_buf(uLong crc, const void* buf, size_t len);
+
+/* set max number of threads scr_crc32 uses to compute the crc32 of a file,
+ * defaults to SCR_CRC_THREADS */
+void scr_crc32_set_threads(int threads);
+
 /* opens, reads, and computes the crc32 value for the given filename */
 int scr_crc32(const char* filename, uLong* crc);
 
+/* same as scr_crc32, but splits large files into ranges
+ * that are processed by up to threads threads */
+int scr_crc32_parallel(const char* filename, int threads, uLong* crc);
+
 /*
 =========================================
 Directory functions
@@ -132,11 +168,17 @@ File Copy Functions
 =========================================
 */
 
+/* flags for scr_file_copy */
+#define SCR_FILE_COPY_DIRECT (1) /* bypass page cache with O_DIRECT if supported */
+
+/* copy src_file to dst_file using buffers of buf_size bytes,
+ * computes crc32 of file if crc is not NULL */
 int scr_file_copy(
   const char* src_file,
   const char* dst_file,
   unsigned long buf_size,
-  uLong* crc
+  uLong* crc,
+  int flags
 );
 
 #endif
@@ -57,6 +57,8 @@ Define common hash key strings
 #define SCR_KEY_META      ("META")
 #define SCR_KEY_COMPLETE  ("COMPLETE")
 #define SCR_KEY_CRC       ("CRC")
+#define SCR_KEY_BASE      ("BASE")
+#define SCR_KEY_COMPRESS  ("COMPRESS")
 
 /* these keys are kept in hashes stored in files for long periods of time,
  * thus we associate a version number with them in order to read old files */
@@ -91,6 +93,15 @@ Define common hash key strings
 #define SCR_SUMMARY_6_KEY_LENGTH    ("LENGTH")
 #define SCR_SUMMARY_6_KEY_OFFSET    ("OFFSET")
 
+#define SCR_DELTA_KEY_VERSION ("VERSION")
+
+#define SCR_DELTA_FILE_VERSION_1 (1)
+#define SCR_DELTA_1_KEY_SIZE      ("SIZE")
+#define SCR_DELTA_1_KEY_BLOCKSIZE ("BLOCKSIZE")
+#define SCR_DELTA_1_KEY_BASECRC   ("BASECRC")
+#define SCR_DELTA_1_KEY_RANGE     ("RANGE")
+#define SCR_DELTA_1_KEY_COUNT     ("COUNT")
+
 #define SCR_INDEX_KEY_VERSION ("VERSION")
 
 #define SCR_INDEX_FILE_VERSION_1 (1)
@@ -104,6 +115,7 @@ Define common hash key strings
 #define SCR_INDEX_1_KEY_FLUSHED   ("FLUSHED")
 #define SCR_INDEX_1_KEY_FAILED    ("FAILED")
 #define SCR_INDEX_1_KEY_CURRENT   ("CURRENT")
+#define SCR_INDEX_1_KEY_BASE      ("BASE")
 
 /* the rest of these hash keys are only used in memory or in files
  * that live for the life of the job, thus backwards compatibility is not needed */
@@ -123,6 +135,14 @@ Define common hash key strings
 
 #define SCR_NODES_KEY_NODES ("NODES")
 
+/* per-window transfer stats recorded by scr_axl_window */
+#define SCR_WINDOW_KEY_WINDOW ("WINDOW")
+#define SCR_WINDOW_KEY_START  ("START")
+#define SCR_WINDOW_KEY_SECS   ("SECS")
+#define SCR_WINDOW_KEY_BYTES  ("BYTES")
+#define SCR_WINDOW_KEY_FILES  ("FILES")
+#define SCR_WINDOW_KEY_PROCS  ("PROCS")
+
 /* transfer file keys */
 #define SCR_TRANSFER_KEY_FILES       ("FILES")
 #define SCR_TRANSFER_KEY_DESTINATION ("DESTINATION")
@@ -192,6 +212,14 @@ Define common hash key strings
 #define SCR_META_KEY_CTIME_NSECS ("CTIME_NSECS")
 #define SCR_META_KEY_MTIME_SECS  ("MTIME_SECS")
 #define SCR_META_KEY_MTIME_NSECS ("MTIME_NSECS")
+#define SCR_META_KEY_DELTA     ("DELTA")
+#define SCR_META_KEY_DELTA_FILE     ("FILE")
+#define SCR_META_KEY_DELTA_BASE     ("BASE")
+#define SCR_META_KEY_DELTA_BASEFILE ("BASEFILE")
+#define SCR_META_KEY_DELTA_BASEORIG ("BASEORIG")
+#define SCR_META_KEY_COMPRESS       ("COMPRESS")
+#define SCR_META_KEY_COMPRESS_CODEC ("CODEC")
+#define SCR_META_KEY_COMPRESS_SIZE  ("SIZE")
 
 #define SCR_KEY_COPY_XOR_CHUNK   ("CHUNK")
 #define SCR_KEY_COPY_XOR_DATASET ("DSET")
@@ -157,6 +157,35 @@ int scr_meta_set_crc32(scr_meta* meta, uLong crc)
   return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
 }
 
+/* records that the changed blocks of this file are stored in delta_file,
+ * relative to file base_file of dataset base_id, whose original path is base_orig */
+int scr_meta_set_delta(scr_meta* meta, const char* delta_file, int base_id, const char* base_file, const char* base_orig)
+{
+  kvtree* delta = kvtree_set(meta, SCR_META_KEY_DELTA, kvtree_new());
+  kvtree_util_set_str(delta, SCR_META_KEY_DELTA_FILE,     delta_file);
+  kvtree_util_set_int(delta, SCR_META_KEY_DELTA_BASE,     base_id);
+  kvtree_util_set_str(delta, SCR_META_KEY_DELTA_BASEFILE, base_file);
+  kvtree_util_set_str(delta, SCR_META_KEY_DELTA_BASEORIG, base_orig);
+  return SCR_SUCCESS;
+}
+
+/* removes any delta recorded for this file */
+int scr_meta_unset_delta(scr_meta* meta)
+{
+  kvtree_unset(meta, SCR_META_KEY_DELTA);
+  return SCR_SUCCESS;
+}
+
+/* records that this file is compressed with the named codec,
+ * and the size of the file before it was compressed */
+int scr_meta_set_compress(scr_meta* meta, const char* codec, unsigned long size)
+{
+  kvtree* compress = kvtree_set(meta, SCR_META_KEY_COMPRESS, kvtree_new());
+  kvtree_util_set_str(compress, SCR_META_KEY_COMPRESS_CODEC, codec);
+  kvtree_util_set_bytecount(compress, SCR_META_KEY_COMPRESS_SIZE, size);
+  return SCR_SUCCESS;
+}
+
 static void scr_stat_get_atimes(const struct stat* sb, uint64_t* secs, uint64_t* nsecs)
 {
     *secs = (uint64_t) sb->st_atime;
@@ -306,6 +335,70 @@ int scr_meta_get_crc32(const scr_meta* meta, uLong* crc)
   return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
 }
 
+/* gets codec and size before compression recorded for this file,
+ * returns SCR_SUCCESS if the file is compressed,
+ * either of the output parameters may be NULL */
+int scr_meta_get_compress(const scr_meta* meta, char** codec, unsigned long* size)
+{
+  kvtree* compress = kvtree_get(meta, SCR_META_KEY_COMPRESS);
+  if (compress == NULL) {
+    return SCR_FAILURE;
+  }
+
+  char* name;
+  unsigned long bytes;
+  if (kvtree_util_get_str(compress, SCR_META_KEY_COMPRESS_CODEC, &name) != KVTREE_SUCCESS ||
+      kvtree_util_get_bytecount(compress, SCR_META_KEY_COMPRESS_SIZE, &bytes) != KVTREE_SUCCESS)
+  {
+    return SCR_FAILURE;
+  }
+
+  if (codec != NULL) {
+    *codec = name;
+  }
+  if (size != NULL) {
+    *size = bytes;
+  }
+  return SCR_SUCCESS;
+}
+
+/* gets delta file and base file recorded for this file,
+ * returns SCR_SUCCESS if the file is stored as a delta,
+ * any of the output parameters may be NULL */
+int scr_meta_get_delta(const scr_meta* meta, char** delta_file, int* base_id, char** base_file, char** base_orig)
+{
+  kvtree* delta = kvtree_get(meta, SCR_META_KEY_DELTA);
+  if (delta == NULL) {
+    return SCR_FAILURE;
+  }
+
+  char* file;
+  char* bfile;
+  char* borig;
+  int bid;
+  if (kvtree_util_get_str(delta, SCR_META_KEY_DELTA_FILE,     &file)  != KVTREE_SUCCESS ||
+      kvtree_util_get_int(delta, SCR_META_KEY_DELTA_BASE,     &bid)   != KVTREE_SUCCESS ||
+      kvtree_util_get_str(delta, SCR_META_KEY_DELTA_BASEFILE, &bfile) != KVTREE_SUCCESS ||
+      kvtree_util_get_str(delta, SCR_META_KEY_DELTA_BASEORIG, &borig) != KVTREE_SUCCESS)
+  {
+    return SCR_FAILURE;
+  }
+
+  if (delta_file != NULL) {
+    *delta_file = file;
+  }
+  if (base_id != NULL) {
+    *base_id = bid;
+  }
+  if (base_file != NULL) {
+    *base_file = bfile;
+  }
+  if (base_orig != NULL) {
+    *base_orig = borig;
+  }
+  return SCR_SUCCESS;
+}
+
 /*
 =========================================
 Check field values
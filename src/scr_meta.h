@@ -97,6 +97,17 @@ int scr_meta_set_stat(scr_meta* meta, struct stat* statbuf);
 /* set the crc32 field on meta */
 int scr_meta_set_crc32(scr_meta* meta, uLong crc);
 
+/* records that the changed blocks of this file are stored in delta_file,
+ * relative to file base_file of dataset base_id, whose original path is base_orig */
+int scr_meta_set_delta(scr_meta* meta, const char* delta_file, int base_id, const char* base_file, const char* base_orig);
+
+/* removes any delta recorded for this file */
+int scr_meta_unset_delta(scr_meta* meta);
+
+/* records that this file is compressed with the named codec,
+ * and the size of the file before it was compressed */
+int scr_meta_set_compress(scr_meta* meta, const char* codec, unsigned long size);
+
 /*
 =========================================
 Get field values
@@ -130,6 +141,16 @@ int scr_meta_get_complete(const scr_meta* meta, int* complete);
 /* get the crc32 field in meta data, returns SCR_SUCCESS if a field is set */
 int scr_meta_get_crc32(const scr_meta* meta, uLong* crc);
 
+/* gets delta file and base file recorded for this file,
+ * returns SCR_SUCCESS if the file is stored as a delta,
+ * any of the output parameters may be NULL */
+int scr_meta_get_delta(const scr_meta* meta, char** delta_file, int* base_id, char** base_file, char** base_orig);
+
+/* gets codec and size before compression recorded for this file,
+ * returns SCR_SUCCESS if the file is compressed,
+ * either of the output parameters may be NULL */
+int scr_meta_get_compress(const scr_meta* meta, char** codec, unsigned long* size);
+
 /*
 =========================================
 Check field values
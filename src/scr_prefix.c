@@ -264,6 +264,9 @@ static int scr_prefix_delete_data(int id)
       MPI_Barrier(scr_comm_world);
     }
 
+    /* we may have deleted directories that flush created */
+    scr_flush_create_dirs_reset();
+
     /* free dtcmp buffers */
     scr_free(&group_id);
     scr_free(&group_ranks);
@@ -328,7 +331,8 @@ int scr_prefix_delete(int id, const char* name)
 /* keep a sliding window of checkpoints in the prefix directory,
  * delete any pure checkpoints that fall outside of the window
  * defined by the given dataset id and the window width,
- * excludes checkpoints that are marked as output */
+ * excludes checkpoints that are marked as output and checkpoints
+ * that hold the base files of deltas in newer datasets */
 int scr_prefix_delete_sliding(int id, int window)
 {
   /* rank 0 reads the index file */
@@ -391,6 +395,13 @@ int scr_prefix_delete_sliding(int id, int window)
           }
         }
         scr_dataset_delete(&dataset);
+
+        /* nor checkpoints whose files newer incremental checkpoints
+         * in the prefix directory were flushed as deltas against */
+        if (scr_index_is_base(index_hash, target_id)) {
+          scr_dbg(2, "Keeping dataset %d `%s' as a base of a newer dataset", target_id, target);
+          continue;
+        }
       }
     }
 
@@ -456,8 +467,9 @@ int scr_prefix_delete_all(void)
     int target_id;
     char target[SCR_MAX_FILENAME];
     if (scr_my_rank_world == 0) {
-      /* get the oldest dataset id */
-      scr_index_get_oldest(index_hash, &target_id, target);
+      /* get the oldest dataset id, deleting datasets whose files
+       * are the base of deltas in a newer dataset after the newer one */
+      scr_index_get_oldest_deletable(index_hash, &target_id, target);
     }
 
     /* broadcast target id from rank 0 */
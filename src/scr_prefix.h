@@ -18,7 +18,8 @@ int scr_prefix_delete(int id, const char* name);
 /* keep a sliding window of checkpoints in the prefix directory,
  * delete any pure checkpoints that fall outside of the window
  * defined by the given dataset id and the window width,
- * excludes checkpoints that are marked as output */
+ * excludes checkpoints that are marked as output and checkpoints
+ * that hold the base files of deltas in newer datasets */
 int scr_prefix_delete_sliding(int id, int window);
 
 /* delete all datasets listed in the index file,
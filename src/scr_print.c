@@ -1,4 +1,6 @@
 #include "kvtree.h"
+#include "spath.h"
+#include "scr_filemap.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -103,9 +105,13 @@ int main(int argc, char* argv[])
   /* get the file name */
   char* filename = argv[optind];
 
-  /* read in the file */
+  /* read in the file, filemaps may be written in binary format,
+   * which scr_filemap_read understands along with plain kvtree files */
   kvtree* hash = kvtree_new();
-  if (kvtree_read_file(filename, hash) == KVTREE_SUCCESS) {
+  spath* path = spath_from_str(filename);
+  int read_rc = scr_filemap_read(path, hash);
+  spath_delete(&path);
+  if (read_rc == SCR_SUCCESS) {
     /* we read the file, now print it out */
     kvtree_sort_recursive(hash);
     kvtree_print_mode(hash, 0, print_mode);
@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Rebuild missing files of a redundancy set from the
+ * redundancy files that were copied to the prefix directory. */
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_io.h"
+#include "scr_meta.h"
+#include "scr_err.h"
+#include "scr_util.h"
+#include "scr_filemap.h"
+#include "scr_rebuild.h"
+
+#include "spath.h"
+#include "kvtree.h"
+#include "kvtree_util.h"
+#include "redset.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#ifdef SCR_GLOBALS_H
+#error "globals.h accessed from tools"
+#endif
+
+struct scr_rebuild_cache_struct {
+  kvtree* filemaps;     /* views of filemaps read from the dataset directory, indexed by rank */
+#ifdef HAVE_PTHREADS
+  pthread_mutex_t lock; /* protects filemaps when rebuilds run in different threads */
+#endif
+};
+
+/* allocate an empty filemap cache */
+scr_rebuild_cache* scr_rebuild_cache_new(void)
+{
+  scr_rebuild_cache* cache = (scr_rebuild_cache*) SCR_MALLOC(sizeof(scr_rebuild_cache));
+  cache->filemaps = kvtree_new();
+#ifdef HAVE_PTHREADS
+  pthread_mutex_init(&cache->lock, NULL);
+#endif
+  return cache;
+}
+
+/* free a filemap cache and all filemaps it holds */
+int scr_rebuild_cache_delete(scr_rebuild_cache** ptr_cache)
+{
+  if (ptr_cache != NULL) {
+    scr_rebuild_cache* cache = *ptr_cache;
+    if (cache != NULL) {
+      /* close each view we hold */
+      kvtree_elem* elem;
+      for (elem = kvtree_elem_first(cache->filemaps);
+           elem != NULL;
+           elem = kvtree_elem_next(elem))
+      {
+        void* ptr = NULL;
+        kvtree_util_get_ptr(cache->filemaps, kvtree_elem_key(elem), &ptr);
+        scr_filemap_view* view = (scr_filemap_view*) ptr;
+        scr_filemap_view_close(&view);
+      }
+      kvtree_delete(&cache->filemaps);
+#ifdef HAVE_PTHREADS
+      pthread_mutex_destroy(&cache->lock);
+#endif
+    }
+    scr_free(ptr_cache);
+  }
+  return SCR_SUCCESS;
+}
+
+/* return view cached for the given rank, or NULL if there is none,
+ * caller must hold the lock */
+static scr_filemap_view* scr_rebuild_cache_lookup(scr_rebuild_cache* cache, int rank)
+{
+  char rank_str[32];
+  snprintf(rank_str, sizeof(rank_str), "%d", rank);
+  void* ptr = NULL;
+  kvtree_util_get_ptr(cache->filemaps, rank_str, &ptr);
+  return (scr_filemap_view*) ptr;
+}
+
+/* add view to the cache unless it already has one for this rank,
+ * in which case the given view is closed, returns the cached view,
+ * caller must hold the lock */
+static scr_filemap_view* scr_rebuild_cache_insert(scr_rebuild_cache* cache, int rank, scr_filemap_view** ptr_view)
+{
+  /* another thread may have read this filemap while we did,
+   * keep the first one since others may already be using it */
+  scr_filemap_view* cached = scr_rebuild_cache_lookup(cache, rank);
+  if (cached != NULL) {
+    scr_filemap_view_close(ptr_view);
+    return cached;
+  }
+
+  char rank_str[32];
+  snprintf(rank_str, sizeof(rank_str), "%d", rank);
+  kvtree_util_set_ptr(cache->filemaps, rank_str, *ptr_view);
+
+  cached = *ptr_view;
+  *ptr_view = NULL;
+  return cached;
+}
+
+/* add filemap view for the given rank to the cache,
+ * the cache takes ownership of the view and sets the caller's pointer to NULL */
+int scr_rebuild_cache_add(scr_rebuild_cache* cache, int rank, scr_filemap_view** ptr_view)
+{
+#ifdef HAVE_PTHREADS
+  pthread_mutex_lock(&cache->lock);
+#endif
+  scr_rebuild_cache_insert(cache, rank, ptr_view);
+#ifdef HAVE_PTHREADS
+  pthread_mutex_unlock(&cache->lock);
+#endif
+  return SCR_SUCCESS;
+}
+
+/* return view of filemap for the given rank, reading it from the dataset
+ * directory if it is not in the cache, sets allocated to 1 if the caller
+ * must close the returned view, returns NULL if the filemap can't be read */
+static scr_filemap_view* scr_rebuild_filemap_get(
+  const spath* path_prefix,
+  int rank,
+  scr_rebuild_cache* cache,
+  int* allocated)
+{
+  *allocated = 0;
+
+  /* check whether we've already read this filemap */
+  if (cache != NULL) {
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&cache->lock);
+#endif
+    scr_filemap_view* cached = scr_rebuild_cache_lookup(cache, rank);
+#ifdef HAVE_PTHREADS
+    pthread_mutex_unlock(&cache->lock);
+#endif
+    if (cached != NULL) {
+      return cached;
+    }
+  }
+
+  /* define name of filemap file for this rank */
+  spath* filemap_path = spath_dup(path_prefix);
+  spath_append_strf(filemap_path, "filemap_%d", rank);
+
+  /* read in filemap for this member */
+  scr_filemap_view* view = scr_filemap_view_open(filemap_path);
+
+  /* free the name of the filemap file */
+  spath_delete(&filemap_path);
+
+  if (view == NULL) {
+    return NULL;
+  }
+
+  /* remember the filemap for other rebuilds */
+  if (cache != NULL) {
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&cache->lock);
+#endif
+    scr_filemap_view* cached = scr_rebuild_cache_insert(cache, rank, &view);
+#ifdef HAVE_PTHREADS
+    pthread_mutex_unlock(&cache->lock);
+#endif
+    return cached;
+  }
+
+  *allocated = 1;
+  return view;
+}
+
+/* given a file record from a filemap, allocate and return
+ * corresponding path to file in prefix directory */
+static char* lookup_path(const scr_filemap_record* rec)
+{
+  /* get original filename */
+  if (rec->origname == NULL) {
+    scr_err("Failed to read original name for file %s @ %s:%d",
+      rec->file, __FILE__, __LINE__
+    );
+    return NULL;
+  }
+
+  /* get original path of file */
+  if (rec->origpath == NULL) {
+    scr_err("Failed to read original path for file %s @ %s:%d",
+      rec->file, __FILE__, __LINE__
+    );
+    return NULL;
+  }
+
+  /* construct full path to file */
+  spath* path_user_full = spath_from_str(rec->origname);
+  spath_prepend_str(path_user_full, rec->origpath);
+  spath_reduce(path_user_full);
+
+  /* make a copy of the full path */
+  char* path = spath_strdup(path_user_full);
+
+  /* free path */
+  spath_delete(&path_user_full);
+
+  return path;
+}
+
+/* this defines an output map that translates the path of the filemap
+ * as it was stored in cache to the map now stored in the prefix directory
+ * after a scavenge, this map will be needed to tell redset where those
+ * files are now located */
+static int build_map_filemap(
+  const spath* path_prefix,
+  redset_filelist list,
+  kvtree* map)
+{
+  if (list == NULL) {
+    /* failed to get a list */
+    return SCR_FAILURE;
+  }
+
+  /* get number of data files */
+  int num = redset_filelist_count(list);
+
+  /* iterate over list of files and define its new path for each one */
+  int j;
+  for (j = 0; j < num; j++) {
+    /* get name for this file */
+    const char* file = redset_filelist_file(list, j);
+
+    /* filemap files are stored in the dataset directory under their basename */
+    spath* path_name = spath_from_str(file);
+    spath_basename(path_name);
+    spath_prepend(path_name, path_prefix);
+    char* new_file = spath_strdup(path_name);
+    spath_delete(&path_name);
+
+    /* map from filemap as it was in cache to its new location */
+    kvtree_util_set_str(map, file, new_file);
+
+    scr_free(&new_file);
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* this defines an output map that translates the path of each user data file
+ * as it was stored in cache to the location where it is now stored within
+ * the prefix directory after a scavenge, this map is needed to tell redset
+ * where those files are now located */
+static int build_map_data(
+  const spath* path_prefix, /* path to the dataset directory holding the filemaps */
+  int set_size,             /* size of redundancy set */
+  int* ranks,               /* global mpi rank of each member in the redundancy set */
+  scr_rebuild_cache* cache, /* cache of filemaps, may be NULL */
+  kvtree* map)              /* output map that maps data file in cache to its location within prefix directory */
+{
+  int rc = SCR_SUCCESS;
+
+  /* get file name, file size, and open each of the user files that we have */
+  int i;
+  for (i = 0; i < set_size; i++) {
+    /* lookup global mpi rank for this group rank */
+    int rank = ranks[i];
+
+    /* get filemap for this member */
+    int allocated = 0;
+    scr_filemap_view* filemap = scr_rebuild_filemap_get(path_prefix, rank, cache, &allocated);
+    if (filemap == NULL) {
+      continue;
+    }
+
+    /* iterate over each file to define its new
+     * path and record in the output map */
+    int num = scr_filemap_view_num_files(filemap);
+    int j;
+    for (j = 0; j < num; j++) {
+      /* get original file name */
+      scr_filemap_record rec;
+      if (scr_filemap_view_get(filemap, j, &rec) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+        continue;
+      }
+      const char* file = rec.file;
+
+      /* get path of file, we have to remap based on filemap info */
+      char* new_file = lookup_path(&rec);
+      if (new_file == NULL) {
+        rc = SCR_FAILURE;
+        continue;
+      }
+
+      /* map original file name to new location */
+      kvtree_util_set_str(map, file, new_file);
+
+      /* get parent directory for file */
+      spath* user_dir_path = spath_from_str(new_file);
+      spath_reduce(user_dir_path);
+      spath_dirname(user_dir_path);
+
+      /* create directory */
+      if (! spath_is_null(user_dir_path)) {
+        char* user_dir = spath_strdup(user_dir_path);
+        mode_t mode_dir = scr_getmode(1, 1, 1);
+        if (scr_mkdir(user_dir, mode_dir) != SCR_SUCCESS) {
+          scr_err("Failed to create directory for user file %s @ %s:%d",
+            user_dir, __FILE__, __LINE__
+          );
+          rc = SCR_FAILURE;
+        }
+        scr_free(&user_dir);
+      }
+
+      /* free directory */
+      spath_delete(&user_dir_path);
+
+      scr_free(&new_file);
+    }
+
+    if (allocated) {
+      scr_filemap_view_close(&filemap);
+    }
+  }
+
+  return rc;
+}
+
+struct scr_rebuild_set_struct {
+  char* scheme;     /* redundancy scheme, one of the SCR_REBUILD_* values */
+  int numfiles;     /* number of redundancy files */
+  char** paths;     /* absolute path to each redundancy file */
+  char* prefix;     /* prefix of the redset files */
+  kvtree* map;      /* maps each file as it was in cache to its path in the dataset */
+  int rc;           /* SCR_FAILURE if some files could not be mapped */
+};
+
+/* free a prepared rebuild */
+int scr_rebuild_set_delete(scr_rebuild_set** ptr_set)
+{
+  if (ptr_set != NULL) {
+    scr_rebuild_set* set = *ptr_set;
+    if (set != NULL) {
+      int i;
+      for (i = 0; i < set->numfiles; i++) {
+        scr_free(&set->paths[i]);
+      }
+      scr_free(&set->paths);
+      scr_free(&set->scheme);
+      scr_free(&set->prefix);
+      kvtree_delete(&set->map);
+    }
+    scr_free(ptr_set);
+  }
+  return SCR_SUCCESS;
+}
+
+/* read the headers of the redundancy files of a single set in dataset
+ * directory dir and map each missing file to its path in the dataset,
+ * creating the directories it will be written to, scheme is one of the
+ * SCR_REBUILD_* values, build_data is 1 to rebuild user data files and
+ * 0 to rebuild filemaps, files lists the existing redundancy files of the
+ * set relative to dir, filemaps are read through cache if it is not NULL,
+ * returns NULL if the set can't be rebuilt */
+scr_rebuild_set* scr_rebuild_prepare(
+  const spath* dir,
+  const char* scheme,
+  int build_data,
+  int numfiles,
+  const char** files,
+  scr_rebuild_cache* cache)
+{
+  /* refer to files with absolute paths, so that the decode
+   * does not depend on the current working directory */
+  spath* path_prefix = spath_dup(dir);
+  if (! spath_is_absolute(path_prefix)) {
+    char cwd[SCR_MAX_FILENAME];
+    if (scr_getcwd(cwd, sizeof(cwd)) != SCR_SUCCESS) {
+      scr_err("Failed to read current working directory @ %s:%d",
+        __FILE__, __LINE__
+      );
+      spath_delete(&path_prefix);
+      return NULL;
+    }
+    spath_prepend_str(path_prefix, cwd);
+  }
+  spath_reduce(path_prefix);
+
+  scr_rebuild_set* set = (scr_rebuild_set*) SCR_MALLOC(sizeof(scr_rebuild_set));
+  set->scheme   = strdup(scheme);
+  set->numfiles = numfiles;
+  set->paths    = NULL;
+  set->prefix   = NULL;
+  set->map      = kvtree_new();
+  set->rc       = SCR_SUCCESS;
+
+  /* build full path to each redundancy file */
+  if (numfiles > 0) {
+    set->paths = (char**) SCR_MALLOC(numfiles * sizeof(char*));
+  }
+  int i;
+  for (i = 0; i < numfiles; i++) {
+    spath* file_path = spath_dup(path_prefix);
+    spath_append_str(file_path, files[i]);
+    set->paths[i] = spath_strdup(file_path);
+    spath_delete(&file_path);
+  }
+
+  /* read in the size of the redundancy set and its member ranks */
+  int set_size = 0;
+  int* global_ranks = NULL;
+  redset_filelist list = NULL;
+  const char** paths = (const char**) set->paths;
+  if (strcmp(scheme, SCR_REBUILD_PARTNER) == 0) {
+    list = redset_filelist_get_data_partner(numfiles, paths, &set_size, &global_ranks);
+  } else if (strcmp(scheme, SCR_REBUILD_XOR) == 0) {
+    list = redset_filelist_get_data_xor(numfiles, paths, &set_size, &global_ranks);
+  } else if (strcmp(scheme, SCR_REBUILD_RS) == 0) {
+    list = redset_filelist_get_data_rs(numfiles, paths, &set_size, &global_ranks);
+  } else {
+    scr_err("Unknown redundancy scheme %s @ %s:%d",
+      scheme, __FILE__, __LINE__
+    );
+  }
+
+  /* failed to get the file list for some reason */
+  if (list == NULL) {
+    scr_rebuild_set_delete(&set);
+    spath_delete(&path_prefix);
+    return NULL;
+  }
+
+  /* define map from cache locations to prefix directory
+   * and prefix of redset files */
+  spath* file_prefix = spath_dup(path_prefix);
+  if (build_data) {
+    spath_append_str(file_prefix, "reddesc.er.");
+    set->rc = build_map_data(path_prefix, set_size, global_ranks, cache, set->map);
+  } else {
+    spath_append_str(file_prefix, "reddescmap.er.");
+    set->rc = build_map_filemap(path_prefix, list, set->map);
+  }
+  set->prefix = spath_strdup(file_prefix);
+  spath_delete(&file_prefix);
+
+  redset_filelist_release(&list);
+  scr_free(&global_ranks);
+  spath_delete(&path_prefix);
+
+  return set;
+}
+
+/* decode the missing files of a prepared set, returns SCR_SUCCESS
+ * if the files were rebuilt and all of them could be mapped */
+int scr_rebuild_decode(const scr_rebuild_set* set)
+{
+  int redset_rc;
+  const char** paths = (const char**) set->paths;
+  if (strcmp(set->scheme, SCR_REBUILD_PARTNER) == 0) {
+    redset_rc = redset_rebuild_partner(set->numfiles, paths, set->prefix, set->map);
+  } else if (strcmp(set->scheme, SCR_REBUILD_XOR) == 0) {
+    redset_rc = redset_rebuild_xor(set->numfiles, paths, set->prefix, set->map);
+  } else {
+    redset_rc = redset_rebuild_rs(set->numfiles, paths, set->prefix, set->map);
+  }
+
+  if (redset_rc != REDSET_SUCCESS) {
+    /* rebuild failed */
+    return SCR_FAILURE;
+  }
+  return set->rc;
+}
+
+/* rebuild the missing files of a single redundancy set in dataset directory dir,
+ * scheme is one of the SCR_REBUILD_* values, build_data is 1 to rebuild
+ * user data files and 0 to rebuild filemaps, files lists the existing
+ * redundancy files of the set relative to dir, filemaps are read through
+ * cache if it is not NULL, returns SCR_SUCCESS if the files were rebuilt */
+int scr_rebuild_files(
+  const spath* dir,
+  const char* scheme,
+  int build_data,
+  int numfiles,
+  const char** files,
+  scr_rebuild_cache* cache)
+{
+  scr_rebuild_set* set = scr_rebuild_prepare(dir, scheme, build_data, numfiles, files, cache);
+  if (set == NULL) {
+    return SCR_FAILURE;
+  }
+
+  int rc = scr_rebuild_decode(set);
+
+  scr_rebuild_set_delete(&set);
+
+  return rc;
+}
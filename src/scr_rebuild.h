@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_REBUILD_H
+#define SCR_REBUILD_H
+
+#include "spath.h"
+#include "scr_filemap.h"
+
+/* redundancy schemes that can be rebuilt */
+#define SCR_REBUILD_PARTNER "partner"
+#define SCR_REBUILD_XOR     "xor"
+#define SCR_REBUILD_RS      "rs"
+
+/* cache of filemaps read from a dataset directory, so that
+ * each filemap is parsed only once across many rebuilds,
+ * the cache may be filled by scans running in different threads */
+typedef struct scr_rebuild_cache_struct scr_rebuild_cache;
+
+/* allocate an empty filemap cache */
+scr_rebuild_cache* scr_rebuild_cache_new(void);
+
+/* free a filemap cache and all filemaps it holds */
+int scr_rebuild_cache_delete(scr_rebuild_cache** ptr_cache);
+
+/* add filemap view for the given rank to the cache,
+ * the cache takes ownership of the view and sets the caller's pointer to NULL */
+int scr_rebuild_cache_add(scr_rebuild_cache* cache, int rank, scr_filemap_view** ptr_view);
+
+/* a redundancy set whose missing files are ready to be decoded */
+typedef struct scr_rebuild_set_struct scr_rebuild_set;
+
+/* read the headers of the redundancy files of a single set in dataset
+ * directory dir and map each missing file to its path in the dataset,
+ * creating the directories it will be written to, scheme is one of the
+ * SCR_REBUILD_* values, build_data is 1 to rebuild user data files and
+ * 0 to rebuild filemaps, files lists the existing redundancy files of the
+ * set relative to dir, filemaps are read through cache if it is not NULL,
+ * returns NULL if the set can't be rebuilt */
+scr_rebuild_set* scr_rebuild_prepare(
+  const spath* dir,
+  const char* scheme,
+  int build_data,
+  int numfiles,
+  const char** files,
+  scr_rebuild_cache* cache
+);
+
+/* decode the missing files of a prepared set, returns SCR_SUCCESS
+ * if the files were rebuilt and all of them could be mapped,
+ * redset is not known to be thread safe, so callers that decode several
+ * sets at once do so in separate processes */
+int scr_rebuild_decode(const scr_rebuild_set* set);
+
+/* free a prepared rebuild */
+int scr_rebuild_set_delete(scr_rebuild_set** ptr_set);
+
+/* rebuild the missing files of a single redundancy set in dataset directory dir,
+ * scheme is one of the SCR_REBUILD_* values, build_data is 1 to rebuild
+ * user data files and 0 to rebuild filemaps, files lists the existing
+ * redundancy files of the set relative to dir, filemaps are read through
+ * cache if it is not NULL, returns SCR_SUCCESS if the files were rebuilt */
+int scr_rebuild_files(
+  const spath* dir,
+  const char* scheme,
+  int build_data,
+  int numfiles,
+  const char** files,
+  scr_rebuild_cache* cache
+);
+
+#endif
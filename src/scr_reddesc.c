@@ -527,11 +527,14 @@ static int scr_reddesc_apply_to_filemap(const scr_reddesc* desc, int id, const s
   return rc;
 }
 
-/* apply redundancy scheme to files */
+/* apply redundancy scheme to files, if checked is set, the caller has
+ * just recorded the size and complete flag of each file in its meta data,
+ * so those values are used rather than checking the files again */
 int scr_reddesc_apply(
   scr_filemap* map,
   const scr_reddesc* desc,
-  int id)
+  int id,
+  int checked)
 {
   /* start timer */
   time_t timestamp_start;
@@ -554,14 +557,27 @@ int scr_reddesc_apply(
     char* file = kvtree_elem_key(file_elem);
 
     /* check the file */
-    if (! scr_bool_have_file(map, file)) {
-      scr_dbg(2, "File determined to be invalid: %s", file);
-      valid = 0;
+    unsigned long filesize = 0;
+    if (checked) {
+      /* use the complete flag and size the caller recorded in the meta data */
+      const scr_meta* meta = scr_filemap_peek_meta(map, file);
+      if (meta == NULL || scr_meta_is_complete(meta) != SCR_SUCCESS) {
+        scr_dbg(2, "File determined to be invalid: %s", file);
+        valid = 0;
+      } else {
+        scr_meta_get_filesize(meta, &filesize);
+      }
+    } else {
+      if (! scr_bool_have_file(map, file)) {
+        scr_dbg(2, "File determined to be invalid: %s", file);
+        valid = 0;
+      }
+      filesize = scr_file_size(file);
     }
 
     /* add up the number of files and bytes on our way through */
     my_counts[0] += 1;
-    my_counts[1] += scr_file_size(file);
+    my_counts[1] += filesize;
 
     /* if crc_on_copy is set, compute crc and update meta file */
     if (scr_crc_on_copy) {
@@ -638,6 +654,14 @@ int scr_reddesc_apply(
     /* get the filename */
     char* file = kvtree_elem_key(file_elem);
 
+    /* for an incremental checkpoint, protect the changed blocks of the file,
+     * the full file is recreated from its base after a rebuild */
+    const scr_meta* meta = scr_filemap_peek_meta(map, file);
+    char* delta_file;
+    if (meta != NULL && scr_meta_get_delta(meta, &delta_file, NULL, NULL, NULL) == SCR_SUCCESS) {
+      file = delta_file;
+    }
+
     /* add file to the set */
     if (ER_Add(set_id, file) != ER_SUCCESS) {
       scr_err("Failed to add file to ER set: %s @ %s:%d", file, __FILE__, __LINE__);
@@ -756,6 +780,9 @@ int scr_reddesc_recover(scr_cache_index* cindex, int id, const char* dir)
   }
   scr_free(&reddesc_filemap);
 
+  /* the filemap may have been rewritten, so read it again on next use */
+  scr_cache_forget_map(id);
+
   /* if dataset was a cache bypass, we stop after recovering the filemap,
    * since no redundancy was applied to data files in prefix directory */
   int bypass;
@@ -804,6 +831,14 @@ int scr_reddesc_recover(scr_cache_index* cindex, int id, const char* dir)
   }
   scr_free(&reddesc_data);
 
+  /* recreate any full file stored as changed blocks, datasets are rebuilt
+   * from oldest to newest, so base files have already been recovered */
+  if (scr_alltrue(rc == SCR_SUCCESS, scr_comm_world)) {
+    rc = scr_delta_restore(cindex, id);
+  } else {
+    rc = SCR_FAILURE;
+  }
+
   return rc;
 }
 
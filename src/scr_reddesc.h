@@ -105,11 +105,14 @@ scr_storedesc* scr_reddesc_get_store(
   const scr_reddesc* desc
 );
 
-/* apply redundancy scheme to files */
+/* apply redundancy scheme to files, if checked is set, the caller has
+ * just recorded the size and complete flag of each file in its meta data,
+ * so those values are used rather than checking the files again */
 int scr_reddesc_apply(
   scr_filemap* map,
   const scr_reddesc* c,
-  int id
+  int id,
+  int checked
 );
 
 /* rebuilds files for specified dataset id using specified redundancy descriptor,
@@ -11,6 +11,7 @@
 
 /* Reads parameters from environment and configuration files */
 
+#include "scr_conf.h"
 #include "scr.h"
 #include "scr_err.h"
 #include "scr_io.h"
@@ -35,6 +36,11 @@
 /* pull in things like ULLONG_MAX */
 #include <limits.h>
 
+/* worker threads */
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 /* TODO: support processing of byte values */
 
 /* given a string, convert it to a double and write that value to val */
@@ -361,6 +367,29 @@ int kvtree_write_path(const spath* path, const kvtree* tree)
   return rc;
 }
 
+int scr_kvtree_write_atomic(const spath* path, const kvtree* tree)
+{
+  int rc = SCR_SUCCESS;
+  char* file = spath_strdup(path);
+
+  /* write to a temporary file in the same directory */
+  char tmpfile[SCR_MAX_FILENAME];
+  if (scr_file_tmpname(file, tmpfile, sizeof(tmpfile)) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  } else if (kvtree_write_file(tmpfile, tree) != KVTREE_SUCCESS) {
+    scr_file_unlink(tmpfile);
+    rc = SCR_FAILURE;
+  }
+
+  /* move the temporary file in place of the original */
+  if (rc == SCR_SUCCESS) {
+    rc = scr_file_replace(tmpfile, file);
+  }
+
+  scr_free(&file);
+  return rc;
+}
+
 /* given a string defining SCR_PREFIX value as given by user
  * return spath of fully qualified path, user should free */
 spath* scr_get_prefix(const char* str)
@@ -389,3 +418,77 @@ spath* scr_get_prefix(const char* str)
 
   return prefix_path;
 }
+
+/* a group of workers, some of which may run in their own thread */
+struct scr_workers_struct {
+  int n;                /* number of workers */
+#ifdef HAVE_PTHREADS
+  pthread_t* tids;      /* thread of each worker */
+  int* started;         /* whether each worker got its own thread */
+#endif
+};
+
+/* starts n workers, worker i calls fn(args + i * arg_size) in its own thread,
+ * a worker that cannot get a thread runs to completion before this returns */
+scr_workers* scr_workers_start(int n, void* (*fn)(void*), void* args, size_t arg_size)
+{
+  if (n < 0) {
+    n = 0;
+  }
+
+  scr_workers* workers = (scr_workers*) SCR_MALLOC(sizeof(scr_workers));
+  workers->n = n;
+#ifdef HAVE_PTHREADS
+  workers->tids    = (pthread_t*) SCR_MALLOC(n * sizeof(pthread_t));
+  workers->started = (int*) SCR_MALLOC(n * sizeof(int));
+#endif
+
+  int i;
+  for (i = 0; i < n; i++) {
+    void* arg = (void*) ((char*) args + i * arg_size);
+
+    int started = 0;
+#ifdef HAVE_PTHREADS
+    started = (pthread_create(&workers->tids[i], NULL, fn, arg) == 0);
+    workers->started[i] = started;
+#endif
+
+    /* no thread, so do this worker's share ourself */
+    if (! started) {
+      fn(arg);
+    }
+  }
+
+  return workers;
+}
+
+/* waits for the workers to finish, then frees them and sets the pointer to NULL */
+void scr_workers_join(scr_workers** ptr)
+{
+  if (ptr == NULL || *ptr == NULL) {
+    return;
+  }
+
+#ifdef HAVE_PTHREADS
+  scr_workers* workers = *ptr;
+  int i;
+  for (i = 0; i < workers->n; i++) {
+    if (workers->started[i]) {
+      pthread_join(workers->tids[i], NULL);
+    }
+  }
+  scr_free(&workers->started);
+  scr_free(&workers->tids);
+#endif
+
+  scr_free(ptr);
+}
+
+/* runs n workers and returns once all have finished,
+ * the calling thread runs worker 0 itself */
+void scr_workers_run(int n, void* (*fn)(void*), void* args, size_t arg_size)
+{
+  scr_workers* workers = scr_workers_start(n - 1, fn, (char*) args + arg_size, arg_size);
+  fn(args);
+  scr_workers_join(&workers);
+}
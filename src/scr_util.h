@@ -78,8 +78,29 @@ int kvtree_read_path(const spath* path, kvtree* tree);
 /* convenience to write kvtree to an spath */
 int kvtree_write_path(const spath* path, const kvtree* tree);
 
+/* write kvtree to a temporary file next to path and rename it into place,
+ * so readers see either the old or the new contents but never a partial file,
+ * returns SCR_SUCCESS if the file was written */
+int scr_kvtree_write_atomic(const spath* path, const kvtree* tree);
+
 /* given a string defining SCR_PREFIX value as given by user
  * return spath of fully qualified path, user should free */
 spath* scr_get_prefix(const char* prefix);
 
+/* a group of workers started by scr_workers_start */
+typedef struct scr_workers_struct scr_workers;
+
+/* starts n workers, worker i calls fn(args + i * arg_size) in its own thread,
+ * pass an arg_size of 0 to give every worker the same argument, a worker
+ * that cannot get a thread, which is every worker without pthreads, runs
+ * to completion before this returns, free with scr_workers_join */
+scr_workers* scr_workers_start(int n, void* (*fn)(void*), void* args, size_t arg_size);
+
+/* waits for the workers to finish, then frees them and sets the pointer to NULL */
+void scr_workers_join(scr_workers** workers);
+
+/* same as scr_workers_start followed by scr_workers_join, but the calling
+ * thread runs worker 0 itself, runs at least one worker */
+void scr_workers_run(int n, void* (*fn)(void*), void* args, size_t arg_size);
+
 #endif
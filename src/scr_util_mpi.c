@@ -321,6 +321,55 @@ axl_xfer_t scr_xfer_str_to_axl_type(const char* str)
   return type;
 }
 
+/* returns 1 if files of the given transfer type can be copied with
+ * scr_file_copy_list rather than AXL, this is the case for the SYNC
+ * type, which AXL implements by copying each file through a user-space
+ * buffer, while scr_file_copy lets the kernel copy the data when possible,
+ * we leave it to AXL if it needs a state file or must create directories */
+static int scr_file_copy_list_ok(axl_xfer_t type, const char* state_file)
+{
+  return (type == AXL_XFER_SYNC && state_file == NULL && ! scr_axl_mkdir);
+}
+
+/* copy files for the calling process without AXL,
+ * stops at the first file that fails to copy */
+static int scr_file_copy_list(
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist)
+{
+  int i;
+  for (i = 0; i < num_files; i++) {
+    const char* src_file = src_filelist[i];
+    const char* dst_file = dest_filelist[i];
+
+    /* capture the permissions and timestamps of the source file */
+    scr_meta* meta = NULL;
+    struct stat statbuf;
+    if (scr_copy_metadata && stat(src_file, &statbuf) == 0) {
+      meta = scr_meta_new();
+      scr_meta_set_stat(meta, &statbuf);
+    }
+
+    /* copy the file and apply the source metadata to the new file */
+    int rc = scr_file_copy(src_file, dst_file, scr_file_buf_size, NULL, 0);
+    if (rc != SCR_SUCCESS) {
+      scr_err("Failed to copy %s --> %s @ %s:%d",
+        src_file, dst_file, __FILE__, __LINE__
+      );
+    } else if (meta != NULL) {
+      rc = scr_meta_apply_stat(meta, dst_file);
+    }
+    scr_meta_delete(&meta);
+
+    if (rc != SCR_SUCCESS) {
+      return SCR_FAILURE;
+    }
+  }
+
+  return SCR_SUCCESS;
+}
+
 int scr_axl(
   const char* name,
   const char* state_file,
@@ -332,6 +381,15 @@ int scr_axl(
 {
   int rc = SCR_SUCCESS;
 
+  /* copy files directly for the SYNC type if we can */
+  if (scr_file_copy_list_ok(type, state_file)) {
+    int success = (scr_file_copy_list(num_files, src_filelist, dest_filelist) == SCR_SUCCESS);
+    if (! scr_alltrue(success, comm)) {
+      rc = SCR_FAILURE;
+    }
+    return rc;
+  }
+
   /* define a transfer handle */
   int id = AXL_Create_comm(type, name, state_file, comm);
   if (id < 0) {
@@ -394,3 +452,274 @@ int scr_axl(
 
   return rc;
 }
+
+/* transfer files for the calling process using its own AXL handle,
+ * returns SCR_SUCCESS if all files were transferred */
+static int scr_axl_local(
+  const char* name,
+  const char* state_file,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type)
+{
+  int rc = SCR_SUCCESS;
+
+  /* copy files directly for the SYNC type if we can */
+  if (scr_file_copy_list_ok(type, state_file)) {
+    return scr_file_copy_list(num_files, src_filelist, dest_filelist);
+  }
+
+  /* define a transfer handle */
+  int id = AXL_Create(type, name, state_file);
+  if (id < 0) {
+    scr_err("Failed to create AXL transfer handle @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* add files to transfer list */
+  int i;
+  for (i = 0; i < num_files; i++) {
+    if (AXL_Add(id, src_filelist[i], dest_filelist[i]) != AXL_SUCCESS) {
+      scr_err("Failed to add file to AXL transfer handle %d: %s --> %s @ %s:%d",
+        id, src_filelist[i], dest_filelist[i], __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  /* kick off the transfer and wait for it to complete */
+  if (rc == SCR_SUCCESS) {
+    if (AXL_Dispatch(id) == AXL_SUCCESS) {
+      if (AXL_Wait(id) != AXL_SUCCESS) {
+        scr_err("Failed to wait on AXL transfer handle %d @ %s:%d",
+          id, __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+    } else {
+      scr_err("Failed to dispatch AXL transfer handle %d @ %s:%d",
+        id, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
+
+  /* release the handle */
+  if (AXL_Free(id) != AXL_SUCCESS) {
+    scr_err("Failed to free AXL transfer handle %d @ %s:%d",
+      id, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  return rc;
+}
+
+/* print bandwidth achieved by one window of processes,
+ * and record its stats in the stats hash if one is given */
+static void scr_axl_window_report(
+  const char* name,
+  int window,
+  int procs,
+  int files,
+  double bytes,
+  time_t timestamp_start,
+  double time_diff,
+  kvtree* stats)
+{
+  double bw = 0.0;
+  if (time_diff > 0.0) {
+    bw = bytes / (1024.0 * 1024.0 * time_diff);
+  }
+  scr_dbg(1, "scr_axl_window: `%s' window %d: %d procs, %d files, %f secs, %e bytes, %f MB/s, %f MB/s per proc",
+    name, window, procs, files, time_diff, bytes, bw, bw / (double) procs
+  );
+
+  if (stats != NULL) {
+    kvtree* hash = kvtree_set_kv_int(stats, SCR_WINDOW_KEY_WINDOW, window);
+    kvtree_util_set_unsigned_long(hash, SCR_WINDOW_KEY_START, (unsigned long) timestamp_start);
+    kvtree_util_set_double(hash, SCR_WINDOW_KEY_SECS,  time_diff);
+    kvtree_util_set_double(hash, SCR_WINDOW_KEY_BYTES, bytes);
+    kvtree_util_set_int(hash,    SCR_WINDOW_KEY_FILES, files);
+    kvtree_util_set_int(hash,    SCR_WINDOW_KEY_PROCS, procs);
+  }
+}
+
+/* transfer files via AXL with flow control, so that at most width
+ * processes in comm are transferring data at the same time,
+ * if pipeline is set, rank 0 runs a sliding window and starts a new
+ * process as soon as another finishes, otherwise processes run in
+ * waves of width and a wave starts only after the previous wave
+ * has completed, rank 0 reports the bandwidth of each group of
+ * width completed processes and records it in stats if not NULL,
+ * if width is not positive or if it covers all processes,
+ * this is the same as scr_axl */
+int scr_axl_window(
+  const char* name,
+  const char* state_file,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  int width,
+  int pipeline,
+  kvtree* stats,
+  MPI_Comm comm)
+{
+  /* get our rank and the number of ranks in comm */
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* no flow control needed if everyone can go at once */
+  if (width <= 0 || width >= ranks) {
+    return scr_axl(name, state_file, num_files, src_filelist, dest_filelist, type, comm);
+  }
+
+  /* count the number of bytes we'll transfer */
+  double bytes = 0.0;
+  int i;
+  for (i = 0; i < num_files; i++) {
+    bytes += (double) scr_file_size(src_filelist[i]);
+  }
+
+  /* hand off the window on a private communicator,
+   * so our messages can't match other traffic on comm */
+  MPI_Comm window_comm;
+  MPI_Comm_dup(comm, &window_comm);
+
+  int success = 1;
+  if (rank == 0) {
+    /* allocate a slot for each process that may be active at once,
+     * each slot has a send buffer for the start message and a receive
+     * buffer for the success flag, file count, and byte count we get back */
+    int* starts      = (int*)         SCR_MALLOC(width * sizeof(int));
+    double* replies  = (double*)      SCR_MALLOC(3 * width * sizeof(double));
+    MPI_Request* req = (MPI_Request*) SCR_MALLOC(2 * width * sizeof(MPI_Request));
+    for (i = 0; i < 2 * width; i++) {
+      req[i] = MPI_REQUEST_NULL;
+    }
+
+    /* track progress of the current window */
+    int window = 0;
+    int window_procs = 0;
+    int window_files = 0;
+    double window_bytes = 0.0;
+    time_t timestamp_start = scr_log_seconds();
+    double window_start = MPI_Wtime();
+
+    /* we start width-1 other processes, take the last slot to transfer
+     * our own files, and then feed the remaining processes through
+     * the window as slots free up */
+    int next = 1;
+    int outstanding = 0;
+    int have_transferred = 0;
+    while (next < ranks || outstanding > 0 || ! have_transferred) {
+      /* fill up free slots, leaving one for ourself if we've not gone yet,
+       * without pipelining we wait until the current wave is done */
+      int limit = have_transferred ? width : width - 1;
+      int slot = 0;
+      if (pipeline || outstanding == 0) {
+        while (next < ranks && outstanding < limit) {
+          /* find a free slot */
+          while (req[slot] != MPI_REQUEST_NULL) {
+            slot++;
+          }
+
+          /* post a receive for the reply we'll get when rank next is done */
+          MPI_Irecv(&replies[3 * slot], 3, MPI_DOUBLE, next, 0, window_comm, &req[slot]);
+
+          /* send a start message to rank next */
+          starts[slot] = 1;
+          MPI_Isend(&starts[slot], 1, MPI_INT, next, 0, window_comm, &req[slot + width]);
+
+          next++;
+          outstanding++;
+        }
+      }
+
+      /* transfer our own files */
+      if (! have_transferred) {
+        if (scr_axl_local(name, state_file, num_files, src_filelist, dest_filelist, type) != SCR_SUCCESS) {
+          success = 0;
+        }
+        have_transferred = 1;
+
+        /* count ourself as a completed process */
+        window_procs++;
+        window_files += num_files;
+        window_bytes += bytes;
+      } else {
+        /* wait to hear back from any process */
+        MPI_Status status;
+        MPI_Waitany(width, req, &slot, &status);
+
+        /* the corresponding send must be complete */
+        MPI_Wait(&req[slot + width], &status);
+
+        /* check success code from process and add its files and bytes */
+        if (replies[3 * slot] == 0.0) {
+          success = 0;
+        }
+        window_procs++;
+        window_files += (int) replies[3 * slot + 1];
+        window_bytes += replies[3 * slot + 2];
+        outstanding--;
+      }
+
+      /* report bandwidth for each window of width processes */
+      if (window_procs == width) {
+        double now = MPI_Wtime();
+        scr_axl_window_report(name, window, window_procs, window_files, window_bytes,
+          timestamp_start, now - window_start, stats
+        );
+        window++;
+        window_procs = 0;
+        window_files = 0;
+        window_bytes = 0.0;
+        timestamp_start = scr_log_seconds();
+        window_start = now;
+      }
+    }
+
+    /* report the last partial window */
+    if (window_procs > 0) {
+      double now = MPI_Wtime();
+      scr_axl_window_report(name, window, window_procs, window_files, window_bytes,
+        timestamp_start, now - window_start, stats
+      );
+    }
+
+    scr_free(&req);
+    scr_free(&replies);
+    scr_free(&starts);
+  } else {
+    /* wait for the signal to start */
+    int start = 0;
+    MPI_Status status;
+    MPI_Recv(&start, 1, MPI_INT, 0, 0, window_comm, &status);
+
+    /* transfer our files */
+    if (scr_axl_local(name, state_file, num_files, src_filelist, dest_filelist, type) != SCR_SUCCESS) {
+      success = 0;
+    }
+
+    /* tell rank 0 that we're done, whether we succeeded, and how much we moved */
+    double reply[3];
+    reply[0] = (double) success;
+    reply[1] = (double) num_files;
+    reply[2] = bytes;
+    MPI_Send(reply, 3, MPI_DOUBLE, 0, 0, window_comm);
+  }
+
+  MPI_Comm_free(&window_comm);
+
+  /* determine whether everyone transferred their files ok */
+  if (! scr_alltrue(success, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
@@ -12,6 +12,7 @@
 #ifndef SCR_UTIL_MPI_H
 #define SCR_UTIL_MPI_H
 
+#include "kvtree.h"
 #include "axl_mpi.h"
 
 /*
@@ -72,4 +73,25 @@ int scr_axl(
   MPI_Comm comm
 );
 
+/* transfer files via AXL with flow control, so that at most width
+ * processes in comm are transferring data at the same time,
+ * if pipeline is set, a new process starts as soon as another finishes,
+ * otherwise processes run in waves of width processes,
+ * rank 0 reports the bandwidth achieved by each window of processes
+ * and records it under SCR_WINDOW_KEY_WINDOW in stats if not NULL,
+ * if width is not positive or if it covers all processes,
+ * this is the same as scr_axl */
+int scr_axl_window(
+  const char* name,
+  const char* state_file,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  int width,
+  int pipeline,
+  kvtree* stats,
+  MPI_Comm comm
+);
+
 #endif